@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include <demi/types.h>
+#include <stddef.h>
+
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Maximum number of fan-in values that may be given on the command line.
+ */
+#define MAX_FANINS 32
+
+/*====================================================================================================================*
+ * Structures                                                                                                         *
+ *====================================================================================================================*/
+
+/**
+ * @brief Role of this process in a scenario that involves two processes.
+ */
+enum peer
+{
+    PEER_NONE,   /**< Scenario runs in a single process. */
+    PEER_SERVER, /**< Echoes messages back to the client. */
+    PEER_CLIENT, /**< Sends messages to the server and measures round trips. */
+};
+
+/**
+ * @brief Benchmark configuration.
+ */
+struct config
+{
+    unsigned iterations;          /**< Number of measured iterations.                    */
+    unsigned warmup;              /**< Number of iterations that run before measuring.   */
+    size_t size;                  /**< Size of each message (in bytes).                  */
+    unsigned fanins[MAX_FANINS];  /**< Number of queue tokens to wait on.                */
+    unsigned nfanins;             /**< Number of entries in fanins.                      */
+    enum peer peer;               /**< Role of this process.                             */
+    struct sockaddr_in local;     /**< Local socket address.                             */
+    struct sockaddr_in remote;    /**< Remote socket address.                            */
+    int has_local;                /**< Was a local socket address given?                 */
+    int has_remote;               /**< Was a remote socket address given?                */
+    const char *pipe_name;        /**< Name of the pipe that memory scenarios go through. */
+    unsigned connections;         /**< Number of connections that the load scenario opens. */
+    unsigned rate;                /**< Target request rate of the load scenario (per second). */
+};
+
+/*====================================================================================================================*
+ * Scenarios                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Measures demi_wait_any() on pending operations, at every fan-in in the configuration.
+ *
+ * @param config Benchmark configuration.
+ */
+extern void bench_wait_any(const struct config *config);
+
+/**
+ * @brief Measures demi_wait_group_wait() on pending operations, at every fan-in in the configuration.
+ *
+ * @param config Benchmark configuration.
+ */
+extern void bench_wait_group(const struct config *config);
+
+/**
+ * @brief Releases the resources of the wait scenarios. This must be called before exiting.
+ */
+extern void bench_wait_release(void);
+
+/**
+ * @brief Measures a demi_sgaalloc() and demi_sgafree() pair.
+ *
+ * @param config Benchmark configuration.
+ */
+extern void bench_sga(const struct config *config);
+
+/**
+ * @brief Measures a push and pop round through a memory pipe.
+ *
+ * @param config Benchmark configuration.
+ */
+extern void bench_pipe(const struct config *config);
+
+/**
+ * @brief Measures UDP ping-pong round trips.
+ *
+ * @param config Benchmark configuration.
+ */
+extern void bench_udp(const struct config *config);
+
+/**
+ * @brief Measures TCP ping-pong round trips.
+ *
+ * @param config Benchmark configuration.
+ */
+extern void bench_tcp(const struct config *config);
+
+/**
+ * @brief Measures open-loop TCP request-response latency across many connections.
+ *
+ * @param config Benchmark configuration.
+ */
+extern void bench_load(const struct config *config);
+
+#endif /* !BENCH_H_ */
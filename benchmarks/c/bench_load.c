@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "bench.h"
+#include "report.h"
+#include "stopwatch.h"
+#include <assert.h>
+#include <demi/libos.h>
+#include <demi/sga.h>
+#include <demi/wait.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+/*====================================================================================================================*
+ * Structures                                                                                                         *
+ *====================================================================================================================*/
+
+/**
+ * @brief Operations that are in flight across all connections.
+ *
+ * The three arrays are indexed alike, so that the offset that demi_wait_any() hands back finds the connection and
+ * buffer of the completed operation in constant time.
+ */
+struct inflight
+{
+    demi_qtoken_t *qts;   /** Queue tokens of the pending operations.                 */
+    unsigned *conns;      /** Connection of each pending operation.                   */
+    demi_sgarray_t *sgas; /** Scatter-gather array of each pending push, to free later. */
+    unsigned n;           /** Number of pending operations.                           */
+    unsigned capacity;    /** Number of entries that the arrays hold.                 */
+};
+
+/**
+ * @brief State of one client connection.
+ */
+struct connection
+{
+    int qd;              /** Queue descriptor.                                   */
+    size_t partial;      /** Bytes received towards the oldest pending response. */
+    unsigned ncompleted; /** Number of responses received.                       */
+    unsigned nrequests;  /** Number of requests that go through this connection. */
+};
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Adds an operation to the set of operations in flight.
+ *
+ * @param inflight Target set.
+ * @param qt       Queue token of the operation.
+ * @param conn     Connection of the operation.
+ * @param sga      Scatter-gather array to free once a push completes, or NULL on pops.
+ */
+static void inflight_add(struct inflight *inflight, demi_qtoken_t qt, unsigned conn, const demi_sgarray_t *sga)
+{
+    if (inflight->n == inflight->capacity)
+    {
+        inflight->capacity = (inflight->capacity > 0) ? (2 * inflight->capacity) : 64;
+        assert((inflight->qts = realloc(inflight->qts, sizeof(demi_qtoken_t) * inflight->capacity)) != NULL);
+        assert((inflight->conns = realloc(inflight->conns, sizeof(unsigned) * inflight->capacity)) != NULL);
+        assert((inflight->sgas = realloc(inflight->sgas, sizeof(demi_sgarray_t) * inflight->capacity)) != NULL);
+    }
+
+    inflight->qts[inflight->n] = qt;
+    inflight->conns[inflight->n] = conn;
+    if (sga != NULL)
+        memcpy(&inflight->sgas[inflight->n], sga, sizeof(demi_sgarray_t));
+    else
+        memset(&inflight->sgas[inflight->n], 0, sizeof(demi_sgarray_t));
+    inflight->n++;
+}
+
+/**
+ * @brief Removes an operation from the set of operations in flight, by moving the last one into its place.
+ *
+ * @param inflight Target set.
+ * @param offset   Offset of the operation.
+ */
+static void inflight_remove(struct inflight *inflight, unsigned offset)
+{
+    assert(offset < inflight->n);
+
+    inflight->n--;
+    inflight->qts[offset] = inflight->qts[inflight->n];
+    inflight->conns[offset] = inflight->conns[inflight->n];
+    inflight->sgas[offset] = inflight->sgas[inflight->n];
+}
+
+/**
+ * @brief Releases the set of operations in flight. Operations that are still pending are left to demi_close().
+ *
+ * @param inflight Target set.
+ */
+static void inflight_release(struct inflight *inflight)
+{
+    free(inflight->qts);
+    free(inflight->conns);
+    free(inflight->sgas);
+    memset(inflight, 0, sizeof(struct inflight));
+}
+
+/**
+ * @brief Returns the number of bytes in a scatter-gather array.
+ *
+ * @param sga Target scatter-gather array.
+ *
+ * @return The sum of the lengths of all segments.
+ */
+static size_t sga_len(const demi_sgarray_t *sga)
+{
+    size_t len = 0;
+
+    for (uint32_t i = 0; i < sga->sga_numsegs; i++)
+        len += sga->sga_segs[i].sgaseg_len;
+
+    return (len);
+}
+
+/**
+ * @brief Converts an interval in nanoseconds to a timeout.
+ *
+ * @param ns      Interval in nanoseconds. Negative intervals yield a zero timeout.
+ * @param timeout Store location for the timeout.
+ */
+static void ns_to_timespec(long long ns, struct timespec *timeout)
+{
+    if (ns < 0)
+        ns = 0;
+
+    timeout->tv_sec = (time_t)(ns / 1000000000);
+    timeout->tv_nsec = (long)(ns % 1000000000);
+}
+
+/**
+ * @brief Accepts connections and echoes everything that they send, until @p nbytes bytes went through.
+ *
+ * Every connection keeps one pop pending, and echoes are pushed without waiting, so a slow connection never holds up
+ * the others.
+ *
+ * @param config Benchmark configuration.
+ * @param sockqd Listening socket.
+ * @param nbytes Number of bytes to echo across all connections.
+ */
+static void load_server(const struct config *config, int sockqd, size_t nbytes)
+{
+    struct inflight inflight = {0};
+    int *qds = NULL;
+    unsigned npushes = 0;
+
+    assert((qds = malloc(sizeof(int) * config->connections)) != NULL);
+
+    for (unsigned i = 0; i < config->connections; i++)
+    {
+        demi_qtoken_t qt = -1;
+        demi_qresult_t qr = {0};
+
+        assert(demi_accept(&qt, sockqd) == 0);
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        assert(qr.qr_opcode == DEMI_OPC_ACCEPT);
+        qds[i] = qr.qr_value.ares.qd;
+
+        assert(demi_pop(&qt, qds[i]) == 0);
+        inflight_add(&inflight, qt, i, NULL);
+    }
+
+    while ((nbytes > 0) || (npushes > 0))
+    {
+        demi_qresult_t qr = {0};
+        demi_qtoken_t qt = -1;
+        int offset = -1;
+
+        assert(demi_wait_any(&qr, &offset, inflight.qts, (int)inflight.n, NULL) == 0);
+
+        unsigned conn = inflight.conns[offset];
+        demi_sgarray_t pushed = inflight.sgas[offset];
+        inflight_remove(&inflight, (unsigned)offset);
+
+        if (qr.qr_opcode == DEMI_OPC_PUSH)
+        {
+            assert(demi_sgafree(&pushed) == 0);
+            npushes--;
+            continue;
+        }
+
+        assert(qr.qr_opcode == DEMI_OPC_POP);
+        size_t len = sga_len(&qr.qr_value.sga);
+        assert((len > 0) && (len <= nbytes));
+        nbytes -= len;
+
+        assert(demi_push(&qt, qds[conn], &qr.qr_value.sga) == 0);
+        inflight_add(&inflight, qt, conn, &qr.qr_value.sga);
+        npushes++;
+
+        assert(demi_pop(&qt, qds[conn]) == 0);
+        inflight_add(&inflight, qt, conn, NULL);
+    }
+
+    for (unsigned i = 0; i < config->connections; i++)
+        assert(demi_close(qds[i]) == 0);
+    inflight_release(&inflight);
+    free(qds);
+}
+
+/**
+ * @brief Sends requests at a fixed rate over several connections and reports the latency of each response.
+ *
+ * Request i is due at t0 + i / rate and goes through connection i % connections. Requests are sent when they are due,
+ * whether earlier responses came back or not, and latency runs from when the request was due rather than from when it
+ * was actually sent. A stall therefore shows up in the latency of every request that was due during the stall, instead
+ * of silently delaying them (coordinated omission).
+ *
+ * @param config Benchmark configuration.
+ * @param sockqd Socket of the first connection.
+ */
+static void load_client(const struct config *config, int sockqd)
+{
+    const unsigned nconns = config->connections;
+    const unsigned total = config->warmup + config->iterations;
+    const double interval_ns = 1000000000.0 / (double)config->rate;
+    struct inflight inflight = {0};
+    struct connection *conns = NULL;
+    unsigned nsent = 0;
+    unsigned ncompleted = 0;
+    unsigned npushes = 0;
+    long long t0 = 0;
+    long long first_due = 0;
+    long long last_done = 0;
+
+    assert((conns = calloc(nconns, sizeof(struct connection))) != NULL);
+
+    // Open every connection before the first request is due.
+    for (unsigned i = 0; i < nconns; i++)
+    {
+        demi_qtoken_t qt = -1;
+        demi_qresult_t qr = {0};
+
+        conns[i].qd = sockqd;
+        if (i > 0)
+            assert(demi_socket(&conns[i].qd, AF_INET, SOCK_STREAM, 0) == 0);
+        conns[i].nrequests = total / nconns + ((i < total % nconns) ? 1 : 0);
+
+        assert(demi_connect(&qt, conns[i].qd, (const struct sockaddr *)&config->remote, sizeof(struct sockaddr_in)) ==
+               0);
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        assert(qr.qr_opcode == DEMI_OPC_CONNECT);
+
+        if (conns[i].nrequests > 0)
+        {
+            assert(demi_pop(&qt, conns[i].qd) == 0);
+            inflight_add(&inflight, qt, i, NULL);
+        }
+    }
+
+    stopwatch_reset();
+    t0 = stopwatch_now();
+    first_due = t0 + (long long)((double)config->warmup * interval_ns);
+
+    // A response may come back before its push completes, so wait for both.
+    while ((ncompleted < total) || (npushes > 0))
+    {
+        demi_qresult_t qr = {0};
+        struct timespec timeout = {0};
+        int offset = -1;
+        int ret = 0;
+
+        // Send every request that is due by now.
+        for (long long now = stopwatch_now(); nsent < total; nsent++)
+        {
+            long long due = t0 + (long long)((double)nsent * interval_ns);
+            unsigned conn = nsent % nconns;
+            demi_qtoken_t qt = -1;
+            demi_sgarray_t sga = {0};
+
+            if (due > now)
+            {
+                ns_to_timespec(due - now, &timeout);
+                break;
+            }
+
+            sga = demi_sgaalloc(config->size);
+            assert(sga.sga_segs[0].sgaseg_buf != NULL);
+            memset(sga.sga_segs[0].sgaseg_buf, 1, config->size);
+            assert(demi_push(&qt, conns[conn].qd, &sga) == 0);
+            inflight_add(&inflight, qt, conn, &sga);
+            npushes++;
+        }
+
+        // Wait for a completion, but no longer than until the next request is due.
+        ret = demi_wait_any(&qr, &offset, inflight.qts, (int)inflight.n, (nsent < total) ? &timeout : NULL);
+        if (ret == ETIMEDOUT)
+            continue;
+        assert(ret == 0);
+
+        unsigned conn = inflight.conns[offset];
+        demi_sgarray_t pushed = inflight.sgas[offset];
+        inflight_remove(&inflight, (unsigned)offset);
+
+        if (qr.qr_opcode == DEMI_OPC_PUSH)
+        {
+            assert(demi_sgafree(&pushed) == 0);
+            npushes--;
+            continue;
+        }
+
+        assert(qr.qr_opcode == DEMI_OPC_POP);
+        long long now = stopwatch_now();
+        size_t len = sga_len(&qr.qr_value.sga);
+        assert(len > 0);
+        assert(demi_sgafree(&qr.qr_value.sga) == 0);
+
+        // Stream sockets may deliver several responses, or part of one, in a single pop.
+        for (conns[conn].partial += len; conns[conn].partial >= config->size; conns[conn].partial -= config->size)
+        {
+            unsigned request = conns[conn].ncompleted++ * nconns + conn;
+
+            assert(request < nsent);
+            if (request >= config->warmup)
+            {
+                stopwatch_record(now - (t0 + (long long)((double)request * interval_ns)));
+                last_done = now;
+            }
+            ncompleted++;
+        }
+
+        if (conns[conn].ncompleted < conns[conn].nrequests)
+        {
+            demi_qtoken_t qt = -1;
+
+            assert(demi_pop(&qt, conns[conn].qd) == 0);
+            inflight_add(&inflight, qt, conn, NULL);
+        }
+    }
+
+    // Throughput counts what came back over the measured window, which starts when the first measured request was due.
+    double elapsed_s = (double)(last_done - first_due) / 1000000000.0;
+    report_add_throughput("load", config->size, nconns, (elapsed_s > 0.0) ? (config->iterations / elapsed_s) : 0.0);
+
+    for (unsigned i = 1; i < nconns; i++)
+        assert(demi_close(conns[i].qd) == 0);
+    inflight_release(&inflight);
+    free(conns);
+}
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Measures open-loop TCP request-response latency across many connections.
+ *
+ * @param config Benchmark configuration.
+ */
+void bench_load(const struct config *config)
+{
+    int sockqd = -1;
+
+    assert(config->peer != PEER_NONE);
+    assert((config->connections > 0) && (config->rate > 0));
+    assert(demi_socket(&sockqd, AF_INET, SOCK_STREAM, 0) == 0);
+
+    if (config->peer == PEER_SERVER)
+    {
+        assert(demi_bind(sockqd, (const struct sockaddr *)&config->local, sizeof(struct sockaddr_in)) == 0);
+        assert(demi_listen(sockqd, (int)config->connections) == 0);
+        load_server(config, sockqd, (size_t)(config->warmup + config->iterations) * config->size);
+    }
+    else
+        load_client(config, sockqd);
+
+    assert(demi_close(sockqd) == 0);
+}
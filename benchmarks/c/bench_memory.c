@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "bench.h"
+#include "report.h"
+#include "stopwatch.h"
+#include <assert.h>
+#include <demi/libos.h>
+#include <demi/sga.h>
+#include <demi/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Pushes a message of @p size bytes into a pipe, and pops it from the other end.
+ *
+ * @param txqd Queue descriptor of the end that pushes.
+ * @param rxqd Queue descriptor of the end that pops.
+ * @param size Size of the message (in bytes).
+ */
+static void pipe_round(int txqd, int rxqd, size_t size)
+{
+    demi_qtoken_t qt = -1;
+    demi_qresult_t qr = {0};
+    demi_sgarray_t sga = demi_sgaalloc(size);
+
+    assert(sga.sga_segs[0].sgaseg_buf != NULL);
+
+    // Push, then pop until we got the whole message back.
+    assert(demi_push(&qt, txqd, &sga) == 0);
+    assert(demi_wait(&qr, qt, NULL) == 0);
+    assert(qr.qr_opcode == DEMI_OPC_PUSH);
+    assert(demi_sgafree(&sga) == 0);
+
+    for (size_t nbytes = 0; nbytes < size;)
+    {
+        assert(demi_pop(&qt, rxqd) == 0);
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        assert(qr.qr_opcode == DEMI_OPC_POP);
+        nbytes += qr.qr_value.sga.sga_segs[0].sgaseg_len;
+        assert(demi_sgafree(&qr.qr_value.sga) == 0);
+    }
+}
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Measures a demi_sgaalloc() and demi_sgafree() pair.
+ *
+ * @param config Benchmark configuration.
+ */
+void bench_sga(const struct config *config)
+{
+    for (unsigned i = 0; i < config->warmup; i++)
+    {
+        demi_sgarray_t sga = demi_sgaalloc(config->size);
+        assert(demi_sgafree(&sga) == 0);
+    }
+
+    stopwatch_reset();
+    for (unsigned i = 0; i < config->iterations; i++)
+    {
+        stopwatch_start();
+        demi_sgarray_t sga = demi_sgaalloc(config->size);
+        assert(demi_sgafree(&sga) == 0);
+        stopwatch_stop();
+    }
+
+    report_add("sga", config->size, 0);
+}
+
+/**
+ * @brief Measures a push and pop round through a memory pipe.
+ *
+ * Both ends of the pipe are opened by this process, so each iteration measures the cost of the I/O path without any
+ * cross-process scheduling noise.
+ *
+ * @param config Benchmark configuration.
+ */
+void bench_pipe(const struct config *config)
+{
+    char name[256];
+    int rxqd = -1;
+    int txqd = -1;
+
+    int len = snprintf(name, sizeof(name), "%s:pipe", config->pipe_name);
+    if ((len < 0) || (len >= (int)sizeof(name)))
+    {
+        fprintf(stderr, "pipe name is too long: %s\n", config->pipe_name);
+        exit(EXIT_FAILURE);
+    }
+    assert(demi_create_pipe(&rxqd, name) == 0);
+    assert(demi_open_pipe(&txqd, name) == 0);
+
+    for (unsigned i = 0; i < config->warmup; i++)
+        pipe_round(txqd, rxqd, config->size);
+
+    stopwatch_reset();
+    for (unsigned i = 0; i < config->iterations; i++)
+    {
+        stopwatch_start();
+        pipe_round(txqd, rxqd, config->size);
+        stopwatch_stop();
+    }
+
+    report_add("pipe", config->size, 0);
+
+    assert(demi_close(txqd) == 0);
+    assert(demi_close(rxqd) == 0);
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "bench.h"
+#include "report.h"
+#include "stopwatch.h"
+#include <assert.h>
+#include <demi/libos.h>
+#include <demi/sga.h>
+#include <demi/wait.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Pushes a scatter-gather array and waits for the operation to complete.
+ *
+ * @param qd   Target queue descriptor.
+ * @param sga  Target scatter-gather array.
+ * @param dest Destination address, or NULL on connected sockets.
+ */
+static void push_wait(int qd, const demi_sgarray_t *sga, const struct sockaddr_in *dest)
+{
+    demi_qtoken_t qt = -1;
+    demi_qresult_t qr = {0};
+
+    if (dest != NULL)
+        assert(demi_pushto(&qt, qd, sga, (const struct sockaddr *)dest, sizeof(struct sockaddr_in)) == 0);
+    else
+        assert(demi_push(&qt, qd, sga) == 0);
+    assert(demi_wait(&qr, qt, NULL) == 0);
+    assert(qr.qr_opcode == DEMI_OPC_PUSH);
+}
+
+/**
+ * @brief Pops a scatter-gather array and waits for the operation to complete.
+ *
+ * @param qd  Target queue descriptor.
+ * @param sga Store location for the scatter-gather array that was popped.
+ */
+static void pop_wait(int qd, demi_sgarray_t *sga)
+{
+    demi_qtoken_t qt = -1;
+    demi_qresult_t qr = {0};
+
+    assert(demi_pop(&qt, qd) == 0);
+    assert(demi_wait(&qr, qt, NULL) == 0);
+    assert(qr.qr_opcode == DEMI_OPC_POP);
+    memcpy(sga, &qr.qr_value.sga, sizeof(demi_sgarray_t));
+}
+
+/**
+ * @brief Sends a message of @p size bytes and pops until the whole echo came back.
+ *
+ * @param qd   Target queue descriptor.
+ * @param size Size of the message (in bytes).
+ * @param dest Destination address, or NULL on connected sockets.
+ */
+static void ping(int qd, size_t size, const struct sockaddr_in *dest)
+{
+    demi_sgarray_t sga = demi_sgaalloc(size);
+
+    assert(sga.sga_segs[0].sgaseg_buf != NULL);
+    memset(sga.sga_segs[0].sgaseg_buf, 1, size);
+    push_wait(qd, &sga, dest);
+    assert(demi_sgafree(&sga) == 0);
+
+    // Stream sockets may deliver the echo in several pieces.
+    for (size_t nbytes = 0; nbytes < size;)
+    {
+        pop_wait(qd, &sga);
+        nbytes += sga.sga_segs[0].sgaseg_len;
+        assert(demi_sgafree(&sga) == 0);
+    }
+}
+
+/**
+ * @brief Echoes everything that is popped from a queue, until @p nbytes bytes went through.
+ *
+ * @param qd     Target queue descriptor.
+ * @param nbytes Number of bytes to echo.
+ * @param dest   Destination address, or NULL on connected sockets.
+ */
+static void pong(int qd, size_t nbytes, const struct sockaddr_in *dest)
+{
+    while (nbytes > 0)
+    {
+        demi_sgarray_t sga = {0};
+
+        pop_wait(qd, &sga);
+        assert(sga.sga_segs[0].sgaseg_len <= nbytes);
+        nbytes -= sga.sga_segs[0].sgaseg_len;
+        push_wait(qd, &sga, dest);
+        assert(demi_sgafree(&sga) == 0);
+    }
+}
+
+/**
+ * @brief Runs the client side of a ping-pong scenario and reports round-trip times.
+ *
+ * @param scenario Name of the scenario.
+ * @param config   Benchmark configuration.
+ * @param qd       Target queue descriptor.
+ * @param dest     Destination address, or NULL on connected sockets.
+ */
+static void ping_pong_client(const char *scenario, const struct config *config, int qd, const struct sockaddr_in *dest)
+{
+    for (unsigned i = 0; i < config->warmup; i++)
+        ping(qd, config->size, dest);
+
+    stopwatch_reset();
+    for (unsigned i = 0; i < config->iterations; i++)
+    {
+        stopwatch_start();
+        ping(qd, config->size, dest);
+        stopwatch_stop();
+    }
+
+    report_add(scenario, config->size, 0);
+}
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Measures UDP ping-pong round trips.
+ *
+ * @param config Benchmark configuration.
+ */
+void bench_udp(const struct config *config)
+{
+    int sockqd = -1;
+
+    assert(config->peer != PEER_NONE);
+    assert(demi_socket(&sockqd, AF_INET, SOCK_DGRAM, 0) == 0);
+    assert(demi_bind(sockqd, (const struct sockaddr *)&config->local, sizeof(struct sockaddr_in)) == 0);
+
+    if (config->peer == PEER_SERVER)
+        pong(sockqd, (size_t)(config->warmup + config->iterations) * config->size, &config->remote);
+    else
+        ping_pong_client("udp", config, sockqd, &config->remote);
+
+    assert(demi_close(sockqd) == 0);
+}
+
+/**
+ * @brief Measures TCP ping-pong round trips.
+ *
+ * @param config Benchmark configuration.
+ */
+void bench_tcp(const struct config *config)
+{
+    int sockqd = -1;
+    demi_qtoken_t qt = -1;
+    demi_qresult_t qr = {0};
+
+    assert(config->peer != PEER_NONE);
+    assert(demi_socket(&sockqd, AF_INET, SOCK_STREAM, 0) == 0);
+
+    if (config->peer == PEER_SERVER)
+    {
+        int qd = -1;
+
+        assert(demi_bind(sockqd, (const struct sockaddr *)&config->local, sizeof(struct sockaddr_in)) == 0);
+        assert(demi_listen(sockqd, 16) == 0);
+        assert(demi_accept(&qt, sockqd) == 0);
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        assert(qr.qr_opcode == DEMI_OPC_ACCEPT);
+        qd = qr.qr_value.ares.qd;
+
+        pong(qd, (size_t)(config->warmup + config->iterations) * config->size, NULL);
+
+        assert(demi_close(qd) == 0);
+    }
+    else
+    {
+        assert(demi_connect(&qt, sockqd, (const struct sockaddr *)&config->remote, sizeof(struct sockaddr_in)) == 0);
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        assert(qr.qr_opcode == DEMI_OPC_CONNECT);
+
+        ping_pong_client("tcp", config, sockqd, NULL);
+    }
+
+    assert(demi_close(sockqd) == 0);
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "bench.h"
+#include "report.h"
+#include "stopwatch.h"
+#include <assert.h>
+#include <demi/libos.h>
+#include <demi/wait.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*====================================================================================================================*
+ * Private Variables                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Queue on which we keep operations pending, so that there is something to wait on.
+ */
+static struct
+{
+    int qd;             /** Queue descriptor.                          */
+    demi_qtoken_t *qts; /** Queue tokens of the pending pop operations. */
+    unsigned nqts;      /** Number of pending pop operations.         */
+} sink = {.qd = -1, .qts = NULL, .nqts = 0};
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Ensures that at least @p n pop operations are pending on the sink queue.
+ *
+ * Nothing is ever sent to the sink queue, so these operations never complete. The sink queue is a pipe on catmem and a
+ * bound UDP socket on every other LibOS.
+ *
+ * @param config Benchmark configuration.
+ * @param n      Number of pending operations.
+ */
+static void sink_ensure_pending(const struct config *config, unsigned n)
+{
+    if (sink.qd < 0)
+    {
+        const char *libos = getenv("LIBOS");
+        char name[256];
+
+        if ((libos != NULL) && !strcmp(libos, "catmem"))
+        {
+            int len = snprintf(name, sizeof(name), "%s:sink", config->pipe_name);
+            if ((len < 0) || (len >= (int)sizeof(name)))
+            {
+                fprintf(stderr, "pipe name is too long: %s\n", config->pipe_name);
+                exit(EXIT_FAILURE);
+            }
+            assert(demi_create_pipe(&sink.qd, name) == 0);
+        }
+        else
+        {
+            assert(demi_socket(&sink.qd, AF_INET, SOCK_DGRAM, 0) == 0);
+            assert(demi_bind(sink.qd, (const struct sockaddr *)&config->local, sizeof(struct sockaddr_in)) == 0);
+        }
+    }
+
+    if (sink.nqts >= n)
+        return;
+
+    assert((sink.qts = realloc(sink.qts, sizeof(demi_qtoken_t) * n)) != NULL);
+    for (unsigned i = sink.nqts; i < n; i++)
+        assert(demi_pop(&sink.qts[i], sink.qd) == 0);
+    sink.nqts = n;
+}
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Measures demi_wait_any() on pending operations, at every fan-in in the configuration.
+ *
+ * Every call scans all queue tokens and runs the scheduler once before timing out.
+ *
+ * @param config Benchmark configuration.
+ */
+void bench_wait_any(const struct config *config)
+{
+    const struct timespec timeout = {.tv_sec = 0, .tv_nsec = 0};
+
+    for (unsigned f = 0; f < config->nfanins; f++)
+    {
+        const unsigned fanin = config->fanins[f];
+        demi_qresult_t qr = {0};
+        int ready_offset = -1;
+
+        sink_ensure_pending(config, fanin);
+
+        for (unsigned i = 0; i < config->warmup; i++)
+            assert(demi_wait_any(&qr, &ready_offset, sink.qts, fanin, &timeout) == ETIMEDOUT);
+
+        stopwatch_reset();
+        for (unsigned i = 0; i < config->iterations; i++)
+        {
+            stopwatch_start();
+            assert(demi_wait_any(&qr, &ready_offset, sink.qts, fanin, &timeout) == ETIMEDOUT);
+            stopwatch_stop();
+        }
+
+        report_add("wait_any", 0, fanin);
+    }
+}
+
+/**
+ * @brief Measures demi_wait_group_wait() on pending operations, at every fan-in in the configuration.
+ *
+ * Queue tokens are registered in the wait group once, outside the measured loop.
+ *
+ * @param config Benchmark configuration.
+ */
+void bench_wait_group(const struct config *config)
+{
+    const struct timespec timeout = {.tv_sec = 0, .tv_nsec = 0};
+
+    for (unsigned f = 0; f < config->nfanins; f++)
+    {
+        const unsigned fanin = config->fanins[f];
+        demi_qresult_t qr = {0};
+        int wgd = -1;
+
+        sink_ensure_pending(config, fanin);
+
+        assert(demi_wait_group_create(&wgd) == 0);
+        for (unsigned i = 0; i < fanin; i++)
+            assert(demi_wait_group_add(wgd, sink.qts[i]) == 0);
+
+        for (unsigned i = 0; i < config->warmup; i++)
+            assert(demi_wait_group_wait(&qr, wgd, &timeout) == ETIMEDOUT);
+
+        stopwatch_reset();
+        for (unsigned i = 0; i < config->iterations; i++)
+        {
+            stopwatch_start();
+            assert(demi_wait_group_wait(&qr, wgd, &timeout) == ETIMEDOUT);
+            stopwatch_stop();
+        }
+
+        // Hand the queue tokens back, so that other scenarios can wait on them.
+        assert(demi_wait_group_free(wgd) == 0);
+
+        report_add("wait_group", 0, fanin);
+    }
+}
+
+/**
+ * @brief Releases the resources of the wait scenarios, so that no pipe is left behind once we exit.
+ */
+void bench_wait_release(void)
+{
+    if (sink.qd < 0)
+        return;
+
+    assert(demi_close(sink.qd) == 0);
+    free(sink.qts);
+    sink.qd = -1;
+    sink.qts = NULL;
+    sink.nqts = 0;
+}
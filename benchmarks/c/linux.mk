@@ -38,7 +38,7 @@ all: benchmarks
 make-dirs:
 	mkdir -p $(BINDIR)
 
-# Builds system call test.
+# Builds benchmarks.
 benchmarks: make-dirs $(OBJ)
 	$(COMPILE_CMD)
 
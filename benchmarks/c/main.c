@@ -7,53 +7,189 @@
  * Imports                                                                                                            *
  *====================================================================================================================*/
 
+#include "bench.h"
+#include "report.h"
 #include "stopwatch.h"
 #include <assert.h>
 #include <demi/libos.h>
-#include <demi/sga.h>
-#include <demi/wait.h>
-#include <stdbool.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#endif
+
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Scenarios that run when none is given on the command line. These do not need a remote peer.
+ */
+#define DEFAULT_SCENARIOS "sga,wait_any,wait_group"
+
+/**
+ * @brief Fan-in values that are used when none is given on the command line.
+ */
+#define DEFAULT_FANINS "1,16,256,4096"
+
+/**
+ * @brief Local socket address that is used when none is given on the command line.
+ */
+#define DEFAULT_LOCAL "127.0.0.1:12345"
+
+/*====================================================================================================================*
+ * Private Variables                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Scenario descriptor.
+ */
+struct scenario
+{
+    const char *name;                       /**< Name of the scenario.                    */
+    void (*fn)(const struct config *);      /**< Function that runs the scenario.        */
+    int needs_peer;                         /**< Does the scenario run across two hosts? */
+    const char *description;                /**< Description of the scenario.            */
+};
+
+/**
+ * @brief All scenarios.
+ */
+static const struct scenario scenarios[] = {
+    {"sga", bench_sga, 0, "demi_sgaalloc() and demi_sgafree() churn"},
+    {"wait_any", bench_wait_any, 0, "demi_wait_any() on pending operations, at every fan-in"},
+    {"wait_group", bench_wait_group, 0, "demi_wait_group_wait() on pending operations, at every fan-in"},
+    {"pipe", bench_pipe, 0, "push and pop round through a memory pipe (catmem)"},
+    {"udp", bench_udp, 1, "UDP ping-pong round trips"},
+    {"tcp", bench_tcp, 1, "TCP ping-pong round trips"},
+    {"load", bench_load, 1, "open-loop TCP requests at --rate over --connections, timed from when each was due"},
+};
 
 /*====================================================================================================================*
- * System Calls in demi/wait.h                                                                                        *
+ * Private Functions                                                                                                  *
  *====================================================================================================================*/
 
 /**
- * @brief Microbenchmark for demi_wait_any().
+ * @brief Prints program usage and exits.
+ *
+ * @param progname Program name.
+ * @param status   Exit status.
+ */
+static void usage(const char *progname, int status)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", progname);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --scenario LIST         Comma-separated scenarios to run (default: %s).\n", DEFAULT_SCENARIOS);
+    fprintf(stderr, "  --format csv|json       Output format (default: csv).\n");
+    fprintf(stderr, "  --clock monotonic|tsc   Clock that times each iteration (default: monotonic).\n");
+    fprintf(stderr, "  --iterations N          Number of measured iterations (default: 10000).\n");
+    fprintf(stderr, "  --warmup N              Number of iterations before measuring (default: 100).\n");
+    fprintf(stderr, "  --size BYTES            Size of each message (default: 64).\n");
+    fprintf(stderr, "  --fanin LIST            Comma-separated number of queue tokens to wait on (default: %s).\n",
+            DEFAULT_FANINS);
+    fprintf(stderr, "  --connections N         Number of connections that the load scenario opens (default: 1).\n");
+    fprintf(stderr, "  --rate N                Requests per second that the load scenario sends (default: 10000).\n");
+    fprintf(stderr, "  --server | --client     Role of this process in the udp, tcp and load scenarios, which also need\n"
+            "                          --local and --remote.\n");
+    fprintf(stderr, "  --local IPV4:PORT       Local socket address (default: %s).\n", DEFAULT_LOCAL);
+    fprintf(stderr, "  --remote IPV4:PORT      Remote socket address.\n");
+    fprintf(stderr, "  --pipe-name NAME        Prefix of the names of memory pipes (default: demikernel-benchmarks).\n");
+    fprintf(stderr, "Scenarios:\n");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(struct scenario); i++)
+        fprintf(stderr, "  %-22s  %s.\n", scenarios[i].name, scenarios[i].description);
+
+    exit(status);
+}
+
+/**
+ * @brief Parses a non-negative number.
+ *
+ * @param progname Program name.
+ * @param str      String representation of the number.
+ *
+ * @return The parsed number.
+ */
+static unsigned long parse_number(const char *progname, const char *str)
+{
+    char *end = NULL;
+    unsigned long val = strtoul(str, &end, 10);
+
+    if ((end == str) || (*end != '\0'))
+        usage(progname, EXIT_FAILURE);
+
+    return (val);
+}
+
+/**
+ * @brief Parses a socket address in the IPV4:PORT format.
+ *
+ * @param progname Program name.
+ * @param str      String representation of the socket address.
+ * @param addr     Store location for the socket address.
  */
-static void microbench_wait_any(const unsigned NUM_ITERS, const unsigned NUM_QTS)
+static void parse_sockaddr(const char *progname, const char *str, struct sockaddr_in *addr)
 {
-    demi_qtoken_t *qts = NULL;
+    char ip_str[64];
+    const char *colon = strrchr(str, ':');
 
-    assert(NUM_ITERS > 0);
-    assert(NUM_QTS > 0);
+    if ((colon == NULL) || ((size_t)(colon - str) >= sizeof(ip_str)))
+        usage(progname, EXIT_FAILURE);
 
-    // Allocate an array of queue tokens.
-    assert((qts = malloc(sizeof(demi_qtoken_t) * NUM_QTS)) != NULL);
+    memcpy(ip_str, str, colon - str);
+    ip_str[colon - str] = '\0';
 
-    stopwatch_reset();
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((unsigned short)parse_number(progname, colon + 1));
+    if (inet_pton(AF_INET, ip_str, &addr->sin_addr) != 1)
+        usage(progname, EXIT_FAILURE);
+}
 
-    memset(qts, 1, sizeof(demi_qtoken_t) * NUM_QTS);
+/**
+ * @brief Parses a comma-separated list of fan-in values.
+ *
+ * @param progname Program name.
+ * @param str      Comma-separated list.
+ * @param config   Configuration to fill in.
+ */
+static void parse_fanins(const char *progname, const char *str, struct config *config)
+{
+    char buf[256];
 
-    for (unsigned i = 0; i < NUM_ITERS; i++)
+    if (strlen(str) >= sizeof(buf))
+        usage(progname, EXIT_FAILURE);
+    strcpy(buf, str);
+
+    config->nfanins = 0;
+    for (char *tok = strtok(buf, ","); tok != NULL; tok = strtok(NULL, ","))
     {
-        demi_qresult_t qr = {};
-        int ready_offset = -1;
-        struct timespec timeout = {.tv_sec = 0, .tv_nsec = 0};
+        unsigned long fanin = parse_number(progname, tok);
 
-        stopwatch_start();
-        assert(demi_wait_any(&qr, &ready_offset, qts, NUM_QTS, &timeout) != 0);
-        stopwatch_stop();
+        if ((config->nfanins == MAX_FANINS) || (fanin == 0) || (fanin > INT_MAX))
+            usage(progname, EXIT_FAILURE);
+        config->fanins[config->nfanins++] = (unsigned)fanin;
     }
+}
 
-    printf("demi_wait_any() takes about %lld nanoseconds.\n", stopwatch_read());
+/**
+ * @brief Looks up a scenario by name.
+ *
+ * @param name Name of the scenario.
+ *
+ * @return The scenario, or NULL if there is none with that name.
+ */
+static const struct scenario *find_scenario(const char *name)
+{
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(struct scenario); i++)
+    {
+        if (!strcmp(scenarios[i].name, name))
+            return (&scenarios[i]);
+    }
 
-    // Release resources.
-    free(qts);
+    return (NULL);
 }
 
 /*===================================================================================================================*
@@ -63,20 +199,119 @@ static void microbench_wait_any(const unsigned NUM_ITERS, const unsigned NUM_QTS
 /**
  * @brief Drives the application.
  *
- * @param argc Argument count (unused).
- * @param argv Argument vector (unused).
+ * Runs the selected scenarios one after the other and prints one report entry per measurement on the standard output.
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector.
  *
  * @return On successful completion EXIT_SUCCESS is returned.
  */
 int main(int argc, char *const argv[])
 {
-    ((void)argc);
-    ((void)argv);
+    struct config config = {0};
+    enum report_format format = REPORT_CSV;
+    enum stopwatch_clock clock = STOPWATCH_CLOCK_MONOTONIC;
+    char scenario_list[256];
+
+    // Set defaults.
+    config.iterations = 10000;
+    config.warmup = 100;
+    config.size = 64;
+    config.peer = PEER_NONE;
+    config.pipe_name = "demikernel-benchmarks";
+    config.connections = 1;
+    config.rate = 10000;
+    strcpy(scenario_list, DEFAULT_SCENARIOS);
+    parse_fanins(argv[0], DEFAULT_FANINS, &config);
+    parse_sockaddr(argv[0], DEFAULT_LOCAL, &config.local);
+
+    // Parse command line.
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *arg = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (!strcmp(opt, "--help"))
+            usage(argv[0], EXIT_SUCCESS);
+        else if (!strcmp(opt, "--server"))
+            config.peer = PEER_SERVER;
+        else if (!strcmp(opt, "--client"))
+            config.peer = PEER_CLIENT;
+        else if (arg == NULL)
+            usage(argv[0], EXIT_FAILURE);
+        else
+        {
+            if (!strcmp(opt, "--scenario") && (strlen(arg) < sizeof(scenario_list)))
+                strcpy(scenario_list, arg);
+            else if (!strcmp(opt, "--format") && !strcmp(arg, "csv"))
+                format = REPORT_CSV;
+            else if (!strcmp(opt, "--format") && !strcmp(arg, "json"))
+                format = REPORT_JSON;
+            else if (!strcmp(opt, "--clock") && !strcmp(arg, "monotonic"))
+                clock = STOPWATCH_CLOCK_MONOTONIC;
+            else if (!strcmp(opt, "--clock") && !strcmp(arg, "tsc"))
+                clock = STOPWATCH_CLOCK_TSC;
+            else if (!strcmp(opt, "--iterations"))
+                config.iterations = (unsigned)parse_number(argv[0], arg);
+            else if (!strcmp(opt, "--warmup"))
+                config.warmup = (unsigned)parse_number(argv[0], arg);
+            else if (!strcmp(opt, "--size"))
+                config.size = (size_t)parse_number(argv[0], arg);
+            else if (!strcmp(opt, "--connections"))
+                config.connections = (unsigned)parse_number(argv[0], arg);
+            else if (!strcmp(opt, "--rate"))
+                config.rate = (unsigned)parse_number(argv[0], arg);
+            else if (!strcmp(opt, "--fanin"))
+                parse_fanins(argv[0], arg, &config);
+            else if (!strcmp(opt, "--local"))
+            {
+                parse_sockaddr(argv[0], arg, &config.local);
+                config.has_local = 1;
+            }
+            else if (!strcmp(opt, "--remote"))
+            {
+                parse_sockaddr(argv[0], arg, &config.remote);
+                config.has_remote = 1;
+            }
+            else if (!strcmp(opt, "--pipe-name"))
+                config.pipe_name = arg;
+            else
+                usage(argv[0], EXIT_FAILURE);
+            i++;
+        }
+    }
+
+    if ((config.iterations == 0) || (config.size == 0) || (config.connections == 0) || (config.rate == 0))
+        usage(argv[0], EXIT_FAILURE);
+
+    // Check all scenarios before running any of them.
+    const struct scenario *selected[sizeof(scenarios) / sizeof(struct scenario)];
+    size_t nselected = 0;
+    for (char *tok = strtok(scenario_list, ","); tok != NULL; tok = strtok(NULL, ","))
+    {
+        const struct scenario *scenario = find_scenario(tok);
+
+        if ((scenario == NULL) || (nselected == sizeof(selected) / sizeof(selected[0])))
+            usage(argv[0], EXIT_FAILURE);
+        if (scenario->needs_peer && ((config.peer == PEER_NONE) || !config.has_local || !config.has_remote))
+            usage(argv[0], EXIT_FAILURE);
+        selected[nselected++] = scenario;
+    }
+
+    if (stopwatch_set_clock(clock) != 0)
+    {
+        fprintf(stderr, "%s: clock is not available on this platform\n", argv[0]);
+        return (EXIT_FAILURE);
+    }
 
     // This shall never fail.
     assert(demi_init(argc, argv) == 0);
 
-    microbench_wait_any(100000, 1048576);
+    report_begin(format);
+    for (size_t i = 0; i < nselected; i++)
+        selected[i]->fn(&config);
+    report_end();
+    bench_wait_release();
 
     return (EXIT_SUCCESS);
 }
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "report.h"
+#include "stopwatch.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*====================================================================================================================*
+ * Private Variables                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Report.
+ */
+static struct
+{
+    enum report_format format; /** Output format.             */
+    const char *libos;         /** Name of the LibOS.         */
+    unsigned nentries;         /** Number of entries so far.  */
+} report = {.format = REPORT_CSV, .libos = NULL, .nentries = 0};
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Starts a report on the standard output.
+ *
+ * @param format Output format.
+ */
+void report_begin(enum report_format format)
+{
+    report.format = format;
+    report.libos = getenv("LIBOS");
+    report.nentries = 0;
+
+    if (report.libos == NULL)
+        report.libos = "unknown";
+
+    if (report.format == REPORT_CSV)
+        printf("scenario,libos,size,fanin,iterations,"
+               "mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,ops_per_sec,bytes_per_sec\n");
+    else
+        printf("[");
+}
+
+/**
+ * @brief Adds an entry to the report, with the elapsed times that were recorded by the stopwatch.
+ *
+ * @param scenario Name of the scenario.
+ * @param size     Size of each message (in bytes), or zero.
+ * @param fanin    Number of queue tokens waited on, or zero.
+ */
+void report_add(const char *scenario, size_t size, unsigned fanin)
+{
+    long long mean_ns = stopwatch_read();
+
+    // Each iteration runs one operation (or round trip) at a time, so throughput follows from the mean latency.
+    report_add_throughput(scenario, size, fanin, (mean_ns > 0) ? (1000000000.0 / (double)mean_ns) : 0.0);
+}
+
+/**
+ * @brief Adds an entry to the report, with the elapsed times that were recorded by the stopwatch and a throughput that
+ * was measured by the caller.
+ *
+ * @param scenario    Name of the scenario.
+ * @param size        Size of each message (in bytes), or zero.
+ * @param fanin       Number of queue tokens waited on, or zero.
+ * @param ops_per_sec Measured throughput (in operations per second).
+ */
+void report_add_throughput(const char *scenario, size_t size, unsigned fanin, double ops_per_sec)
+{
+    assert(scenario != NULL);
+
+    long iterations = stopwatch_count();
+    long long mean_ns = stopwatch_read();
+    long long p50_ns = stopwatch_percentile(50.0);
+    long long p90_ns = stopwatch_percentile(90.0);
+    long long p99_ns = stopwatch_percentile(99.0);
+    long long p999_ns = stopwatch_percentile(99.9);
+    long long max_ns = stopwatch_max();
+    double bytes_per_sec = ops_per_sec * (double)size;
+
+    if (report.format == REPORT_CSV)
+    {
+        printf("%s,%s,%zu,%u,%ld,%lld,%lld,%lld,%lld,%lld,%lld,%.0f,%.0f\n", scenario, report.libos, size, fanin,
+               iterations, mean_ns, p50_ns, p90_ns, p99_ns, p999_ns, max_ns, ops_per_sec, bytes_per_sec);
+    }
+    else
+    {
+        printf("%s\n  {\"scenario\": \"%s\", \"libos\": \"%s\", \"size\": %zu, \"fanin\": %u, \"iterations\": %ld, "
+               "\"mean_ns\": %lld, \"p50_ns\": %lld, \"p90_ns\": %lld, \"p99_ns\": %lld, \"p999_ns\": %lld, "
+               "\"max_ns\": %lld, \"ops_per_sec\": %.0f, \"bytes_per_sec\": %.0f}",
+               (report.nentries > 0) ? "," : "", scenario, report.libos, size, fanin, iterations, mean_ns, p50_ns,
+               p90_ns, p99_ns, p999_ns, max_ns, ops_per_sec, bytes_per_sec);
+    }
+
+    report.nentries++;
+    fflush(stdout);
+}
+
+/**
+ * @brief Ends the report.
+ */
+void report_end(void)
+{
+    if (report.format == REPORT_JSON)
+        printf("%s]\n", (report.nentries > 0) ? "\n" : "");
+    fflush(stdout);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+#ifndef REPORT_H_
+#define REPORT_H_
+
+#include <stddef.h>
+
+/**
+ * @brief Output formats.
+ */
+enum report_format
+{
+    REPORT_CSV,  /**< One header line, then one line per entry. */
+    REPORT_JSON, /**< An array with one object per entry.       */
+};
+
+/**
+ * @brief Starts a report on the standard output.
+ *
+ * @param format Output format.
+ */
+extern void report_begin(enum report_format format);
+
+/**
+ * @brief Adds an entry to the report, with the elapsed times that were recorded by the stopwatch.
+ *
+ * @param scenario Name of the scenario.
+ * @param size     Size of each message (in bytes), or zero.
+ * @param fanin    Number of queue tokens waited on, or zero.
+ */
+extern void report_add(const char *scenario, size_t size, unsigned fanin);
+
+/**
+ * @brief Adds an entry to the report, with the elapsed times that were recorded by the stopwatch and a throughput that
+ * was measured by the caller.
+ *
+ * Use this when several operations were in flight at once, so throughput does not follow from the mean latency.
+ *
+ * @param scenario    Name of the scenario.
+ * @param size        Size of each message (in bytes), or zero.
+ * @param fanin       Number of queue tokens waited on, or zero.
+ * @param ops_per_sec Measured throughput (in operations per second).
+ */
+extern void report_add_throughput(const char *scenario, size_t size, unsigned fanin, double ops_per_sec);
+
+/**
+ * @brief Ends the report.
+ */
+extern void report_end(void);
+
+#endif /* !REPORT_H_ */
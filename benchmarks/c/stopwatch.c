@@ -10,9 +10,20 @@
 // This must come first.
 #define _POSIX_C_SOURCE 199309L
 
+#include "stopwatch.h"
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#elif defined(_M_X64)
+#include <intrin.h>
+#define HAVE_TSC 1
+#endif
+
 /*====================================================================================================================*
  * Constants                                                                                                          *
  *====================================================================================================================*/
@@ -27,6 +38,29 @@
  */
 #define NUM_ITER 100000
 
+/**
+ * @brief Time spent calibrating the time stamp counter (in nanoseconds).
+ */
+#define TSC_CALIBRATION_NS 10000000
+
+/**
+ * @brief Log2 of the number of sub-buckets per power of two in the histogram.
+ *
+ * Values below 2^(SUB_BUCKET_BITS + 1) are recorded exactly. Above that, each power of two is split into
+ * 2^SUB_BUCKET_BITS buckets, so the relative error of a recorded value is at most 2^-SUB_BUCKET_BITS.
+ */
+#define SUB_BUCKET_BITS 5
+
+/**
+ * @brief Number of sub-buckets per power of two in the histogram.
+ */
+#define SUB_BUCKET_COUNT (1 << SUB_BUCKET_BITS)
+
+/**
+ * @brief Number of buckets in the histogram, which covers all 64-bit values.
+ */
+#define NUM_BUCKETS ((64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT)
+
 /*====================================================================================================================*
  * Private Variables                                                                                                  *
  *====================================================================================================================*/
@@ -36,17 +70,166 @@
  */
 static struct
 {
-    struct timespec start;    /** Start time.      */
-    struct timespec end;      /** End time.        */
-    long nstops;              /** Number of stops. */
-    long long total_time;     /** Total time.      */
-    long long total_overhead; /** Total overhead.  */
-} stopwatch = {.nstops = 0, .total_time = 0, .total_overhead = 0};
+    enum stopwatch_clock clock;    /** Clock that is read.          */
+    double tsc_ticks_per_ns;       /** Time stamp counter rate.     */
+    uint64_t start;                /** Start time (in clock units). */
+    long nstops;                   /** Number of stops.             */
+    long long total_time;          /** Total time.                  */
+    long long total_overhead;      /** Total overhead.              */
+    long long max_time;            /** Longest elapsed time.        */
+    uint64_t buckets[NUM_BUCKETS]; /** Histogram of elapsed times.  */
+} stopwatch = {.clock = STOPWATCH_CLOCK_MONOTONIC,
+               .tsc_ticks_per_ns = 0.0,
+               .nstops = 0,
+               .total_time = 0,
+               .total_overhead = 0,
+               .max_time = 0};
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static uint64_t monotonic_now(void)
+{
+    struct timespec now;
+
+    assert(clock_gettime(CLOCK_MONOTONIC, &now) == 0);
+    return ((uint64_t)now.tv_sec * GIGA + (uint64_t)now.tv_nsec);
+}
+
+/**
+ * @brief Reads the clock of the stopwatch.
+ *
+ * @return The current time in clock units.
+ */
+static uint64_t clock_now(void)
+{
+#ifdef HAVE_TSC
+    if (stopwatch.clock == STOPWATCH_CLOCK_TSC)
+    {
+        // Keep earlier instructions from executing after we read the counter.
+        _mm_lfence();
+        return (__rdtsc());
+    }
+#endif
+
+    return (monotonic_now());
+}
+
+/**
+ * @brief Converts an interval of the clock of the stopwatch to nanoseconds.
+ *
+ * @param delta Interval in clock units.
+ *
+ * @return The interval in nanoseconds.
+ */
+static long long clock_to_ns(uint64_t delta)
+{
+    if (stopwatch.clock == STOPWATCH_CLOCK_TSC)
+        return ((long long)((double)delta / stopwatch.tsc_ticks_per_ns));
+
+    return ((long long)delta);
+}
+
+/**
+ * @brief Returns the index of the most significant bit that is set in a non-zero value.
+ *
+ * @param val Target value.
+ *
+ * @return The index of the most significant bit that is set.
+ */
+static unsigned msb(uint64_t val)
+{
+#ifdef __GNUC__
+    return (63 - __builtin_clzll(val));
+#else
+    unsigned i = 0;
+    while (val >>= 1)
+        i++;
+    return (i);
+#endif
+}
+
+/**
+ * @brief Returns the histogram bucket of a value.
+ *
+ * @param val Target value.
+ *
+ * @return The index of the bucket that @p val falls in.
+ */
+static unsigned bucket_of(uint64_t val)
+{
+    if (val < 2 * SUB_BUCKET_COUNT)
+        return ((unsigned)val);
+
+    unsigned shift = msb(val) - SUB_BUCKET_BITS;
+    return ((shift + 1) * SUB_BUCKET_COUNT + (unsigned)(val >> shift) - SUB_BUCKET_COUNT);
+}
+
+/**
+ * @brief Returns the highest value that falls in a histogram bucket.
+ *
+ * @param index Index of the target bucket.
+ *
+ * @return The highest value that falls in the bucket.
+ */
+static uint64_t bucket_highest(unsigned index)
+{
+    if (index < 2 * SUB_BUCKET_COUNT)
+        return (index);
+
+    unsigned shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t lowest = (uint64_t)(index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT) << shift;
+    return (lowest + (((uint64_t)1 << shift) - 1));
+}
 
 /*====================================================================================================================*
  * Public Functions                                                                                                   *
  *====================================================================================================================*/
 
+/**
+ * @brief Selects the clock that the stopwatch reads. The stopwatch must be reset afterwards.
+ *
+ * @param clock Target clock.
+ *
+ * @return On successful completion, zero is returned. If the clock is not available on this platform, -1 is returned
+ * instead and the stopwatch keeps reading its current clock.
+ */
+int stopwatch_set_clock(enum stopwatch_clock clock)
+{
+    if (clock == STOPWATCH_CLOCK_MONOTONIC)
+    {
+        stopwatch.clock = clock;
+        return (0);
+    }
+
+#ifdef HAVE_TSC
+    // Calibrate the time stamp counter once, by spinning against the monotonic clock.
+    if (stopwatch.tsc_ticks_per_ns == 0.0)
+    {
+        uint64_t ns_start = monotonic_now();
+        uint64_t tsc_start = __rdtsc();
+        uint64_t ns_end = 0;
+
+        do
+            ns_end = monotonic_now();
+        while (ns_end - ns_start < TSC_CALIBRATION_NS);
+
+        stopwatch.tsc_ticks_per_ns = (double)(__rdtsc() - tsc_start) / (double)(ns_end - ns_start);
+    }
+
+    stopwatch.clock = clock;
+    return (0);
+#else
+    return (-1);
+#endif
+}
+
 /**
  * @brief Resets the stopwatch.
  */
@@ -55,15 +238,16 @@ void stopwatch_reset(void)
     stopwatch.nstops = 0;
     stopwatch.total_time = 0;
     stopwatch.total_overhead = 0;
+    stopwatch.max_time = 0;
+    memset(stopwatch.buckets, 0, sizeof(stopwatch.buckets));
 
     // Compute average overhead.
     for (int i = 0; i < NUM_ITER; i++)
     {
-        assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.start) == 0);
-        assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.end) == 0);
+        uint64_t start = clock_now();
+        uint64_t end = clock_now();
 
-        stopwatch.total_overhead +=
-            (stopwatch.end.tv_sec - stopwatch.start.tv_sec) * GIGA + (stopwatch.end.tv_nsec - stopwatch.start.tv_nsec);
+        stopwatch.total_overhead += clock_to_ns(end - start);
     }
 
     stopwatch.total_overhead /= NUM_ITER;
@@ -74,28 +258,127 @@ void stopwatch_reset(void)
  */
 void stopwatch_start(void)
 {
-    assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.start) == 0);
+    stopwatch.start = clock_now();
 }
 
 /**
- * @brief Stops the stopwatch.
+ * @brief Stops the stopwatch, and records the time elapsed since it was started.
  */
 void stopwatch_stop(void)
 {
-    assert(clock_gettime(CLOCK_MONOTONIC, &stopwatch.end) == 0);
+    uint64_t end = clock_now();
+    long long elapsed = clock_to_ns(end - stopwatch.start) - stopwatch.total_overhead;
+
+    stopwatch_record(elapsed);
+}
+
+/**
+ * @brief Reads the clock of the stopwatch.
+ *
+ * @return The current time in nanoseconds.
+ */
+long long stopwatch_now(void)
+{
+    return (clock_to_ns(clock_now()));
+}
+
+/**
+ * @brief Records an elapsed time that was measured by the caller.
+ *
+ * @param elapsed Elapsed time in nanoseconds.
+ */
+void stopwatch_record(long long elapsed)
+{
+    if (elapsed < 0)
+        elapsed = 0;
 
     stopwatch.nstops++;
-    stopwatch.total_time += (stopwatch.end.tv_sec - stopwatch.start.tv_sec) * GIGA +
-                            (stopwatch.end.tv_nsec - stopwatch.start.tv_nsec) - stopwatch.total_overhead;
+    stopwatch.total_time += elapsed;
+    if (elapsed > stopwatch.max_time)
+        stopwatch.max_time = elapsed;
+    stopwatch.buckets[bucket_of((uint64_t)elapsed)]++;
+}
+
+/**
+ * @brief Returns the number of times that the stopwatch was stopped.
+ *
+ * @return The number of recorded samples.
+ */
+long stopwatch_count(void)
+{
+    return (stopwatch.nstops);
 }
 
 /**
  * @brief Returns the elapsed times in nanoseconds.
  *
- * @return The elapsed times in nanoseconds.
+ * @return The mean of the elapsed times in nanoseconds.
  */
 long long stopwatch_read(void)
 {
     assert(stopwatch.nstops > 0);
     return (stopwatch.total_time / stopwatch.nstops);
 }
+
+/**
+ * @brief Returns a percentile of the elapsed times.
+ *
+ * @param percentile Target percentile, between 0 and 100.
+ *
+ * @return The elapsed time in nanoseconds, below which @p percentile percent of the samples fall.
+ */
+long long stopwatch_percentile(double percentile)
+{
+    assert(stopwatch.nstops > 0);
+    assert((percentile >= 0.0) && (percentile <= 100.0));
+
+    // Find the bucket that holds the sample of this rank.
+    double exact_rank = (percentile / 100.0) * (double)stopwatch.nstops;
+    uint64_t rank = (uint64_t)exact_rank;
+    uint64_t seen = 0;
+
+    if (((double)rank < exact_rank) || (rank == 0))
+        rank++;
+
+    for (unsigned i = 0; i < NUM_BUCKETS; i++)
+    {
+        seen += stopwatch.buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t highest = bucket_highest(i);
+            return ((highest < (uint64_t)stopwatch.max_time) ? (long long)highest : stopwatch.max_time);
+        }
+    }
+
+    return (stopwatch.max_time);
+}
+
+/**
+ * @brief Returns the longest elapsed time.
+ *
+ * @return The longest elapsed time in nanoseconds.
+ */
+long long stopwatch_max(void)
+{
+    assert(stopwatch.nstops > 0);
+    return (stopwatch.max_time);
+}
+
+/**
+ * @brief Prints a summary of the elapsed times: mean, p50, p90, p99, p99.9 and max.
+ *
+ * @param stream Target output stream.
+ * @param name   Name of what was measured.
+ */
+void stopwatch_print(FILE *stream, const char *name)
+{
+    if (stopwatch.nstops == 0)
+    {
+        fprintf(stream, "%s: no samples\n", name);
+        return;
+    }
+
+    fprintf(stream, "%s: samples=%ld mean=%lld p50=%lld p90=%lld p99=%lld p99.9=%lld max=%lld (nanoseconds)\n", name,
+            stopwatch.nstops, stopwatch_read(), stopwatch_percentile(50.0), stopwatch_percentile(90.0),
+            stopwatch_percentile(99.0), stopwatch_percentile(99.9), stopwatch_max());
+}
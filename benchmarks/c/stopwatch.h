@@ -6,6 +6,30 @@
 #ifndef STOPWATCH_H_
 #define STOPWATCH_H_
 
+#include <stdio.h>
+
+/**
+ * @brief Clocks that the stopwatch may read.
+ */
+enum stopwatch_clock
+{
+    STOPWATCH_CLOCK_MONOTONIC, /**< clock_gettime(CLOCK_MONOTONIC).                     */
+    STOPWATCH_CLOCK_TSC,       /**< Time stamp counter, calibrated against the above. */
+};
+
+/**
+ * @brief Selects the clock that the stopwatch reads. The stopwatch must be reset afterwards.
+ *
+ * The time stamp counter is calibrated the first time that it is selected. It should only be used on processors with an
+ * invariant time stamp counter.
+ *
+ * @param clock Target clock.
+ *
+ * @return On successful completion, zero is returned. If the clock is not available on this platform, -1 is returned
+ * instead and the stopwatch keeps reading its current clock.
+ */
+extern int stopwatch_set_clock(enum stopwatch_clock clock);
+
 /**
  * @brief Resets the stopwatch.
  */
@@ -17,15 +41,66 @@ extern void stopwatch_reset(void);
 extern void stopwatch_start(void);
 
 /**
- * @brief Stops the stopwatch.
+ * @brief Stops the stopwatch, and records the time elapsed since it was started.
  */
 extern void stopwatch_stop(void);
 
+/**
+ * @brief Reads the clock of the stopwatch.
+ *
+ * Only differences between two readings are meaningful.
+ *
+ * @return The current time in nanoseconds.
+ */
+extern long long stopwatch_now(void);
+
+/**
+ * @brief Records an elapsed time that was measured by the caller, e.g. from two readings of stopwatch_now().
+ *
+ * Unlike stopwatch_stop(), the overhead of the stopwatch is not subtracted.
+ *
+ * @param elapsed Elapsed time in nanoseconds.
+ */
+extern void stopwatch_record(long long elapsed);
+
+/**
+ * @brief Returns the number of times that the stopwatch was stopped.
+ *
+ * @return The number of recorded samples.
+ */
+extern long stopwatch_count(void);
+
 /**
  * @brief Returns the elapsed times in nanoseconds.
  *
- * @return The elapsed times in nanoseconds.
+ * @return The mean of the elapsed times in nanoseconds.
  */
 extern long long stopwatch_read(void);
 
+/**
+ * @brief Returns a percentile of the elapsed times.
+ *
+ * Samples are recorded in a log-bucketed histogram, so the returned value is within about 3% of the exact percentile.
+ *
+ * @param percentile Target percentile, between 0 and 100.
+ *
+ * @return The elapsed time in nanoseconds, below which @p percentile percent of the samples fall.
+ */
+extern long long stopwatch_percentile(double percentile);
+
+/**
+ * @brief Returns the longest elapsed time.
+ *
+ * @return The longest elapsed time in nanoseconds.
+ */
+extern long long stopwatch_max(void);
+
+/**
+ * @brief Prints a summary of the elapsed times: mean, p50, p90, p99, p99.9 and max.
+ *
+ * @param stream Target output stream.
+ * @param name   Name of what was measured.
+ */
+extern void stopwatch_print(FILE *stream, const char *name);
+
 #endif /* !STOPWATCH_H_ */
@@ -3,17 +3,40 @@
 
 CC = cl
 
+LIBS = $(LIBS) "WS2_32.lib"
+
+# Object files.
+OBJ = main.obj report.obj stopwatch.obj bench_memory.obj bench_net.obj bench_wait.obj bench_load.obj
+
 all: benchmarks
 
-benchmarks: make-dirs benchmarks.obj
-	$(CC) benchmarks.obj $(LIBS) /Fe: $(BINDIR)\benchmarks.exe
+benchmarks: make-dirs $(OBJ)
+	$(CC) $(OBJ) $(LIBS) /Fe: $(BINDIR)\benchmarks.exe
 
 clean:
-	IF EXIST benchmarks.obj del /Q benchmarks.obj
+	IF EXIST main.obj del /Q $(OBJ)
 	IF EXIST $(BINDIR)\benchmarks.exe del /S /Q $(BINDIR)\benchmarks.exe
 
-benchmarks.obj:
+main.obj:
 	$(CC) /I $(INCDIR) benchmarks\c\main.c /c
 
+report.obj:
+	$(CC) /I $(INCDIR) benchmarks\c\report.c /c
+
+stopwatch.obj:
+	$(CC) /I $(INCDIR) benchmarks\c\stopwatch.c /c
+
+bench_memory.obj:
+	$(CC) /I $(INCDIR) benchmarks\c\bench_memory.c /c
+
+bench_net.obj:
+	$(CC) /I $(INCDIR) benchmarks\c\bench_net.c /c
+
+bench_wait.obj:
+	$(CC) /I $(INCDIR) benchmarks\c\bench_wait.c /c
+
+bench_load.obj:
+	$(CC) /I $(INCDIR) benchmarks\c\bench_load.c /c
+
 make-dirs:
 	IF NOT EXIST $(BINDIR) mkdir $(BINDIR)
@@ -106,10 +106,13 @@ fn os_build() -> Result<()> {
         .allowlist_var("RTE_ETHER_MAX_LEN")
         .allowlist_var("RTE_ETH_RSS_IP")
         .allowlist_var("RTE_MAX_ETHPORTS")
+        .allowlist_var("RTE_ETH_RETA_GROUP_SIZE")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_UDP_CKSUM")
         .allowlist_var("RTE_ETH_MQ_RX_RSS")
         .allowlist_var("RTE_ETH_MQ_TX_NONE")
+        .allowlist_var("RTE_EPOLL_PER_THREAD")
+        .allowlist_var("RTE_INTR_EVENT_ADD")
         .allowlist_function("rte_eth_find_next_owned_by")
         .allowlist_function("rte_eth_dev_info_get")
         .allowlist_function("rte_eth_macaddr_get")
@@ -127,6 +130,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_dev_count_avail")
         .allowlist_function("rte_eth_conf")
         .allowlist_function("rte_eth_dev_configure")
+        .allowlist_function("rte_eth_dev_rss_reta_update")
         .allowlist_function("rte_eth_dev_count_avail")
         .allowlist_function("rte_eth_dev_get_mtu")
         .allowlist_function("rte_eth_dev_set_mtu")
@@ -149,6 +153,10 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_tx_burst")
         .allowlist_function("rte_eth_rx_burst")
         .allowlist_function("rte_eal_init")
+        .allowlist_function("rte_eth_dev_rx_intr_ctl_q")
+        .allowlist_function("rte_eth_dev_rx_intr_enable")
+        .allowlist_function("rte_eth_dev_rx_intr_disable")
+        .allowlist_function("rte_epoll_wait")
         .clang_arg(cflags)
         .header("wrapper.h")
         .parse_callbacks(Box::new(bindgen::CargoCallbacks))
@@ -255,10 +263,13 @@ fn os_build() -> Result<()> {
         .allowlist_var("RTE_ETHER_MAX_LEN")
         .allowlist_var("RTE_ETH_RSS_IP")
         .allowlist_var("RTE_MAX_ETHPORTS")
+        .allowlist_var("RTE_ETH_RETA_GROUP_SIZE")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_UDP_CKSUM")
         .allowlist_var("RTE_ETH_MQ_RX_RSS")
         .allowlist_var("RTE_ETH_MQ_TX_NONE")
+        .allowlist_var("RTE_EPOLL_PER_THREAD")
+        .allowlist_var("RTE_INTR_EVENT_ADD")
         .allowlist_function("rte_eth_find_next_owned_by")
         .allowlist_function("rte_eth_dev_info_get")
         .allowlist_function("rte_eth_macaddr_get")
@@ -276,6 +287,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_dev_count_avail")
         .allowlist_function("rte_eth_conf")
         .allowlist_function("rte_eth_dev_configure")
+        .allowlist_function("rte_eth_dev_rss_reta_update")
         .allowlist_function("rte_eth_dev_count_avail")
         .allowlist_function("rte_eth_dev_get_mtu")
         .allowlist_function("rte_eth_dev_set_mtu")
@@ -298,6 +310,10 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_tx_burst")
         .allowlist_function("rte_eth_rx_burst")
         .allowlist_function("rte_eal_init")
+        .allowlist_function("rte_eth_dev_rx_intr_ctl_q")
+        .allowlist_function("rte_eth_dev_rx_intr_enable")
+        .allowlist_function("rte_eth_dev_rx_intr_disable")
+        .allowlist_function("rte_epoll_wait")
         .clang_arg("-mavx")
         .header("wrapper.h")
         .parse_callbacks(Box::new(bindgen::CargoCallbacks::new()))
@@ -28,6 +28,11 @@ uint16_t rte_eth_rx_burst_(uint16_t port_id, uint16_t queue_id, struct rte_mbuf
     return rte_eth_rx_burst(port_id, queue_id, rx_pkts, nb_pkts);
 }
 
+int rte_eth_rx_queue_count_(uint16_t port_id, uint16_t queue_id)
+{
+    return rte_eth_rx_queue_count(port_id, queue_id);
+}
+
 uint16_t rte_mbuf_refcnt_read_(const struct rte_mbuf *m)
 {
     return rte_mbuf_refcnt_read(m);
@@ -43,6 +48,11 @@ char *rte_pktmbuf_adj_(struct rte_mbuf *m, uint16_t len)
     return rte_pktmbuf_adj(m, len);
 }
 
+char *rte_pktmbuf_prepend_(struct rte_mbuf *m, uint16_t len)
+{
+    return rte_pktmbuf_prepend(m, len);
+}
+
 int rte_pktmbuf_trim_(struct rte_mbuf *m, uint16_t len)
 {
     return rte_pktmbuf_trim(m, len);
@@ -73,6 +83,16 @@ int rte_eth_rss_ip_()
     return RTE_ETH_RSS_IP;
 }
 
+int rte_eth_rss_tcp_()
+{
+    return RTE_ETH_RSS_TCP;
+}
+
+int rte_eth_rss_udp_()
+{
+    return RTE_ETH_RSS_UDP;
+}
+
 int rte_eth_tx_offload_tcp_cksum_()
 {
     return RTE_ETH_TX_OFFLOAD_TCP_CKSUM;
@@ -97,3 +117,27 @@ int rte_eth_tx_offload_multi_segs_()
 {
     return RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
 }
+
+int rte_eth_tx_offload_tcp_tso_()
+{
+    return RTE_ETH_TX_OFFLOAD_TCP_TSO;
+}
+
+int rte_eth_tx_offload_ipv4_cksum_()
+{
+    return RTE_ETH_TX_OFFLOAD_IPV4_CKSUM;
+}
+
+void rte_mbuf_set_tcp_tso_(struct rte_mbuf *m, uint16_t l2_len, uint16_t l3_len, uint16_t l4_len, uint16_t tso_segsz)
+{
+    m->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM | RTE_MBUF_F_TX_TCP_SEG;
+    m->l2_len = l2_len;
+    m->l3_len = l3_len;
+    m->l4_len = l4_len;
+    m->tso_segsz = tso_segsz;
+}
+
+uint16_t rte_eth_tx_prepare_(uint16_t port_id, uint16_t queue_id, struct rte_mbuf **tx_pkts, uint16_t nb_pkts)
+{
+    return rte_eth_tx_prepare(port_id, queue_id, tx_pkts, nb_pkts);
+}
@@ -15,20 +15,28 @@ extern "C" {
     fn rte_pktmbuf_alloc_(mp: *mut rte_mempool) -> *mut rte_mbuf;
     fn rte_eth_tx_burst_(port_id: u16, queue_id: u16, tx_pkts: *mut *mut rte_mbuf, nb_pkts: u16) -> u16;
     fn rte_eth_rx_burst_(port_id: u16, queue_id: u16, rx_pkts: *mut *mut rte_mbuf, nb_pkts: u16) -> u16;
+    fn rte_eth_rx_queue_count_(port_id: u16, queue_id: u16) -> c_int;
     fn rte_mbuf_refcnt_read_(m: *const rte_mbuf) -> u16;
     fn rte_mbuf_refcnt_update_(m: *mut rte_mbuf, value: i16) -> u16;
     fn rte_pktmbuf_adj_(packet: *mut rte_mbuf, len: u16) -> *mut c_char;
+    fn rte_pktmbuf_prepend_(packet: *mut rte_mbuf, len: u16) -> *mut c_char;
     fn rte_pktmbuf_trim_(packet: *mut rte_mbuf, len: u16) -> c_int;
     fn rte_pktmbuf_headroom_(m: *const rte_mbuf) -> u16;
     fn rte_pktmbuf_tailroom_(m: *const rte_mbuf) -> u16;
     fn rte_errno_() -> c_int;
     fn rte_pktmbuf_chain_(head: *mut rte_mbuf, tail: *mut rte_mbuf) -> c_int;
     fn rte_eth_rss_ip_() -> c_int;
+    fn rte_eth_rss_tcp_() -> c_int;
+    fn rte_eth_rss_udp_() -> c_int;
     fn rte_eth_tx_offload_tcp_cksum_() -> c_int;
     fn rte_eth_tx_offload_udp_cksum_() -> c_int;
     fn rte_eth_rx_offload_tcp_cksum_() -> c_int;
     fn rte_eth_rx_offload_udp_cksum_() -> c_int;
     fn rte_eth_tx_offload_multi_segs_() -> c_int;
+    fn rte_eth_tx_offload_tcp_tso_() -> c_int;
+    fn rte_eth_tx_offload_ipv4_cksum_() -> c_int;
+    fn rte_mbuf_set_tcp_tso_(m: *mut rte_mbuf, l2_len: u16, l3_len: u16, l4_len: u16, tso_segsz: u16);
+    fn rte_eth_tx_prepare_(port_id: u16, queue_id: u16, tx_pkts: *mut *mut rte_mbuf, nb_pkts: u16) -> u16;
 }
 
 #[cfg(all(feature = "mlx5", target_os = "windows"))]
@@ -81,6 +89,11 @@ pub unsafe fn rte_eth_rx_burst(port_id: u16, queue_id: u16, rx_pkts: *mut *mut r
     rte_eth_rx_burst_(port_id, queue_id, rx_pkts, nb_pkts)
 }
 
+#[inline]
+pub unsafe fn rte_eth_rx_queue_count(port_id: u16, queue_id: u16) -> c_int {
+    rte_eth_rx_queue_count_(port_id, queue_id)
+}
+
 #[inline]
 pub unsafe fn rte_mbuf_refcnt_read(m: *const rte_mbuf) -> u16 {
     rte_mbuf_refcnt_read_(m)
@@ -96,6 +109,11 @@ pub unsafe fn rte_pktmbuf_adj(packet: *mut rte_mbuf, len: u16) -> *mut c_char {
     rte_pktmbuf_adj_(packet, len)
 }
 
+#[inline]
+pub unsafe fn rte_pktmbuf_prepend(packet: *mut rte_mbuf, len: u16) -> *mut c_char {
+    rte_pktmbuf_prepend_(packet, len)
+}
+
 #[inline]
 pub unsafe fn rte_pktmbuf_trim(packet: *mut rte_mbuf, len: u16) -> c_int {
     rte_pktmbuf_trim_(packet, len)
@@ -126,6 +144,16 @@ pub unsafe fn rte_eth_rss_ip() -> c_int {
     rte_eth_rss_ip_()
 }
 
+#[inline]
+pub unsafe fn rte_eth_rss_tcp() -> c_int {
+    rte_eth_rss_tcp_()
+}
+
+#[inline]
+pub unsafe fn rte_eth_rss_udp() -> c_int {
+    rte_eth_rss_udp_()
+}
+
 #[inline]
 pub unsafe fn rte_eth_tx_offload_tcp_cksum() -> c_int {
     rte_eth_tx_offload_tcp_cksum_()
@@ -150,3 +178,23 @@ pub unsafe fn rte_eth_rx_offload_udp_cksum() -> c_int {
 pub unsafe fn rte_eth_tx_offload_multi_segs() -> c_int {
     rte_eth_tx_offload_multi_segs_()
 }
+
+#[inline]
+pub unsafe fn rte_eth_tx_offload_tcp_tso() -> c_int {
+    rte_eth_tx_offload_tcp_tso_()
+}
+
+#[inline]
+pub unsafe fn rte_eth_tx_offload_ipv4_cksum() -> c_int {
+    rte_eth_tx_offload_ipv4_cksum_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_set_tcp_tso(m: *mut rte_mbuf, l2_len: u16, l3_len: u16, l4_len: u16, tso_segsz: u16) {
+    rte_mbuf_set_tcp_tso_(m, l2_len, l3_len, l4_len, tso_segsz)
+}
+
+#[inline]
+pub unsafe fn rte_eth_tx_prepare(port_id: u16, queue_id: u16, tx_pkts: *mut *mut rte_mbuf, nb_pkts: u16) -> u16 {
+    rte_eth_tx_prepare_(port_id, queue_id, tx_pkts, nb_pkts)
+}
@@ -8,6 +8,7 @@
 #include <rte_common.h>
 #include <rte_cycles.h>
 #include <rte_eal.h>
+#include <rte_interrupts.h>
 #include <rte_ip.h>
 #include <rte_lcore.h>
 #include <rte_memcpy.h>
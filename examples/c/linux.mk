@@ -5,9 +5,12 @@
 # Toolchain Configuration
 #=======================================================================================================================
 
+# Directory of the benchmarks, which the examples borrow the stopwatch from.
+export BENCHDIR := ../../benchmarks/c
+
 # C
 export CC := gcc
-export CFLAGS := -Werror -Wall -Wextra -O3 -I $(INCDIR) -std=c99
+export CFLAGS := -Werror -Wall -Wextra -O3 -I $(INCDIR) -I $(BENCHDIR) -std=c99
 
 #=======================================================================================================================
 # Build Artifacts
@@ -25,6 +28,9 @@ export EXEC_SUFFIX := elf
 # Compiles several object files into a binary.
 export COMPILE_CMD = $(CC) $(CFLAGS) $@.o common.o -o $(BINDIR)/examples/c/$@.$(EXEC_SUFFIX) $(LIBS)
 
+# Compiles several object files into a binary that times round trips with the stopwatch.
+export COMPILE_TIMED_CMD = $(CC) $(CFLAGS) $@.o common.o stopwatch.o -o $(BINDIR)/examples/c/$@.$(EXEC_SUFFIX) $(LIBS)
+
 #=======================================================================================================================
 
 # Builds everything.
@@ -34,7 +40,7 @@ make-dirs:
 	mkdir -p $(BINDIR)/examples/c
 
 # Builds pipe ping pong test.
-pipe-ping-pong: make-dirs pipe-ping-pong.o
+pipe-ping-pong: make-dirs common.o pipe-ping-pong.o
 	$(COMPILE_CMD)
 
 # Builds UDP push pop test.
@@ -42,26 +48,30 @@ udp-push-pop: make-dirs common.o udp-push-pop.o
 	$(COMPILE_CMD)
 
 # Builds UDP ping pong test.
-udp-ping-pong: make-dirs common.o udp-ping-pong.o
-	$(COMPILE_CMD)
+udp-ping-pong: make-dirs common.o stopwatch.o udp-ping-pong.o
+	$(COMPILE_TIMED_CMD)
 
 # Builds TCP push pop test.
 tcp-push-pop: make-dirs common.o tcp-push-pop.o
 	$(COMPILE_CMD)
 
 # Builds TCP ping pong test.
-tcp-ping-pong: make-dirs common.o tcp-ping-pong.o
-	$(COMPILE_CMD)
+tcp-ping-pong: make-dirs common.o stopwatch.o tcp-ping-pong.o
+	$(COMPILE_TIMED_CMD)
 
 # Cleans up all build artifacts.
 clean:
-	@rm -rf $(OBJ)
+	@rm -rf $(OBJ) stopwatch.o
 	@rm -rf $(BINDIR)/examples/c/pipe-ping-pong.$(EXEC_SUFFIX)
 	@rm -rf $(BINDIR)/examples/c/udp-push-pop.$(EXEC_SUFFIX)
 	@rm -rf $(BINDIR)/examples/c/udp-ping-pong.$(EXEC_SUFFIX)
 	@rm -rf $(BINDIR)/examples/c/tcp-push-pop.$(EXEC_SUFFIX)
 	@rm -rf $(BINDIR)/examples/c/tcp-ping-pong.$(EXEC_SUFFIX)
 
+# Builds the stopwatch.
+stopwatch.o: $(BENCHDIR)/stopwatch.c
+	$(CC) $(CFLAGS) $< -c -o $@
+
 # Builds a C source file.
 %.o: %.c
 	$(CC) $(CFLAGS) $< -c -o $@
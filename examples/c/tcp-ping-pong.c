@@ -22,6 +22,7 @@
 #endif
 
 #include "common.h"
+#include "stopwatch.h"
 
 /*====================================================================================================================*
  * Constants                                                                                                          *
@@ -225,6 +226,7 @@ static void client(int argc, char *const argv[], const struct sockaddr_in *remot
     connect_wait(sockqd, remote);
 
     /* Run. */
+    stopwatch_reset();
     while (nbytes < max_bytes)
     {
         demi_qresult_t qr = {0};
@@ -238,6 +240,7 @@ static void client(int argc, char *const argv[], const struct sockaddr_in *remot
         memset(sga.sga_segs[0].sgaseg_buf, 1, data_size);
 
         /* Push scatter-gather array. */
+        stopwatch_start();
         push_wait(sockqd, &sga, &qr);
 
         /* Release sent scatter-gather array. */
@@ -246,6 +249,7 @@ static void client(int argc, char *const argv[], const struct sockaddr_in *remot
         /* Pop data scatter-gather array. */
         memset(&qr, 0, sizeof(demi_qresult_t));
         pop_wait(sockqd, &qr);
+        stopwatch_stop();
 
         /* Check payload. */
         for (uint32_t i = 0; i < qr.qr_value.sga.sga_segs[0].sgaseg_len; i++)
@@ -257,6 +261,9 @@ static void client(int argc, char *const argv[], const struct sockaddr_in *remot
 
         fprintf(stdout, "pong (%zu)\n", nbytes);
     }
+
+    /* Print round-trip times. */
+    stopwatch_print(stdout, "rtt");
 }
 
 /*====================================================================================================================*
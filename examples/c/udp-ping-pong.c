@@ -23,6 +23,7 @@
 #endif
 
 #include "common.h"
+#include "stopwatch.h"
 
 /*====================================================================================================================*
  * Constants                                                                                                          *
@@ -178,6 +179,7 @@ static void client(int argc,
     assert(demi_bind(sockqd, (const struct sockaddr *)local, sizeof(struct sockaddr_in)) == 0);
 
     /* Run. */
+    stopwatch_reset();
     for (unsigned it = 0; it < max_iterations; it++)
     {
         demi_qresult_t qr = {0};
@@ -192,6 +194,7 @@ static void client(int argc,
         memcpy(sga.sga_segs[0].sgaseg_buf, expected_buf, data_size);
 
         /* Push scatter-gather array. */
+        stopwatch_start();
         pushto_wait(sockqd, &sga, &qr, (const struct sockaddr *)remote);
 
         /* Release sent scatter-gather array. */
@@ -199,6 +202,7 @@ static void client(int argc,
 
         /* Pop data scatter-gather array. */
         pop_wait(sockqd, &qr);
+        stopwatch_stop();
 
         /* Parse operation result. */
         assert(!memcmp(qr.qr_value.sga.sga_segs[0].sgaseg_buf, expected_buf, data_size));
@@ -208,6 +212,9 @@ static void client(int argc,
 
         fprintf(stdout, "pong (%u)\n", it);
     }
+
+    /* Print round-trip times. */
+    stopwatch_print(stdout, "rtt");
 }
 
 /*====================================================================================================================*
@@ -13,6 +13,9 @@ CFLAGS = $(CFLAGS) /Zi
 # Compiles several object files into a binary.
 COMPILE_CMD = $(CC) $(CFLAGS) $@.obj common.obj $(LIBS) /Fe: $(BINDIR)/examples/c/$@.exe
 
+# Compiles several object files into a binary that times round trips with the stopwatch.
+COMPILE_TIMED_CMD = $(CC) $(CFLAGS) $@.obj common.obj stopwatch.obj $(LIBS) /Fe: $(BINDIR)/examples/c/$@.exe
+
 # Builds everything.
 all: udp-push-pop udp-ping-pong tcp-push-pop tcp-ping-pong
 
@@ -25,7 +28,7 @@ udp-push-pop: make-dirs udp-push-pop.obj
 
 # Builds UDP ping pong test.
 udp-ping-pong: make-dirs udp-ping-pong.obj
-	$(COMPILE_CMD)
+	$(COMPILE_TIMED_CMD)
 
 # Builds TCP push pop test.
 tcp-push-pop: make-dirs tcp-push-pop.obj
@@ -33,7 +36,7 @@ tcp-push-pop: make-dirs tcp-push-pop.obj
 
 # Builds TCP ping pong test.
 tcp-ping-pong: make-dirs tcp-ping-pong.obj
-	$(COMPILE_CMD)
+	$(COMPILE_TIMED_CMD)
 
 # Cleans up all build artifacts.
 clean:
@@ -47,14 +50,17 @@ clean:
 common.obj:
 	$(CC) /I $(INCDIR) /I examples\c\ examples\c\common.c /c
 
+stopwatch.obj:
+	$(CC) /I benchmarks\c\ benchmarks\c\stopwatch.c /c
+
 udp-push-pop.obj: common.obj
 	$(CC) /I $(INCDIR) /I examples\c\ examples\c\udp-push-pop.c /c
 
-udp-ping-pong.obj: common.obj
-	$(CC) /I $(INCDIR) /I examples\c\ examples\c\udp-ping-pong.c /c
+udp-ping-pong.obj: common.obj stopwatch.obj
+	$(CC) /I $(INCDIR) /I examples\c\ /I benchmarks\c\ examples\c\udp-ping-pong.c /c
 
 tcp-push-pop.obj: common.obj
 	$(CC) /I $(INCDIR) /I examples\c\ examples\c\tcp-push-pop.c /c
 
-tcp-ping-pong.obj: common.obj
-	$(CC) /I $(INCDIR) /I examples\c\ examples\c\tcp-ping-pong.c /c
+tcp-ping-pong.obj: common.obj stopwatch.obj
+	$(CC) /I $(INCDIR) /I examples\c\ /I benchmarks\c\ examples\c\tcp-ping-pong.c /c
@@ -0,0 +1,47 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+#=======================================================================================================================
+# Toolchain Configuration
+#=======================================================================================================================
+
+# C++
+export CXX := g++
+export CXXFLAGS := -Werror -Wall -Wextra -O3 -I $(INCDIR) -std=c++20
+
+#=======================================================================================================================
+# Build Artifacts
+#=======================================================================================================================
+
+# C++ source files.
+export SRC_CXX := $(wildcard *.cpp)
+
+# Object files.
+export OBJ := $(SRC_CXX:.cpp=.o)
+
+# Suffix for executable files.
+export EXEC_SUFFIX := elf
+
+# Compiles an object file into a binary.
+export COMPILE_CMD = $(CXX) $(CXXFLAGS) $@.o -o $(BINDIR)/examples/cpp/$@.$(EXEC_SUFFIX) $(LIBS)
+
+#=======================================================================================================================
+
+# Builds everything.
+all: tcp-echo
+
+make-dirs:
+	mkdir -p $(BINDIR)/examples/cpp
+
+# Builds TCP echo test.
+tcp-echo: make-dirs tcp-echo.o
+	$(COMPILE_CMD)
+
+# Cleans up all build artifacts.
+clean:
+	@rm -rf $(OBJ)
+	@rm -rf $(BINDIR)/examples/cpp/tcp-echo.$(EXEC_SUFFIX)
+
+# Builds a C++ source file.
+%.o: %.cpp $(INCDIR)/demi/demi.hpp
+	$(CXX) $(CXXFLAGS) $< -c -o $@
@@ -0,0 +1,256 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include <demi/demi.hpp>
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <string>
+#include <utility>
+
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Data size.
+ */
+static constexpr std::size_t DATA_SIZE = 64;
+
+/**
+ * @brief Maximum number of messages to transfer.
+ */
+static constexpr unsigned MAX_MSGS = 1024;
+
+/**
+ * @brief Number of messages that the client keeps in flight.
+ */
+static constexpr std::size_t DEPTH = 16;
+
+/*====================================================================================================================*
+ * server()                                                                                                           *
+ *====================================================================================================================*/
+
+/**
+ * @brief Echoes data back on a connection until the client closes it.
+ *
+ * @param queue Accepted connection.
+ */
+static demi::Task echo(demi::Queue queue)
+{
+    for (;;)
+    {
+        demi::Sga sga = co_await queue.pop();
+        if (sga.size() == 0)
+            break;
+        co_await queue.push(sga);
+    }
+}
+
+/**
+ * @brief Accepts connections and starts an echo task for each of them.
+ *
+ * @param executor Executor that runs the echo tasks.
+ * @param listener Passive socket.
+ * @param max_conns Number of connections to accept.
+ */
+static demi::Task accept_loop(demi::Executor &executor, demi::Queue &listener, unsigned max_conns)
+{
+    for (unsigned i = 0; i < max_conns; i++)
+    {
+        demi::Accepted accepted = co_await listener.accept();
+        executor.spawn(echo(std::move(accepted.queue)));
+    }
+}
+
+/**
+ * @brief TCP echo server, which serves several connections at once.
+ *
+ * @param local Local socket address.
+ * @param max_conns Number of connections to serve.
+ */
+static void server(const struct sockaddr_in &local, unsigned max_conns)
+{
+    demi::Executor executor;
+    demi::Queue listener = demi::Queue::socket(AF_INET, SOCK_STREAM);
+    listener.bind(local);
+    listener.listen(16);
+
+    executor.spawn(accept_loop(executor, listener, max_conns));
+    executor.run();
+}
+
+/*====================================================================================================================*
+ * client()                                                                                                           *
+ *====================================================================================================================*/
+
+/**
+ * @brief Pushes messages, with up to DEPTH of them in flight.
+ *
+ * @param queue Connected socket.
+ * @param data_size Number of bytes in each message.
+ * @param max_msgs Number of messages to send.
+ */
+static demi::Task send_loop(demi::Queue &queue, std::size_t data_size, unsigned max_msgs)
+{
+    std::deque<std::pair<demi::Sga, demi::Operation<void>>> inflight;
+    for (unsigned i = 0; i < max_msgs; i++)
+    {
+        if (inflight.size() == DEPTH)
+        {
+            co_await inflight.front().second;
+            inflight.pop_front();
+        }
+        demi::Sga sga = demi::Sga::alloc(data_size);
+        std::memset(sga.data().data(), 1, sga.data().size());
+        demi::Operation<void> push = queue.push(sga);
+        inflight.emplace_back(std::move(sga), std::move(push));
+    }
+    while (!inflight.empty())
+    {
+        co_await inflight.front().second;
+        inflight.pop_front();
+    }
+}
+
+/**
+ * @brief Pops the echoed data and checks it.
+ *
+ * @param queue Connected socket.
+ * @param max_bytes Number of bytes to receive.
+ */
+static demi::Task receive_loop(demi::Queue &queue, std::size_t max_bytes)
+{
+    std::size_t nbytes = 0;
+    while (nbytes < max_bytes)
+    {
+        demi::Sga sga = co_await queue.pop();
+        if (sga.size() == 0)
+            throw std::runtime_error("connection closed by server");
+        for (demi_sgaseg_t &seg : sga.segments())
+        {
+            for (std::uint32_t i = 0; i < seg.sgaseg_len; i++)
+            {
+                if (static_cast<const char *>(seg.sgaseg_buf)[i] != 1)
+                    throw std::runtime_error("unexpected payload");
+            }
+        }
+        nbytes += sga.size();
+    }
+    std::fprintf(stdout, "pong (%zu)\n", nbytes);
+}
+
+/**
+ * @brief TCP echo client, which keeps several messages in flight on its connection.
+ *
+ * @param remote Remote socket address.
+ * @param data_size Number of bytes in each message.
+ * @param max_msgs Number of messages to transfer.
+ */
+static void client(const struct sockaddr_in &remote, std::size_t data_size, unsigned max_msgs)
+{
+    demi::Executor executor;
+    demi::Queue queue = demi::Queue::socket(AF_INET, SOCK_STREAM);
+
+    executor.spawn([](demi::Queue &queue, const struct sockaddr_in remote) -> demi::Task {
+        co_await queue.connect(remote);
+    }(queue, remote));
+    executor.run();
+
+    executor.spawn(send_loop(queue, data_size, max_msgs));
+    executor.spawn(receive_loop(queue, data_size * max_msgs));
+    executor.run();
+}
+
+/*====================================================================================================================*
+ * usage()                                                                                                            *
+ *====================================================================================================================*/
+
+/**
+ * @brief Prints program usage.
+ *
+ * @param progname Program name.
+ */
+static void usage(const char *progname)
+{
+    std::fprintf(stderr, "Usage: %s MODE ipv4-address port [data-size] [max-msgs]\n", progname);
+    std::fprintf(stderr, "MODE:\n");
+    std::fprintf(stderr, "  --client    Run in client mode.\n");
+    std::fprintf(stderr, "  --server    Run in server mode.\n");
+}
+
+/*====================================================================================================================*
+ * build_sockaddr()                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Builds a socket address.
+ *
+ * @param ip_str    String representation of an IP address.
+ * @param port_str  String representation of a port number.
+ *
+ * @return The socket address.
+ */
+static struct sockaddr_in build_sockaddr(const char *ip_str, const char *port_str)
+{
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(std::stoi(port_str)));
+    if (inet_pton(AF_INET, ip_str, &addr.sin_addr) != 1)
+        throw std::invalid_argument("invalid ipv4 address");
+    return addr;
+}
+
+/*====================================================================================================================*
+ * main()                                                                                                             *
+ *====================================================================================================================*/
+
+/**
+ * @brief Echoes messages over TCP, with the C++ interface of Demikernel.
+ *
+ * The client keeps several messages in flight on its connection, and the server echoes data back on as many
+ * connections as it accepts, with one task per connection.
+ *
+ * @param argc Argument count.
+ * @param argv Argument list.
+ *
+ * @return On successful completion EXIT_SUCCESS is returned.
+ */
+int main(int argc, char *const argv[])
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return (EXIT_SUCCESS);
+    }
+
+    try
+    {
+        std::size_t data_size = (argc >= 5) ? std::stoul(argv[4]) : DATA_SIZE;
+        unsigned max_msgs = (argc >= 6) ? static_cast<unsigned>(std::stoul(argv[5])) : MAX_MSGS;
+        struct sockaddr_in saddr = build_sockaddr(argv[2], argv[3]);
+
+        demi::init(argc, argv);
+        if (!std::strcmp(argv[1], "--server"))
+            server(saddr, 1);
+        else if (!std::strcmp(argv[1], "--client"))
+            client(saddr, data_size, max_msgs);
+        else
+            usage(argv[0]);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return (EXIT_FAILURE);
+    }
+
+    return (EXIT_SUCCESS);
+}
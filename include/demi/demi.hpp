@@ -0,0 +1,860 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef DEMI_DEMI_HPP_IS_INCLUDED
+#define DEMI_DEMI_HPP_IS_INCLUDED
+
+/**
+ * @file
+ * @brief Header-only C++20 interface to Demikernel.
+ *
+ * @details Scatter-gather arrays and I/O queue descriptors are wrapped in move-only types that release them when they
+ * go out of scope. Asynchronous operations are started as soon as they are issued, and their results are retrieved by
+ * awaiting them from a demi::Task coroutine. A demi::Executor runs tasks and resumes them as their operations
+ * complete, waiting on all outstanding operations at once. Several operations can be in flight on the same queue, even
+ * from a single task, by issuing them before awaiting any of them.
+ *
+ * Errors that are returned by Demikernel are thrown as std::system_error, with the error code in the generic category.
+ */
+
+#include <demi/libos.h>
+#include <demi/sga.h>
+#include <demi/types.h>
+#include <demi/wait.h>
+
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <span>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace demi
+{
+
+class Executor;
+
+/*====================================================================================================================*
+ * Errors                                                                                                             *
+ *====================================================================================================================*/
+
+/**
+ * @brief Throws a positive error code that was returned by Demikernel.
+ *
+ * @param err  Error code.
+ * @param what Name of the failed call.
+ */
+[[noreturn]] inline void throw_error(int err, const char *what)
+{
+    throw std::system_error(err, std::generic_category(), what);
+}
+
+/**
+ * @brief Checks the return code of a call into Demikernel, and throws it on failure.
+ *
+ * @param ret  Return code.
+ * @param what Name of the call.
+ */
+inline void check(int ret, const char *what)
+{
+    if (ret != 0)
+        throw_error(ret, what);
+}
+
+/**
+ * @brief Initializes Demikernel.
+ *
+ * @param argc Number of arguments.
+ * @param argv Argument values.
+ */
+inline void init(int argc, char *const argv[])
+{
+    check(demi_init(argc, argv), "demi_init");
+}
+
+/*====================================================================================================================*
+ * Sga                                                                                                                *
+ *====================================================================================================================*/
+
+/**
+ * @brief A scatter-gather array, which is released with demi_sgafree() when it goes out of scope.
+ */
+class Sga
+{
+  public:
+    /**
+     * @brief Creates an empty scatter-gather array.
+     */
+    Sga() noexcept : sga_{}
+    {
+    }
+
+    /**
+     * @brief Takes ownership of a scatter-gather array.
+     *
+     * @param sga Scatter-gather array that was allocated or returned by Demikernel.
+     */
+    explicit Sga(const demi_sgarray_t &sga) noexcept : sga_(sga)
+    {
+    }
+
+    /**
+     * @brief Allocates a scatter-gather array.
+     *
+     * @param size Size of the scatter-gather array.
+     *
+     * @return The allocated scatter-gather array. Throws std::bad_alloc on failure.
+     */
+    static Sga alloc(std::size_t size)
+    {
+        demi_sgarray_t sga = demi_sgaalloc(size);
+        if (sga.sga_numsegs == 0)
+            throw std::bad_alloc();
+        return Sga(sga);
+    }
+
+    Sga(const Sga &) = delete;
+    Sga &operator=(const Sga &) = delete;
+
+    Sga(Sga &&other) noexcept : sga_(std::exchange(other.sga_, demi_sgarray_t{}))
+    {
+    }
+
+    Sga &operator=(Sga &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            sga_ = std::exchange(other.sga_, demi_sgarray_t{});
+        }
+        return *this;
+    }
+
+    ~Sga()
+    {
+        reset();
+    }
+
+    /**
+     * @brief Checks if this holds a scatter-gather array.
+     */
+    explicit operator bool() const noexcept
+    {
+        return sga_.sga_numsegs != 0;
+    }
+
+    /**
+     * @brief Returns the segments of the scatter-gather array.
+     */
+    std::span<demi_sgaseg_t> segments() noexcept
+    {
+        return std::span<demi_sgaseg_t>(sga_.sga_segs, sga_.sga_numsegs);
+    }
+
+    /**
+     * @brief Returns the data of the first segment, which is all of it for scatter-gather arrays with one segment.
+     */
+    std::span<std::byte> data() noexcept
+    {
+        if (sga_.sga_numsegs == 0)
+            return std::span<std::byte>();
+        return std::span<std::byte>(static_cast<std::byte *>(sga_.sga_segs[0].sgaseg_buf), sga_.sga_segs[0].sgaseg_len);
+    }
+
+    /**
+     * @brief Returns the size in bytes of the data in all segments. A popped scatter-gather array with no data means
+     * that the other side closed the connection.
+     */
+    std::size_t size() const noexcept
+    {
+        std::size_t size = 0;
+        for (std::uint32_t i = 0; i < sga_.sga_numsegs; i++)
+            size += sga_.sga_segs[i].sgaseg_len;
+        return size;
+    }
+
+    /**
+     * @brief Returns the source address of a popped scatter-gather array.
+     */
+    struct sockaddr_in addr() const noexcept
+    {
+        return sga_.sga_addr;
+    }
+
+    /**
+     * @brief Appends the segments of another scatter-gather array to this one, taking over its buffers.
+     *
+     * @param tail Scatter-gather array to append, which is left empty on success.
+     */
+    void append(Sga &tail)
+    {
+        check(demi_sgaappend(&sga_, &tail.sga_), "demi_sgaappend");
+        // The buffers of the tail now belong to us, and it must not be released.
+        tail.sga_ = demi_sgarray_t{};
+    }
+
+    /**
+     * @brief Returns the underlying scatter-gather array, which remains owned by this object.
+     */
+    const demi_sgarray_t *get() const noexcept
+    {
+        return &sga_;
+    }
+
+    /**
+     * @brief Gives up ownership of the underlying scatter-gather array, which must then be released by the caller.
+     */
+    demi_sgarray_t release() noexcept
+    {
+        return std::exchange(sga_, demi_sgarray_t{});
+    }
+
+    /**
+     * @brief Releases the scatter-gather array, if any.
+     */
+    void reset() noexcept
+    {
+        if (sga_.sga_numsegs != 0)
+            demi_sgafree(&sga_);
+        sga_ = demi_sgarray_t{};
+    }
+
+  private:
+    demi_sgarray_t sga_;
+};
+
+/*====================================================================================================================*
+ * Task                                                                                                               *
+ *====================================================================================================================*/
+
+/**
+ * @brief A coroutine that awaits Demikernel operations, and that is run by an Executor.
+ *
+ * @details Tasks do not start until they are handed to Executor::spawn(). A task may only suspend by awaiting an
+ * Operation.
+ */
+class Task
+{
+  public:
+    /**
+     * @brief Coroutine promise of a task.
+     */
+    struct promise_type
+    {
+        /**
+         * @brief Executor that runs this task.
+         */
+        Executor *executor = nullptr;
+
+        /**
+         * @brief Exception that escaped the task, if any.
+         */
+        std::exception_ptr exception;
+
+        Task get_return_object() noexcept
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept
+        {
+            exception = std::current_exception();
+        }
+    };
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+  private:
+    friend class Executor;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/*====================================================================================================================*
+ * Operation                                                                                                          *
+ *====================================================================================================================*/
+
+namespace detail
+{
+
+/**
+ * @brief Checks the result of a completed operation, and throws its error code if it failed.
+ */
+inline void check_result(const demi_qresult_t &qr)
+{
+    if (qr.qr_opcode == DEMI_OPC_FAILED)
+        throw_error(static_cast<int>(qr.qr_ret), "operation failed");
+}
+
+} // namespace detail
+
+/**
+ * @brief An asynchronous operation that was issued on an I/O queue.
+ *
+ * @details The operation runs as soon as it is issued. Awaiting it from a Task suspends the task until the operation
+ * completes, and then yields its result, of type @p T. Every operation should be awaited exactly once, as Demikernel
+ * holds on to the result of an operation until it is retrieved.
+ *
+ * @tparam T Type of the result.
+ */
+template <typename T> class Operation
+{
+  public:
+    /**
+     * @brief Wraps the I/O queue token of an operation that was issued.
+     */
+    explicit Operation(demi_qtoken_t qt) noexcept : qt_(qt), qr_{}
+    {
+    }
+
+    Operation(const Operation &) = delete;
+    Operation &operator=(const Operation &) = delete;
+    Operation(Operation &&) noexcept = default;
+    Operation &operator=(Operation &&) noexcept = default;
+
+    /**
+     * @brief Returns the I/O queue token of the operation.
+     */
+    demi_qtoken_t token() const noexcept
+    {
+        return qt_;
+    }
+
+    /**
+     * @brief Suspends the awaiting task until the operation completes.
+     */
+    class Awaiter
+    {
+      public:
+        explicit Awaiter(Operation *operation) noexcept : operation_(operation)
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<Task::promise_type> handle);
+
+        T await_resume();
+
+      private:
+        Operation *operation_;
+    };
+
+    /**
+     * @brief Awaits the operation in place, so that the result is stored right into it.
+     */
+    Awaiter operator co_await() noexcept
+    {
+        return Awaiter(this);
+    }
+
+  private:
+    demi_qtoken_t qt_;
+    demi_qresult_t qr_;
+};
+
+/*====================================================================================================================*
+ * Queue                                                                                                              *
+ *====================================================================================================================*/
+
+struct Accepted;
+
+/**
+ * @brief An I/O queue descriptor, which is closed when it goes out of scope.
+ */
+class Queue
+{
+  public:
+    /**
+     * @brief Creates a handle that holds no I/O queue.
+     */
+    Queue() noexcept : qd_(-1)
+    {
+    }
+
+    /**
+     * @brief Takes ownership of an I/O queue descriptor.
+     */
+    explicit Queue(int qd) noexcept : qd_(qd)
+    {
+    }
+
+    /**
+     * @brief Creates a socket I/O queue.
+     *
+     * @param domain   Communication domain for the new socket.
+     * @param type     Type of the socket.
+     * @param protocol Communication protocol for the new socket.
+     */
+    static Queue socket(int domain, int type, int protocol = 0)
+    {
+        int qd = -1;
+        check(demi_socket(&qd, domain, type, protocol), "demi_socket");
+        return Queue(qd);
+    }
+
+    /**
+     * @brief Creates a new memory I/O queue.
+     *
+     * @param name Name of the memory I/O queue.
+     */
+    static Queue create_pipe(const char *name)
+    {
+        int qd = -1;
+        check(demi_create_pipe(&qd, name), "demi_create_pipe");
+        return Queue(qd);
+    }
+
+    /**
+     * @brief Opens an existing memory I/O queue.
+     *
+     * @param name Name of the memory I/O queue.
+     */
+    static Queue open_pipe(const char *name)
+    {
+        int qd = -1;
+        check(demi_open_pipe(&qd, name), "demi_open_pipe");
+        return Queue(qd);
+    }
+
+    Queue(const Queue &) = delete;
+    Queue &operator=(const Queue &) = delete;
+
+    Queue(Queue &&other) noexcept : qd_(std::exchange(other.qd_, -1))
+    {
+    }
+
+    Queue &operator=(Queue &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            qd_ = std::exchange(other.qd_, -1);
+        }
+        return *this;
+    }
+
+    ~Queue()
+    {
+        reset();
+    }
+
+    /**
+     * @brief Checks if this holds an I/O queue.
+     */
+    explicit operator bool() const noexcept
+    {
+        return qd_ >= 0;
+    }
+
+    /**
+     * @brief Returns the I/O queue descriptor, which remains owned by this object.
+     */
+    int get() const noexcept
+    {
+        return qd_;
+    }
+
+    /**
+     * @brief Gives up ownership of the I/O queue descriptor, which must then be closed by the caller.
+     */
+    int release() noexcept
+    {
+        return std::exchange(qd_, -1);
+    }
+
+    /**
+     * @brief Closes the I/O queue, reporting any error.
+     */
+    void close()
+    {
+        if (qd_ >= 0)
+            check(demi_close(std::exchange(qd_, -1)), "demi_close");
+    }
+
+    /**
+     * @brief Binds an address to a socket I/O queue.
+     *
+     * @param addr Local address.
+     */
+    void bind(const struct sockaddr_in &addr)
+    {
+        check(demi_bind(qd_, reinterpret_cast<const struct sockaddr *>(&addr), sizeof(addr)), "demi_bind");
+    }
+
+    /**
+     * @brief Sets as passive a socket I/O queue.
+     *
+     * @param backlog Maximum number of pending connections.
+     */
+    void listen(int backlog)
+    {
+        check(demi_listen(qd_, backlog), "demi_listen");
+    }
+
+    /**
+     * @brief Accepts a connection on a socket I/O queue.
+     */
+    Operation<Accepted> accept();
+
+    /**
+     * @brief Initiates a connection on a socket I/O queue.
+     *
+     * @param addr Remote address.
+     */
+    Operation<void> connect(const struct sockaddr_in &addr)
+    {
+        demi_qtoken_t qt = 0;
+        check(demi_connect(&qt, qd_, reinterpret_cast<const struct sockaddr *>(&addr), sizeof(addr)),
+              "demi_connect");
+        return Operation<void>(qt);
+    }
+
+    /**
+     * @brief Pushes a scatter-gather array to the I/O queue. The scatter-gather array must outlive the operation.
+     *
+     * @param sga Scatter-gather array to push.
+     */
+    Operation<void> push(const Sga &sga)
+    {
+        demi_qtoken_t qt = 0;
+        check(demi_push(&qt, qd_, sga.get()), "demi_push");
+        return Operation<void>(qt);
+    }
+
+    /**
+     * @brief Pushes a scatter-gather array to a socket I/O queue. The scatter-gather array must outlive the operation.
+     *
+     * @param sga  Scatter-gather array to push.
+     * @param addr Remote address.
+     */
+    Operation<void> pushto(const Sga &sga, const struct sockaddr_in &addr)
+    {
+        demi_qtoken_t qt = 0;
+        check(demi_pushto(&qt, qd_, sga.get(), reinterpret_cast<const struct sockaddr *>(&addr), sizeof(addr)),
+              "demi_pushto");
+        return Operation<void>(qt);
+    }
+
+    /**
+     * @brief Pops a scatter-gather array from the I/O queue.
+     */
+    Operation<Sga> pop()
+    {
+        demi_qtoken_t qt = 0;
+        check(demi_pop(&qt, qd_), "demi_pop");
+        return Operation<Sga>(qt);
+    }
+
+    /**
+     * @brief Pops data from the I/O queue straight into the buffer of a scatter-gather array with a single segment.
+     * The scatter-gather array must outlive the operation. The result covers the received data in that buffer.
+     *
+     * @param sga Scatter-gather array to receive data into.
+     */
+    Operation<Sga> pop_into(const Sga &sga)
+    {
+        demi_qtoken_t qt = 0;
+        check(demi_pop_into(&qt, qd_, sga.get()), "demi_pop_into");
+        return Operation<Sga>(qt);
+    }
+
+  private:
+    /**
+     * @brief Closes the I/O queue, ignoring errors.
+     */
+    void reset() noexcept
+    {
+        if (qd_ >= 0)
+            demi_close(std::exchange(qd_, -1));
+    }
+
+    int qd_;
+};
+
+/**
+ * @brief Result of an accept operation.
+ */
+struct Accepted
+{
+    Queue queue;             /**< Accepted connection.          */
+    struct sockaddr_in addr; /**< Remote address of connection. */
+};
+
+inline Operation<Accepted> Queue::accept()
+{
+    demi_qtoken_t qt = 0;
+    check(demi_accept(&qt, qd_), "demi_accept");
+    return Operation<Accepted>(qt);
+}
+
+/*====================================================================================================================*
+ * Executor                                                                                                           *
+ *====================================================================================================================*/
+
+/**
+ * @brief Runs tasks on the calling thread, and resumes them as the operations that they await complete.
+ *
+ * @details All outstanding operations are waited on with a single call to demi_wait_many(), which hands back the
+ * results of up to a batch of completed operations at a time. An exception that escapes from a task is rethrown by
+ * Executor::run() or Executor::poll().
+ */
+class Executor
+{
+  public:
+    /**
+     * @brief Creates an executor.
+     *
+     * @param batch_size Largest number of completed operations to retrieve per wait.
+     */
+    explicit Executor(std::size_t batch_size = 64) : results_(batch_size == 0 ? 1 : batch_size)
+    {
+    }
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    /**
+     * @brief Destroys the tasks that are still suspended. Their outstanding operations are abandoned.
+     */
+    ~Executor()
+    {
+        for (Waiter &waiter : waiters_)
+            waiter.handle.destroy();
+    }
+
+    /**
+     * @brief Starts a task, which runs until it first awaits an operation.
+     *
+     * @param task Task to run.
+     */
+    void spawn(Task task)
+    {
+        std::coroutine_handle<Task::promise_type> handle = std::exchange(task.handle_, nullptr);
+        handle.promise().executor = this;
+        if (std::exception_ptr exception = resume(handle))
+            std::rethrow_exception(exception);
+    }
+
+    /**
+     * @brief Runs tasks until none of them waits on an operation anymore.
+     */
+    void run()
+    {
+        while (!qts_.empty())
+            poll(nullptr);
+    }
+
+    /**
+     * @brief Waits for outstanding operations to complete, and resumes the tasks that await them.
+     *
+     * @param timeout Timeout interval, or nullptr to use the default one of Demikernel.
+     *
+     * @return The number of tasks that were resumed, which is zero if the wait timed out.
+     */
+    std::size_t poll(const struct timespec *timeout)
+    {
+        if (qts_.empty())
+            return 0;
+
+        int nqrs = 0;
+        int ret = demi_wait_many(results_.data(), &nqrs, static_cast<int>(results_.size()), qts_.data(),
+                                 static_cast<int>(qts_.size()), timeout);
+        if (ret == ETIMEDOUT)
+            return 0;
+        check(ret, "demi_wait_many");
+
+        // Hand over all results before resuming any task, since resumed tasks may issue and await new operations.
+        ready_.clear();
+        for (int i = 0; i < nqrs; i++)
+        {
+            Waiter waiter = remove_waiter(results_[i].qr_qt);
+            *waiter.result = results_[i];
+            ready_.push_back(waiter.handle);
+        }
+        std::exception_ptr exception;
+        for (std::coroutine_handle<Task::promise_type> handle : ready_)
+        {
+            std::exception_ptr e = resume(handle);
+            if (e && !exception)
+                exception = e;
+        }
+        if (exception)
+            std::rethrow_exception(exception);
+        return static_cast<std::size_t>(nqrs);
+    }
+
+    /**
+     * @brief Returns the number of outstanding operations that tasks wait on.
+     */
+    std::size_t size() const noexcept
+    {
+        return qts_.size();
+    }
+
+  private:
+    template <typename T> friend class Operation;
+
+    /**
+     * @brief A task that waits for an operation to complete.
+     */
+    struct Waiter
+    {
+        demi_qresult_t *result;                           /**< Store location for the result. */
+        std::coroutine_handle<Task::promise_type> handle; /**< Task to resume.                */
+    };
+
+    /**
+     * @brief Suspends a task until the operation with I/O queue token @p qt completes.
+     */
+    void suspend(demi_qtoken_t qt, demi_qresult_t *result, std::coroutine_handle<Task::promise_type> handle)
+    {
+        index_.emplace(qt, qts_.size());
+        qts_.push_back(qt);
+        waiters_.push_back(Waiter{result, handle});
+    }
+
+    /**
+     * @brief Removes the task that waits on the operation with I/O queue token @p qt.
+     */
+    Waiter remove_waiter(demi_qtoken_t qt)
+    {
+        auto it = index_.find(qt);
+        std::size_t i = it->second;
+        index_.erase(it);
+        Waiter waiter = waiters_[i];
+
+        // Fill the hole with the last entry.
+        std::size_t last = qts_.size() - 1;
+        if (i != last)
+        {
+            qts_[i] = qts_[last];
+            waiters_[i] = waiters_[last];
+            index_[qts_[i]] = i;
+        }
+        qts_.pop_back();
+        waiters_.pop_back();
+        return waiter;
+    }
+
+    /**
+     * @brief Resumes a task, and releases it once it has finished.
+     *
+     * @return The exception that escaped the task, if it finished with one.
+     */
+    std::exception_ptr resume(std::coroutine_handle<Task::promise_type> handle)
+    {
+        handle.resume();
+        if (!handle.done())
+            return nullptr;
+        std::exception_ptr exception = std::move(handle.promise().exception);
+        handle.destroy();
+        return exception;
+    }
+
+    /**
+     * @brief I/O queue tokens of outstanding operations.
+     */
+    std::vector<demi_qtoken_t> qts_;
+
+    /**
+     * @brief Tasks that wait on each of the outstanding operations, in the same order.
+     */
+    std::vector<Waiter> waiters_;
+
+    /**
+     * @brief Offsets of the I/O queue tokens of outstanding operations.
+     */
+    std::unordered_map<demi_qtoken_t, std::size_t> index_;
+
+    /**
+     * @brief Store location for the results of completed operations.
+     */
+    std::vector<demi_qresult_t> results_;
+
+    /**
+     * @brief Tasks to resume after a wait, which is reused across waits.
+     */
+    std::vector<std::coroutine_handle<Task::promise_type>> ready_;
+};
+
+/*====================================================================================================================*
+ * Operation Implementation                                                                                           *
+ *====================================================================================================================*/
+
+template <typename T>
+inline void Operation<T>::Awaiter::await_suspend(std::coroutine_handle<Task::promise_type> handle)
+{
+    handle.promise().executor->suspend(operation_->qt_, &operation_->qr_, handle);
+}
+
+template <typename T> inline T Operation<T>::Awaiter::await_resume()
+{
+    const demi_qresult_t &qr = operation_->qr_;
+    detail::check_result(qr);
+    if constexpr (std::is_same_v<T, Sga>)
+    {
+        return Sga(qr.qr_value.sga);
+    }
+    else if constexpr (std::is_same_v<T, Accepted>)
+    {
+        return Accepted{Queue(qr.qr_value.ares.qd), qr.qr_value.ares.addr};
+    }
+    else
+    {
+        static_assert(std::is_void_v<T>, "unsupported operation result");
+    }
+}
+
+} // namespace demi
+
+#endif /* DEMI_DEMI_HPP_IS_INCLUDED */
@@ -150,6 +150,21 @@ extern "C"
      */
     extern int demi_pop(demi_qtoken_t *qt_out, int qd);
 
+    /**
+     * @brief Asynchronously pops data from an I/O queue straight into the buffer of a scatter-gather array.
+     *
+     * @details The scatter-gather array must have a single segment, and it remains owned by the caller. The completed
+     * operation returns a scatter-gather array that covers the received data in that segment, which should be
+     * released with demi_sgafree() once consumed.
+     *
+     * @param qt_out Store location for I/O queue token.
+     * @param qd     Target I/O queue descriptor.
+     * @param sga    Scatter-gather array to receive data into.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_pop_into(demi_qtoken_t *qt_out, int qd, const demi_sgarray_t *sga);
+
 #ifdef __cplusplus
 }
 #endif
@@ -31,6 +31,21 @@ extern "C"
      */
     extern int demi_sgafree(demi_sgarray_t *sga);
 
+    /**
+     * @brief Appends the segments of a scatter-gather array to another one.
+     *
+     * @details On successful completion, @p sga takes over the buffers of @p tail, which is cleared and must not be
+     * released. Pushing the resulting scatter-gather array sends the data of all segments, in order. Some LibOSes
+     * may copy the data of one of the scatter-gather arrays to move it to a different kind of memory, so segment
+     * pointers should be read again after this call. On failure, both scatter-gather arrays remain valid.
+     *
+     * @param sga  Target scatter-gather array.
+     * @param tail Scatter-gather array to append.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_sgaappend(demi_sgarray_t *sga, demi_sgarray_t *tail);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#ifndef DEMI_STATS_H_IS_INCLUDED
+#define DEMI_STATS_H_IS_INCLUDED
+
+#include <demi/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Takes a snapshot of the statistics of the calling thread.
+     *
+     * @details Counters are kept per thread, and only count the work of the calling thread. Each of them grows
+     * monotonically, except for the gauges, which reflect the state at the time of the snapshot.
+     *
+     * @param stats_out Store location for the statistics.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_getstats(demi_stats_t *stats_out);
+
+    /**
+     * @brief Takes a snapshot of the statistics of an I/O queue.
+     *
+     * @param qstats_out Store location for the statistics.
+     * @param qd         Target I/O queue descriptor.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_getqstats(demi_qstats_t *qstats_out, int qd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEMI_STATS_H_IS_INCLUDED */
@@ -24,7 +24,7 @@ extern "C"
 /**
  * @brief Maximum number of segments in a scatter-gather array.
  */
-#define DEMI_SGARRAY_MAXSIZE 1
+#define DEMI_SGARRAY_MAXSIZE 16
 
     /**
      * @brief An I/O queue token.
@@ -103,14 +103,11 @@ extern "C"
 
     /**
      * @brief Result value for an asynchronous I/O operation.
+     *
+     * @details This structure is not packed: its fields are naturally aligned, and it is padded to a multiple of 8
+     * bytes, as the scatter-gather array in it is not.
      */
-    #ifdef _WIN32
-    #pragma pack(push, 1)
     typedef struct demi_qresult
-    #endif
-    #ifdef __linux__
-    typedef struct __attribute__((__packed__)) demi_qresult
-    #endif
     {
         enum demi_opcode qr_opcode; /**< Opcode of completed operation.                              */
         int32_t qr_qd;              /**< I/O queue descriptor associated to the completed operation. */
@@ -126,9 +123,35 @@ extern "C"
             demi_accept_result_t ares; /**< Accept result.                      */
         } qr_value;
     } demi_qresult_t;
-    #ifdef _WIN32
-    #pragma pack(pop)
-    #endif
+
+    /**
+     * @brief Snapshot of the statistics of a thread.
+     */
+    typedef struct demi_stats
+    {
+        uint64_t rx_packets;                /**< Packets that the network device handed to us.                  */
+        uint64_t rx_bytes;                  /**< Bytes in the packets that the network device handed to us.     */
+        uint64_t rx_drops;                  /**< Received packets that were dropped.                            */
+        uint64_t tx_packets;                /**< Packets that the network device accepted for transmission.     */
+        uint64_t tx_bytes;                  /**< Bytes in the packets accepted for transmission.                */
+        uint64_t tx_drops;                  /**< Outgoing packets that were dropped.                            */
+        uint64_t mempool_exhausted;         /**< Failed allocations of packet buffers.                          */
+        uint64_t tcp_retransmits;           /**< TCP segments that were sent again.                             */
+        uint64_t tcp_rto_backoffs;          /**< Times that a TCP retransmission timeout was backed off.        */
+        uint64_t tcp_out_of_order_segments; /**< Out-of-order TCP segments held for reassembly (gauge).         */
+        uint64_t num_tasks;                 /**< Coroutines in the scheduler (gauge).                           */
+        uint64_t num_unclaimed_results;     /**< Completed operations whose results were not retrieved (gauge). */
+        uint64_t num_idle_blocks;           /**< Times that wait calls blocked because they had nothing to do.  */
+    } demi_stats_t;
+
+    /**
+     * @brief Snapshot of the statistics of an I/O queue.
+     */
+    typedef struct demi_qstats
+    {
+        uint64_t num_spin_completions;  /**< Operations that completed while wait calls were busy-polling. */
+        uint64_t num_block_completions; /**< Operations that completed after a wait call had blocked.      */
+    } demi_qstats_t;
 #ifdef __cplusplus
 }
 #endif
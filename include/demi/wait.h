@@ -37,6 +37,68 @@ extern "C"
     extern int demi_wait_any(demi_qresult_t *qr_out, int *ready_offset, const demi_qtoken_t qts[], int num_qts,
                              const struct timespec *timeout);
 
+    /**
+     * @brief Waits for asynchronous I/O operations in a list to complete, and retrieves the results of as many
+     * completed operations as possible.
+     *
+     * @param qrs_out  Store location for the results of the completed I/O operations.
+     * @param nqrs_out Store location for the number of results that were stored in @p qrs_out.
+     * @param max      Maximum number of results to store in @p qrs_out.
+     * @param qts      List of I/O queue tokens to wait for completion.
+     * @param num_qts  Length of the list of I/O queue tokens to wait for completion.
+     * @param timeout  Timeout interval in seconds and nanoseconds.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_wait_many(demi_qresult_t *qrs_out, int *nqrs_out, int max, const demi_qtoken_t qts[], int num_qts,
+                              const struct timespec *timeout);
+
+    /**
+     * @brief Creates an empty wait group.
+     *
+     * A wait group is a persistent set of I/O queue tokens. Each token is registered once, and the cost of waiting on
+     * the group does not depend on how many tokens are outstanding in it.
+     *
+     * @param wgd_out Store location for the descriptor of the new wait group.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_wait_group_create(int *wgd_out);
+
+    /**
+     * @brief Adds an asynchronous I/O operation to a wait group.
+     *
+     * Once added, the result of the operation can only be retrieved by waiting on the wait group.
+     *
+     * @param wgd Descriptor of the target wait group.
+     * @param qt  I/O queue token of the target operation.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_wait_group_add(int wgd, demi_qtoken_t qt);
+
+    /**
+     * @brief Waits for any asynchronous I/O operation in a wait group to complete, and removes it from the group.
+     *
+     * @param qr_out  Store location for the result of the completed I/O operation.
+     * @param wgd     Descriptor of the target wait group.
+     * @param timeout Timeout interval in seconds and nanoseconds.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_wait_group_wait(demi_qresult_t *qr_out, int wgd, const struct timespec *timeout);
+
+    /**
+     * @brief Releases a wait group.
+     *
+     * Operations that are still in the wait group can be waited on individually afterwards.
+     *
+     * @param wgd Descriptor of the target wait group.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_wait_group_free(int wgd);
+
 #ifdef __cplusplus
 }
 #endif
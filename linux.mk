@@ -135,23 +135,31 @@ clean-tests-c:
 #=======================================================================================================================
 
 # Builds all examples.
-all-examples: all-examples-c all-examples-rust
+all-examples: all-examples-c all-examples-cpp all-examples-rust
 
 # Builds all C examples.
 all-examples-c: all-libs
 	$(MAKE) -C examples/c all
 
+# Builds all C++ examples.
+all-examples-cpp: all-libs
+	$(MAKE) -C examples/cpp all
+
 # Builds all Rust examples.
 all-examples-rust:
 	$(MAKE) -C examples/rust all
 
 # Cleans all examples.
-clean-examples: clean-examples-c clean-examples-rust
+clean-examples: clean-examples-c clean-examples-cpp clean-examples-rust
 
 # Cleans all C examples.
 clean-examples-c:
 	$(MAKE) -C examples/c clean
 
+# Cleans all C++ examples.
+clean-examples-cpp:
+	$(MAKE) -C examples/cpp clean
+
 # Cleans all Rust examples.
 clean-examples-rust:
 	$(MAKE) -C examples/rust clean
@@ -257,7 +257,7 @@ impl SharedMemorySocket {
         // TODO: Remove the copy eventually.
         match catmem.push_coroutine(qd, buf.clone()).await {
             (_, OperationResult::Push) => {
-                buf.trim(buf.len())?;
+                buf.advance(buf.total_len())?;
                 Ok(())
             },
             (_, OperationResult::Failed(e)) => Err(e),
@@ -276,12 +276,13 @@ impl SharedMemorySocket {
         // and by construction it should be connected. If not, the socket state machine
         // was not correctly driven.
         let qd: QDesc = self.catmem_qd.expect("socket should be connected");
-        match catmem.pop_coroutine(qd, Some(size)).await {
+        // Pop straight into the buffer.
+        let mut target: DemiBuffer = buf.clone();
+        target.trim(target.len() - size)?;
+        match catmem.pop_into_coroutine(qd, target).await {
             (_, OperationResult::Pop(_, incoming)) => {
                 let len: usize = incoming.len();
-                // TODO: Remove this copy. Our API should support passing back a buffer without sending in a buffer.
-                buf.trim(size - len)?;
-                buf.copy_from_slice(&incoming[0..len]);
+                buf.trim(buf.len() - len)?;
                 // We do not keep a socket address for the remote socket, so none to return.
                 Ok(None)
             },
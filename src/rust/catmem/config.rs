@@ -0,0 +1,54 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    demikernel::config::Config,
+    runtime::fail::Fail,
+};
+use ::std::time::Duration;
+use ::yaml_rust::Yaml;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Name for the libos in configs.
+const LIBOS: &str = "catmem";
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Catmem-specific configuration for Demikernel configuration object.
+impl Config {
+    /// Reads spin-then-block wait settings from the "spin_then_block" subsection. Returned value is Some(spin time) if
+    /// enabled; otherwise, None. A wait call that has busy-polled for the spin time without completing anything blocks
+    /// on the futexes of the rings that it pops from. A missing subsection disables blocking waits.
+    pub fn catmem_spin_then_block(&self) -> Result<Option<Duration>, Fail> {
+        const SECTION: &str = "spin_then_block";
+        let section: &Yaml = &self.0[LIBOS][SECTION];
+        if section.is_badvalue() {
+            return Ok(None);
+        }
+
+        let enabled: bool = match section["enabled"].as_bool() {
+            Some(enabled) => enabled,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"enabled\" has unexpected type")),
+        };
+        let spin_micros: i64 = match section["spin_micros"].as_i64() {
+            Some(spin_micros) if spin_micros >= 0 => spin_micros,
+            Some(_) => return Err(Fail::new(libc::ERANGE, "parameter \"spin_micros\" is out of range")),
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"spin_micros\" has unexpected type")),
+        };
+
+        if enabled {
+            Ok(Some(Duration::from_micros(spin_micros as u64)))
+        } else {
+            Ok(None)
+        }
+    }
+}
@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod config;
 pub mod queue;
 mod ring;
 
@@ -8,18 +9,24 @@ mod ring;
 // Imports
 //======================================================================================================================
 
-use self::queue::SharedCatmemQueue;
+use self::queue::{
+    SharedCatmemQueue,
+    SharedWaitingQueues,
+};
 use crate::{
     demikernel::config::Config,
     runtime::{
         fail::Fail,
         limits,
         memory::{
+            self,
             DemiBuffer,
             MemoryRuntime,
         },
         queue::downcast_queue,
         types::demi_sgarray_t,
+        IdleBlocker,
+        IdleWait,
         Operation,
         OperationResult,
         SharedDemiRuntime,
@@ -35,6 +42,7 @@ use ::std::{
         DerefMut,
     },
     pin::Pin,
+    time::Duration,
 };
 
 //======================================================================================================================
@@ -44,35 +52,56 @@ use ::std::{
 /// A LibOS that exposes bi-directional memory queues.
 pub struct CatmemLibOS {
     runtime: SharedDemiRuntime,
+    /// Queues with pending pops, if blocking waits are enabled.
+    waiting: Option<SharedWaitingQueues>,
 }
 
 #[derive(Clone)]
 pub struct SharedCatmemLibOS(SharedObject<CatmemLibOS>);
 
+/// Blocks wait calls that have nothing to do on the futexes of the rings with pending pops.
+struct CatmemIdleBlocker {
+    waiting: SharedWaitingQueues,
+}
+
 //======================================================================================================================
 // Associated Functions
 //======================================================================================================================
 
 /// Associated functions for Catmem LibOS.
 impl CatmemLibOS {
-    pub fn new(runtime: SharedDemiRuntime) -> Self {
-        Self { runtime }
+    pub fn new(runtime: SharedDemiRuntime, waiting: Option<SharedWaitingQueues>) -> Self {
+        Self { runtime, waiting }
     }
 }
 
 /// Associate Functions for the shared Catmem LibOS
 impl SharedCatmemLibOS {
     /// Instantiates a shared Catmem LibOS.
-    pub fn new(_config: &Config, runtime: SharedDemiRuntime) -> Self {
-        Self(SharedObject::new(CatmemLibOS::new(runtime)))
+    pub fn new(config: &Config, mut runtime: SharedDemiRuntime) -> Self {
+        // Block wait calls that run out of work on the rings, if enabled.
+        let waiting: Option<SharedWaitingQueues> = match config.catmem_spin_then_block() {
+            Ok(Some(spin_time)) => {
+                let waiting: SharedWaitingQueues = SharedWaitingQueues::new();
+                runtime.set_idle_wait(IdleWait::new(
+                    spin_time,
+                    Box::new(CatmemIdleBlocker {
+                        waiting: waiting.clone(),
+                    }),
+                ));
+                Some(waiting)
+            },
+            Ok(None) => None,
+            Err(e) => panic!("invalid spin-then-block configuration: {:?}", e),
+        };
+        Self(SharedObject::new(CatmemLibOS::new(runtime, waiting)))
     }
 
     /// Creates a new memory queue.
     pub fn create_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
         trace!("create_pipe() name={:?}", name);
-        let qd: QDesc = self
-            .runtime
-            .alloc_queue::<SharedCatmemQueue>(SharedCatmemQueue::create(name)?);
+        let queue: SharedCatmemQueue = SharedCatmemQueue::create(name, self.waiting.clone())?;
+        let qd: QDesc = self.runtime.alloc_queue::<SharedCatmemQueue>(queue);
 
         Ok(qd)
     }
@@ -81,9 +110,8 @@ impl SharedCatmemLibOS {
     pub fn open_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
         trace!("open_pipe() name={:?}", name);
 
-        let qd: QDesc = self
-            .runtime
-            .alloc_queue::<SharedCatmemQueue>(SharedCatmemQueue::open(name)?);
+        let queue: SharedCatmemQueue = SharedCatmemQueue::open(name, self.waiting.clone())?;
+        let qd: QDesc = self.runtime.alloc_queue::<SharedCatmemQueue>(queue);
 
         Ok(qd)
     }
@@ -151,7 +179,7 @@ impl SharedCatmemLibOS {
 
         let buf: DemiBuffer = self.runtime.clone_sgarray(sga)?;
 
-        if buf.len() == 0 {
+        if buf.total_len() == 0 {
             let cause: String = format!("zero-length buffer (qd={:?})", qd);
             error!("push(): {}", cause);
             return Err(Fail::new(libc::EINVAL, &cause));
@@ -204,6 +232,33 @@ impl SharedCatmemLibOS {
         (qd, OperationResult::Pop(None, buf))
     }
 
+    /// Pops data from a Pop ring straight into the buffers of a scatter-gather array. If not a Pop ring, then fail.
+    pub fn pop_into(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
+        trace!("pop_into() qd={:?}", qd);
+
+        let buf: DemiBuffer = memory::into_pop_target(self.runtime.clone_sgarray(sga)?)?;
+
+        let task_name: String = format!("Catmem::pop_into for qd={:?}", qd);
+        let coroutine: Pin<Box<Operation>> = Box::pin(self.clone().pop_into_coroutine(qd, buf).fuse());
+
+        self.runtime.clone().insert_io_coroutine(&task_name, coroutine)
+    }
+
+    pub async fn pop_into_coroutine(self, qd: QDesc, buf: DemiBuffer) -> (QDesc, OperationResult) {
+        // Make sure the queue still exists.
+        let mut queue: SharedCatmemQueue = match self.get_queue(&qd) {
+            Ok(queue) => queue,
+            Err(e) => return (qd, OperationResult::Failed(e)),
+        };
+
+        // Wait for pop to complete.
+        let (buf, _) = match queue.do_pop_into(buf).await {
+            Ok(result) => result,
+            Err(e) => return (qd, OperationResult::Failed(e)),
+        };
+        (qd, OperationResult::Pop(None, buf))
+    }
+
     pub fn get_queue(&self, qd: &QDesc) -> Result<SharedCatmemQueue, Fail> {
         Ok(self.runtime.get_qtable().get::<SharedCatmemQueue>(qd)?.clone())
     }
@@ -227,6 +282,12 @@ impl DerefMut for SharedCatmemLibOS {
     }
 }
 
+impl IdleBlocker for CatmemIdleBlocker {
+    fn block(&mut self, timeout: Duration) {
+        self.waiting.block(timeout)
+    }
+}
+
 impl Drop for CatmemLibOS {
     // Releases all sockets allocated by Catnap.
     fn drop(&mut self) {
@@ -28,8 +28,20 @@ use ::std::{
         Deref,
         DerefMut,
     },
+    time::{
+        Duration,
+        Instant,
+    },
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Longest time that we block on the futex of one ring when several rings are waited on. We cannot wait on several
+/// futexes at once, so we take turns.
+const WAIT_SLICE: Duration = Duration::from_micros(100);
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -38,38 +50,52 @@ use ::std::{
 /// the [ring] structure.
 pub struct CatmemQueue {
     ring: Ring,
+    /// Queues with pending pops, if blocking waits are enabled.
+    waiting: Option<SharedWaitingQueues>,
 }
 
 #[derive(Clone)]
 
 pub struct SharedCatmemQueue(SharedObject<CatmemQueue>);
+
+/// Queues that have a pop waiting on an empty ring. These are the rings that an idle wait call blocks on.
+#[derive(Clone)]
+pub struct SharedWaitingQueues(SharedObject<Vec<SharedCatmemQueue>>);
+
+/// Keeps a queue in the waiting queues for as long as its pop is pending, including when the pop is cancelled.
+struct WaitingGuard {
+    queues: SharedWaitingQueues,
+    queue: SharedCatmemQueue,
+}
 //======================================================================================================================
 // Associated Functions
 //======================================================================================================================
 
 impl CatmemQueue {
     /// Creates a new [CatmemQueue] and a new shared ring buffer.
-    pub fn create(name: &str) -> Result<Self, Fail> {
+    pub fn create(name: &str, waiting: Option<SharedWaitingQueues>) -> Result<Self, Fail> {
         Ok(Self {
             ring: Ring::create(name)?,
+            waiting,
         })
     }
 
     /// Creates a new [CatmemQueue] and attaches it to an existing share ring buffer.
-    pub fn open(name: &str) -> Result<Self, Fail> {
+    pub fn open(name: &str, waiting: Option<SharedWaitingQueues>) -> Result<Self, Fail> {
         Ok(Self {
             ring: Ring::open(name)?,
+            waiting,
         })
     }
 }
 
 impl SharedCatmemQueue {
-    pub fn create(name: &str) -> Result<Self, Fail> {
-        Ok(Self(SharedObject::new(CatmemQueue::create(name)?)))
+    pub fn create(name: &str, waiting: Option<SharedWaitingQueues>) -> Result<Self, Fail> {
+        Ok(Self(SharedObject::new(CatmemQueue::create(name, waiting)?)))
     }
 
-    pub fn open(name: &str) -> Result<Self, Fail> {
-        Ok(Self(SharedObject::new(CatmemQueue::open(name)?)))
+    pub fn open(name: &str, waiting: Option<SharedWaitingQueues>) -> Result<Self, Fail> {
+        Ok(Self(SharedObject::new(CatmemQueue::open(name, waiting)?)))
     }
 
     pub fn shutdown(&mut self) -> Result<(), Fail> {
@@ -143,7 +169,14 @@ impl SharedCatmemQueue {
     /// shared memory ring, this function returns an error.
     pub async fn do_pop(&mut self, size: Option<usize>) -> Result<(DemiBuffer, bool), Fail> {
         let size: usize = size.unwrap_or(limits::RECVBUF_SIZE_MAX);
-        let mut buf: DemiBuffer = DemiBuffer::new(size as u16);
+        self.do_pop_into(DemiBuffer::new(size as u16)).await
+    }
+
+    /// This function pops data from the queue straight into [buf], and returns it trimmed down to the data that was
+    /// read. If the queue is connected to the push end of a shared memory ring, this function returns an error.
+    pub async fn do_pop_into(&mut self, mut buf: DemiBuffer) -> Result<(DemiBuffer, bool), Fail> {
+        let size: usize = buf.len();
+        let mut _guard: Option<WaitingGuard> = None;
         let eof: bool = loop {
             match self.ring.try_pop(&mut buf) {
                 Ok((len, eof)) => {
@@ -158,6 +191,12 @@ impl SharedCatmemQueue {
                     break eof;
                 },
                 Err(e) if DemiRuntime::should_retry(e.errno) => {
+                    // Let idle wait calls block on this ring until the pop completes.
+                    if _guard.is_none() {
+                        if let Some(queues) = self.waiting.clone() {
+                            _guard = Some(WaitingGuard::new(queues, self.clone()));
+                        }
+                    }
                     // Operation in progress. Check if cancelled.
                     poll_yield().await;
                 },
@@ -172,11 +211,15 @@ impl SharedCatmemQueue {
     /// This function tries to push [buf] to the shared memory ring. If the queue is connected to the pop end, then
     /// this function returns an error.
     pub async fn do_push(&mut self, mut buf: DemiBuffer) -> Result<(), Fail> {
+        // Segments of a buffer chain are pushed in order, one after the other.
         loop {
             match self.ring.try_push(&buf) {
                 Ok(len) if len == buf.len() => {
                     trace!("data written ({:?}/{:?} bytes)", buf.len(), buf.len());
-                    return Ok(());
+                    match buf.take_tail() {
+                        Some(tail) => buf = tail,
+                        None => return Ok(()),
+                    }
                 },
                 Ok(len) if len < buf.len() => {
                     buf.adjust(len).expect("should be able to split remaining bytes");
@@ -220,10 +263,84 @@ impl SharedCatmemQueue {
     }
 }
 
+impl SharedWaitingQueues {
+    pub fn new() -> Self {
+        Self(SharedObject::new(Vec::new()))
+    }
+
+    /// Blocks until a message may be available on one of the waiting queues, or `timeout` expires.
+    pub fn block(&self, timeout: Duration) {
+        match self.len() {
+            0 => (),
+            1 => {
+                if let Err(e) = self[0].ring.wait_for_message(timeout) {
+                    warn!("block(): {:?}", e);
+                }
+            },
+            _ => {
+                // Take turns on the rings, and stop as soon as any of them has a message.
+                let deadline: Instant = Instant::now() + timeout;
+                let mut i: usize = 0;
+                loop {
+                    if self.iter().any(|queue| queue.ring.has_message()) {
+                        break;
+                    }
+                    let now: Instant = Instant::now();
+                    if now >= deadline {
+                        break;
+                    }
+                    if let Err(e) = self[i % self.len()]
+                        .ring
+                        .wait_for_message(WAIT_SLICE.min(deadline - now))
+                    {
+                        warn!("block(): {:?}", e);
+                        break;
+                    }
+                    i += 1;
+                }
+            },
+        }
+    }
+}
+
+impl WaitingGuard {
+    fn new(mut queues: SharedWaitingQueues, queue: SharedCatmemQueue) -> Self {
+        queues.push(queue.clone());
+        Self { queues, queue }
+    }
+}
+
 //======================================================================================================================
 // Trait implementation
 //======================================================================================================================
 
+impl Drop for WaitingGuard {
+    fn drop(&mut self) {
+        let target: &CatmemQueue = self.queue.deref();
+        if let Some(i) = self
+            .queues
+            .iter()
+            .position(|queue| ::std::ptr::eq(queue.deref(), target))
+        {
+            self.queues.swap_remove(i);
+        }
+    }
+}
+
+impl Deref for SharedWaitingQueues {
+    type Target = Vec<SharedCatmemQueue>;
+
+    fn deref(&self) -> &Self::Target {
+        self.0.deref()
+    }
+}
+
+impl DerefMut for SharedWaitingQueues {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.0.deref_mut()
+    }
+}
+
 impl Deref for SharedCatmemQueue {
     type Target = CatmemQueue;
 
@@ -18,7 +18,7 @@ use crate::{
         },
     },
 };
-use ::std::ptr::copy;
+use ::std::time::Duration;
 
 //======================================================================================================================
 // Constants
@@ -38,6 +38,9 @@ const REGULAR_MESSAGE_HEADER: [u8; HEADER_SIZE] = [0xB, 0xE, 0xE, 0xF];
 /// padding. Still, this is intentionally set so as the effective capacity is large enough to hold 16 KB of data.
 const RING_BUFFER_CAPACITY: usize = 65536;
 
+/// Maximum number of payload bytes in a message. Longer pushes are split into several messages.
+const MAX_MESSAGE_SIZE: usize = 16384;
+
 /// Maximum number of retries for pushing a EoF signal.
 pub const MAX_RETRIES_PUSH_EOF: u32 = 16;
 
@@ -86,51 +89,52 @@ impl Ring {
         })
     }
 
-    /// Try to pop a byte from the shared memory ring. If successful, return the byte and whether the eof flag is set,
-    /// otherwise return None for a retry.
+    /// Try to pop a message from the shared memory ring into `buf`. If successful, return the number of bytes read
+    /// and whether the eof flag is set, otherwise return EAGAIN for a retry.
     pub fn try_pop(&mut self, buf: &mut [u8]) -> Result<(usize, bool), Fail> {
         self.state_machine.may_pop()?;
 
-        let mut msg: Vec<u8> = vec![0; buf.len() + HEADER_SIZE];
-        // Read data from the ring buffer.
-        let msg_len: usize = self.pop_buf.try_pop(&mut msg)? - HEADER_SIZE;
+        // Read the message header and the payload straight into the buffer.
+        let mut header: [u8; HEADER_SIZE] = [0; HEADER_SIZE];
+        let msg_len: usize = self.pop_buf.try_pop_vectored(&mut [&mut header, buf])? - HEADER_SIZE;
 
         // Check how many bytes were read.
         if msg_len > 0 {
-            // We read some bytes. This should be a regular message,
-            // thus copy it to the buffer.
-
-            // Ensure that the message header is valid.
-            debug_assert_eq!(REGULAR_MESSAGE_HEADER, msg[0..HEADER_SIZE]);
-
-            // Copy the message to the buffer.
-            unsafe {
-                let buf_ptr: *mut u8 = buf.as_mut_ptr();
-                let msg_ptr: *const u8 = msg.as_ptr();
-                copy(msg_ptr.add(HEADER_SIZE), buf_ptr, msg_len);
-            };
-
+            // We read some bytes. This should be a regular message.
+            debug_assert_eq!(REGULAR_MESSAGE_HEADER, header);
             Ok((msg_len, false))
         } else {
             // We read no bytes. This should be an EoF message.
-
-            // Ensure that the message header is what we expect.
-            debug_assert_eq!(EOF_MESSAGE_HEADER, msg[0..HEADER_SIZE]);
-
+            debug_assert_eq!(EOF_MESSAGE_HEADER, header);
             Ok((0, true))
         }
     }
 
-    /// Try to send a byte through the shared memory ring. If there is no space or another thread is writing to this
-    /// ring, return [false], otherwise, return [true] if successfully enqueued.
+    /// Try to send `buf` through the shared memory ring, as one message of at most [MAX_MESSAGE_SIZE] bytes. If there
+    /// is no space, return EAGAIN, otherwise, return the number of bytes that were enqueued.
     pub fn try_push(&mut self, buf: &[u8]) -> Result<usize, Fail> {
         self.state_machine.may_push()?;
-        // Write the header.
-        let mut msg: Vec<u8> = REGULAR_MESSAGE_HEADER.to_vec();
-        msg.append(&mut buf.to_vec());
+        // An empty message would read as an EoF.
+        if buf.is_empty() {
+            return Ok(0);
+        }
+        let len: usize = buf.len().min(MAX_MESSAGE_SIZE);
+
+        // Write the header and the payload straight into the ring buffer.
+        Ok(self
+            .push_buf
+            .try_push_vectored(&[&REGULAR_MESSAGE_HEADER, &buf[..len]])?
+            - HEADER_SIZE)
+    }
+
+    /// Checks whether a message is available for popping.
+    pub fn has_message(&self) -> bool {
+        !self.pop_buf.is_empty()
+    }
 
-        // Write data to the ring buffer.
-        Ok(self.push_buf.try_push(&msg)? - HEADER_SIZE)
+    /// Blocks the calling thread until a message may be available for popping, or `timeout` expires.
+    pub fn wait_for_message(&self, timeout: Duration) -> Result<(), Fail> {
+        self.pop_buf.wait_for_message(timeout)
     }
 
     /// Closes the target ring.
@@ -15,13 +15,17 @@ use crate::{
         fail::Fail,
         limits,
         memory::DemiBuffer,
+        types::DEMI_SGARRAY_MAXLEN,
         DemiRuntime,
     },
 };
 use ::socket2::Socket;
 use ::std::{
     cmp::min,
-    io,
+    io::{
+        self,
+        IoSlice,
+    },
     mem::MaybeUninit,
     net::SocketAddr,
 };
@@ -71,22 +75,35 @@ impl ActiveSocketData {
         }) = self.send_queue.try_pop()
         {
             // A dummy request to detect when the socket has connected.
-            if buf.is_empty() {
+            if buf.total_len() == 0 {
                 result.set(Some(Ok(())));
                 return;
             }
-            // Try to send the buffer.
-            let io_result: Result<usize, io::Error> = match addr {
-                Some(addr) => self.socket.send_to(&buf, &addr.clone().into()),
-                None => self.socket.send(&buf),
+            // Try to send the buffer. Buffer chains are sent with a single vectored write.
+            let io_result: Result<usize, io::Error> = if buf.num_segments() > 1 {
+                let mut iov: [IoSlice; DEMI_SGARRAY_MAXLEN] = [IoSlice::new(&[]); DEMI_SGARRAY_MAXLEN];
+                let mut iovcnt: usize = 0;
+                for (slot, segment) in iov.iter_mut().zip(buf.segments()) {
+                    *slot = IoSlice::new(segment);
+                    iovcnt += 1;
+                }
+                match addr {
+                    Some(addr) => self.socket.send_to_vectored(&iov[..iovcnt], &addr.clone().into()),
+                    None => self.socket.send_vectored(&iov[..iovcnt]),
+                }
+            } else {
+                match addr {
+                    Some(addr) => self.socket.send_to(&buf, &addr.clone().into()),
+                    None => self.socket.send(&buf),
+                }
             };
             match io_result {
                 // Operation completed.
                 Ok(nbytes) => {
-                    trace!("data pushed ({:?}/{:?} bytes)", nbytes, buf.len());
-                    buf.adjust(nbytes as usize)
+                    trace!("data pushed ({:?}/{:?} bytes)", nbytes, buf.total_len());
+                    buf.advance(nbytes as usize)
                         .expect("OS should not have sent more bytes than in the buffer");
-                    if buf.is_empty() {
+                    if buf.total_len() == 0 {
                         // Done sending this buffer
                         result.set(Some(Ok(())));
                     } else {
@@ -113,10 +130,11 @@ impl ActiveSocketData {
     /// queue.
     /// TODO: Incoming queue should possibly be byte oriented.
     pub fn poll_recv(&mut self) {
-        let mut buf: DemiBuffer = DemiBuffer::new(limits::POP_SIZE_MAX as u16);
         if self.closed {
             return;
         }
+        // This is recycled by the buffer pool if nothing is received, and trimmed in place to what was received.
+        let mut buf: DemiBuffer = DemiBuffer::new(limits::POP_SIZE_MAX as u16);
         match self
             .socket
             .recv_from(unsafe { std::slice::from_raw_parts_mut(buf.as_mut_ptr() as *mut MaybeUninit<u8>, buf.len()) })
@@ -144,6 +162,19 @@ impl ActiveSocketData {
         }
     }
 
+    /// Returns the poll() events that this socket waits for: incoming data until the other side closes, and room to
+    /// write only while there is data queued up for sending.
+    pub fn poll_events(&self) -> libc::c_short {
+        let mut events: libc::c_short = 0;
+        if !self.closed {
+            events |= libc::POLLIN;
+        }
+        if !self.send_queue.is_empty() {
+            events |= libc::POLLOUT;
+        }
+        events
+    }
+
     /// Pushes data to the socket. Blocks until completion.
     pub async fn push(&mut self, addr: Option<SocketAddr>, buf: DemiBuffer) -> Result<(), Fail> {
         let mut result: SharedAsyncValue<Option<Result<(), Fail>>> = SharedAsyncValue::new(None);
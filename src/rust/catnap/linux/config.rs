@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    demikernel::config::Config,
+    runtime::fail::Fail,
+};
+use ::std::time::Duration;
+use ::yaml_rust::Yaml;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Name for the libos in configs.
+const LIBOS: &str = "catnap";
+
+/// Largest number of submission queue entries that Linux accepts.
+const IO_URING_MAX_QUEUE_DEPTH: i64 = 32768;
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Linux-specific configuration for Demikernel configuration object.
+impl Config {
+    /// Reads io_uring settings from the "io_uring" subsection. Returned value is Some(queue depth) if enabled;
+    /// otherwise, None. A missing subsection disables io_uring.
+    pub fn io_uring(&self) -> Result<Option<u32>, Fail> {
+        const SECTION: &str = "io_uring";
+        let section: &Yaml = &self.0[LIBOS][SECTION];
+        if section.is_badvalue() {
+            return Ok(None);
+        }
+
+        let enabled: bool = match section["enabled"].as_bool() {
+            Some(enabled) => enabled,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"enabled\" has unexpected type")),
+        };
+        let queue_depth: i64 = match section["queue_depth"].as_i64() {
+            Some(queue_depth) if queue_depth > 0 && queue_depth <= IO_URING_MAX_QUEUE_DEPTH => queue_depth,
+            Some(_) => return Err(Fail::new(libc::ERANGE, "parameter \"queue_depth\" is out of range")),
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"queue_depth\" has unexpected type")),
+        };
+
+        if enabled {
+            Ok(Some(queue_depth as u32))
+        } else {
+            Ok(None)
+        }
+    }
+
+    /// Reads spin-then-block wait settings from the "spin_then_block" subsection. Returned value is Some(spin time) if
+    /// enabled; otherwise, None. The spin time is how long a wait call busy-polls without completing anything before
+    /// its thread blocks on the sockets. A missing subsection disables blocking waits.
+    pub fn catnap_spin_then_block(&self) -> Result<Option<Duration>, Fail> {
+        const SECTION: &str = "spin_then_block";
+        let section: &Yaml = &self.0[LIBOS][SECTION];
+        if section.is_badvalue() {
+            return Ok(None);
+        }
+
+        let enabled: bool = match section["enabled"].as_bool() {
+            Some(enabled) => enabled,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"enabled\" has unexpected type")),
+        };
+        let spin_micros: i64 = match section["spin_micros"].as_i64() {
+            Some(spin_micros) if spin_micros >= 0 => spin_micros,
+            Some(_) => return Err(Fail::new(libc::ERANGE, "parameter \"spin_micros\" is out of range")),
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"spin_micros\" has unexpected type")),
+        };
+
+        if enabled {
+            Ok(Some(Duration::from_micros(spin_micros as u64)))
+        } else {
+            Ok(None)
+        }
+    }
+
+    /// Reads the "reuse_port" parameter. If set, sockets are created with SO_REUSEPORT, so that the LibOSes of several
+    /// threads can each bind a socket to the same address, and the kernel spreads incoming connections across their
+    /// listening sockets. A missing parameter leaves it unset.
+    pub fn catnap_reuse_port(&self) -> Result<bool, Fail> {
+        let value: &Yaml = &self.0[LIBOS]["reuse_port"];
+        if value.is_badvalue() {
+            return Ok(false);
+        }
+        match value.as_bool() {
+            Some(reuse_port) => Ok(reuse_port),
+            None => Err(Fail::new(libc::EINVAL, "parameter \"reuse_port\" has unexpected type")),
+        }
+    }
+}
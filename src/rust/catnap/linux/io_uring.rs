@@ -0,0 +1,1020 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Minimal io_uring bindings for the Linux transport.
+//!
+//! Operations are queued as submission queue entries (SQEs) while coroutines run, and the transport's background
+//! coroutine hands all of them to the kernel and reaps the completion queue entries (CQEs) with at most one
+//! `io_uring_enter()` per poll. Sockets are referenced through the ring's registered file table, so the kernel does not
+//! have to look up and reference count the file on each operation.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::async_value::SharedAsyncValue,
+    runtime::{
+        fail::Fail,
+        memory::DemiBuffer,
+        types::DEMI_SGARRAY_MAXLEN,
+        SharedObject,
+    },
+};
+use ::slab::Slab;
+use ::socket2::SockAddr;
+use ::std::{
+    mem,
+    net::SocketAddr,
+    ops::{
+        Deref,
+        DerefMut,
+    },
+    os::fd::RawFd,
+    ptr,
+    sync::atomic::{
+        AtomicU32,
+        Ordering,
+    },
+    time::Duration,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+// Operation codes, from include/uapi/linux/io_uring.h.
+const IORING_OP_SENDMSG: u8 = 9;
+const IORING_OP_RECVMSG: u8 = 10;
+const IORING_OP_ACCEPT: u8 = 13;
+const IORING_OP_ASYNC_CANCEL: u8 = 14;
+const IORING_OP_CONNECT: u8 = 16;
+const IORING_OP_SEND: u8 = 26;
+
+// Flags for submission queue entries.
+const IOSQE_FIXED_FILE: u8 = 1 << 0;
+
+// Flags for io_uring_setup().
+const IORING_SETUP_COOP_TASKRUN: u32 = 1 << 8;
+const IORING_SETUP_TASKRUN_FLAG: u32 = 1 << 9;
+
+// Features reported by io_uring_setup().
+const IORING_FEAT_SINGLE_MMAP: u32 = 1 << 0;
+const IORING_FEAT_EXT_ARG: u32 = 1 << 8;
+
+// Flags that the kernel sets in the submission ring.
+const IORING_SQ_CQ_OVERFLOW: u32 = 1 << 1;
+const IORING_SQ_TASKRUN: u32 = 1 << 2;
+
+// Flags for io_uring_enter().
+const IORING_ENTER_GETEVENTS: u32 = 1 << 0;
+const IORING_ENTER_EXT_ARG: u32 = 1 << 3;
+
+// Operation codes for io_uring_register().
+const IORING_REGISTER_FILES: u32 = 2;
+const IORING_REGISTER_FILES_UPDATE: u32 = 6;
+
+// Offsets for mapping the rings.
+const IORING_OFF_SQ_RING: libc::off_t = 0;
+const IORING_OFF_CQ_RING: libc::off_t = 0x8000000;
+const IORING_OFF_SQES: libc::off_t = 0x10000000;
+
+/// User data of cancellation requests, whose completions are discarded.
+const CANCEL_USER_DATA: u64 = u64::MAX;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+#[repr(C)]
+#[derive(Default)]
+struct SubmissionRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    flags: u32,
+    dropped: u32,
+    array: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+#[repr(C)]
+#[derive(Default)]
+struct CompletionRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    overflow: u32,
+    cqes: u32,
+    flags: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// Parameters of io_uring_setup().
+#[repr(C)]
+#[derive(Default)]
+struct Params {
+    sq_entries: u32,
+    cq_entries: u32,
+    flags: u32,
+    sq_thread_cpu: u32,
+    sq_thread_idle: u32,
+    features: u32,
+    wq_fd: u32,
+    resv: [u32; 3],
+    sq_off: SubmissionRingOffsets,
+    cq_off: CompletionRingOffsets,
+}
+
+/// Submission queue entry.
+#[repr(C)]
+#[derive(Default)]
+struct Sqe {
+    opcode: u8,
+    flags: u8,
+    ioprio: u16,
+    fd: i32,
+    off: u64,
+    addr: u64,
+    len: u32,
+    op_flags: u32,
+    user_data: u64,
+    buf_index: u16,
+    personality: u16,
+    file_index: u32,
+    addr3: u64,
+    pad: u64,
+}
+
+/// Completion queue entry.
+#[repr(C)]
+struct Cqe {
+    user_data: u64,
+    res: i32,
+    flags: u32,
+}
+
+/// Extended argument of io_uring_enter(), which carries a timeout for the wait.
+#[repr(C)]
+struct GeteventsArg {
+    sigmask: u64,
+    sigmask_sz: u32,
+    pad: u32,
+    ts: u64,
+}
+
+/// Argument of IORING_REGISTER_FILES_UPDATE.
+#[repr(C)]
+struct FilesUpdate {
+    offset: u32,
+    resv: u32,
+    fds: u64,
+}
+
+/// File that an operation targets.
+#[derive(Clone, Copy, Debug)]
+pub enum File {
+    /// Index in the registered file table.
+    Fixed(u32),
+    /// Raw file descriptor, for sockets that did not fit in the registered file table.
+    Raw(RawFd),
+}
+
+/// A memory mapping of the rings that is shared with the kernel.
+struct Mapping {
+    ptr: *mut libc::c_void,
+    len: usize,
+}
+
+/// An io_uring instance.
+struct IoUring {
+    fd: RawFd,
+    /// Mappings of the rings, which are unmapped on drop.
+    mappings: Vec<Mapping>,
+    sq_head: *const AtomicU32,
+    sq_tail: *const AtomicU32,
+    sq_flags: *const AtomicU32,
+    sq_mask: u32,
+    sq_entries: u32,
+    sq_array: *mut u32,
+    sqes: *mut Sqe,
+    cq_head: *const AtomicU32,
+    cq_tail: *const AtomicU32,
+    cq_mask: u32,
+    cqes: *const Cqe,
+    /// Number of entries that were queued and not handed to the kernel yet.
+    to_submit: u32,
+    /// Number of entries in the registered file table.
+    nfiles: u32,
+    /// Whether io_uring_enter() takes a timeout (Linux 5.11 and later), which we need to block in it.
+    ext_arg: bool,
+}
+
+/// Memory that the kernel accesses while an operation is in flight. It is owned by the operation, so that it outlives
+/// the coroutine that started the operation if the coroutine is cancelled.
+enum Resources {
+    Buffer {
+        _buf: DemiBuffer,
+    },
+    Message {
+        message: Box<Message>,
+        _buf: DemiBuffer,
+    },
+    Address {
+        _addr: Box<SockAddr>,
+    },
+    AcceptAddress {
+        addr: Box<(libc::sockaddr_storage, libc::socklen_t)>,
+    },
+}
+
+/// A message header for sendmsg() and recvmsg(), along with the memory it points to.
+struct Message {
+    msg: libc::msghdr,
+    iov: [libc::iovec; DEMI_SGARRAY_MAXLEN],
+    name: libc::sockaddr_storage,
+}
+
+/// An operation in flight.
+struct Operation {
+    user_data: u64,
+    result: SharedAsyncValue<Option<i32>>,
+    resources: Resources,
+    /// Was the coroutine that started the operation cancelled?
+    orphaned: bool,
+}
+
+/// An io_uring instance and the operations that are in flight on it.
+pub struct IoUringQueue {
+    ring: IoUring,
+    operations: Slab<Operation>,
+    /// Sequence number of the last operation, which tells apart operations that reuse the same slot.
+    last_seq: u32,
+}
+
+/// Shared io_uring across coroutines.
+#[derive(Clone)]
+pub struct SharedIoUringQueue(SharedObject<IoUringQueue>);
+
+/// Cancels an operation if it is dropped before the operation completes.
+struct InFlight {
+    queue: SharedIoUringQueue,
+    key: usize,
+    user_data: u64,
+    completed: bool,
+}
+
+//======================================================================================================================
+// Implementations
+//======================================================================================================================
+
+impl IoUring {
+    /// Creates an io_uring with at least `entries` submission queue entries and a registered file table of `nfiles`
+    /// empty slots.
+    fn new(entries: u32, nfiles: u32) -> Result<Self, Fail> {
+        // Completions are only posted when we enter the kernel, which spares interrupting the application thread. Older
+        // kernels do not support this, so fall back to the default mode on those.
+        let mut params: Params = Params {
+            flags: IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG,
+            ..Default::default()
+        };
+        let mut fd: libc::c_long = unsafe { libc::syscall(libc::SYS_io_uring_setup, entries, &mut params) };
+        if fd < 0 && errno() == libc::EINVAL {
+            params = Params::default();
+            fd = unsafe { libc::syscall(libc::SYS_io_uring_setup, entries, &mut params) };
+        }
+        if fd < 0 {
+            let errno: libc::c_int = errno();
+            let cause: String = format!("failed to create io_uring (errno={:?})", errno);
+            error!("new(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        let mut ring: Self = Self {
+            fd: fd as RawFd,
+            mappings: Vec::with_capacity(3),
+            sq_head: ptr::null(),
+            sq_tail: ptr::null(),
+            sq_flags: ptr::null(),
+            sq_mask: 0,
+            sq_entries: params.sq_entries,
+            sq_array: ptr::null_mut(),
+            sqes: ptr::null_mut(),
+            cq_head: ptr::null(),
+            cq_tail: ptr::null(),
+            cq_mask: 0,
+            cqes: ptr::null(),
+            to_submit: 0,
+            nfiles: 0,
+            ext_arg: params.features & IORING_FEAT_EXT_ARG != 0,
+        };
+        if !ring.ext_arg {
+            warn!("new(): kernel does not support timeouts on io_uring_enter(), so wait calls will not block");
+        }
+
+        // Map the rings. Recent kernels map both rings at once.
+        let sq_len: usize = params.sq_off.array as usize + params.sq_entries as usize * mem::size_of::<u32>();
+        let cq_len: usize = params.cq_off.cqes as usize + params.cq_entries as usize * mem::size_of::<Cqe>();
+        let (sq_ring, cq_ring): (*mut u8, *mut u8) = if params.features & IORING_FEAT_SINGLE_MMAP != 0 {
+            let rings: *mut u8 = ring.map(sq_len.max(cq_len), IORING_OFF_SQ_RING)?;
+            (rings, rings)
+        } else {
+            (
+                ring.map(sq_len, IORING_OFF_SQ_RING)?,
+                ring.map(cq_len, IORING_OFF_CQ_RING)?,
+            )
+        };
+        let sqes: *mut u8 = ring.map(params.sq_entries as usize * mem::size_of::<Sqe>(), IORING_OFF_SQES)?;
+
+        // Safety: The kernel laid out the rings at these offsets, within the lengths that were just mapped.
+        unsafe {
+            ring.sq_head = sq_ring.add(params.sq_off.head as usize) as *const AtomicU32;
+            ring.sq_tail = sq_ring.add(params.sq_off.tail as usize) as *const AtomicU32;
+            ring.sq_flags = sq_ring.add(params.sq_off.flags as usize) as *const AtomicU32;
+            ring.sq_mask = *(sq_ring.add(params.sq_off.ring_mask as usize) as *const u32);
+            ring.sq_array = sq_ring.add(params.sq_off.array as usize) as *mut u32;
+            ring.sqes = sqes as *mut Sqe;
+            ring.cq_head = cq_ring.add(params.cq_off.head as usize) as *const AtomicU32;
+            ring.cq_tail = cq_ring.add(params.cq_off.tail as usize) as *const AtomicU32;
+            ring.cq_mask = *(cq_ring.add(params.cq_off.ring_mask as usize) as *const u32);
+            ring.cqes = cq_ring.add(params.cq_off.cqes as usize) as *const Cqe;
+        }
+
+        // Register an empty file table, whose slots are filled as sockets are created.
+        let fds: Vec<i32> = vec![-1; nfiles as usize];
+        ring.register(IORING_REGISTER_FILES, fds.as_ptr() as *const libc::c_void, nfiles)?;
+        ring.nfiles = nfiles;
+
+        Ok(ring)
+    }
+
+    /// Maps `len` bytes of the ring at `offset`.
+    fn map(&mut self, len: usize, offset: libc::off_t) -> Result<*mut u8, Fail> {
+        let ptr: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                self.fd,
+                offset,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            let errno: libc::c_int = errno();
+            let cause: String = format!("failed to map io_uring (errno={:?})", errno);
+            error!("map(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        self.mappings.push(Mapping { ptr, len });
+        Ok(ptr as *mut u8)
+    }
+
+    /// Issues an io_uring_register() call.
+    fn register(&self, opcode: u32, arg: *const libc::c_void, nr_args: u32) -> Result<(), Fail> {
+        match unsafe { libc::syscall(libc::SYS_io_uring_register, self.fd, opcode, arg, nr_args) } {
+            ret if ret >= 0 => Ok(()),
+            _ => {
+                let errno: libc::c_int = errno();
+                let cause: String = format!(
+                    "failed to register with io_uring (opcode={:?}, errno={:?})",
+                    opcode, errno
+                );
+                error!("register(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            },
+        }
+    }
+
+    /// Sets slot `index` of the registered file table to `fd`, or clears it if `fd` is -1.
+    fn update_file(&self, index: u32, fd: RawFd) -> Result<(), Fail> {
+        let fds: [i32; 1] = [fd];
+        let update: FilesUpdate = FilesUpdate {
+            offset: index,
+            resv: 0,
+            fds: fds.as_ptr() as u64,
+        };
+        self.register(
+            IORING_REGISTER_FILES_UPDATE,
+            &update as *const FilesUpdate as *const libc::c_void,
+            1,
+        )
+    }
+
+    /// Queues a submission queue entry. It is handed to the kernel on the next call to [Self::enter].
+    fn push(&mut self, sqe: Sqe) -> Result<(), Fail> {
+        // Safety: The head and tail live in the mapped submission ring.
+        let head: u32 = unsafe { (*self.sq_head).load(Ordering::Acquire) };
+        let tail: u32 = unsafe { (*self.sq_tail).load(Ordering::Relaxed) };
+        if tail.wrapping_sub(head) == self.sq_entries {
+            // The ring is full, so make room by handing the queued entries to the kernel.
+            self.enter()?;
+            let head: u32 = unsafe { (*self.sq_head).load(Ordering::Acquire) };
+            if tail.wrapping_sub(head) == self.sq_entries {
+                let cause: &str = "io_uring submission queue is full";
+                warn!("push(): {}", cause);
+                return Err(Fail::new(libc::EAGAIN, cause));
+            }
+        }
+
+        let index: u32 = tail & self.sq_mask;
+        // Safety: The index is masked to the size of the ring, and the kernel does not read this slot until the tail
+        // moves past it.
+        unsafe {
+            ptr::write(self.sqes.add(index as usize), sqe);
+            *self.sq_array.add(index as usize) = index;
+            (*self.sq_tail).store(tail.wrapping_add(1), Ordering::Release);
+        }
+        self.to_submit += 1;
+        Ok(())
+    }
+
+    /// Checks whether we have to enter the kernel, either to submit entries or to have completions posted.
+    fn should_enter(&self) -> bool {
+        // Safety: The flags live in the mapped submission ring.
+        let flags: u32 = unsafe { (*self.sq_flags).load(Ordering::Relaxed) };
+        self.to_submit > 0 || flags & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW) != 0
+    }
+
+    /// Hands queued entries to the kernel and waits until at least one completion is posted or `timeout` expires.
+    /// Kernels that do not support timeouts on io_uring_enter() (before Linux 5.11) return right away.
+    fn wait(&mut self, timeout: Duration) -> Result<(), Fail> {
+        if !self.ext_arg {
+            return self.enter();
+        }
+        let ts: libc::timespec = libc::timespec {
+            tv_sec: timeout.as_secs() as libc::time_t,
+            tv_nsec: timeout.subsec_nanos() as libc::c_long,
+        };
+        let arg: GeteventsArg = GeteventsArg {
+            sigmask: 0,
+            sigmask_sz: 0,
+            pad: 0,
+            ts: &ts as *const libc::timespec as u64,
+        };
+        match unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_enter,
+                self.fd,
+                self.to_submit,
+                1,
+                IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                &arg as *const GeteventsArg,
+                mem::size_of::<GeteventsArg>(),
+            )
+        } {
+            nsubmitted if nsubmitted >= 0 => {
+                self.to_submit -= nsubmitted as u32;
+                Ok(())
+            },
+            _ => match errno() {
+                // Timed out, interrupted, or short on resources: the next poll sorts it out.
+                libc::ETIME | libc::EINTR | libc::EAGAIN | libc::EBUSY => Ok(()),
+                errno => {
+                    let cause: String = format!("io_uring_enter failed (errno={:?})", errno);
+                    error!("wait(): {}", cause);
+                    Err(Fail::new(errno, &cause))
+                },
+            },
+        }
+    }
+
+    /// Hands queued entries to the kernel and has it post pending completions, without waiting for any.
+    fn enter(&mut self) -> Result<(), Fail> {
+        loop {
+            match unsafe {
+                libc::syscall(
+                    libc::SYS_io_uring_enter,
+                    self.fd,
+                    self.to_submit,
+                    0,
+                    IORING_ENTER_GETEVENTS,
+                    ptr::null::<libc::sigset_t>(),
+                    0,
+                )
+            } {
+                nsubmitted if nsubmitted >= 0 => {
+                    self.to_submit -= nsubmitted as u32;
+                    return Ok(());
+                },
+                _ => match errno() {
+                    libc::EINTR => continue,
+                    // The kernel is short on resources or the completion ring is full, so try again on the next poll.
+                    libc::EAGAIN | libc::EBUSY => return Ok(()),
+                    errno => {
+                        let cause: String = format!("io_uring_enter failed (errno={:?})", errno);
+                        error!("enter(): {}", cause);
+                        return Err(Fail::new(errno, &cause));
+                    },
+                },
+            }
+        }
+    }
+
+    /// Pops the next completion queue entry, returning its user data and result.
+    fn pop(&mut self) -> Option<(u64, i32)> {
+        // Safety: The head and tail live in the mapped completion ring.
+        let head: u32 = unsafe { (*self.cq_head).load(Ordering::Relaxed) };
+        let tail: u32 = unsafe { (*self.cq_tail).load(Ordering::Acquire) };
+        if head == tail {
+            return None;
+        }
+        // Safety: The index is masked to the size of the ring, and the kernel does not overwrite this entry until the
+        // head moves past it.
+        let completion: (u64, i32) = unsafe {
+            let cqe: &Cqe = &*self.cqes.add((head & self.cq_mask) as usize);
+            (cqe.user_data, cqe.res)
+        };
+        unsafe { (*self.cq_head).store(head.wrapping_add(1), Ordering::Release) };
+        Some(completion)
+    }
+}
+
+impl Sqe {
+    /// Creates a submission queue entry for an operation on `file`.
+    fn new(opcode: u8, file: File) -> Self {
+        match file {
+            File::Fixed(index) => Self {
+                opcode,
+                flags: IOSQE_FIXED_FILE,
+                fd: index as i32,
+                ..Default::default()
+            },
+            File::Raw(fd) => Self {
+                opcode,
+                fd,
+                ..Default::default()
+            },
+        }
+    }
+}
+
+impl Message {
+    /// Creates a message header for a single buffer. The header points into the message itself, so it must not move
+    /// after this.
+    fn new(buf: &mut DemiBuffer, len: usize, addr: Option<SocketAddr>) -> Box<Self> {
+        // Safety: All of these are plain C structures, for which zero is a valid value.
+        let mut message: Box<Self> = Box::new(unsafe { mem::zeroed() });
+        message.iov[0].iov_base = buf.as_mut_ptr() as *mut libc::c_void;
+        message.iov[0].iov_len = len;
+        message.msg.msg_iov = message.iov.as_mut_ptr();
+        message.msg.msg_iovlen = 1;
+        message.msg.msg_name = &mut message.name as *mut libc::sockaddr_storage as *mut libc::c_void;
+        message.msg.msg_namelen = match addr {
+            Some(addr) => {
+                let addr: SockAddr = addr.into();
+                let len: libc::socklen_t = addr.len();
+                message.name = addr.as_storage();
+                len
+            },
+            None => mem::size_of::<libc::sockaddr_storage>() as libc::socklen_t,
+        };
+        message
+    }
+
+    /// Creates a message header for the segments of a buffer chain, to send them to `addr` (if any). Segments past
+    /// the first [DEMI_SGARRAY_MAXLEN] ones are left out.
+    fn with_segments(buf: &mut DemiBuffer, addr: Option<SocketAddr>) -> Box<Self> {
+        let len: usize = buf.len();
+        let mut message: Box<Self> = Self::new(buf, len, addr);
+        let mut iovcnt: usize = 0;
+        for (iov, segment) in message.iov.iter_mut().zip(buf.segments()) {
+            iov.iov_base = segment.as_ptr() as *mut libc::c_void;
+            iov.iov_len = segment.len();
+            iovcnt += 1;
+        }
+        message.msg.msg_iovlen = iovcnt as _;
+        // Connected sockets take no address.
+        if addr.is_none() {
+            message.msg.msg_name = ptr::null_mut();
+            message.msg.msg_namelen = 0;
+        }
+        message
+    }
+}
+
+impl SharedIoUringQueue {
+    /// Creates an io_uring with at least `entries` submission queue entries and a registered file table of `nfiles`
+    /// slots.
+    pub fn new(entries: u32, nfiles: u32) -> Result<Self, Fail> {
+        Ok(Self(SharedObject::new(IoUringQueue {
+            ring: IoUring::new(entries, nfiles)?,
+            operations: Slab::new(),
+            last_seq: 0,
+        })))
+    }
+
+    /// Registers `fd` in slot `index` of the file table, if the table is large enough.
+    pub fn register_file(&mut self, index: usize, fd: RawFd) -> Result<(), Fail> {
+        if index >= self.ring.nfiles as usize {
+            return Ok(());
+        }
+        self.ring.update_file(index as u32, fd)
+    }
+
+    /// Returns how operations should refer to `fd`, given the slot of the file table it was registered in.
+    pub fn file(&self, index: usize, fd: RawFd) -> File {
+        if index >= self.ring.nfiles as usize {
+            File::Raw(fd)
+        } else {
+            File::Fixed(index as u32)
+        }
+    }
+
+    /// Clears slot `index` of the file table, if any.
+    pub fn unregister_file(&mut self, index: usize) -> Result<(), Fail> {
+        if index >= self.ring.nfiles as usize {
+            return Ok(());
+        }
+        self.ring.update_file(index as u32, -1)
+    }
+
+    /// Hands queued operations to the kernel and completes the operations that finished. This is called from the
+    /// transport's background coroutine.
+    pub fn poll(&mut self) -> Result<(), Fail> {
+        if self.ring.should_enter() {
+            self.ring.enter()?;
+        }
+        while let Some((user_data, res)) = self.ring.pop() {
+            if user_data == CANCEL_USER_DATA {
+                continue;
+            }
+            let key: usize = (user_data & u32::MAX as u64) as usize;
+            match self.operations.get_mut(key) {
+                // Nobody waits for this one, so release its resources now that the kernel is done with them.
+                Some(operation) if operation.user_data == user_data && operation.orphaned => {
+                    self.operations.remove(key);
+                },
+                Some(operation) if operation.user_data == user_data => operation.result.set(Some(res)),
+                _ => warn!("poll(): completion for unknown operation (user_data={:?})", user_data),
+            }
+        }
+        Ok(())
+    }
+
+    /// Blocks until an operation completes or `timeout` expires. Completions are handled on the next poll.
+    pub fn wait(&mut self, timeout: Duration) -> Result<(), Fail> {
+        self.ring.wait(timeout)
+    }
+
+    /// Sends `buf` on `file`, to `addr` if the socket is not connected. Buffer chains are sent with a single
+    /// sendmsg(). Returns the number of bytes that were sent.
+    pub async fn send(&mut self, file: File, mut buf: DemiBuffer, addr: Option<SocketAddr>) -> Result<usize, Fail> {
+        let (sqe, resources): (Sqe, Resources) = if addr.is_some() || buf.num_segments() > 1 {
+            let message: Box<Message> = Message::with_segments(&mut buf, addr);
+            let mut sqe: Sqe = Sqe::new(IORING_OP_SENDMSG, file);
+            sqe.addr = &message.msg as *const libc::msghdr as u64;
+            (sqe, Resources::Message { message, _buf: buf })
+        } else {
+            let mut sqe: Sqe = Sqe::new(IORING_OP_SEND, file);
+            sqe.addr = buf.as_ptr() as u64;
+            sqe.len = buf.len() as u32;
+            (sqe, Resources::Buffer { _buf: buf })
+        };
+        match self.submit(sqe, resources).await?.0 {
+            nbytes if nbytes >= 0 => Ok(nbytes as usize),
+            res => Err(Self::fail("send", -res)),
+        }
+    }
+
+    /// Receives at most `size` bytes from `file` into `buf`. Returns the number of bytes that were received, and the
+    /// address of the sender for datagram sockets.
+    pub async fn recv(
+        &mut self,
+        file: File,
+        mut buf: DemiBuffer,
+        size: usize,
+    ) -> Result<(usize, Option<SocketAddr>), Fail> {
+        let message: Box<Message> = Message::new(&mut buf, size, None);
+        let mut sqe: Sqe = Sqe::new(IORING_OP_RECVMSG, file);
+        sqe.addr = &message.msg as *const libc::msghdr as u64;
+        match self.submit(sqe, Resources::Message { message, _buf: buf }).await? {
+            (nbytes, Resources::Message { message, .. }) if nbytes >= 0 => {
+                // Connected sockets do not report the address of the sender.
+                let addr: Option<SocketAddr> = match message.msg.msg_namelen {
+                    0 => None,
+                    // Safety: The kernel filled in the address and its length.
+                    len => unsafe { SockAddr::new(message.name, len) }.as_socket(),
+                };
+                Ok((nbytes as usize, addr))
+            },
+            (res, _) => Err(Self::fail("recv", -res)),
+        }
+    }
+
+    /// Accepts a connection on the listening socket `file`. Returns the new socket and the address of the peer.
+    pub async fn accept(&mut self, file: File) -> Result<(RawFd, SocketAddr), Fail> {
+        // Safety: A socket address storage is a plain C structure, for which zero is a valid value.
+        let addr: Box<(libc::sockaddr_storage, libc::socklen_t)> = Box::new((
+            unsafe { mem::zeroed() },
+            mem::size_of::<libc::sockaddr_storage>() as libc::socklen_t,
+        ));
+        let mut sqe: Sqe = Sqe::new(IORING_OP_ACCEPT, file);
+        sqe.addr = &addr.0 as *const libc::sockaddr_storage as u64;
+        sqe.off = &addr.1 as *const libc::socklen_t as u64;
+        sqe.op_flags = libc::SOCK_CLOEXEC as u32;
+        match self.submit(sqe, Resources::AcceptAddress { addr }).await? {
+            (fd, Resources::AcceptAddress { addr }) if fd >= 0 => {
+                // Safety: The kernel filled in the address and its length.
+                let addr: SockAddr = unsafe { SockAddr::new(addr.0, addr.1) };
+                match addr.as_socket() {
+                    Some(addr) => Ok((fd, addr)),
+                    None => {
+                        unsafe { libc::close(fd) };
+                        Err(Fail::new(
+                            libc::EAFNOSUPPORT,
+                            "accepted a connection from a non-IP address",
+                        ))
+                    },
+                }
+            },
+            (res, _) => Err(Self::fail("accept", -res)),
+        }
+    }
+
+    /// Connects `file` to `remote`.
+    pub async fn connect(&mut self, file: File, remote: SocketAddr) -> Result<(), Fail> {
+        let addr: Box<SockAddr> = Box::new(remote.into());
+        let mut sqe: Sqe = Sqe::new(IORING_OP_CONNECT, file);
+        sqe.addr = addr.as_ptr() as u64;
+        sqe.off = addr.len() as u64;
+        match self.submit(sqe, Resources::Address { _addr: addr }).await?.0 {
+            0 => Ok(()),
+            res => Err(Self::fail("connect", -res)),
+        }
+    }
+
+    /// Queues an operation and waits for it to complete. Returns the result of the operation, which is a negative
+    /// error code on failure, along with the resources that the kernel accessed.
+    async fn submit(&mut self, mut sqe: Sqe, resources: Resources) -> Result<(i32, Resources), Fail> {
+        let mut result: SharedAsyncValue<Option<i32>> = SharedAsyncValue::new(None);
+        self.last_seq = self.last_seq.wrapping_add(1);
+        let seq: u32 = self.last_seq;
+        let entry: slab::VacantEntry<Operation> = self.operations.vacant_entry();
+        let key: usize = entry.key();
+        let user_data: u64 = (seq as u64) << 32 | key as u64;
+        entry.insert(Operation {
+            user_data,
+            result: result.clone(),
+            resources,
+            orphaned: false,
+        });
+        sqe.user_data = user_data;
+        if let Err(e) = self.ring.push(sqe) {
+            self.operations.remove(key);
+            return Err(e);
+        }
+
+        let mut in_flight: InFlight = InFlight {
+            queue: self.clone(),
+            key,
+            user_data,
+            completed: false,
+        };
+        loop {
+            match result.get() {
+                Some(res) => {
+                    in_flight.completed = true;
+                    let operation: Operation = self.operations.remove(key);
+                    return Ok((res, operation.resources));
+                },
+                None => {
+                    result.wait_for_change(None).await?;
+                },
+            }
+        }
+    }
+
+    /// Builds a failure for a completed operation.
+    fn fail(operation: &str, errno: i32) -> Fail {
+        let cause: String = format!("failed to {} on socket: {:?}", operation, errno);
+        if errno != libc::ECANCELED {
+            error!("{}(): {}", operation, cause);
+        }
+        Fail::new(errno, &cause)
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Reads the error code of the last system call.
+fn errno() -> libc::c_int {
+    unsafe { *libc::__errno_location() }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for IoUring {
+    fn drop(&mut self) {
+        for mapping in self.mappings.drain(..) {
+            unsafe { libc::munmap(mapping.ptr, mapping.len) };
+        }
+        if unsafe { libc::close(self.fd) } != 0 {
+            warn!("drop(): failed to close io_uring (errno={:?})", errno());
+        }
+    }
+}
+
+impl Drop for InFlight {
+    /// Asks the kernel to cancel the operation if its coroutine went away. Its resources are released once the kernel
+    /// posts the completion.
+    fn drop(&mut self) {
+        if self.completed {
+            return;
+        }
+        match self.queue.operations.get_mut(self.key) {
+            Some(operation) if operation.user_data == self.user_data => match operation.result.get() {
+                // The kernel is done, but the coroutine did not get to see it.
+                Some(_) => {
+                    self.queue.operations.remove(self.key);
+                    return;
+                },
+                None => operation.orphaned = true,
+            },
+            _ => return,
+        }
+        let mut sqe: Sqe = Sqe::new(IORING_OP_ASYNC_CANCEL, File::Raw(-1));
+        sqe.addr = self.user_data;
+        sqe.user_data = CANCEL_USER_DATA;
+        if let Err(e) = self.queue.ring.push(sqe) {
+            warn!("drop(): failed to cancel io_uring operation: {:?}", e);
+        }
+    }
+}
+
+impl Deref for SharedIoUringQueue {
+    type Target = IoUringQueue;
+
+    fn deref(&self) -> &Self::Target {
+        self.0.deref()
+    }
+}
+
+impl DerefMut for SharedIoUringQueue {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.0.deref_mut()
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        errno,
+        File,
+        IoUring,
+        Sqe,
+        IORING_OP_SEND,
+    };
+    use crate::runtime::fail::Fail;
+    use ::anyhow::Result;
+    use ::std::{
+        mem,
+        os::fd::{
+            AsRawFd,
+            FromRawFd,
+            OwnedFd,
+            RawFd,
+        },
+        time::{
+            Duration,
+            Instant,
+        },
+    };
+
+    /// Creates an io_uring, or returns None if the kernel does not support io_uring or does not let us use it (e.g. in
+    /// a container whose seccomp profile blocks it), so that tests can be skipped there.
+    fn new_ring(entries: u32, nfiles: u32) -> Result<Option<IoUring>> {
+        match IoUring::new(entries, nfiles) {
+            Ok(ring) => Ok(Some(ring)),
+            Err(e) if e.errno == libc::ENOSYS || e.errno == libc::EPERM => {
+                warn!("io_uring is not available, skipping test: {:?}", e);
+                Ok(None)
+            },
+            Err(e) => ::anyhow::bail!("failed to create io_uring: {:?}", e),
+        }
+    }
+
+    /// Creates a pair of connected stream sockets.
+    fn socketpair() -> Result<(OwnedFd, OwnedFd)> {
+        let mut fds: [RawFd; 2] = [-1; 2];
+        let ret: libc::c_int = unsafe {
+            libc::socketpair(
+                libc::AF_UNIX,
+                libc::SOCK_STREAM | libc::SOCK_CLOEXEC,
+                0,
+                fds.as_mut_ptr(),
+            )
+        };
+        if ret != 0 {
+            ::anyhow::bail!("failed to create socket pair (errno={:?})", errno());
+        }
+        // Safety: The kernel just handed us these file descriptors, and nobody else owns them.
+        Ok(unsafe { (OwnedFd::from_raw_fd(fds[0]), OwnedFd::from_raw_fd(fds[1])) })
+    }
+
+    /// Checks that an operation on a registered file goes through the submission ring and comes back on the completion
+    /// ring with its user data and result.
+    #[test]
+    fn submit_and_complete() -> Result<()> {
+        let mut ring: IoUring = match new_ring(8, 1)? {
+            Some(ring) => ring,
+            None => return Ok(()),
+        };
+        let (tx, rx): (OwnedFd, OwnedFd) = socketpair()?;
+        ring.update_file(0, tx.as_raw_fd())?;
+
+        let data: [u8; 16] = *b"demikernel+uring";
+        let mut sqe: Sqe = Sqe::new(IORING_OP_SEND, File::Fixed(0));
+        sqe.addr = data.as_ptr() as u64;
+        sqe.len = data.len() as u32;
+        sqe.user_data = 42;
+        ring.push(sqe)?;
+        crate::ensure_eq!(ring.to_submit, 1);
+        // Nothing completes before the entry is handed to the kernel.
+        ::anyhow::ensure!(ring.pop().is_none());
+
+        let deadline: Instant = Instant::now() + Duration::from_secs(5);
+        let completion: (u64, i32) = loop {
+            ring.enter()?;
+            if let Some(completion) = ring.pop() {
+                break completion;
+            }
+            ::anyhow::ensure!(Instant::now() < deadline, "operation did not complete");
+        };
+        crate::ensure_eq!(ring.to_submit, 0);
+        crate::ensure_eq!(completion, (42, data.len() as i32));
+        ::anyhow::ensure!(ring.pop().is_none());
+
+        // The data made it to the other end of the socket pair.
+        let mut received: [u8; 16] = [0; 16];
+        let nbytes: isize = unsafe {
+            libc::recv(
+                rx.as_raw_fd(),
+                received.as_mut_ptr() as *mut libc::c_void,
+                received.len(),
+                libc::MSG_DONTWAIT,
+            )
+        };
+        crate::ensure_eq!(nbytes, data.len() as isize);
+        crate::ensure_eq!(received, data);
+
+        ring.update_file(0, -1)?;
+        Ok(())
+    }
+
+    /// Checks that blocking in io_uring_enter() with nothing in flight returns once the timeout expires.
+    #[test]
+    fn wait_times_out() -> Result<()> {
+        let mut ring: IoUring = match new_ring(8, 1)? {
+            Some(ring) => ring,
+            None => return Ok(()),
+        };
+        // Kernels before Linux 5.11 do not take a timeout, so wait calls return right away.
+        if !ring.ext_arg {
+            return Ok(());
+        }
+
+        let timeout: Duration = Duration::from_millis(10);
+        let start: Instant = Instant::now();
+        ring.wait(timeout)?;
+        ::anyhow::ensure!(start.elapsed() >= timeout);
+        ::anyhow::ensure!(ring.pop().is_none());
+        Ok(())
+    }
+
+    /// Checks that errors of a blocking io_uring_enter() other than timeouts and interruptions are reported.
+    #[test]
+    fn wait_reports_enter_errors() -> Result<()> {
+        let mut ring: IoUring = match new_ring(8, 1)? {
+            Some(ring) => ring,
+            None => return Ok(()),
+        };
+
+        // Point the ring at a file that is not an io_uring, which the kernel refuses to enter.
+        let fd: RawFd = unsafe { libc::eventfd(0, libc::EFD_CLOEXEC) };
+        ::anyhow::ensure!(fd >= 0, "failed to create eventfd (errno={:?})", errno());
+        // Safety: The kernel just handed us this file descriptor, and nobody else owns it.
+        let other: OwnedFd = unsafe { OwnedFd::from_raw_fd(fd) };
+        let ring_fd: RawFd = mem::replace(&mut ring.fd, other.as_raw_fd());
+        let result: Result<(), Fail> = ring.wait(Duration::from_millis(10));
+        ring.fd = ring_fd;
+
+        match result {
+            Ok(()) => ::anyhow::bail!("wait() should fail"),
+            Err(e) => crate::ensure_eq!(e.errno, libc::EOPNOTSUPP),
+        }
+        Ok(())
+    }
+}
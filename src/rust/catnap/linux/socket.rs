@@ -157,6 +157,15 @@ impl SharedSocketData {
             SocketData::Passive(_) => (),
         }
     }
+
+    /// Returns the poll() events that this socket waits for.
+    pub fn poll_events(&self) -> libc::c_short {
+        match self.deref() {
+            SocketData::Inactive(_) => 0,
+            SocketData::Active(data) => data.poll_events(),
+            SocketData::Passive(_) => libc::POLLIN,
+        }
+    }
 }
 
 //======================================================================================================================
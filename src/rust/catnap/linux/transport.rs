@@ -6,6 +6,8 @@
 //======================================================================================================================
 
 mod active_socket;
+mod config;
+mod io_uring;
 mod passive_socket;
 mod socket;
 
@@ -14,9 +16,15 @@ mod socket;
 //======================================================================================================================
 
 use crate::{
-    catnap::transport::socket::{
-        SharedSocketData,
-        SocketData,
+    catnap::transport::{
+        io_uring::{
+            File,
+            SharedIoUringQueue,
+        },
+        socket::{
+            SharedSocketData,
+            SocketData,
+        },
     },
     demikernel::config::Config,
     runtime::{
@@ -25,6 +33,8 @@ use crate::{
         network::transport::NetworkTransport,
         poll_yield,
         DemiRuntime,
+        IdleBlocker,
+        IdleWait,
         SharedDemiRuntime,
         SharedObject,
     },
@@ -38,7 +48,9 @@ use ::socket2::{
     Type,
 };
 use ::std::{
+    cmp::min,
     io,
+    mem,
     net::{
         Shutdown,
         SocketAddr,
@@ -49,8 +61,11 @@ use ::std::{
     },
     os::fd::{
         AsRawFd,
+        FromRawFd,
         RawFd,
     },
+    ptr,
+    time::Duration,
 };
 
 //======================================================================================================================
@@ -60,6 +75,10 @@ use ::std::{
 // Set to the max number of file descriptors that can be open without increasing the number on Linux.
 const EPOLL_BATCH_SIZE: usize = 1024;
 
+// Number of sockets that io_uring refers to through its registered file table. Other sockets fall back to regular file
+// descriptors.
+const IO_URING_FIXED_FILES: u32 = 1024;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -67,6 +86,10 @@ const EPOLL_BATCH_SIZE: usize = 1024;
 /// Underlying network transport.
 pub struct CatnapTransport {
     epoll_fd: RawFd,
+    /// If set, I/O goes through io_uring instead of epoll and non-blocking system calls.
+    io_uring: Option<SharedIoUringQueue>,
+    /// If set, sockets are created with SO_REUSEPORT, so that several threads can listen on the same port.
+    reuse_port: bool,
     socket_table: Slab<SharedSocketData>,
     runtime: SharedDemiRuntime,
 }
@@ -75,6 +98,13 @@ pub struct CatnapTransport {
 #[derive(Clone)]
 pub struct SharedCatnapTransport(SharedObject<CatnapTransport>);
 
+/// Blocks wait calls that have nothing to do on the sockets of the transport.
+struct CatnapIdleBlocker {
+    transport: SharedCatnapTransport,
+    /// Descriptors to poll, which are reused across calls.
+    pollfds: Vec<libc::pollfd>,
+}
+
 /// Short-hand for our socket descriptor.
 type SockDesc = <SharedCatnapTransport as NetworkTransport>::SocketDescriptor;
 
@@ -84,7 +114,7 @@ type SockDesc = <SharedCatnapTransport as NetworkTransport>::SocketDescriptor;
 
 impl SharedCatnapTransport {
     /// Create a new Linux-based network transport.
-    pub fn new(_config: &Config, runtime: &mut SharedDemiRuntime) -> Self {
+    pub fn new(config: &Config, runtime: &mut SharedDemiRuntime) -> Self {
         // Create epoll socket.
         // Linux ignores the size argument to epoll, it just has to be more than 0.
         let epoll_fd: RawFd = match unsafe { libc::epoll_create(10) } {
@@ -95,19 +125,61 @@ impl SharedCatnapTransport {
             },
         };
 
-        // Set up background task for polling epoll API.
+        // Create io_uring, if enabled. Fall back to epoll on kernels that do not support it.
+        let io_uring: Option<SharedIoUringQueue> = match config.io_uring() {
+            Ok(Some(queue_depth)) => match SharedIoUringQueue::new(queue_depth, IO_URING_FIXED_FILES) {
+                Ok(io_uring) => Some(io_uring),
+                Err(e) => {
+                    warn!("new(): falling back to epoll ({:?})", e);
+                    None
+                },
+            },
+            Ok(None) => None,
+            Err(e) => panic!("invalid io_uring configuration: {:?}", e),
+        };
+        let reuse_port: bool = match config.catnap_reuse_port() {
+            Ok(reuse_port) => reuse_port,
+            Err(e) => panic!("invalid reuse_port configuration: {:?}", e),
+        };
+
+        // Set up background task for polling epoll API or reaping io_uring completions.
         let me: Self = Self(SharedObject::new(CatnapTransport {
             epoll_fd,
+            io_uring: io_uring.clone(),
+            reuse_port,
             socket_table: Slab::<SharedSocketData>::new(),
             runtime: runtime.clone(),
         }));
-        let mut me2: Self = me.clone();
-        runtime
-            .insert_background_coroutine(
-                "catnap::transport::epoll",
-                Box::pin(async move { me2.poll().await }.fuse()),
-            )
-            .expect("should be able to insert background coroutine");
+        match io_uring {
+            Some(io_uring) => runtime
+                .insert_background_coroutine(
+                    "catnap::transport::io_uring",
+                    Box::pin(async move { Self::poll_io_uring(io_uring).await }.fuse()),
+                )
+                .expect("should be able to insert background coroutine"),
+            None => {
+                let mut me2: Self = me.clone();
+                runtime
+                    .insert_background_coroutine(
+                        "catnap::transport::epoll",
+                        Box::pin(async move { me2.poll().await }.fuse()),
+                    )
+                    .expect("should be able to insert background coroutine")
+            },
+        };
+
+        // Block wait calls that run out of work on the sockets, if enabled.
+        match config.catnap_spin_then_block() {
+            Ok(Some(spin_time)) => runtime.set_idle_wait(IdleWait::new(
+                spin_time,
+                Box::new(CatnapIdleBlocker {
+                    transport: me.clone(),
+                    pollfds: Vec::new(),
+                }),
+            )),
+            Ok(None) => (),
+            Err(e) => panic!("invalid spin-then-block configuration: {:?}", e),
+        }
         me
     }
 
@@ -184,21 +256,21 @@ impl SharedCatnapTransport {
             };
             while let Some(event) = events.pop() {
                 let offset: usize = event.u64 as usize;
-                if event.events | (libc::EPOLLIN as u32) != 0 {
+                if event.events & (libc::EPOLLIN as u32) != 0 {
                     // Wake pop.
                     self.socket_table
                         .get_mut(offset)
                         .expect("should have allocated this when epoll was registered")
                         .poll_in();
                 }
-                if event.events | (libc::EPOLLOUT as u32) != 0 {
+                if event.events & (libc::EPOLLOUT as u32) != 0 {
                     // Wake push.
                     self.socket_table
                         .get_mut(offset)
                         .expect("should have allocated this when epoll was registered")
                         .poll_out();
                 }
-                if event.events | (libc::EPOLLERR as u32 | libc::EPOLLHUP as u32) != 0 {
+                if event.events & (libc::EPOLLERR as u32 | libc::EPOLLHUP as u32) != 0 {
                     // Wake both push and pop.
                     self.socket_table
                         .get_mut(offset)
@@ -215,6 +287,80 @@ impl SharedCatnapTransport {
         }
     }
 
+    /// Blocks until one of the sockets has an event that a coroutine waits for, or until `timeout` expires. Sockets are
+    /// polled with the events that they wait for, rather than through the epoll socket, where they are registered for
+    /// both incoming and outgoing events and would almost always be ready.
+    fn block(&mut self, pollfds: &mut Vec<libc::pollfd>, timeout: Duration) {
+        if let Some(io_uring) = self.io_uring.as_mut() {
+            if let Err(e) = io_uring.wait(timeout) {
+                warn!("block(): {:?}", e);
+            }
+            return;
+        }
+
+        pollfds.clear();
+        for (_, data) in self.socket_table.iter() {
+            let events: libc::c_short = data.poll_events();
+            if events != 0 {
+                pollfds.push(libc::pollfd {
+                    fd: data.as_raw_fd(),
+                    events,
+                    revents: 0,
+                });
+            }
+        }
+        let ts: libc::timespec = libc::timespec {
+            tv_sec: timeout.as_secs() as libc::time_t,
+            tv_nsec: timeout.subsec_nanos() as libc::c_long,
+        };
+        if unsafe { libc::ppoll(pollfds.as_mut_ptr(), pollfds.len() as libc::nfds_t, &ts, ptr::null()) } < 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            if errno != libc::EINTR {
+                warn!("block(): ppoll failed (errno={:?})", errno);
+            }
+        }
+    }
+
+    /// Background function for submitting io_uring operations and reaping their completions.
+    async fn poll_io_uring(mut io_uring: SharedIoUringQueue) {
+        loop {
+            if let Err(e) = io_uring.poll() {
+                error!("poll_io_uring(): {:?}", e);
+                break;
+            }
+            // Yield for one iteration.
+            poll_yield().await;
+        }
+    }
+
+    /// Registers the socket with io_uring, if enabled.
+    fn register_io_uring(&mut self, sd: &SockDesc) -> Result<(), Fail> {
+        let fd: RawFd = self.raw_fd_from_sd(sd);
+        match self.io_uring.as_mut() {
+            Some(io_uring) => io_uring.register_file(*sd, fd),
+            None => Ok(()),
+        }
+    }
+
+    /// Removes the socket from io_uring or epoll, whichever is enabled.
+    fn unregister(&mut self, sd: &SockDesc) -> Result<(), Fail> {
+        if let Some(io_uring) = self.io_uring.as_mut() {
+            return io_uring.unregister_file(*sd);
+        }
+        match self.data_from_sd(sd).deref_mut() {
+            SocketData::Active(_) => self.unregister_epoll(sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32),
+            SocketData::Passive(_) => self.unregister_epoll(sd, libc::EPOLLIN as u32),
+            _ => Ok(()),
+        }
+    }
+
+    /// Internal function to get the io_uring and the file that its operations should target, given the socket
+    /// descriptor.
+    fn io_uring_from_sd(&self, sd: &SockDesc) -> Option<(SharedIoUringQueue, File)> {
+        let io_uring: &SharedIoUringQueue = self.io_uring.as_ref()?;
+        Some((io_uring.clone(), io_uring.file(*sd, self.raw_fd_from_sd(sd))))
+    }
+
     /// Internal function to get the raw file descriptor from a socket, given the socket descriptor.
     fn raw_fd_from_sd(&self, sd: &SockDesc) -> RawFd {
         self.socket_table
@@ -243,10 +389,34 @@ fn get_libc_err(e: io::Error) -> i32 {
     e.raw_os_error().expect("should have an os error code")
 }
 
+/// Sets the SO_REUSEPORT option on `socket`.
+fn set_reuse_port(socket: &Socket) -> Result<(), io::Error> {
+    let optval: libc::c_int = 1;
+    // Safety: the option value is a valid integer that outlives the call, and its size is passed along with it.
+    match unsafe {
+        libc::setsockopt(
+            socket.as_raw_fd(),
+            libc::SOL_SOCKET,
+            libc::SO_REUSEPORT,
+            &optval as *const libc::c_int as *const libc::c_void,
+            mem::size_of::<libc::c_int>() as libc::socklen_t,
+        )
+    } {
+        0 => Ok(()),
+        _ => Err(io::Error::last_os_error()),
+    }
+}
+
 //======================================================================================================================
 // Trait implementation
 //======================================================================================================================
 
+impl IdleBlocker for CatnapIdleBlocker {
+    fn block(&mut self, timeout: Duration) {
+        self.transport.block(&mut self.pollfds, timeout)
+    }
+}
+
 /// Dereference a shared reference to the underlying transport.
 impl Deref for SharedCatnapTransport {
     type Target = CatnapTransport;
@@ -287,11 +457,22 @@ impl NetworkTransport for SharedCatnapTransport {
                     error!("new(): {}", cause);
                     return Err(Fail::new(get_libc_err(e), &cause));
                 }
-                if let Err(e) = socket.set_nonblocking(true) {
-                    let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
-                    socket.shutdown(Shutdown::Both)?;
-                    error!("new(): {}", cause);
-                    return Err(Fail::new(get_libc_err(e), &cause));
+                if self.reuse_port {
+                    if let Err(e) = set_reuse_port(&socket) {
+                        let cause: String = format!("cannot set REUSE_PORT option: {:?}", e);
+                        socket.shutdown(Shutdown::Both)?;
+                        error!("new(): {}", cause);
+                        return Err(Fail::new(get_libc_err(e), &cause));
+                    }
+                }
+                // io_uring waits for blocking sockets to become ready without blocking the caller.
+                if self.io_uring.is_none() {
+                    if let Err(e) = socket.set_nonblocking(true) {
+                        let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
+                        socket.shutdown(Shutdown::Both)?;
+                        error!("new(): {}", cause);
+                        return Err(Fail::new(get_libc_err(e), &cause));
+                    }
                 }
 
                 // Set TCP socket options
@@ -316,11 +497,17 @@ impl NetworkTransport for SharedCatnapTransport {
             Type::STREAM => self.socket_table.insert(SharedSocketData::new_inactive(socket)),
             Type::DGRAM => {
                 let new_sd: Self::SocketDescriptor = self.socket_table.insert(SharedSocketData::new_active(socket));
-                self.register_epoll(&new_sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?;
+                if self.io_uring.is_none() {
+                    self.register_epoll(&new_sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?;
+                }
                 new_sd
             },
             _ => unreachable!("We should have returned an error by now"),
         };
+        if let Err(e) = self.register_io_uring(&sd) {
+            self.socket_table.remove(sd);
+            return Err(e);
+        }
         Ok(sd)
     }
 
@@ -349,7 +536,9 @@ impl NetworkTransport for SharedCatnapTransport {
 
         // Update socket state.
         self.data_from_sd(sd).move_socket_to_passive();
-        self.register_epoll(&sd, libc::EPOLLIN as u32)?;
+        if self.io_uring.is_none() {
+            self.register_epoll(&sd, libc::EPOLLIN as u32)?;
+        }
 
         Ok(())
     }
@@ -357,7 +546,14 @@ impl NetworkTransport for SharedCatnapTransport {
     /// Accept the next incoming connection. This function blocks until a new connection arrives from the underlying
     /// transport.
     async fn accept(&mut self, sd: &mut Self::SocketDescriptor) -> Result<(Self::SocketDescriptor, SocketAddr), Fail> {
-        let (new_socket, addr) = self.data_from_sd(sd).accept().await?;
+        let (new_socket, addr): (Socket, SocketAddr) = match self.io_uring_from_sd(sd) {
+            Some((mut io_uring, file)) => {
+                let (fd, addr): (RawFd, SocketAddr) = io_uring.accept(file).await?;
+                // Safety: The kernel just created this file descriptor for us.
+                (unsafe { Socket::from_raw_fd(fd) }, addr)
+            },
+            None => self.data_from_sd(sd).accept().await?,
+        };
         // Set socket options.
         if let Err(e) = new_socket.set_reuse_address(true) {
             let cause: String = format!("cannot set REUSE_ADDRESS option: {:?}", e);
@@ -371,16 +567,26 @@ impl NetworkTransport for SharedCatnapTransport {
             error!("accept(): {}", cause);
             return Err(Fail::new(get_libc_err(e), &cause));
         }
-        if let Err(e) = new_socket.set_nonblocking(true) {
-            let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
-            self.socket_from_sd(sd).shutdown(Shutdown::Both)?;
-            error!("accept(): {}", cause);
-            return Err(Fail::new(get_libc_err(e), &cause));
+        if self.io_uring.is_none() {
+            if let Err(e) = new_socket.set_nonblocking(true) {
+                let cause: String = format!("cannot set NONBLOCKING option: {:?}", e);
+                self.socket_from_sd(sd).shutdown(Shutdown::Both)?;
+                error!("accept(): {}", cause);
+                return Err(Fail::new(get_libc_err(e), &cause));
+            }
         }
 
         let new_data: SharedSocketData = SharedSocketData::new_active(new_socket);
         let new_sd: usize = self.socket_table.insert(new_data);
-        self.register_epoll(&new_sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?;
+        match self.io_uring {
+            Some(_) => {
+                if let Err(e) = self.register_io_uring(&new_sd) {
+                    self.socket_table.remove(new_sd);
+                    return Err(e);
+                }
+            },
+            None => self.register_epoll(&new_sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?,
+        }
         Ok((new_sd, addr))
     }
 
@@ -388,6 +594,9 @@ impl NetworkTransport for SharedCatnapTransport {
     /// with an error.
     async fn connect(&mut self, sd: &mut Self::SocketDescriptor, remote: SocketAddr) -> Result<(), Fail> {
         self.data_from_sd(sd).move_socket_to_active();
+        if let Some((mut io_uring, file)) = self.io_uring_from_sd(sd) {
+            return io_uring.connect(file, remote).await;
+        }
         self.register_epoll(&sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?;
 
         loop {
@@ -410,6 +619,7 @@ impl NetworkTransport for SharedCatnapTransport {
 
     /// Close the socket and block until close completes.
     async fn close(&mut self, sd: &mut Self::SocketDescriptor) -> Result<(), Fail> {
+        let use_io_uring: bool = self.io_uring.is_some();
         let data: &mut SharedSocketData = self.data_from_sd(sd);
         loop {
             // Close the socket.
@@ -421,8 +631,12 @@ impl NetworkTransport for SharedCatnapTransport {
                     match errno {
                         libc::ENOTCONN => break,
                         errno if DemiRuntime::should_retry(errno) => {
-                            // Wait for a new incoming event.
-                            data.pop(&mut DemiBuffer::new(0), 0).await?;
+                            // Wait for a new incoming event. There are none with io_uring, so just try again later.
+                            if use_io_uring {
+                                poll_yield().await;
+                            } else {
+                                data.pop(&mut DemiBuffer::new(0), 0).await?;
+                            }
                             continue;
                         },
                         errno => return Err(Fail::new(errno, "operation failed")),
@@ -430,12 +644,8 @@ impl NetworkTransport for SharedCatnapTransport {
                 },
             }
         }
-        // Check whether we need to remove epoll events.
-        match data.deref_mut() {
-            SocketData::Active(_) => self.unregister_epoll(sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?,
-            SocketData::Passive(_) => self.unregister_epoll(sd, libc::EPOLLIN as u32)?,
-            _ => (),
-        };
+        // Check whether we need to remove epoll events or the registered file.
+        self.unregister(sd)?;
         self.socket_table.remove(*sd);
         Ok(())
     }
@@ -449,9 +659,22 @@ impl NetworkTransport for SharedCatnapTransport {
         addr: Option<SocketAddr>,
     ) -> Result<(), Fail> {
         {
-            self.data_from_sd(sd).push(addr, buf.clone()).await?;
+            match self.io_uring_from_sd(sd) {
+                Some((mut io_uring, file)) => {
+                    let mut pending: DemiBuffer = buf.clone();
+                    while pending.total_len() > 0 {
+                        let nbytes: usize = io_uring.send(file, pending.clone(), addr).await?;
+                        trace!("data pushed ({:?}/{:?} bytes)", nbytes, pending.total_len());
+                        pending
+                            .advance(nbytes)
+                            .expect("OS should not have sent more bytes than in the buffer");
+                    }
+                },
+                None => self.data_from_sd(sd).push(addr, buf.clone()).await?,
+            }
             // Clear out the original buffer.
-            buf.trim(buf.len()).expect("Should be able to empty the buffer");
+            buf.advance(buf.total_len())
+                .expect("Should be able to empty the buffer");
             Ok(())
         }
     }
@@ -465,7 +688,18 @@ impl NetworkTransport for SharedCatnapTransport {
         buf: &mut DemiBuffer,
         size: usize,
     ) -> Result<Option<SocketAddr>, Fail> {
-        self.data_from_sd(sd).pop(buf, size).await
+        match self.io_uring_from_sd(sd) {
+            Some((mut io_uring, file)) => {
+                // Receive straight into the buffer that is handed to the application.
+                let (nbytes, addr): (usize, Option<SocketAddr>) =
+                    io_uring.recv(file, buf.clone(), min(size, buf.len())).await?;
+                trace!("data popped ({:?} bytes)", nbytes);
+                buf.trim(buf.len() - nbytes)
+                    .expect("OS should not have received more bytes than in the buffer");
+                Ok(addr)
+            },
+            None => self.data_from_sd(sd).pop(buf, size).await,
+        }
     }
 
     /// Close the socket on the underlying transport. Also unregisters the socket with epoll.
@@ -486,12 +720,8 @@ impl NetworkTransport for SharedCatnapTransport {
                 }
             },
         }
-        // Check whether we need to remove epoll events.
-        match data.deref_mut() {
-            SocketData::Active(_) => self.unregister_epoll(sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?,
-            SocketData::Passive(_) => self.unregister_epoll(sd, libc::EPOLLIN as u32)?,
-            _ => (),
-        };
+        // Check whether we need to remove epoll events or the registered file.
+        self.unregister(sd)?;
         self.socket_table.remove(*sd);
         Ok(())
     }
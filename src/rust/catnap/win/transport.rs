@@ -290,9 +290,10 @@ impl NetworkTransport for SharedCatnapTransport {
 
             match result {
                 Ok(nbytes) => {
-                    trace!("data pushed ({:?}/{:?} bytes)", nbytes, buf.len());
-                    buf.adjust(nbytes)?;
-                    if buf.is_empty() {
+                    // Each operation sends the first segment of a buffer chain.
+                    trace!("data pushed ({:?}/{:?} bytes)", nbytes, buf.total_len());
+                    buf.advance(nbytes)?;
+                    if buf.total_len() == 0 {
                         return Ok(());
                     }
                 },
@@ -17,23 +17,22 @@ use crate::{
         libdpdk::{
             rte_mbuf,
             rte_mempool,
+            RTE_PKTMBUF_HEADROOM,
+        },
+        memory::{
+            self,
+            DemiBuffer,
         },
-        memory::DemiBuffer,
         types::{
             demi_sgarray_t,
-            demi_sgaseg_t,
+            DEMI_SGARRAY_MAXLEN,
         },
     },
 };
 use ::anyhow::Error;
-use ::libc::c_void;
 use ::std::{
     ffi::CString,
     mem,
-    ptr::{
-        self,
-        NonNull,
-    },
 };
 
 //==============================================================================
@@ -59,6 +58,9 @@ pub struct MemoryManager {
 
     // Large body pool for buffers given to the application for zero-copy.
     body_pool: MemoryPool,
+
+    // Number of bytes that fit in a header mbuf, past its headroom.
+    header_mbuf_len: usize,
 }
 
 //==============================================================================
@@ -67,15 +69,15 @@ pub struct MemoryManager {
 
 /// Associated Functions for Memory Managers
 impl MemoryManager {
-    /// Instantiates a memory manager.
-    pub fn new(max_body_size: usize) -> Result<Self, Error> {
+    /// Instantiates a memory manager for the device queue `queue_id`.
+    pub fn new(queue_id: u16, max_body_size: usize) -> Result<Self, Error> {
         let config: MemoryConfig = MemoryConfig::new(None, None, Some(max_body_size), None, None);
         let header_size: usize = ETHERNET2_HEADER_SIZE + (IPV4_HEADER_MAX_SIZE as usize) + MAX_TCP_HEADER_SIZE;
         let header_mbuf_size: usize = header_size + config.get_inline_body_size();
 
         // Create memory pool for holding packet headers.
         let header_pool: MemoryPool = MemoryPool::new(
-            CString::new("header_pool")?,
+            CString::new(format!("header_pool_{}", queue_id))?,
             header_mbuf_size,
             config.get_header_pool_size(),
             config.get_cache_size(),
@@ -83,7 +85,7 @@ impl MemoryManager {
 
         // Create memory pool for holding packet bodies.
         let body_pool: MemoryPool = MemoryPool::new(
-            CString::new("body_pool")?,
+            CString::new(format!("body_pool_{}", queue_id))?,
             config.get_max_body_size(),
             config.get_body_pool_size(),
             config.get_cache_size(),
@@ -93,25 +95,18 @@ impl MemoryManager {
             config,
             header_pool,
             body_pool,
+            header_mbuf_len: header_mbuf_size.saturating_sub(RTE_PKTMBUF_HEADROOM as usize),
         })
     }
 
     /// Converts a runtime buffer into a scatter-gather array.
     pub fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
+        memory::into_sgarray(buf)
+    }
 
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+    /// Returns the number of bytes that fit in a header mbuf.
+    pub fn header_mbuf_len(&self) -> usize {
+        self.header_mbuf_len
     }
 
     /// Allocates a header mbuf.
@@ -128,60 +123,38 @@ impl MemoryManager {
         Ok(unsafe { DemiBuffer::from_mbuf(mbuf_ptr) })
     }
 
-    /// Allocates a scatter-gather array.
+    /// Allocates a scatter-gather array. Sizes that do not fit in a single body mbuf get a chain of body mbufs.
     pub fn alloc_sgarray(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
+        let max_body_size: usize = self.config.get_max_body_size();
+        if size > DEMI_SGARRAY_MAXLEN * max_body_size {
+            return Err(Fail::new(libc::EINVAL, "size too large for a demi_sgarray_t"));
         }
 
         // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer = if size > self.config.get_inline_body_size() && size <= self.config.get_max_body_size() {
-            // Allocate a DPDK-managed buffer.
-            let mbuf_ptr: *mut rte_mbuf = self.body_pool.alloc_mbuf(Some(size))?;
-            // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
-            unsafe { DemiBuffer::from_mbuf(mbuf_ptr) }
+        let buf: DemiBuffer = if size > self.config.get_inline_body_size() {
+            // Allocate a chain of DPDK-managed buffers. If any allocation fails, dropping the chain releases the
+            // buffers that we got so far.
+            let mut buf: DemiBuffer = self.alloc_body_mbuf_with_len(size.min(max_body_size))?;
+            let mut remaining: usize = size - buf.len();
+            while remaining > 0 {
+                let segment: DemiBuffer = self.alloc_body_mbuf_with_len(remaining.min(max_body_size))?;
+                remaining -= segment.len();
+                buf.append(segment)?;
+            }
+            buf
         } else {
             // Allocate a heap-managed buffer.
             DemiBuffer::new(size as u16)
         };
 
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
         // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        memory::into_sgarray(buf)
     }
 
     /// Releases a scatter-gather array.
     pub fn free_sgarray(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
-
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
-        }
-
         // Convert back to a DemiBuffer and drop it.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
+        let buf: DemiBuffer = unsafe { memory::take_sgarray_buffer(&sga)? };
         drop(buf);
 
         Ok(())
@@ -189,61 +162,23 @@ impl MemoryManager {
 
     /// Clones a scatter-gather array into a DemiBuffer.
     pub fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
+        memory::clone_sgarray(sga)
+    }
 
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    /// Appends the segments of `tail` to `sga`. Buffer chains cannot mix heap-managed and DPDK-managed buffers, so if
+    /// only one of the scatter-gather arrays is backed by mbufs, the data of the other one is first copied to mbufs.
+    pub fn append_sgarray(&self, sga: &mut demi_sgarray_t, mut tail: demi_sgarray_t) -> Result<(), Fail> {
+        if sga.sga_numsegs as usize + tail.sga_numsegs as usize > DEMI_SGARRAY_MAXLEN {
+            return Err(Fail::new(libc::EINVAL, "too many segments for a demi_sgarray_t"));
         }
 
-        // Convert back to a DemiBuffer.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        let mut clone: DemiBuffer = buf.clone();
-
-        // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
-        mem::forget(buf);
-
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
-            }
-
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
-
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
-
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
+        match (Self::is_heap_sgarray(sga)?, Self::is_heap_sgarray(&tail)?) {
+            (true, false) => self.copy_sgarray_to_mbufs(sga)?,
+            (false, true) => self.copy_sgarray_to_mbufs(&mut tail)?,
+            _ => (),
         }
 
-        // Return the clone.
-        Ok(clone)
+        memory::append_sgarray(sga, tail)
     }
 
     /// Returns a raw pointer to the underlying body pool.
@@ -251,4 +186,26 @@ impl MemoryManager {
     pub fn body_pool(&self) -> *mut rte_mempool {
         self.body_pool.into_raw()
     }
+
+    /// Allocates a body mbuf that holds `len` bytes.
+    fn alloc_body_mbuf_with_len(&self, len: usize) -> Result<DemiBuffer, Fail> {
+        let mbuf_ptr: *mut rte_mbuf = self.body_pool.alloc_mbuf(Some(len))?;
+        // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
+        Ok(unsafe { DemiBuffer::from_mbuf(mbuf_ptr) })
+    }
+
+    /// Checks whether a scatter-gather array is backed by heap-managed buffers.
+    fn is_heap_sgarray(sga: &demi_sgarray_t) -> Result<bool, Fail> {
+        let buf: DemiBuffer = unsafe { memory::take_sgarray_buffer(sga)? };
+        let is_heap_allocated: bool = buf.is_heap_allocated();
+        // Don't drop buf, as the scatter-gather array keeps its reference.
+        mem::forget(buf);
+        Ok(is_heap_allocated)
+    }
+
+    /// Replaces the buffers of a scatter-gather array with body mbufs that hold a copy of their data. Segments keep
+    /// their offsets and lengths in the new buffers. On failure, the scatter-gather array is left untouched.
+    fn copy_sgarray_to_mbufs(&self, sga: &mut demi_sgarray_t) -> Result<(), Fail> {
+        memory::copy_sgarray(sga, |len| self.alloc_body_mbuf_with_len(len))
+    }
 }
@@ -92,3 +92,11 @@ impl MemoryPool {
         Ok(mbuf_ptr)
     }
 }
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Send Trait Implementation for Memory Pools
+// Safety: DPDK memory pools are thread-safe, so ownership of a pool may move to whichever thread claims it.
+unsafe impl Send for MemoryPool {}
@@ -51,4 +51,9 @@ impl MemoryRuntime for SharedDPDKRuntime {
     fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
         self.mm.clone_sgarray(sga)
     }
+
+    /// Appends a [demi_sgarray_t] to another one.
+    fn sgaappend(&self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        self.mm.append_sgarray(sga, tail)
+    }
 }
@@ -2,14 +2,18 @@
 // Licensed under the MIT license.
 
 pub mod memory;
+mod rss;
 
 //==============================================================================
 // Imports
 //==============================================================================
 
-use self::memory::{
-    consts::DEFAULT_MAX_BODY_SIZE,
-    MemoryManager,
+use self::{
+    memory::{
+        consts::DEFAULT_MAX_BODY_SIZE,
+        MemoryManager,
+    },
+    rss::RssConfig,
 };
 use crate::{
     demikernel::config::Config,
@@ -19,12 +23,18 @@ use crate::{
         libdpdk::{
             rte_delay_us_block,
             rte_eal_init,
+            rte_epoll_event,
+            rte_epoll_wait,
             rte_eth_conf,
             rte_eth_dev_configure,
             rte_eth_dev_count_avail,
             rte_eth_dev_get_mtu,
             rte_eth_dev_info_get,
             rte_eth_dev_is_valid_port,
+            rte_eth_dev_rss_reta_update,
+            rte_eth_dev_rx_intr_ctl_q,
+            rte_eth_dev_rx_intr_disable,
+            rte_eth_dev_rx_intr_enable,
             rte_eth_dev_set_mtu,
             rte_eth_dev_start,
             rte_eth_find_next_owned_by,
@@ -33,27 +43,39 @@ use crate::{
             rte_eth_macaddr_get,
             rte_eth_promiscuous_enable,
             rte_eth_rss_ip,
+            rte_eth_rss_reta_entry64,
+            rte_eth_rss_tcp,
+            rte_eth_rss_udp,
             rte_eth_rx_burst,
             rte_eth_rx_mq_mode_RTE_ETH_MQ_RX_RSS as RTE_ETH_MQ_RX_RSS,
             rte_eth_rx_offload_tcp_cksum,
             rte_eth_rx_offload_udp_cksum,
+            rte_eth_rx_queue_count,
             rte_eth_rx_queue_setup,
             rte_eth_rxconf,
             rte_eth_tx_burst,
             rte_eth_tx_mq_mode_RTE_ETH_MQ_TX_NONE as RTE_ETH_MQ_TX_NONE,
+            rte_eth_tx_offload_ipv4_cksum,
             rte_eth_tx_offload_multi_segs,
             rte_eth_tx_offload_tcp_cksum,
+            rte_eth_tx_offload_tcp_tso,
             rte_eth_tx_offload_udp_cksum,
+            rte_eth_tx_prepare,
             rte_eth_tx_queue_setup,
             rte_eth_txconf,
             rte_ether_addr,
             rte_mbuf,
-            rte_pktmbuf_chain,
+            rte_mbuf_set_tcp_tso,
+            rte_pktmbuf_free,
+            rte_pktmbuf_prepend,
+            RTE_EPOLL_PER_THREAD,
             RTE_ETHER_MAX_JUMBO_FRAME_LEN,
             RTE_ETHER_MAX_LEN,
             RTE_ETH_DEV_NO_OWNER,
             RTE_ETH_LINK_FULL_DUPLEX,
             RTE_ETH_LINK_UP,
+            RTE_ETH_RETA_GROUP_SIZE,
+            RTE_INTR_EVENT_ADD,
             RTE_PKTMBUF_HEADROOM,
         },
         memory::DemiBuffer,
@@ -63,11 +85,22 @@ use crate::{
                 TcpConfig,
                 UdpConfig,
             },
-            consts::RECEIVE_BATCH_SIZE,
+            consts::{
+                RECEIVE_BATCH_SIZE,
+                TRANSMIT_BATCH_SIZE,
+            },
             types::MacAddress,
             NetworkRuntime,
             PacketBuf,
+            SegmentationOffload,
         },
+        stats::{
+            with_stats,
+            ThreadStats,
+        },
+        IdleBlocker,
+        IdleWait,
+        SharedDemiRuntime,
         SharedObject,
     },
 };
@@ -79,14 +112,25 @@ use ::anyhow::{
     format_err,
     Error,
 };
+use ::libc::c_char;
 use ::std::{
+    cmp,
     ffi::CString,
     mem::MaybeUninit,
-    net::Ipv4Addr,
+    net::{
+        Ipv4Addr,
+        SocketAddrV4,
+    },
     ops::{
         Deref,
         DerefMut,
     },
+    ptr,
+    slice,
+    sync::{
+        Mutex,
+        MutexGuard,
+    },
     time::Duration,
 };
 
@@ -105,14 +149,50 @@ macro_rules! expect_zero {
     }};
 }
 
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Number of consecutive transmit attempts in which the network device accepts no packets before we give up on a
+/// flush and leave the remaining packets queued for the next one.
+const MAX_TRANSMIT_RETRIES: usize = 8;
+
+//==============================================================================
+// Static Variables
+//==============================================================================
+
+/// Network device state that is shared by all DPDK runtimes in this process. It is set up by the first runtime.
+static DPDK_PORT: Mutex<Option<DPDKPort>> = Mutex::new(None);
+
 //==============================================================================
 // Structures
 //==============================================================================
 
+/// Network device that is shared by all DPDK runtimes.
+struct DPDKPort {
+    port_id: u16,
+    link_addr: MacAddress,
+    rss_config: RssConfig,
+    /// Largest TCP segment that the network device cuts into MSS-sized segments, if TCP segmentation offload is enabled.
+    tcp_segmentation_offload: Option<usize>,
+    /// Memory managers of the queues that no runtime has claimed yet, indexed by queue.
+    memory_managers: Vec<Option<MemoryManager>>,
+    /// Whether receive interrupts are enabled on the network device.
+    rx_interrupts: bool,
+}
+
 /// DPDK Runtime
 pub struct DPDKRuntime {
     mm: MemoryManager,
     port_id: u16,
+    /// Receive/transmit queue pair that this runtime owns.
+    queue_id: u16,
+    /// Receive-side scaling configuration of the network device, used to find out which queue receives a flow.
+    rss_config: RssConfig,
+    /// Maximum number of packets that are taken from the receive queue at once.
+    rx_burst_size: u16,
+    /// Packets that are waiting to be handed to the network device in a single burst.
+    transmit_batch: ArrayVec<*mut rte_mbuf, TRANSMIT_BATCH_SIZE>,
     link_addr: MacAddress,
     ipv4_addr: Ipv4Addr,
     arp_config: ArpConfig,
@@ -123,21 +203,206 @@ pub struct DPDKRuntime {
 #[derive(Clone)]
 pub struct SharedDPDKRuntime(SharedObject<DPDKRuntime>);
 
+/// Blocks wait calls that have nothing to do on the receive interrupt of the queue of a runtime.
+struct DPDKIdleBlocker {
+    runtime: SharedDPDKRuntime,
+}
+
 //==============================================================================
 // Associate Functions
 //==============================================================================
 
 /// Associate Functions for DPDK Runtime
+impl DPDKRuntime {
+    /// Queues `mbuf_ptr` for transmission. The transmit batch is flushed right away if it is already full, and if the
+    /// network device still cannot take any packets, `mbuf_ptr` is dropped.
+    fn enqueue_mbuf(&mut self, mbuf_ptr: *mut rte_mbuf) {
+        if self.transmit_batch.is_full() {
+            self.flush_transmit_batch();
+        }
+
+        // Safety: `mbuf_ptr` is a valid MBuf pointer that we own.
+        let pkt_len: u32 = unsafe { (*mbuf_ptr).pkt_len };
+        match self.transmit_batch.try_push(mbuf_ptr) {
+            Ok(()) => with_stats(|s: &ThreadStats| {
+                s.tx_packets.incr();
+                s.tx_bytes.add(pkt_len as u64);
+            }),
+            Err(e) => {
+                warn!("enqueue_mbuf(): dropping packet because the transmit ring is full");
+                with_stats(|s: &ThreadStats| s.tx_drops.incr());
+                // Safety: rte_pktmbuf_free is a FFI that is safe to call, as we still own this valid MBuf pointer.
+                unsafe { rte_pktmbuf_free(e.element()) };
+            },
+        }
+    }
+
+    /// Queues `mbuf_ptr` for transmission, like [Self::enqueue_mbuf], but first asks the network device to cut it into
+    /// segments if `offload` says so.
+    fn enqueue_packet(&mut self, mbuf_ptr: *mut rte_mbuf, offload: Option<SegmentationOffload>) {
+        if let Some(offload) = offload {
+            // Safety: the following FFIs are safe to call, as `mbuf_ptr` is a valid MBuf pointer that we own and that
+            // holds the complete packet.
+            let num_prepared: u16 = unsafe {
+                rte_mbuf_set_tcp_tso(
+                    mbuf_ptr,
+                    offload.l2_len,
+                    offload.l3_len,
+                    offload.l4_len,
+                    offload.segment_size,
+                );
+                // Some devices need the headers to be fixed up (e.g. with a pseudo-header checksum) before segmentation.
+                let mut packets: [*mut rte_mbuf; 1] = [mbuf_ptr];
+                rte_eth_tx_prepare(self.port_id, self.queue_id, packets.as_mut_ptr(), 1)
+            };
+            if num_prepared != 1 {
+                let rte_errno: libc::c_int = unsafe { dpdk_rs::rte_errno() };
+                warn!(
+                    "enqueue_packet(): dropping packet that the network device cannot segment (rte_errno={:?})",
+                    rte_errno
+                );
+                with_stats(|s: &ThreadStats| s.tx_drops.incr());
+                // Safety: rte_pktmbuf_free is a FFI that is safe to call, as we still own this valid MBuf pointer.
+                unsafe { rte_pktmbuf_free(mbuf_ptr) };
+                return;
+            }
+        }
+        self.enqueue_mbuf(mbuf_ptr);
+    }
+
+    /// Copies `body` (which may itself be a chain) into a chain of body mbufs, as it may not fit in a single one. Fails
+    /// if the memory pool runs out of mbufs, in which case none of them are kept.
+    fn copy_into_body_mbufs(&self, body: &DemiBuffer) -> Result<DemiBuffer, Fail> {
+        let mut head: Option<DemiBuffer> = None;
+        for segment in body.segments() {
+            let mut offset: usize = 0;
+            while offset < segment.len() {
+                // Dropping the chain copied so far releases its mbufs.
+                let mut mbuf: DemiBuffer = self.mm.alloc_body_mbuf()?;
+                let len: usize = cmp::min(mbuf.len(), segment.len() - offset);
+                mbuf[..len].copy_from_slice(&segment[offset..(offset + len)]);
+                mbuf.trim(mbuf.len() - len).unwrap();
+                offset += len;
+
+                match head.as_mut() {
+                    Some(head) => head.append(mbuf)?,
+                    None => head = Some(mbuf),
+                }
+            }
+        }
+        Ok(head.expect("'body' should not be empty"))
+    }
+
+    /// Accounts for an outgoing packet that is dropped because the memory pool ran out of mbufs.
+    fn drop_on_exhaustion(cause: &Fail) {
+        warn!(
+            "transmit(): dropping packet because mbuf allocation failed: {:?}",
+            cause
+        );
+        with_stats(|s: &ThreadStats| {
+            s.mempool_exhausted.incr();
+            s.tx_drops.incr();
+        });
+    }
+
+    /// Hands off all queued packets to the network device. Partial sends are retried until the network device stops
+    /// accepting packets, in which case the unsent ones stay queued (in order) for the next flush.
+    fn flush_transmit_batch(&mut self) {
+        let mut num_sent: usize = 0;
+        let mut num_retries: usize = 0;
+        while num_sent < self.transmit_batch.len() {
+            let num_pending: u16 = (self.transmit_batch.len() - num_sent) as u16;
+            // Safety: rte_eth_tx_burst is a FFI that is safe to call, as all pending entries are valid MBuf pointers.
+            let count: u16 = unsafe {
+                let pending: *mut *mut rte_mbuf = self.transmit_batch.as_mut_ptr().add(num_sent);
+                rte_eth_tx_burst(self.port_id, self.queue_id, pending, num_pending)
+            };
+            num_sent += count as usize;
+            if count == 0 {
+                num_retries += 1;
+                if num_retries == MAX_TRANSMIT_RETRIES {
+                    debug!(
+                        "flush_transmit_batch(): transmit ring is full (pending={:?})",
+                        self.transmit_batch.len() - num_sent
+                    );
+                    break;
+                }
+            }
+        }
+        // The network device now owns the packets that it accepted.
+        self.transmit_batch.drain(..num_sent);
+    }
+}
+
+/// Associate Functions for Shared DPDK Runtime
 impl SharedDPDKRuntime {
-    pub fn new(config: Config) -> Result<Self, Fail> {
-        let (mm, port_id, link_addr) = Self::initialize_dpdk(
-            &config.eal_init_args(),
-            config.use_jumbo_frames(),
-            config.mtu()?,
-            config.tcp_checksum_offload(),
-            config.udp_checksum_offload(),
-        )
-        .unwrap();
+    /// Creates a DPDK runtime that owns the next free queue pair of the network device. The device itself is only
+    /// initialized by the first runtime in this process, and queues stay claimed until the process exits. If
+    /// spin-then-block waits are enabled, wait calls on `runtime` that run out of work block on the receive interrupt
+    /// of our queue.
+    pub fn new(config: Config, runtime: &mut SharedDemiRuntime) -> Result<Self, Fail> {
+        let spin_then_block: Option<Duration> = config.catnip_spin_then_block()?;
+        let mut dpdk_port: MutexGuard<Option<DPDKPort>> = match DPDK_PORT.lock() {
+            Ok(dpdk_port) => dpdk_port,
+            Err(_) => return Err(Fail::new(libc::EIO, "network device state is poisoned")),
+        };
+        if dpdk_port.is_none() {
+            match Self::initialize_dpdk(
+                &config.eal_init_args(),
+                config.use_jumbo_frames(),
+                config.mtu()?,
+                config.tcp_checksum_offload(),
+                config.udp_checksum_offload(),
+                config.tcp_segmentation_offload(),
+                config.num_queues()?,
+                spin_then_block.is_some(),
+            ) {
+                Ok(port) => *dpdk_port = Some(port),
+                Err(e) => {
+                    let cause: String = format!("failed to initialize DPDK: {:?}", e);
+                    error!("new(): {}", cause);
+                    return Err(Fail::new(libc::EIO, &cause));
+                },
+            }
+        }
+        let port: &mut DPDKPort = dpdk_port.as_mut().expect("network device should be initialized");
+
+        // Claim a queue.
+        let (queue_id, mm): (u16, MemoryManager) =
+            match port.memory_managers.iter_mut().enumerate().find(|(_, mm)| mm.is_some()) {
+                Some((queue_id, mm)) => (queue_id as u16, mm.take().expect("queue should not be claimed")),
+                None => return Err(Fail::new(libc::EAGAIN, "all queues of the network device are in use")),
+            };
+        let port_id: u16 = port.port_id;
+        let link_addr: MacAddress = port.link_addr;
+        let rss_config: RssConfig = port.rss_config.clone();
+        let tcp_segmentation_offload: Option<usize> = port.tcp_segmentation_offload;
+        let rx_interrupts: bool = port.rx_interrupts;
+        drop(dpdk_port);
+        debug!("new(): claimed queue {:?} of port {:?}", queue_id, port_id);
+
+        if rx_interrupts {
+            // Receive interrupts of our queue are delivered to the epoll instance of this thread, which is the one
+            // that runs us.
+            // Safety: rte_eth_dev_rx_intr_ctl_q is a FFI that is safe to call, as we own this queue of a started port.
+            let ret: libc::c_int = unsafe {
+                rte_eth_dev_rx_intr_ctl_q(
+                    port_id,
+                    queue_id,
+                    RTE_EPOLL_PER_THREAD,
+                    RTE_INTR_EVENT_ADD as libc::c_int,
+                    ptr::null_mut(),
+                )
+            };
+            if ret != 0 {
+                let cause: String = format!(
+                    "failed to register receive interrupt (queue={:?}, ret={:?})",
+                    queue_id, ret
+                );
+                error!("new(): {}", cause);
+                return Err(Fail::new(libc::EIO, &cause));
+            }
+        }
 
         let arp_config = ArpConfig::new(
             Some(Duration::from_secs(15)),
@@ -156,19 +421,34 @@ impl SharedDPDKRuntime {
             None,
             Some(config.tcp_checksum_offload()),
             Some(config.udp_checksum_offload()),
+            tcp_segmentation_offload,
+            Some(config.congestion_control("catnip")?),
         );
 
         let udp_config = UdpConfig::new(Some(config.udp_checksum_offload()), Some(config.udp_checksum_offload()));
 
-        Ok(Self(SharedObject::<DPDKRuntime>::new(DPDKRuntime {
+        let me: Self = Self(SharedObject::<DPDKRuntime>::new(DPDKRuntime {
             mm,
             port_id,
+            queue_id,
+            rss_config,
+            rx_burst_size: config.rx_burst_size()? as u16,
+            transmit_batch: ArrayVec::new(),
             link_addr,
             ipv4_addr: config.local_ipv4_addr(),
             arp_config,
             tcp_config,
             udp_config,
-        })))
+        }));
+
+        // Block wait calls that run out of work on the receive interrupt, if enabled.
+        if let Some(spin_time) = spin_then_block {
+            runtime.set_idle_wait(IdleWait::new(
+                spin_time,
+                Box::new(DPDKIdleBlocker { runtime: me.clone() }),
+            ));
+        }
+        Ok(me)
     }
 
     /// Initializes DPDK.
@@ -178,7 +458,10 @@ impl SharedDPDKRuntime {
         mtu: u16,
         tcp_checksum_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(MemoryManager, u16, MacAddress), Error> {
+        tcp_segmentation_offload: bool,
+        num_queues: u16,
+        rx_interrupts: bool,
+    ) -> Result<DPDKPort, Error> {
         std::env::set_var("MLX5_SHUT_UP_BF", "1");
         std::env::set_var("MLX5_SINGLE_THREADED", "1");
         std::env::set_var("MLX4_SINGLE_THREADED", "1");
@@ -200,17 +483,24 @@ impl SharedDPDKRuntime {
             DEFAULT_MAX_BODY_SIZE
         };
 
-        let memory_manager = MemoryManager::new(max_body_size)?;
+        // Each queue gets its own memory pools, so that runtimes do not contend on them.
+        let mut memory_managers: Vec<MemoryManager> = Vec::with_capacity(num_queues as usize);
+        for queue_id in 0..num_queues {
+            memory_managers.push(MemoryManager::new(queue_id, max_body_size)?);
+        }
 
         let owner: u64 = RTE_ETH_DEV_NO_OWNER as u64;
         let port_id: u16 = unsafe { rte_eth_find_next_owned_by(0, owner) as u16 };
-        Self::initialize_dpdk_port(
+        let (rss_config, tcp_segmentation_offload): (RssConfig, Option<usize>) = Self::initialize_dpdk_port(
             port_id,
-            &memory_manager,
+            &memory_managers,
             use_jumbo_frames,
             mtu,
             tcp_checksum_offload,
             udp_checksum_offload,
+            tcp_segmentation_offload,
+            rx_interrupts,
+            max_body_size - RTE_PKTMBUF_HEADROOM as usize,
         )?;
 
         // TODO: Where is this function?
@@ -228,20 +518,34 @@ impl SharedDPDKRuntime {
             Err(format_err!("Invalid mac address"))?;
         }
 
-        Ok((memory_manager, port_id, local_link_addr))
+        Ok(DPDKPort {
+            port_id,
+            link_addr: local_link_addr,
+            rss_config,
+            tcp_segmentation_offload,
+            memory_managers: memory_managers.into_iter().map(Some).collect(),
+            rx_interrupts,
+        })
     }
 
-    /// Initializes a DPDK port.
+    /// Initializes a DPDK port with one receive/transmit queue pair per memory manager. Incoming flows are spread
+    /// across receive queues with a symmetric RSS hash, whose configuration is returned. TCP segmentation offload is
+    /// enabled if requested and supported, in which case the largest segment that the device may be handed is returned
+    /// as well, given that bodies are chained in mbufs of `body_mbuf_len` bytes. Receive interrupts are enabled if
+    /// requested.
     fn initialize_dpdk_port(
         port_id: u16,
-        memory_manager: &MemoryManager,
+        memory_managers: &[MemoryManager],
         use_jumbo_frames: bool,
         mtu: u16,
         tcp_checksum_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(), Error> {
-        let rx_rings: u16 = 1;
-        let tx_rings: u16 = 1;
+        tcp_segmentation_offload: bool,
+        rx_interrupts: bool,
+        body_mbuf_len: usize,
+    ) -> Result<(RssConfig, Option<usize>), Error> {
+        let rx_rings: u16 = memory_managers.len() as u16;
+        let tx_rings: u16 = memory_managers.len() as u16;
         let rx_ring_size: u16 = 2048;
         let tx_ring_size: u16 = 2048;
         let nb_rxd: u16 = rx_ring_size;
@@ -262,6 +566,19 @@ impl SharedDPDKRuntime {
         };
 
         println!("dev_info: {:?}", dev_info);
+        if rx_rings > dev_info.max_rx_queues || tx_rings > dev_info.max_tx_queues {
+            bail!(
+                "Device supports at most {} rx and {} tx queues, but {} were requested",
+                dev_info.max_rx_queues,
+                dev_info.max_tx_queues,
+                rx_rings
+            );
+        }
+        if rx_rings > 1 && dev_info.reta_size == 0 {
+            bail!("Device has no RSS redirection table, so it cannot use multiple queues");
+        }
+        let mut rss_config: RssConfig = RssConfig::new(dev_info.hash_key_size as usize, dev_info.reta_size, rx_rings);
+
         let mut port_conf: rte_eth_conf = unsafe { MaybeUninit::zeroed().assume_init() };
         port_conf.rxmode.max_lro_pkt_size = if use_jumbo_frames {
             RTE_ETHER_MAX_JUMBO_FRAME_LEN
@@ -275,7 +592,19 @@ impl SharedDPDKRuntime {
             port_conf.rxmode.offloads |= unsafe { rte_eth_rx_offload_udp_cksum() as u64 };
         }
         port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
-        port_conf.rx_adv_conf.rss_conf.rss_hf = unsafe { rte_eth_rss_ip() as u64 } | dev_info.flow_type_rss_offloads;
+        port_conf.rx_adv_conf.rss_conf.rss_hf =
+            unsafe { (rte_eth_rss_ip() | rte_eth_rss_tcp() | rte_eth_rss_udp()) as u64 }
+                & dev_info.flow_type_rss_offloads;
+        if rx_rings > 1 {
+            // Replace the default key with a symmetric one, so that we can steer flows that we open to our own queue.
+            let rss_key: &mut Vec<u8> = rss_config.key_mut();
+            port_conf.rx_adv_conf.rss_conf.rss_key_len = rss_key.len() as u8;
+            port_conf.rx_adv_conf.rss_conf.rss_key = rss_key.as_mut_ptr();
+        }
+
+        if rx_interrupts {
+            port_conf.intr_conf.set_rxq(1);
+        }
 
         port_conf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
         if tcp_checksum_offload {
@@ -286,6 +615,24 @@ impl SharedDPDKRuntime {
         }
         port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_multi_segs() as u64 };
 
+        // The device has to fill in the IPv4 and TCP checksums of the segments that it cuts, and each segment that we
+        // hand to it is a chain of one header mbuf and as many body mbufs as the device takes.
+        let tso_offloads: u64 = unsafe {
+            (rte_eth_tx_offload_tcp_tso() | rte_eth_tx_offload_ipv4_cksum() | rte_eth_tx_offload_tcp_cksum()) as u64
+        };
+        let tcp_segmentation_offload: Option<usize> = if !tcp_segmentation_offload {
+            None
+        } else if !tcp_checksum_offload {
+            warn!("initialize_dpdk_port(): TCP segmentation offload requires TCP checksum offload");
+            None
+        } else if dev_info.tx_offload_capa & tso_offloads != tso_offloads || dev_info.tx_desc_lim.nb_seg_max < 2 {
+            warn!("initialize_dpdk_port(): device does not support TCP segmentation offload");
+            None
+        } else {
+            port_conf.txmode.offloads |= tso_offloads;
+            Some((dev_info.tx_desc_lim.nb_seg_max as usize - 1) * body_mbuf_len)
+        };
+
         let mut rx_conf: rte_eth_rxconf = unsafe { MaybeUninit::zeroed().assume_init() };
         rx_conf.rx_thresh.pthresh = rx_pthresh;
         rx_conf.rx_thresh.hthresh = rx_hthresh;
@@ -307,6 +654,25 @@ impl SharedDPDKRuntime {
             ))?;
         }
 
+        if rx_rings > 1 {
+            // Spread the redirection table evenly across receive queues, as expected by the RSS configuration.
+            let group_size: usize = RTE_ETH_RETA_GROUP_SIZE as usize;
+            let num_groups: usize = (dev_info.reta_size as usize + group_size - 1) / group_size;
+            let mut reta_conf: Vec<rte_eth_rss_reta_entry64> = vec![unsafe { mem::zeroed() }; num_groups];
+            for index in 0..dev_info.reta_size {
+                let entry: &mut rte_eth_rss_reta_entry64 = &mut reta_conf[index as usize / group_size];
+                entry.mask |= 1 << (index as usize % group_size);
+                entry.reta[index as usize % group_size] = rss_config.reta_entry(index);
+            }
+            unsafe {
+                expect_zero!(rte_eth_dev_rss_reta_update(
+                    port_id,
+                    reta_conf.as_mut_ptr(),
+                    dev_info.reta_size
+                ))?;
+            }
+        }
+
         unsafe {
             expect_zero!(rte_eth_dev_set_mtu(port_id, mtu))?;
             let mut dpdk_mtu: u16 = 0u16;
@@ -326,7 +692,7 @@ impl SharedDPDKRuntime {
                     nb_rxd,
                     socket_id,
                     &rx_conf as *const _,
-                    memory_manager.body_pool(),
+                    memory_managers[i as usize].body_pool(),
                 ))?;
             }
             for i in 0..tx_rings {
@@ -374,7 +740,7 @@ impl SharedDPDKRuntime {
             retry_count -= 1;
         }
 
-        Ok(())
+        Ok((rss_config, tcp_segmentation_offload))
     }
 
     pub fn get_link_addr(&self) -> MacAddress {
@@ -402,6 +768,49 @@ impl SharedDPDKRuntime {
 // Trait Implementations
 //==============================================================================
 
+/// Drop Trait Implementation for DPDK Runtime
+impl Drop for DPDKRuntime {
+    fn drop(&mut self) {
+        self.flush_transmit_batch();
+        for mbuf_ptr in self.transmit_batch.drain(..) {
+            // Safety: rte_pktmbuf_free is a FFI that is safe to call, as we still own this valid MBuf pointer.
+            unsafe { rte_pktmbuf_free(mbuf_ptr) };
+        }
+    }
+}
+
+impl IdleBlocker for DPDKIdleBlocker {
+    fn block(&mut self, timeout: Duration) {
+        // Packets that are still queued for transmission should not wait for us to wake up.
+        self.runtime.flush();
+
+        let port_id: u16 = self.runtime.port_id;
+        let queue_id: u16 = self.runtime.queue_id;
+        // Round up, so that we do not wake up before the timeout just to spin until it.
+        let timeout_ms: libc::c_int =
+            cmp::min((timeout.as_micros() + 999) / 1000, libc::c_int::MAX as u128) as libc::c_int;
+        // Safety: the following FFIs are safe to call, as we own this queue and registered its receive interrupt with
+        // the epoll instance of this thread.
+        unsafe {
+            let ret: libc::c_int = rte_eth_dev_rx_intr_enable(port_id, queue_id);
+            if ret != 0 {
+                warn!("block(): failed to enable receive interrupt (ret={:?})", ret);
+                return;
+            }
+            // A packet that arrived after our last poll but before the interrupt was armed raises no interrupt, so look
+            // for one before waiting. Devices that cannot count received packets (negative return value) may still
+            // hold one until we time out, which the idle policy bounds.
+            if rte_eth_rx_queue_count(port_id, queue_id) <= 0 {
+                let mut event: rte_epoll_event = mem::zeroed();
+                if rte_epoll_wait(RTE_EPOLL_PER_THREAD, &mut event, 1, timeout_ms) < 0 {
+                    warn!("block(): failed to wait for receive interrupt");
+                }
+            }
+            rte_eth_dev_rx_intr_disable(port_id, queue_id);
+        }
+    }
+}
+
 impl Deref for SharedDPDKRuntime {
     type Target = DPDKRuntime;
 
@@ -423,91 +832,105 @@ impl DerefMut for SharedDPDKRuntime {
 /// Network Runtime Trait Implementation for DPDK Runtime
 impl NetworkRuntime for SharedDPDKRuntime {
     fn transmit(&mut self, buf: Box<dyn PacketBuf>) {
-        // TODO: Consider an important optimization here: If there is data in this packet (i.e. not just headers), and
-        // that data is in a DPDK-owned mbuf, and there is "headroom" in that mbuf to hold the packet headers, just
-        // prepend the headers into that mbuf and save the extra header mbuf allocation that we currently always do.
-
-        // TODO: cleanup unwrap() and expect() from this code when this function returns a Result.
+        // TODO: cleanup unwrap() and expect() from this code when this function returns a Result. Until then, packets
+        // that we run out of mbufs for are dropped, like the network would.
 
-        // Alloc header mbuf, check header size.
-        // Serialize header.
         // Decide if we can inline the data --
-        //   1) How much space is left?
+        //   1) How much space is left in a header mbuf?
         //   2) Is the body small enough?
         // If we can inline, copy and return.
         // If we can't inline...
         //   1) See if the body is managed => take
         //   2) Not managed => alloc body
-        // Chain body buffer.
-
-        // First, allocate a header mbuf and write the header into it.
-        let mut header_mbuf: DemiBuffer = match self.mm.alloc_header_mbuf() {
-            Ok(mbuf) => mbuf,
-            Err(e) => panic!("failed to allocate header mbuf: {:?}", e.cause),
-        };
-        let header_size = buf.header_size();
-        assert!(header_size <= header_mbuf.len());
-        buf.write_header(&mut header_mbuf[..header_size]);
+        // Prepend the header to the body buffer if we are its only user, otherwise chain it in a header mbuf.
+        let header_size: usize = buf.header_size();
+        let offload: Option<SegmentationOffload> = buf.segmentation_offload();
 
         if let Some(body) = buf.take_body() {
-            // Next, see how much space we have remaining and inline the body if we have room.
-            let inline_space = header_mbuf.len() - header_size;
-
             // Chain a buffer.
-            if body.len() > inline_space {
-                assert!(header_size + body.len() >= MIN_PAYLOAD_SIZE);
-
-                // We're only using the header_mbuf for, well, the header.
-                header_mbuf.trim(header_mbuf.len() - header_size).unwrap();
+            let body_len: usize = body.total_len();
+            if body_len > self.mm.header_mbuf_len().saturating_sub(header_size) {
+                assert!(header_size + body_len >= MIN_PAYLOAD_SIZE);
+
+                // Get the body. A buffer chain goes out as a chain of mbufs.
+                let body: DemiBuffer = if body.is_dpdk_allocated() {
+                    // The body is already stored in an MBuf.
+                    body
+                } else {
+                    // The body is not dpdk-allocated, allocate DPDKBuffers and copy the body into them.
+                    match self.copy_into_body_mbufs(&body) {
+                        Ok(body) => body,
+                        Err(e) => return DPDKRuntime::drop_on_exhaustion(&e),
+                    }
+                };
 
-                // Get the body mbuf.
-                let body_mbuf: *mut rte_mbuf = if body.is_dpdk_allocated() {
-                    // The body is already stored in an MBuf, just extract it from the DemiBuffer.
-                    body.into_mbuf().expect("'body' should be DPDK-allocated")
+                // Write the header straight into the headroom of the body if no one else can see that memory. This is
+                // the case for bodies copied above. Bodies pushed from a scatter-gather array are still held by the
+                // application, and by the retransmission queue for TCP, so they keep a separate header mbuf.
+                if body.private_headroom() >= header_size {
+                    let body_mbuf: *mut rte_mbuf = body.into_mbuf().expect("'body' should be DPDK-allocated");
+                    // Safety: `body_mbuf` has enough headroom for the header, so rte_pktmbuf_prepend() returns a valid
+                    // pointer to `header_size` writable bytes that nobody else references.
+                    let header: &mut [u8] = unsafe {
+                        let header_ptr: *mut c_char = rte_pktmbuf_prepend(body_mbuf, header_size as u16);
+                        slice::from_raw_parts_mut(header_ptr as *mut u8, header_size)
+                    };
+                    buf.write_header(header);
+                    self.enqueue_packet(body_mbuf, offload);
                 } else {
-                    // The body is not dpdk-allocated, allocate a DPDKBuffer and copy the body into it.
-                    let mut mbuf: DemiBuffer = match self.mm.alloc_body_mbuf() {
+                    // Allocate a header mbuf and write the header into it. On failure, dropping the body releases it.
+                    let mut header_mbuf: DemiBuffer = match self.mm.alloc_header_mbuf() {
                         Ok(mbuf) => mbuf,
-                        Err(e) => panic!("failed to allocate body mbuf: {:?}", e.cause),
+                        Err(e) => return DPDKRuntime::drop_on_exhaustion(&e),
                     };
-                    assert!(mbuf.len() >= body.len());
-                    mbuf[..body.len()].copy_from_slice(&body[..]);
-                    mbuf.trim(mbuf.len() - body.len()).unwrap();
-                    mbuf.into_mbuf().expect("mbuf should not be empty")
-                };
+                    assert!(header_size <= header_mbuf.len());
+                    buf.write_header(&mut header_mbuf[..header_size]);
 
-                let mut header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf should not be empty");
-                // Safety: rte_pktmbuf_chain is a FFI that is safe to call as both of its args are valid MBuf pointers.
-                unsafe {
-                    // Attach the body MBuf onto the header MBuf's buffer chain.
-                    assert_eq!(rte_pktmbuf_chain(header_mbuf_ptr, body_mbuf), 0);
+                    // We're only using the header_mbuf for, well, the header.
+                    header_mbuf.trim(header_mbuf.len() - header_size).unwrap();
+
+                    // Attach the body onto the header's buffer chain.
+                    header_mbuf.append(body).expect("body chain should fit in a packet");
+                    let header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf should not be empty");
+                    self.enqueue_packet(header_mbuf_ptr, offload);
                 }
-                let num_sent = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut header_mbuf_ptr, 1) };
-                assert_eq!(num_sent, 1);
             }
             // Otherwise, write in the inline space.
             else {
-                let body_buf = &mut header_mbuf[header_size..(header_size + body.len())];
-                body_buf.copy_from_slice(&body[..]);
+                let mut header_mbuf: DemiBuffer = match self.mm.alloc_header_mbuf() {
+                    Ok(mbuf) => mbuf,
+                    Err(e) => return DPDKRuntime::drop_on_exhaustion(&e),
+                };
+                assert!(header_size + body_len <= header_mbuf.len());
+                buf.write_header(&mut header_mbuf[..header_size]);
+
+                let body_buf = &mut header_mbuf[header_size..(header_size + body_len)];
+                body.copy_to_slice(body_buf);
 
-                if header_size + body.len() < MIN_PAYLOAD_SIZE {
-                    let padding_bytes = MIN_PAYLOAD_SIZE - (header_size + body.len());
-                    let padding_buf = &mut header_mbuf[(header_size + body.len())..][..padding_bytes];
+                if header_size + body_len < MIN_PAYLOAD_SIZE {
+                    let padding_bytes = MIN_PAYLOAD_SIZE - (header_size + body_len);
+                    let padding_buf = &mut header_mbuf[(header_size + body_len)..][..padding_bytes];
                     for byte in padding_buf {
                         *byte = 0;
                     }
                 }
 
-                let frame_size = std::cmp::max(header_size + body.len(), MIN_PAYLOAD_SIZE);
+                let frame_size = std::cmp::max(header_size + body_len, MIN_PAYLOAD_SIZE);
                 header_mbuf.trim(header_mbuf.len() - frame_size).unwrap();
 
-                let mut header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
-                let num_sent = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut header_mbuf_ptr, 1) };
-                assert_eq!(num_sent, 1);
+                let header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
+                self.enqueue_packet(header_mbuf_ptr, offload);
             }
         }
         // No body on our packet, just send the headers.
         else {
+            let mut header_mbuf: DemiBuffer = match self.mm.alloc_header_mbuf() {
+                Ok(mbuf) => mbuf,
+                Err(e) => return DPDKRuntime::drop_on_exhaustion(&e),
+            };
+            assert!(header_size <= header_mbuf.len());
+            buf.write_header(&mut header_mbuf[..header_size]);
+
             if header_size < MIN_PAYLOAD_SIZE {
                 let padding_bytes = MIN_PAYLOAD_SIZE - header_size;
                 let padding_buf = &mut header_mbuf[header_size..][..padding_bytes];
@@ -517,9 +940,14 @@ impl NetworkRuntime for SharedDPDKRuntime {
             }
             let frame_size = std::cmp::max(header_size, MIN_PAYLOAD_SIZE);
             header_mbuf.trim(header_mbuf.len() - frame_size).unwrap();
-            let mut header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
-            let num_sent = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut header_mbuf_ptr, 1) };
-            assert_eq!(num_sent, 1);
+            let header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
+            self.enqueue_mbuf(header_mbuf_ptr);
+        }
+    }
+
+    fn flush(&mut self) {
+        if !self.transmit_batch.is_empty() {
+            self.flush_transmit_batch();
         }
     }
 
@@ -527,8 +955,8 @@ impl NetworkRuntime for SharedDPDKRuntime {
         let mut out = ArrayVec::new();
 
         let mut packets: [*mut rte_mbuf; RECEIVE_BATCH_SIZE] = unsafe { mem::zeroed() };
-        let nb_rx = unsafe { rte_eth_rx_burst(self.port_id, 0, packets.as_mut_ptr(), RECEIVE_BATCH_SIZE as u16) };
-        assert!(nb_rx as usize <= RECEIVE_BATCH_SIZE);
+        let nb_rx = unsafe { rte_eth_rx_burst(self.port_id, self.queue_id, packets.as_mut_ptr(), self.rx_burst_size) };
+        assert!(nb_rx <= self.rx_burst_size);
 
         {
             for &packet in &packets[..nb_rx as usize] {
@@ -541,6 +969,10 @@ impl NetworkRuntime for SharedDPDKRuntime {
         out
     }
 
+    fn receives_flow(&self, local: SocketAddrV4, remote: SocketAddrV4) -> bool {
+        self.rss_config.queue_of(local, remote) == self.queue_id
+    }
+
     fn get_arp_config(&self) -> ArpConfig {
         self.arp_config.clone()
     }
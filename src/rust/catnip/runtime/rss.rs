@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use ::std::net::SocketAddrV4;
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Pattern that is repeated across the whole RSS hash key. A key built this way makes the Toeplitz hash symmetric, so
+/// both directions of a flow land on the same queue (see "Scalable TCP Session Monitoring with Symmetric Receive-side
+/// Scaling", Woo and Park).
+const SYMMETRIC_RSS_KEY_PATTERN: [u8; 2] = [0x6d, 0x5a];
+
+/// Key length used when the network device does not report one.
+pub const DEFAULT_RSS_KEY_SIZE: usize = 40;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Receive-side scaling configuration that we program in the network device, and that we mirror in software to find
+/// out which queue receives a given flow.
+#[derive(Clone, Debug)]
+pub struct RssConfig {
+    /// Hash key.
+    key: Vec<u8>,
+    /// Number of entries in the redirection table.
+    reta_size: u16,
+    /// Number of receive queues that are spread across the redirection table.
+    num_queues: u16,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for RSS Configuration
+impl RssConfig {
+    /// Creates a symmetric RSS configuration. Entry `i` of the redirection table points to queue `i % num_queues`.
+    pub fn new(key_size: usize, reta_size: u16, num_queues: u16) -> Self {
+        let key_size: usize = if key_size == 0 { DEFAULT_RSS_KEY_SIZE } else { key_size };
+        let key: Vec<u8> = (0..key_size)
+            .map(|i| SYMMETRIC_RSS_KEY_PATTERN[i % SYMMETRIC_RSS_KEY_PATTERN.len()])
+            .collect();
+        Self {
+            key,
+            reta_size,
+            num_queues,
+        }
+    }
+
+    /// Returns a mutable reference to the hash key, as it is expected by the network device.
+    pub fn key_mut(&mut self) -> &mut Vec<u8> {
+        &mut self.key
+    }
+
+    /// Returns the queue that entry `index` of the redirection table points to.
+    pub fn reta_entry(&self, index: u16) -> u16 {
+        index % self.num_queues
+    }
+
+    /// Returns the queue that receives packets sent from `remote` to `local`.
+    pub fn queue_of(&self, local: SocketAddrV4, remote: SocketAddrV4) -> u16 {
+        if self.num_queues == 1 || self.reta_size == 0 {
+            return 0;
+        }
+
+        // The hash input of TCP and UDP packets is: source address, destination address, source port, destination port.
+        let mut input: [u8; 12] = [0; 12];
+        input[0..4].copy_from_slice(&remote.ip().octets());
+        input[4..8].copy_from_slice(&local.ip().octets());
+        input[8..10].copy_from_slice(&remote.port().to_be_bytes());
+        input[10..12].copy_from_slice(&local.port().to_be_bytes());
+
+        let hash: u32 = self.toeplitz_hash(&input);
+        self.reta_entry((hash % self.reta_size as u32) as u16)
+    }
+
+    /// Computes the Toeplitz hash of `input`.
+    fn toeplitz_hash(&self, input: &[u8]) -> u32 {
+        let key_bit = |i: usize| -> u32 { ((self.key[(i / 8) % self.key.len()] >> (7 - (i % 8))) & 1) as u32 };
+
+        // Sliding window over the key, which starts at its first 32 bits.
+        let mut window: u32 = (0..32).fold(0, |window, i| (window << 1) | key_bit(i));
+        let mut hash: u32 = 0;
+        for (i, byte) in input.iter().enumerate() {
+            for bit in 0..8 {
+                if byte & (0x80 >> bit) != 0 {
+                    hash ^= window;
+                }
+                window = (window << 1) | key_bit(32 + i * 8 + bit);
+            }
+        }
+
+        hash
+    }
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::RssConfig;
+    use ::anyhow::Result;
+    use ::std::net::{
+        Ipv4Addr,
+        SocketAddrV4,
+    };
+
+    /// Checks that both directions of a flow map to the same queue.
+    #[test]
+    fn symmetric_queue_lookup() -> Result<()> {
+        let rss: RssConfig = RssConfig::new(0, 512, 4);
+        let a: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 49152);
+        for port in 1..1024 {
+            let b: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(10, 0, 0, 7), port);
+            crate::ensure_eq!(rss.queue_of(a, b), rss.queue_of(b, a));
+        }
+        Ok(())
+    }
+
+    /// Checks that flows are spread across all queues.
+    #[test]
+    fn queue_lookup_covers_all_queues() -> Result<()> {
+        let rss: RssConfig = RssConfig::new(0, 512, 4);
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+        let mut hits: [usize; 4] = [0; 4];
+        for port in 49152..50176 {
+            let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(10, 0, 0, 7), port);
+            hits[rss.queue_of(local, remote) as usize] += 1;
+        }
+        ::anyhow::ensure!(
+            hits.iter().all(|&count| count > 0),
+            "some queues receive no flows: {:?}",
+            hits
+        );
+        Ok(())
+    }
+}
@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use super::rawsocket::PACKET_RING_FRAMES_PER_BLOCK;
+use crate::{
+    demikernel::config::Config,
+    runtime::fail::Fail,
+};
+use ::yaml_rust::Yaml;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Name for the libos in configs.
+const LIBOS: &str = "catpowder";
+
+/// Largest number of frames that we map for each of the receive and transmit rings.
+const PACKET_MMAP_MAX_NUM_FRAMES: i64 = 65536;
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Catpowder-specific configuration for Demikernel configuration object.
+impl Config {
+    /// Reads memory-mapped packet ring settings from the "packet_mmap" subsection. Returned value is Some(number of
+    /// frames in each ring) if enabled; otherwise, None. The number of frames must be a multiple of
+    /// [PACKET_RING_FRAMES_PER_BLOCK]. A missing subsection disables packet rings.
+    pub fn catpowder_packet_mmap(&self) -> Result<Option<u32>, Fail> {
+        const SECTION: &str = "packet_mmap";
+        let section: &Yaml = &self.0[LIBOS][SECTION];
+        if section.is_badvalue() {
+            return Ok(None);
+        }
+
+        let enabled: bool = match section["enabled"].as_bool() {
+            Some(enabled) => enabled,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"enabled\" has unexpected type")),
+        };
+        let num_frames: i64 = match section["num_frames"].as_i64() {
+            Some(num_frames) if num_frames > 0 && num_frames <= PACKET_MMAP_MAX_NUM_FRAMES => num_frames,
+            Some(_) => return Err(Fail::new(libc::ERANGE, "parameter \"num_frames\" is out of range")),
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"num_frames\" has unexpected type")),
+        };
+        if num_frames % PACKET_RING_FRAMES_PER_BLOCK as i64 != 0 {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "parameter \"num_frames\" is not a multiple of the frames per block",
+            ));
+        }
+
+        if enabled {
+            Ok(Some(num_frames as u32))
+        } else {
+            Ok(None)
+        }
+    }
+}
@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod config;
 mod network;
 mod rawsocket;
 
@@ -9,6 +10,7 @@ mod rawsocket;
 //==============================================================================
 
 use self::rawsocket::{
+    PacketRing,
     RawSocket,
     RawSocketAddr,
 };
@@ -25,6 +27,7 @@ use crate::{
             types::MacAddress,
         },
         Runtime,
+        SharedObject,
     },
 };
 use ::std::{
@@ -49,6 +52,8 @@ pub struct LinuxRuntime {
     ipv4_addr: Ipv4Addr,
     ifindex: i32,
     socket: RawSocket,
+    /// Memory-mapped packet rings, if enabled. Otherwise, packets are sent and received one at a time.
+    ring: Option<SharedObject<PacketRing>>,
 }
 
 //==============================================================================
@@ -71,17 +76,41 @@ impl LinuxRuntime {
         let mac_addr: [u8; 6] = [0; 6];
         let ifindex: i32 = Self::get_ifindex(&config.local_interface_name()).expect("could not parse ifindex");
         let socket: RawSocket = RawSocket::new().expect("could not create raw socket");
+        let ring: Option<SharedObject<PacketRing>> =
+            match config.catpowder_packet_mmap().expect("invalid packet ring settings") {
+                Some(num_frames) => Some(SharedObject::new(
+                    PacketRing::new(&socket, num_frames).expect("could not set up packet rings"),
+                )),
+                None => None,
+            };
         let sockaddr: RawSocketAddr = RawSocketAddr::new(ifindex, &mac_addr);
         socket.bind(&sockaddr).expect("could not bind raw socket");
+        let tcp_config: TcpConfig = TcpConfig::new(
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            Some(
+                config
+                    .congestion_control("catpowder")
+                    .expect("invalid congestion control algorithm"),
+            ),
+        );
 
         Self {
-            tcp_config: TcpConfig::default(),
+            tcp_config,
             udp_config: UdpConfig::default(),
             arp_config,
             link_addr: config.local_link_addr(),
             ipv4_addr: config.local_ipv4_addr(),
             ifindex,
             socket,
+            ring,
         }
     }
 
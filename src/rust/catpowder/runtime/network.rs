@@ -24,6 +24,10 @@ use crate::{
             NetworkRuntime,
             PacketBuf,
         },
+        stats::{
+            with_stats,
+            ThreadStats,
+        },
     },
 };
 use ::arrayvec::ArrayVec;
@@ -43,12 +47,30 @@ impl NetworkRuntime for LinuxRuntime {
         let header_size: usize = pkt.header_size();
         let body_size: usize = pkt.body_size();
 
+        // Write the packet straight into the transmit ring, if we have one.
+        if let Some(ring) = self.ring.as_mut() {
+            let write = |frame: &mut [u8]| {
+                pkt.write_header(&mut frame[..header_size]);
+                if let Some(body) = pkt.take_body() {
+                    body.copy_to_slice(&mut frame[header_size..]);
+                }
+            };
+            match ring.transmit(header_size + body_size, write) {
+                Ok(()) => count_transmit(header_size + body_size),
+                Err(e) => {
+                    warn!("dropping packet: {:?}", e);
+                    with_stats(|s: &ThreadStats| s.tx_drops.incr());
+                },
+            }
+            return;
+        }
+
         assert!(header_size + body_size < u16::MAX as usize);
         let mut buf: DemiBuffer = DemiBuffer::new((header_size + body_size) as u16);
 
         pkt.write_header(&mut buf[..header_size]);
         if let Some(body) = pkt.take_body() {
-            buf[header_size..].copy_from_slice(&body[..]);
+            body.copy_to_slice(&mut buf[header_size..]);
         }
 
         let (header, _) = Ethernet2Header::parse(buf.clone()).unwrap();
@@ -58,15 +80,29 @@ impl NetworkRuntime for LinuxRuntime {
         // Send packet.
         match self.socket.sendto(&buf, &dest_sockaddr) {
             // Operation succeeded.
-            Ok(_) => (),
+            Ok(_) => count_transmit(buf.len()),
             // Operation failed, drop packet.
-            Err(e) => warn!("dropping packet: {:?}", e),
+            Err(e) => {
+                warn!("dropping packet: {:?}", e);
+                with_stats(|s: &ThreadStats| s.tx_drops.incr());
+            },
         };
     }
 
+    /// Hands off to the kernel the packets that were written to the transmit ring.
+    fn flush(&mut self) {
+        if let Some(ring) = self.ring.as_mut() {
+            ring.flush();
+        }
+    }
+
     /// Receives a batch of [DemiBuffer].
-    // TODO: This routine currently only tries to receive a single packet buffer, not a batch of them.
+    // TODO: Without packet rings, this routine only tries to receive a single packet buffer, not a batch of them.
     fn receive(&mut self) -> ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> {
+        if let Some(ring) = self.ring.as_mut() {
+            return ring.receive();
+        }
+
         // TODO: This routine contains an extra copy of the entire incoming packet that could potentially be removed.
 
         // TODO: change this function to operate directly on DemiBuffer rather than on MaybeUninit<u8>.
@@ -103,3 +139,15 @@ impl NetworkRuntime for LinuxRuntime {
         self.udp_config.clone()
     }
 }
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Accounts for a packet of `len` bytes that the kernel accepted for transmission.
+fn count_transmit(len: usize) {
+    with_stats(|s: &ThreadStats| {
+        s.tx_packets.incr();
+        s.tx_bytes.add(len as u64);
+    });
+}
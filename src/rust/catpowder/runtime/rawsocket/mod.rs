@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod packetring;
 mod rawsockaddr;
 mod rawsocket;
 
@@ -8,5 +9,9 @@ mod rawsocket;
 // Exports
 //======================================================================================================================
 
+pub use packetring::{
+    PacketRing,
+    PACKET_RING_FRAMES_PER_BLOCK,
+};
 pub use rawsockaddr::RawSocketAddr;
 pub use rawsocket::RawSocket;
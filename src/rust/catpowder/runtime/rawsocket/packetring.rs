@@ -0,0 +1,538 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Memory-mapped packet rings (PACKET_MMAP) for raw sockets.
+//!
+//! The kernel and the runtime exchange frames through a receive ring and a transmit ring that are shared between them,
+//! and each frame carries a status word that tells which side owns it. Received frames are picked up without any
+//! system call, and frames that are written to the transmit ring are handed off to the kernel all at once, with a
+//! single `sendto()` per flush.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use super::RawSocket;
+use crate::runtime::{
+    fail::Fail,
+    memory::DemiBuffer,
+    network::consts::RECEIVE_BATCH_SIZE,
+    stats::{
+        with_stats,
+        ThreadStats,
+    },
+};
+use ::arrayvec::ArrayVec;
+use ::std::{
+    mem,
+    slice,
+    sync::atomic::{
+        AtomicU32,
+        Ordering,
+    },
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of frames in each block of a packet ring.
+pub const PACKET_RING_FRAMES_PER_BLOCK: u32 = 8;
+
+/// Size of a frame in a packet ring. Frames are large enough to hold the biggest packet that we receive, along with the
+/// headers that the kernel writes in front of it.
+const PACKET_RING_FRAME_SIZE: usize = 16384;
+
+/// Offset of packet data in a frame of the transmit ring.
+const TX_DATA_OFFSET: usize = libc::TPACKET2_HDRLEN - mem::size_of::<libc::sockaddr_ll>();
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A ring of frames in the memory that is shared with the kernel.
+struct Ring {
+    /// First frame of the ring.
+    base: *mut u8,
+    /// Number of frames in the ring.
+    num_frames: u32,
+    /// Index of the next frame to be used.
+    head: u32,
+}
+
+/// Receive and transmit packet rings of a raw socket.
+pub struct PacketRing {
+    socket: RawSocket,
+    /// Memory that is shared with the kernel. The receive ring comes first, followed by the transmit ring.
+    mapping: *mut u8,
+    mapping_len: usize,
+    rx: Ring,
+    tx: Ring,
+    /// Number of frames in the transmit ring that were not handed off to the kernel yet.
+    tx_pending: u32,
+}
+
+//======================================================================================================================
+// Associate Functions
+//======================================================================================================================
+
+impl Ring {
+    /// Returns the header of the next frame to be used.
+    fn head_frame(&self) -> *mut libc::tpacket2_hdr {
+        // Safety: the head index is always in bounds of the ring.
+        unsafe { self.base.add(self.head as usize * PACKET_RING_FRAME_SIZE) as *mut libc::tpacket2_hdr }
+    }
+
+    /// Moves on to the next frame.
+    fn advance(&mut self) {
+        self.head = (self.head + 1) % self.num_frames;
+    }
+}
+
+/// Associated functions for packet rings.
+impl PacketRing {
+    /// Sets up receive and transmit packet rings of `num_frames` frames each for `socket`. This should be done before
+    /// the socket is bound.
+    pub fn new(socket: &RawSocket, num_frames: u32) -> Result<Self, Fail> {
+        if num_frames == 0 || num_frames % PACKET_RING_FRAMES_PER_BLOCK != 0 {
+            return Err(Fail::new(libc::EINVAL, "invalid number of frames for packet ring"));
+        }
+
+        // Unlike TPACKET_V3 blocks, TPACKET_V2 frames are handed to us as soon as they are filled, so they do not add
+        // any latency in a runtime that polls.
+        let version: libc::c_int = libc::tpacket_versions::TPACKET_V2 as libc::c_int;
+        socket.set_packet_option(libc::PACKET_VERSION, &version)?;
+
+        // Have the kernel skip frames that it cannot transmit, instead of stalling the transmit ring.
+        let loss: libc::c_int = 1;
+        socket.set_packet_option(libc::PACKET_LOSS, &loss)?;
+
+        let req: libc::tpacket_req = libc::tpacket_req {
+            tp_block_size: (PACKET_RING_FRAME_SIZE as u32) * PACKET_RING_FRAMES_PER_BLOCK,
+            tp_block_nr: num_frames / PACKET_RING_FRAMES_PER_BLOCK,
+            tp_frame_size: PACKET_RING_FRAME_SIZE as u32,
+            tp_frame_nr: num_frames,
+        };
+        socket.set_packet_option(libc::PACKET_RX_RING, &req)?;
+        socket.set_packet_option(libc::PACKET_TX_RING, &req)?;
+
+        let ring_len: usize = num_frames as usize * PACKET_RING_FRAME_SIZE;
+        let mapping_len: usize = 2 * ring_len;
+        let mapping: *mut u8 = socket.mmap(mapping_len)?;
+
+        Ok(Self {
+            socket: socket.clone(),
+            mapping,
+            mapping_len,
+            rx: Ring {
+                base: mapping,
+                num_frames,
+                head: 0,
+            },
+            tx: Ring {
+                // Safety: the transmit ring is mapped right after the receive ring.
+                base: unsafe { mapping.add(ring_len) },
+                num_frames,
+                head: 0,
+            },
+            tx_pending: 0,
+        })
+    }
+
+    /// Returns the size of the largest packet that fits in a frame of the transmit ring.
+    pub fn max_transmit_len(&self) -> usize {
+        PACKET_RING_FRAME_SIZE - TX_DATA_OFFSET
+    }
+
+    /// Writes a packet of `len` bytes to the next frame of the transmit ring, using `write` to fill it in. The packet is
+    /// sent out on the next call to [PacketRing::flush].
+    pub fn transmit<F: FnOnce(&mut [u8])>(&mut self, len: usize, write: F) -> Result<(), Fail> {
+        if len > self.max_transmit_len() {
+            return Err(Fail::new(
+                libc::EMSGSIZE,
+                "packet does not fit in a frame of the transmit ring",
+            ));
+        }
+
+        let hdr: *mut libc::tpacket2_hdr = self.tx.head_frame();
+        let mut status: u32 = frame_status(hdr).load(Ordering::Acquire);
+        if is_transmit_busy(status) {
+            // The ring is full, so ask the kernel to catch up before giving up on this packet.
+            self.send_pending();
+            status = frame_status(hdr).load(Ordering::Acquire);
+            if is_transmit_busy(status) {
+                return Err(Fail::new(libc::EAGAIN, "transmit ring is full"));
+            }
+        }
+
+        // Safety: the frame belongs to us until its status is set, and the packet fits in it.
+        unsafe {
+            let data: &mut [u8] = slice::from_raw_parts_mut((hdr as *mut u8).add(TX_DATA_OFFSET), len);
+            write(data);
+            (*hdr).tp_len = len as u32;
+        }
+        frame_status(hdr).store(libc::TP_STATUS_SEND_REQUEST, Ordering::Release);
+        self.tx.advance();
+        self.tx_pending += 1;
+
+        Ok(())
+    }
+
+    /// Hands off to the kernel all frames that were written to the transmit ring since the last flush.
+    pub fn flush(&mut self) {
+        if self.tx_pending > 0 {
+            self.send_pending();
+        }
+    }
+
+    /// Receives a batch of packets from the receive ring, handing their frames back to the kernel.
+    pub fn receive(&mut self) -> ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> {
+        let mut out: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        while !out.is_full() {
+            let hdr: *mut libc::tpacket2_hdr = self.rx.head_frame();
+            let status: u32 = frame_status(hdr).load(Ordering::Acquire);
+            if status & libc::TP_STATUS_USER == 0 {
+                break;
+            }
+
+            // Safety: the frame belongs to us until we hand it back, and the kernel places the packet inside of it.
+            let (len, snaplen, data): (u32, u32, &[u8]) = unsafe {
+                let len: u32 = (*hdr).tp_len;
+                let snaplen: u32 = (*hdr).tp_snaplen;
+                let mac: usize = (*hdr).tp_mac as usize;
+                (
+                    len,
+                    snaplen,
+                    slice::from_raw_parts((hdr as *const u8).add(mac), snaplen as usize),
+                )
+            };
+            if snaplen != len {
+                warn!(
+                    "receive(): dropping truncated packet (len={:?}, snaplen={:?})",
+                    len, snaplen
+                );
+                with_stats(|s: &ThreadStats| s.rx_drops.incr());
+            } else {
+                match DemiBuffer::from_slice(data) {
+                    Ok(buf) => out.push(buf),
+                    Err(e) => {
+                        warn!("receive(): dropping packet: {:?}", e);
+                        with_stats(|s: &ThreadStats| s.rx_drops.incr());
+                    },
+                }
+            }
+
+            frame_status(hdr).store(libc::TP_STATUS_KERNEL, Ordering::Release);
+            self.rx.advance();
+        }
+        out
+    }
+
+    /// Asks the kernel to transmit all frames that are pending in the transmit ring.
+    fn send_pending(&mut self) {
+        if let Err(e) = self.socket.send_pending() {
+            warn!(
+                "send_pending(): failed to send pending frames (pending={:?}): {:?}",
+                self.tx_pending, e
+            );
+        }
+        self.tx_pending = 0;
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Returns the status word of the frame whose header is `hdr`, which is shared with the kernel.
+fn frame_status<'a>(hdr: *mut libc::tpacket2_hdr) -> &'a AtomicU32 {
+    // Safety: the status word is the first field of the frame header, which is suitably aligned.
+    unsafe { &*(hdr as *const AtomicU32) }
+}
+
+/// Checks if a frame of the transmit ring with status `status` is still owned by the kernel.
+fn is_transmit_busy(status: u32) -> bool {
+    status & (libc::TP_STATUS_SEND_REQUEST | libc::TP_STATUS_SENDING) != 0
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for PacketRing {
+    fn drop(&mut self) {
+        // Hand off any frames still pending before the rings go away.
+        self.flush();
+        if unsafe { libc::munmap(self.mapping as *mut libc::c_void, self.mapping_len) } != 0 {
+            warn!("drop(): failed to unmap packet rings");
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        frame_status,
+        PacketRing,
+        RawSocket,
+        Ring,
+        PACKET_RING_FRAMES_PER_BLOCK,
+        PACKET_RING_FRAME_SIZE,
+        TX_DATA_OFFSET,
+    };
+    use crate::runtime::{
+        fail::Fail,
+        memory::DemiBuffer,
+        network::consts::RECEIVE_BATCH_SIZE,
+        stats::{
+            with_stats,
+            ThreadStats,
+        },
+    };
+    use ::anyhow::Result;
+    use ::arrayvec::ArrayVec;
+    use ::std::{
+        os::fd::{
+            AsRawFd,
+            FromRawFd,
+            OwnedFd,
+            RawFd,
+        },
+        ptr,
+        slice,
+        sync::atomic::Ordering,
+    };
+
+    /// Number of frames in each ring of the tests.
+    const NUM_FRAMES: u32 = PACKET_RING_FRAMES_PER_BLOCK;
+
+    /// Offset at which the fake kernel places received packets in their frames.
+    const RX_MAC_OFFSET: u16 = 64;
+
+    /// Creates a pair of connected datagram sockets. The packet ring gets one end in lieu of a raw socket, and every
+    /// flush of the transmit ring shows up as an empty datagram on the other end.
+    fn socketpair() -> Result<(OwnedFd, OwnedFd)> {
+        let mut fds: [RawFd; 2] = [-1; 2];
+        let ret: libc::c_int = unsafe {
+            libc::socketpair(
+                libc::AF_UNIX,
+                libc::SOCK_DGRAM | libc::SOCK_CLOEXEC,
+                0,
+                fds.as_mut_ptr(),
+            )
+        };
+        ::anyhow::ensure!(ret == 0, "failed to create socket pair");
+        // Safety: The kernel just handed us these file descriptors, and nobody else owns them.
+        Ok(unsafe { (OwnedFd::from_raw_fd(fds[0]), OwnedFd::from_raw_fd(fds[1])) })
+    }
+
+    /// Creates packet rings on anonymous memory, which the tests write to in place of the kernel, for `socket`.
+    fn new_ring(socket: &OwnedFd) -> Result<PacketRing> {
+        let ring_len: usize = NUM_FRAMES as usize * PACKET_RING_FRAME_SIZE;
+        let mapping_len: usize = 2 * ring_len;
+        let mapping: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                mapping_len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS,
+                -1,
+                0,
+            )
+        };
+        ::anyhow::ensure!(mapping != libc::MAP_FAILED, "failed to map packet rings");
+        let mapping: *mut u8 = mapping as *mut u8;
+
+        Ok(PacketRing {
+            socket: RawSocket::from_raw_fd(socket.as_raw_fd()),
+            mapping,
+            mapping_len,
+            rx: Ring {
+                base: mapping,
+                num_frames: NUM_FRAMES,
+                head: 0,
+            },
+            tx: Ring {
+                // Safety: the transmit ring is mapped right after the receive ring.
+                base: unsafe { mapping.add(ring_len) },
+                num_frames: NUM_FRAMES,
+                head: 0,
+            },
+            tx_pending: 0,
+        })
+    }
+
+    /// Returns the header of frame `index` of `ring`.
+    fn frame(ring: &Ring, index: u32) -> *mut libc::tpacket2_hdr {
+        // Safety: the tests only ask for frames that are in bounds of the ring.
+        unsafe { ring.base.add(index as usize * PACKET_RING_FRAME_SIZE) as *mut libc::tpacket2_hdr }
+    }
+
+    /// Counts the flushes of the transmit ring that reached the other end of the socket pair.
+    fn count_flushes(kernel: &OwnedFd) -> usize {
+        let mut count: usize = 0;
+        let mut buf: [u8; 1] = [0; 1];
+        while unsafe {
+            libc::recv(
+                kernel.as_raw_fd(),
+                buf.as_mut_ptr() as *mut libc::c_void,
+                buf.len(),
+                libc::MSG_DONTWAIT,
+            )
+        } == 0
+        {
+            count += 1;
+        }
+        count
+    }
+
+    /// Has the fake kernel place a packet of `len` bytes, of which only `snaplen` fit, in frame `index` of the receive
+    /// ring, and hand the frame over to us.
+    fn kernel_receive(ring: &PacketRing, index: u32, len: u32, snaplen: u32, fill: u8) {
+        let hdr: *mut libc::tpacket2_hdr = frame(&ring.rx, index);
+        // Safety: the frame belongs to the fake kernel, and the packet fits in it.
+        unsafe {
+            (*hdr).tp_len = len;
+            (*hdr).tp_snaplen = snaplen;
+            (*hdr).tp_mac = RX_MAC_OFFSET;
+            ptr::write_bytes((hdr as *mut u8).add(RX_MAC_OFFSET as usize), fill, snaplen as usize);
+        }
+        frame_status(hdr).store(libc::TP_STATUS_USER, Ordering::Release);
+    }
+
+    /// Checks that frames are laid out back to back, and that the head of a ring wraps around after the last frame.
+    #[test]
+    fn ring_head_wraps_around() -> Result<()> {
+        let (socket, _kernel): (OwnedFd, OwnedFd) = socketpair()?;
+        let mut ring: PacketRing = new_ring(&socket)?;
+
+        crate::ensure_eq!(
+            ring.tx.base as usize - ring.rx.base as usize,
+            NUM_FRAMES as usize * PACKET_RING_FRAME_SIZE
+        );
+        for index in 0..NUM_FRAMES {
+            crate::ensure_eq!(ring.tx.head, index);
+            crate::ensure_eq!(ring.tx.head_frame(), frame(&ring.tx, index));
+            ring.tx.advance();
+        }
+        crate::ensure_eq!(ring.tx.head, 0);
+        crate::ensure_eq!(ring.tx.head_frame() as *mut u8, ring.tx.base);
+        Ok(())
+    }
+
+    /// Checks that transmitted frames are handed over to the kernel, that a frame is only reused once the kernel hands
+    /// it back, and that flushes only enter the kernel when there are pending frames.
+    #[test]
+    fn transmit_hands_frames_to_kernel() -> Result<()> {
+        let (socket, kernel): (OwnedFd, OwnedFd) = socketpair()?;
+        let mut ring: PacketRing = new_ring(&socket)?;
+
+        for i in 0..NUM_FRAMES {
+            ring.transmit(60, |data: &mut [u8]| data.fill(i as u8))?;
+        }
+        crate::ensure_eq!(ring.tx_pending, NUM_FRAMES);
+        crate::ensure_eq!(ring.tx.head, 0);
+        for i in 0..NUM_FRAMES {
+            let hdr: *mut libc::tpacket2_hdr = frame(&ring.tx, i);
+            crate::ensure_eq!(frame_status(hdr).load(Ordering::Acquire), libc::TP_STATUS_SEND_REQUEST);
+            crate::ensure_eq!(unsafe { (*hdr).tp_len }, 60);
+            let data: &[u8] = unsafe { slice::from_raw_parts((hdr as *const u8).add(TX_DATA_OFFSET), 60) };
+            ::anyhow::ensure!(data.iter().all(|byte: &u8| *byte == i as u8));
+        }
+        crate::ensure_eq!(count_flushes(&kernel), 0);
+
+        // The ring is full, so we kick the kernel before giving up on the packet.
+        match ring.transmit(60, |data: &mut [u8]| data.fill(0xff)) {
+            Err(Fail { errno, cause: _ }) if errno == libc::EAGAIN => {},
+            result => ::anyhow::bail!("transmit() should fail with EAGAIN, got {:?}", result),
+        }
+        crate::ensure_eq!(count_flushes(&kernel), 1);
+        crate::ensure_eq!(ring.tx_pending, 0);
+        crate::ensure_eq!(ring.tx.head, 0);
+
+        // Once the kernel is done with the first frame, the next packet wraps around into it.
+        frame_status(frame(&ring.tx, 0)).store(libc::TP_STATUS_AVAILABLE, Ordering::Release);
+        ring.transmit(42, |data: &mut [u8]| data.fill(0xff))?;
+        crate::ensure_eq!(ring.tx.head, 1);
+        crate::ensure_eq!(unsafe { (*frame(&ring.tx, 0)).tp_len }, 42);
+        crate::ensure_eq!(
+            frame_status(frame(&ring.tx, 0)).load(Ordering::Acquire),
+            libc::TP_STATUS_SEND_REQUEST
+        );
+
+        ring.flush();
+        crate::ensure_eq!(count_flushes(&kernel), 1);
+        ring.flush();
+        crate::ensure_eq!(count_flushes(&kernel), 0);
+
+        // Packets that do not fit in a frame are refused.
+        match ring.transmit(ring.max_transmit_len() + 1, |_: &mut [u8]| {}) {
+            Err(Fail { errno, cause: _ }) if errno == libc::EMSGSIZE => {},
+            result => ::anyhow::bail!("transmit() should fail with EMSGSIZE, got {:?}", result),
+        }
+        crate::ensure_eq!(ring.tx.head, 1);
+        Ok(())
+    }
+
+    /// Checks that received frames are picked up in order across the end of the ring, that truncated packets are
+    /// dropped, and that every frame is handed back to the kernel.
+    #[test]
+    fn receive_hands_frames_back() -> Result<()> {
+        let (socket, _kernel): (OwnedFd, OwnedFd) = socketpair()?;
+        let mut ring: PacketRing = new_ring(&socket)?;
+        ring.rx.head = NUM_FRAMES - 2;
+        let rx_drops: u64 = with_stats(|s: &ThreadStats| s.rx_drops.get());
+
+        kernel_receive(&ring, NUM_FRAMES - 2, 100, 100, 1);
+        kernel_receive(&ring, NUM_FRAMES - 1, 200, 200, 2);
+        kernel_receive(&ring, 0, 9000, 300, 3);
+        kernel_receive(&ring, 1, 400, 400, 4);
+
+        let bufs: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ring.receive();
+        crate::ensure_eq!(bufs.len(), 3);
+        for (buf, (len, fill)) in bufs.iter().zip([(100, 1), (200, 2), (400, 4)]) {
+            crate::ensure_eq!(buf.len(), len);
+            ::anyhow::ensure!(buf.iter().all(|byte: &u8| *byte == fill));
+        }
+        crate::ensure_eq!(with_stats(|s: &ThreadStats| s.rx_drops.get()), rx_drops + 1);
+
+        crate::ensure_eq!(ring.rx.head, 2);
+        for index in [NUM_FRAMES - 2, NUM_FRAMES - 1, 0, 1] {
+            crate::ensure_eq!(
+                frame_status(frame(&ring.rx, index)).load(Ordering::Acquire),
+                libc::TP_STATUS_KERNEL
+            );
+        }
+
+        // Nothing else was received.
+        crate::ensure_eq!(ring.receive().len(), 0);
+        Ok(())
+    }
+
+    /// Checks that dropping the rings hands off pending frames to the kernel and unmaps the rings.
+    #[test]
+    fn drop_flushes_and_unmaps() -> Result<()> {
+        let (socket, kernel): (OwnedFd, OwnedFd) = socketpair()?;
+
+        // Nothing to hand off.
+        let ring: PacketRing = new_ring(&socket)?;
+        drop(ring);
+        crate::ensure_eq!(count_flushes(&kernel), 0);
+
+        let mut ring: PacketRing = new_ring(&socket)?;
+        ring.transmit(60, |data: &mut [u8]| data.fill(0xab))?;
+        let (mapping, mapping_len): (*mut u8, usize) = (ring.mapping, ring.mapping_len);
+        drop(ring);
+        crate::ensure_eq!(count_flushes(&kernel), 1);
+
+        // The kernel reports unmapped memory as such.
+        let ret: libc::c_int = unsafe { libc::msync(mapping as *mut libc::c_void, mapping_len, libc::MS_ASYNC) };
+        crate::ensure_eq!(ret, -1);
+        crate::ensure_eq!(unsafe { *libc::__errno_location() }, libc::ENOMEM);
+        Ok(())
+    }
+}
@@ -18,6 +18,7 @@ use ::libc;
 use ::std::{
     mem,
     mem::MaybeUninit,
+    ptr,
 };
 
 //======================================================================================================================
@@ -49,6 +50,12 @@ impl RawSocket {
         Ok(RawSocket(sockfd))
     }
 
+    /// Wraps the open file descriptor `fd`, which lets tests stand in for the kernel with other kinds of sockets.
+    #[cfg(test)]
+    pub fn from_raw_fd(fd: libc::c_int) -> Self {
+        RawSocket(fd)
+    }
+
     // Binds a socket to a raw address.
     pub fn bind(&self, addr: &RawSocketAddr) -> Result<(), Fail> {
         let ret: i32 = unsafe {
@@ -64,6 +71,67 @@ impl RawSocket {
         Ok(())
     }
 
+    /// Sets the packet socket option `optname` to `optval`.
+    pub fn set_packet_option<T>(&self, optname: libc::c_int, optval: &T) -> Result<(), Fail> {
+        let optval_ptr: *const libc::c_void = optval as *const T as *const libc::c_void;
+        let optlen: Socklen = mem::size_of::<T>() as Socklen;
+        let ret: i32 = unsafe { libc::setsockopt(self.0, libc::SOL_PACKET, optname, optval_ptr, optlen) };
+
+        // Check if we failed to set the socket option.
+        if ret == -1 {
+            let errno: libc::c_int = errno();
+            let cause: String = format!(
+                "failed to set packet socket option (optname={:?}, errno={:?})",
+                optname, errno
+            );
+            error!("set_packet_option(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        Ok(())
+    }
+
+    /// Maps `len` bytes of the packet rings that were set up for a raw socket.
+    pub fn mmap(&self, len: usize) -> Result<*mut u8, Fail> {
+        let ptr: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                self.0,
+                0,
+            )
+        };
+
+        // Check if we failed to map the packet rings.
+        if ptr == libc::MAP_FAILED {
+            let errno: libc::c_int = errno();
+            let cause: String = format!("failed to map packet rings (errno={:?})", errno);
+            error!("mmap(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        Ok(ptr as *mut u8)
+    }
+
+    /// Asks the kernel to transmit all frames that are pending in the transmit ring of a raw socket, without waiting
+    /// for them to be sent.
+    pub fn send_pending(&self) -> Result<(), Fail> {
+        let ret: isize = unsafe { libc::sendto(self.0, ptr::null(), 0, libc::MSG_DONTWAIT, ptr::null(), 0) };
+
+        // Check if we failed to hand off pending frames. Running out of socket buffer space is fine, because the
+        // kernel keeps the remaining frames in the ring.
+        if ret == -1 {
+            let errno: libc::c_int = errno();
+            if errno != libc::EAGAIN && errno != libc::ENOBUFS {
+                return Err(Fail::new(errno, "failed to send pending frames through raw socket"));
+            }
+        }
+
+        Ok(())
+    }
+
     /// Sends data through a raw socket.
     pub fn sendto(&self, buf: &[u8], rawaddr: &RawSocketAddr) -> Result<usize, Fail> {
         let buf_len: usize = buf.len();
@@ -109,3 +177,12 @@ impl RawSocket {
         Ok((nbytes as usize, rawaddr))
     }
 }
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Reads the error code of the last system call.
+fn errno() -> libc::c_int {
+    unsafe { *libc::__errno_location() }
+}
@@ -10,6 +10,10 @@ use crate::{
         raw_array,
         ring::Ring,
     },
+    pal::linux::futex::{
+        futex_wait,
+        futex_wake,
+    },
     runtime::{
         fail::Fail,
         DemiRuntime,
@@ -21,8 +25,10 @@ use ::core::{
     sync::atomic::{
         self,
         AtomicU16,
+        AtomicU32,
         AtomicUsize,
     },
+    time::Duration,
 };
 use ::std::{
     alloc,
@@ -39,6 +45,9 @@ use crate::timer;
 /// Size of header in bytes = 16-bit buffer length.
 const HEADER_SIZE: usize = 2;
 
+/// Maximum length of a message, which is bounded by the header.
+pub const MAX_MESSAGE_SIZE: usize = u16::MAX as usize;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -54,11 +63,11 @@ const HEADER_SIZE: usize = 2;
 ///
 /// For correctness, the following invariants
 /// must hold:
-/// 0. push_offset and pop_offset must monotonically increase, except when wrapping around, and must always be aligned
-///    with [HEADER_SIZE].
+/// 0. push_offset and pop_offset must monotonically increase and must always be aligned with [HEADER_SIZE]. They count
+///    bytes since the creation of the ring and are reduced modulo the capacity to index the buffer.
 /// 1. push_offset == pop_offset only if queue is empty.
-/// 2. push_offset == pop_offset - [HEADER_SIZE] only if queue is full. We only utilize capacity - [HEADER_SIZE] of the
-///    ring buffer so that we can distinguish between these two states.
+/// 2. push_offset == pop_offset + capacity - [HEADER_SIZE] only if queue is full. We only utilize capacity -
+///    [HEADER_SIZE] of the ring buffer so that the header that follows the last message is always free.
 /// 3. First [HEADER_SIZE] bytes of every buffer is a header indicating the length of valid data in the .
 /// 4. If the message header is non-zero, the data in the payload must be valid.
 /// 5. If the message is valid (i.e., the message header is non-zero), it must exist between the push_offset and
@@ -67,17 +76,51 @@ const HEADER_SIZE: usize = 2;
 /// not be modified or read.
 /// 7. If the 16 bytes pointed to by pop_offset are zero, then there is either another ongoing pop or there is no valid
 /// data in the buffer.
+///
+/// Writers and readers run on different cores, so pop_offset, push_offset and the notifier each sit on their own
+/// cache line. Readers never load push_offset: an empty ring shows as a zero header. Writers only load pop_offset when
+/// a private, possibly stale copy of it makes the ring look full. Since offsets only grow, a stale copy only
+/// underestimates the free space.
 pub struct ConcurrentRingBuffer {
     // Indexes the first empty byte where buffers can be enqueued.
     push_offset: *mut usize,
     // Indexes the first buffer that can be popped.
     pop_offset: *mut usize,
+    // Wakes up readers that wait for messages.
+    notifier: *mut Notifier,
+    // Last value of pop_offset seen by writers of this endpoint.
+    cached_pop_offset: AtomicUsize,
+    // Block that holds the offsets and the notifier.
+    control: *mut Control,
     // Underlying buffer.
     buffer: raw_array::RawArray<u8>,
     /// Is the underlying memory managed by this module?
     is_managed: bool,
 }
 
+/// Pads a value to a (64-byte) cache line, so that it does not share a line with values that are written by other
+/// cores.
+#[repr(C, align(64))]
+struct CachePadded<T>(T);
+
+/// Shared state of a ring buffer, which resides in front of its buffer.
+#[repr(C)]
+struct Control {
+    pop_offset: CachePadded<usize>,
+    push_offset: CachePadded<usize>,
+    notifier: CachePadded<Notifier>,
+}
+
+/// Futex words through which writers wake up readers that are blocked on an empty ring. These reside in the same
+/// memory as the ring, so that they work across processes.
+#[repr(C)]
+struct Notifier {
+    /// Bumped by writers to wake up readers.
+    sequence: AtomicU32,
+    /// Number of readers that are about to block or are blocked.
+    waiters: AtomicU32,
+}
+
 //======================================================================================================================
 // Associated Functions
 //======================================================================================================================
@@ -96,18 +139,10 @@ impl ConcurrentRingBuffer {
             return Err(Fail::new(libc::EINVAL, &cause));
         }
 
-        let push_offset: *mut usize = Self::alloc::<usize>()?;
-        unsafe { *push_offset = 0 };
-
-        let pop_offset: *mut usize = Self::alloc::<usize>()?;
-        unsafe { *pop_offset = 0 };
+        // The control block is zeroed on allocation.
+        let control: *mut Control = Self::alloc::<Control>()?;
 
-        let me: Self = Self {
-            pop_offset,
-            push_offset,
-            buffer: raw_array::RawArray::<u8>::new(capacity)?,
-            is_managed: true,
-        };
+        let me: Self = Self::from_control(control, raw_array::RawArray::<u8>::new(capacity)?, true);
 
         // Initialize the first header to 0.
         me.write_header(0, 0);
@@ -115,6 +150,26 @@ impl ConcurrentRingBuffer {
         Ok(me)
     }
 
+    /// Builds a ring buffer on top of an initialized control block.
+    fn from_control(control: *mut Control, buffer: raw_array::RawArray<u8>, is_managed: bool) -> Self {
+        let (pop_offset, push_offset, notifier): (*mut usize, *mut usize, *mut Notifier) = unsafe {
+            (
+                &mut (*control).pop_offset.0,
+                &mut (*control).push_offset.0,
+                &mut (*control).notifier.0,
+            )
+        };
+        Self {
+            push_offset,
+            pop_offset,
+            notifier,
+            cached_pop_offset: AtomicUsize::new(peek(pop_offset)),
+            control,
+            buffer,
+            is_managed,
+        }
+    }
+
     /// Returns the effective capacity of the target ring buffer in bytes.
     #[allow(unused)]
     pub fn capacity(&self) -> usize {
@@ -134,34 +189,30 @@ impl ConcurrentRingBuffer {
 
     /// Attempts to insert a buffer of [len] bytes into the ring buffer.
     pub fn try_push(&self, buf: &[u8]) -> Result<usize, Fail> {
+        self.try_push_vectored(&[buf])
+    }
+
+    /// Attempts to insert a message made of the concatenation of [bufs] into the ring buffer. This gathers the
+    /// buffers straight into the ring, so that callers need not assemble the message (e.g. a header and a payload)
+    /// beforehand.
+    pub fn try_push_vectored(&self, bufs: &[&[u8]]) -> Result<usize, Fail> {
         #[cfg(feature = "profiler")]
         timer!("collections::concurrent_ring::try_push");
-        let len: usize = buf.len();
+        let len: usize = bufs.iter().map(|buf| buf.len()).sum();
         if len == 0 {
             return Err(Fail::new(libc::EINVAL, "Buffer must be non-zero length"));
         }
+        if len > MAX_MESSAGE_SIZE {
+            return Err(Fail::new(libc::EINVAL, "Buffer is too long to fit in a message"));
+        }
         // reserve_space will allocate space for the header.
         if let Some(push_offset) = self.reserve_space(len) {
             debug_assert!(push_offset % HEADER_SIZE == 0);
-            // Push first part of buffer. If longer than the capacity of the ring, wrap around.
-            let first_offset: usize = push_offset + HEADER_SIZE;
-            let first_len: usize = if push_offset + len + HEADER_SIZE > self.capacity() {
-                self.capacity() - first_offset
-            } else {
-                len
-            };
-            let buf_ptr: *const u8 = buf.as_ptr();
-            let ring_ptr: *mut u8 = unsafe { self.buffer.get_mut().as_mut_ptr() };
-            // Copy the data into the ring buffer.
-            unsafe {
-                copy(buf_ptr, ring_ptr.add(first_offset), first_len);
-            }
-            // If there is remaining data in the buffer, wrap around.
-            if len > first_len {
-                // Copy the data into the ring buffer.
-                unsafe {
-                    copy(buf_ptr.add(first_len), ring_ptr, len - first_len);
-                }
+            // Copy the data into the ring buffer, wrapping around if needed.
+            let mut offset: usize = push_offset + HEADER_SIZE;
+            for buf in bufs {
+                self.copy_to_ring(offset, buf);
+                offset += buf.len();
             }
             // Commit the write by atomically writing the header to release the buffer. The overwritten header MUST be
             // 0. The header describes just the length of the payload.
@@ -173,6 +224,7 @@ impl ConcurrentRingBuffer {
                 peek(self.push_offset),
                 peek(self.pop_offset)
             );
+            self.notify();
 
             Ok(len)
         } else {
@@ -197,9 +249,15 @@ impl ConcurrentRingBuffer {
     /// Attempts to remove next message from the ring buffer up to [len] bytes and copies into [buf]. This function
     /// does not block.
     pub fn try_pop(&self, buf: &mut [u8]) -> Result<usize, Fail> {
+        self.try_pop_vectored(&mut [buf])
+    }
+
+    /// Attempts to remove next message from the ring buffer and scatters it into [bufs], in order. The message must
+    /// fit in the buffers altogether. This function does not block.
+    pub fn try_pop_vectored(&self, bufs: &mut [&mut [u8]]) -> Result<usize, Fail> {
         #[cfg(feature = "profiler")]
         timer!("collections::concurrent_ring::try_pop");
-        let len: usize = buf.len();
+        let len: usize = bufs.iter().map(|buf| buf.len()).sum();
         if len == 0 {
             return Err(Fail::new(libc::EINVAL, "Buffer must be non-zero length"));
         }
@@ -219,38 +277,83 @@ impl ConcurrentRingBuffer {
             },
         };
 
-        // Pop first part of buffer.
-        let first_offset: usize = pop_offset + HEADER_SIZE;
-        let first_len: usize = if pop_offset + pop_len + HEADER_SIZE > self.capacity() {
-            self.capacity() - first_offset
-        } else {
-            len
-        };
-        let buf_ptr: *mut u8 = buf.as_mut_ptr();
-        let ring_ptr: *const u8 = unsafe { self.buffer.get().as_ptr() };
-        // Copy the data into the ring buffer.
-        unsafe {
-            copy(ring_ptr.add(first_offset), buf_ptr, first_len);
-        }
-        // If there is remaining data in the buffer, wrap around.
-        if len > first_len {
-            // Copy the data into the ring buffer.
-            unsafe {
-                copy(ring_ptr, buf_ptr.add(first_len), len - first_len);
-            }
+        // Copy the message out of the ring buffer, wrapping around if needed.
+        let mut offset: usize = pop_offset + HEADER_SIZE;
+        let mut remaining: usize = pop_len;
+        for buf in bufs.iter_mut() {
+            let n: usize = remaining.min(buf.len());
+            self.copy_from_ring(offset, &mut buf[..n]);
+            offset += n;
+            remaining -= n;
         }
 
         // Move to next buffer.
         self.release_space(pop_offset, pop_len);
         trace!(
-            "try_push() len={:?} push_offset={:?} pop_offset={:?}",
-            len,
+            "try_pop() len={:?} push_offset={:?} pop_offset={:?}",
+            pop_len,
             peek(self.push_offset),
             peek(self.pop_offset)
         );
         Ok(pop_len)
     }
 
+    /// Blocks the calling thread until a message may be available or [timeout] expires. This returns right away if
+    /// the ring buffer is not empty. Writers wake up waiting readers after every push.
+    pub fn wait_for_message(&self, timeout: Duration) -> Result<(), Fail> {
+        let notifier: &Notifier = unsafe { &*self.notifier };
+        notifier.waiters.fetch_add(1, atomic::Ordering::Relaxed);
+        let sequence: u32 = notifier.sequence.load(atomic::Ordering::Relaxed);
+        // Pairs with the fence in notify(): either the writer sees us waiting, or we see its message.
+        atomic::fence(atomic::Ordering::SeqCst);
+        let result: Result<(), Fail> = if self.is_empty() {
+            futex_wait(&notifier.sequence, sequence, timeout)
+        } else {
+            Ok(())
+        };
+        notifier.waiters.fetch_sub(1, atomic::Ordering::Relaxed);
+
+        match result {
+            Err(e) if e.errno == libc::ETIMEDOUT => Ok(()),
+            result => result,
+        }
+    }
+
+    /// Wakes up readers that wait for messages, if any.
+    fn notify(&self) {
+        let notifier: &Notifier = unsafe { &*self.notifier };
+        // Pairs with the fence in wait_for_message().
+        atomic::fence(atomic::Ordering::SeqCst);
+        if notifier.waiters.load(atomic::Ordering::Relaxed) > 0 {
+            notifier.sequence.fetch_add(1, atomic::Ordering::Relaxed);
+            if let Err(e) = futex_wake(&notifier.sequence, u32::MAX) {
+                warn!("notify(): failed to wake up readers ({:?})", e);
+            }
+        }
+    }
+
+    /// Copies [buf] into the ring buffer, starting at [offset] and wrapping around the end of the ring buffer.
+    fn copy_to_ring(&self, offset: usize, buf: &[u8]) {
+        let offset: usize = offset % self.capacity();
+        let first_len: usize = buf.len().min(self.capacity() - offset);
+        let ring_ptr: *mut u8 = unsafe { self.buffer.get_mut().as_mut_ptr() };
+        unsafe {
+            copy(buf.as_ptr(), ring_ptr.add(offset), first_len);
+            copy(buf.as_ptr().add(first_len), ring_ptr, buf.len() - first_len);
+        }
+    }
+
+    /// Copies from the ring buffer into [buf], starting at [offset] and wrapping around the end of the ring buffer.
+    fn copy_from_ring(&self, offset: usize, buf: &mut [u8]) {
+        let offset: usize = offset % self.capacity();
+        let first_len: usize = buf.len().min(self.capacity() - offset);
+        let ring_ptr: *const u8 = unsafe { self.buffer.get().as_ptr() };
+        unsafe {
+            copy(ring_ptr.add(offset), buf.as_mut_ptr(), first_len);
+            copy(ring_ptr, buf.as_mut_ptr().add(first_len), buf.len() - first_len);
+        }
+    }
+
     /// Removes the next message from the ring buffer up to [len] bytes and copies into [buf]. This function may block
     /// (spin).
     #[allow(unused)]
@@ -271,10 +374,12 @@ impl ConcurrentRingBuffer {
         #[cfg(feature = "profiler")]
         timer!("collections::concurrent_ring::write_header");
         assert!(offset % 2 == 0);
+        let offset: usize = offset % self.capacity();
         let buffer_ptr: *mut u8 = unsafe { self.buffer.get_mut() }.as_mut_ptr();
         let header_ptr: *mut u16 = unsafe { buffer_ptr.add(offset) } as *mut u16;
         let header: &AtomicU16 = unsafe { &*header_ptr.cast() };
-        header.swap(val as u16, atomic::Ordering::Relaxed) as usize
+        // Writing a length publishes the payload that was copied before it, and claiming a message must see it.
+        header.swap(val as u16, atomic::Ordering::AcqRel) as usize
     }
 
     /// Given a [push_offset] and [pop_offset] into the ring buffer, return available space for writing data. Always
@@ -282,9 +387,9 @@ impl ConcurrentRingBuffer {
     fn available_space(&self, push_offset: usize, pop_offset: usize) -> usize {
         #[cfg(feature = "profiler")]
         timer!("collections::concurrent_ring::available_space");
-        debug_assert!(push_offset + self.capacity() > pop_offset);
-        let used_space: usize = (push_offset + self.capacity() - pop_offset) % self.capacity();
-        debug_assert!(self.capacity() > used_space + HEADER_SIZE);
+        debug_assert!(push_offset >= pop_offset);
+        let used_space: usize = push_offset - pop_offset;
+        debug_assert!(self.capacity() >= used_space + HEADER_SIZE);
         self.capacity() - used_space - HEADER_SIZE
     }
 
@@ -295,14 +400,18 @@ impl ConcurrentRingBuffer {
         timer!("collections::concurrent_ring::reserve_space");
         let len_: usize = align_header(len + HEADER_SIZE);
         let push_offset: usize = peek(self.push_offset);
-        let pop_offset: usize = peek(self.pop_offset);
+        let mut pop_offset: usize = self.cached_pop_offset.load(atomic::Ordering::Relaxed);
 
+        // Only look at the reader's offset if our copy of it says that the ring is full.
         if len_ > self.available_space(push_offset, pop_offset) {
-            return None;
+            pop_offset = peek(self.pop_offset);
+            self.cached_pop_offset.store(pop_offset, atomic::Ordering::Relaxed);
+            if len_ > self.available_space(push_offset, pop_offset) {
+                return None;
+            }
         }
-        let new_offset: usize = (push_offset + len_) % self.capacity();
+        let new_offset: usize = push_offset + len_;
 
-        debug_assert_ne!(new_offset, pop_offset);
         // Queue has space after the enqueue pointer, so try to reserve space.
         match check_and_set(self.push_offset, push_offset, new_offset) {
             Ok(start) => {
@@ -318,7 +427,7 @@ impl ConcurrentRingBuffer {
         #[cfg(feature = "profiler")]
         timer!("collections::concurrent_ring::release_space");
         let len_: usize = align_header(len + HEADER_SIZE);
-        let new_offset: usize = (current_offset + len_) % self.capacity();
+        let new_offset: usize = current_offset + len_;
         // Ensure that the old pop_offset was what we expected. Panic if it is not.
         check_and_set(self.pop_offset, current_offset, new_offset).unwrap();
     }
@@ -375,18 +484,16 @@ impl Ring for ConcurrentRingBuffer {
             ));
         }
 
-        // Check if the memory region is aligned to usize.
-        let align_of_usize: usize = mem::align_of::<usize>();
-        if ptr.align_offset(align_of_usize) != 0 {
+        // Check if the memory region is aligned to a cache line.
+        if ptr.align_offset(mem::align_of::<Control>()) != 0 {
             return Err(Fail::new(
                 libc::EINVAL,
                 "cannot construct a ring buffer from a unaligned memory region",
             ));
         }
 
-        const SIZE_OF_USIZE: usize = mem::size_of::<usize>();
         // Check that there is sufficient space in the buffer.
-        let size_of_ring: usize = 2 * SIZE_OF_USIZE;
+        let size_of_ring: usize = mem::size_of::<Control>();
         if capacity <= size_of_ring {
             return Err(Fail::new(
                 libc::EINVAL,
@@ -395,26 +502,19 @@ impl Ring for ConcurrentRingBuffer {
         }
 
         // Compute pointers and required padding.
-        let mut buffer_ptr: *mut u8 = ptr;
-        let pop_offset: *mut usize = buffer_ptr as *mut usize;
-        buffer_ptr = unsafe { buffer_ptr.add(SIZE_OF_USIZE) };
-        let push_offset: *mut usize = buffer_ptr as *mut usize;
-        buffer_ptr = unsafe { buffer_ptr.add(SIZE_OF_USIZE) };
+        let control: *mut Control = ptr as *mut Control;
+        let buffer_ptr: *mut u8 = unsafe { ptr.add(size_of_ring) };
 
         // Initialize enqueue and dequeue pointers only if requested.
         if init {
-            unsafe {
-                *push_offset = 0;
-                *pop_offset = 0;
-            }
+            unsafe { *control = mem::zeroed() };
         }
 
-        let me: Self = Self {
-            push_offset,
-            pop_offset,
-            buffer: raw_array::RawArray::<u8>::from_raw_parts(buffer_ptr, capacity - size_of_ring)?,
-            is_managed: false,
-        };
+        let me: Self = Self::from_control(
+            control,
+            raw_array::RawArray::<u8>::from_raw_parts(buffer_ptr, capacity - size_of_ring)?,
+            false,
+        );
         // Intialize the header to 0.
         me.write_header(0, 0);
         Ok(me)
@@ -461,11 +561,8 @@ impl Drop for ConcurrentRingBuffer {
         // Check if underlying memory was allocated by this module.
         if self.is_managed {
             // Release underlying memory.
-            let layout: Layout = Layout::new::<usize>();
-            unsafe {
-                alloc::dealloc(self.push_offset as *mut u8, layout);
-                alloc::dealloc(self.pop_offset as *mut u8, layout);
-            }
+            let layout: Layout = Layout::new::<Control>();
+            unsafe { alloc::dealloc(self.control as *mut u8, layout) };
             self.is_managed = false;
         }
     }
@@ -479,11 +576,22 @@ impl Drop for ConcurrentRingBuffer {
 mod test {
     use super::{
         ConcurrentRingBuffer,
+        Control,
         Ring,
     };
     use ::anyhow::Result;
-    use ::core::mem;
+    use ::core::{
+        mem,
+        sync::atomic::{
+            AtomicBool,
+            Ordering,
+        },
+    };
     use ::std::thread;
+    use ::test::{
+        black_box,
+        Bencher,
+    };
     use std::{
         ops::Range,
         time::Duration,
@@ -493,6 +601,10 @@ mod test {
     const RING_BUFFER_CAPACITY: usize = 4096;
     const ITERATIONS: usize = 128;
 
+    /// Storage for ring buffers that are constructed from raw parts, which must be aligned to a cache line.
+    #[repr(C, align(64))]
+    struct AlignedArray<const N: usize>([u8; N]);
+
     /// Creates a ring buffer with a valid capacity.
     fn do_new() -> Result<ConcurrentRingBuffer> {
         let ring: ConcurrentRingBuffer = match ConcurrentRingBuffer::new(RING_BUFFER_CAPACITY) {
@@ -580,9 +692,9 @@ mod test {
     /// Tests if we succeed to construct a ring buffer from raw parts.
     #[test]
     fn from_raw_parts() -> Result<()> {
-        const SIZE: usize = RING_BUFFER_CAPACITY + 2 * mem::size_of::<usize>();
-        let mut array: [u8; SIZE] = [0; SIZE];
-        do_from_raw(array.as_mut_ptr() as *mut u8, SIZE)?;
+        const SIZE: usize = RING_BUFFER_CAPACITY + mem::size_of::<Control>();
+        let mut array: AlignedArray<SIZE> = AlignedArray([0; SIZE]);
+        do_from_raw(array.0.as_mut_ptr() as *mut u8, SIZE)?;
         Ok(())
     }
 
@@ -596,14 +708,65 @@ mod test {
     /// Tets if we succeed to sequentially enqueue and dequeue elements to/from a constructed ring buffer.
     #[test]
     fn enqueue_dequeue_sequential_raw() -> Result<()> {
-        const LENGTH: usize = RING_BUFFER_CAPACITY + 2 * mem::size_of::<usize>();
+        const LENGTH: usize = RING_BUFFER_CAPACITY + mem::size_of::<Control>();
         const SIZE: usize = LENGTH * mem::size_of::<u8>();
-        let mut array: [u8; LENGTH] = [0; LENGTH];
-        let mut ring: ConcurrentRingBuffer = do_from_raw(array.as_mut_ptr() as *mut u8, SIZE)?;
+        let mut array: AlignedArray<LENGTH> = AlignedArray([0; LENGTH]);
+        let mut ring: ConcurrentRingBuffer = do_from_raw(array.0.as_mut_ptr() as *mut u8, SIZE)?;
 
         do_enqueue_dequeue(&mut ring)
     }
 
+    /// Tests if messages are gathered from and scattered to several buffers, also across the end of the ring buffer.
+    #[test]
+    fn enqueue_dequeue_vectored() -> Result<()> {
+        let ring: ConcurrentRingBuffer = do_new()?;
+        let header: [u8; 4] = [0xB, 0xE, 0xE, 0xF];
+        let payload: Vec<u8> = (0..1000).map(|i| i as u8).collect();
+        // Enough rounds to wrap around several times.
+        for _ in 0..(4 * RING_BUFFER_CAPACITY / payload.len()) {
+            crate::ensure_eq!(
+                ring.try_push_vectored(&[&header, &payload])?,
+                header.len() + payload.len()
+            );
+
+            let mut header_out: [u8; 4] = [0; 4];
+            let mut payload_out: Vec<u8> = vec![0; 2 * payload.len()];
+            crate::ensure_eq!(
+                ring.try_pop_vectored(&mut [&mut header_out, &mut payload_out])?,
+                header.len() + payload.len()
+            );
+            crate::ensure_eq!(header_out, header);
+            crate::ensure_eq!(payload_out[..payload.len()], payload[..]);
+            crate::ensure_eq!(ring.is_empty(), true);
+        }
+        Ok(())
+    }
+
+    /// Tests if a reader that waits for a message is woken up by a writer.
+    #[test]
+    fn wait_for_message() -> Result<()> {
+        let ring: ConcurrentRingBuffer = do_new()?;
+
+        // Waiting on an empty ring buffer times out.
+        ring.wait_for_message(Duration::from_millis(1))?;
+
+        thread::scope(|s| -> Result<()> {
+            let reader = s.spawn(|| -> Result<usize> {
+                let mut buf: [u8; 16] = [0; 16];
+                loop {
+                    match ring.try_pop(&mut buf) {
+                        Ok(len) => return Ok(len),
+                        Err(_) => ring.wait_for_message(Duration::from_secs(10))?,
+                    }
+                }
+            });
+            thread::sleep(Duration::from_millis(10));
+            ring.try_push(&[1, 2, 3])?;
+            crate::ensure_eq!(reader.join().unwrap()?, 3);
+            Ok(())
+        })
+    }
+
     /// Tests if we succeed to access a ring buffer concurrently.
     #[test]
     fn enqueue_dequeue_concurrent() -> Result<()> {
@@ -805,4 +968,37 @@ mod test {
 
         Ok(())
     }
+
+    /// Measures the throughput of a ring buffer that is shared by a writer and a reader running on different threads,
+    /// which is dominated by how the two contend on the offsets. Each iteration pops a batch of messages.
+    #[bench]
+    fn bench_cross_thread_throughput(b: &mut Bencher) {
+        const BATCH_SIZE: usize = 1024;
+        const MESSAGE_SIZE: usize = 64;
+        let ring: ConcurrentRingBuffer = ConcurrentRingBuffer::new(RING_BUFFER_CAPACITY).expect("should create ring");
+        let done: AtomicBool = AtomicBool::new(false);
+
+        thread::scope(|s| {
+            s.spawn(|| {
+                let msg: [u8; MESSAGE_SIZE] = [0xab; MESSAGE_SIZE];
+                while !done.load(Ordering::Relaxed) {
+                    if ring.try_push(&msg).is_err() {
+                        thread::yield_now();
+                    }
+                }
+            });
+
+            let mut buf: [u8; MESSAGE_SIZE] = [0; MESSAGE_SIZE];
+            b.bytes = (BATCH_SIZE * MESSAGE_SIZE) as u64;
+            b.iter(|| {
+                for _ in 0..BATCH_SIZE {
+                    while ring.try_pop(&mut buf).is_err() {
+                        thread::yield_now();
+                    }
+                }
+                black_box(&buf);
+            });
+            done.store(true, Ordering::Relaxed);
+        });
+    }
 }
@@ -103,6 +103,11 @@ impl<T> PinSlab<T> {
         Some(key)
     }
 
+    /// Returns the number of occupied slots.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
     /// Checks whether the given slot is occupied.
     pub fn contains(&self, key: usize) -> bool {
         // We are just using this to check the existance of an entry in this slot or not.
@@ -28,9 +28,12 @@ use crate::{
         logging,
         types::{
             demi_qresult_t,
+            demi_qstats_t,
             demi_qtoken_t,
             demi_sgarray_t,
             demi_sgaseg_t,
+            demi_stats_t,
+            DEMI_SGARRAY_MAXLEN,
         },
         QToken,
     },
@@ -45,7 +48,10 @@ use ::socket2::SockAddr;
 use ::std::{
     cell::RefCell,
     ffi::CStr,
-    mem,
+    mem::{
+        self,
+        ManuallyDrop,
+    },
     net::SocketAddr,
     ptr,
     slice,
@@ -64,8 +70,12 @@ use ::std::net::{
 // DEMIKERNEL
 //======================================================================================================================
 
-/// Demikernel state.
-static mut DEMIKERNEL: RefCell<Option<LibOS>> = RefCell::new(None);
+thread_local! {
+/// Demikernel state. Each thread that calls `demi_init()` gets a LibOS of its own, which runs on the scheduler and the
+/// clock of that thread, so several threads of a process can run independent LibOSes side by side. A LibOS is never
+/// torn down, as it may still be referenced by coroutines that the scheduler of its thread holds.
+static DEMIKERNEL: RefCell<ManuallyDrop<Option<LibOS>>> = const { RefCell::new(ManuallyDrop::new(None)) };
+}
 
 //======================================================================================================================
 // init
@@ -77,6 +87,12 @@ pub extern "C" fn demi_init(argc: c_int, argv: *mut *mut c_char) -> c_int {
     logging::initialize();
     trace!("demi_init()");
 
+    // Check if this thread already has a LibOS.
+    if DEMIKERNEL.with(|demikernel| demikernel.borrow().is_some()) {
+        warn!("demi_init(): Demikernel is already initialized on this thread");
+        return libc::EEXIST;
+    }
+
     let libos_name: LibOSName = match LibOSName::from_env() {
         Ok(libos_name) => libos_name.into(),
         Err(e) => panic!("{:?}", e),
@@ -91,7 +107,7 @@ pub extern "C" fn demi_init(argc: c_int, argv: *mut *mut c_char) -> c_int {
         },
     };
 
-    unsafe { DEMIKERNEL = RefCell::new(Some(libos)) };
+    DEMIKERNEL.with(|demikernel| *demikernel.borrow_mut() = ManuallyDrop::new(Some(libos)));
 
     0
 }
@@ -518,6 +534,45 @@ pub extern "C" fn demi_pop(qtok_out: *mut demi_qtoken_t, qd: c_int) -> c_int {
     }
 }
 
+//======================================================================================================================
+// pop_into
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_pop_into(qtok_out: *mut demi_qtoken_t, qd: c_int, sga: *const demi_sgarray_t) -> c_int {
+    trace!("demi_pop_into()");
+
+    // Check for invalid storage location.
+    if qtok_out.is_null() {
+        warn!("demi_pop_into() qtok_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Check if scatter-gather array is invalid.
+    if sga.is_null() {
+        return libc::EINVAL;
+    }
+
+    let sga: &demi_sgarray_t = unsafe { &*sga };
+
+    // Issue pop operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.pop_into(qd.into(), sga) {
+        Ok(qt) => {
+            unsafe { *qtok_out = qt.into() };
+            0
+        },
+        Err(e) => {
+            trace!("demi_pop_into() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 //======================================================================================================================
 // wait
 //======================================================================================================================
@@ -622,6 +677,207 @@ pub extern "C" fn demi_wait_any(
     }
 }
 
+//======================================================================================================================
+// wait_many
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_wait_many(
+    qrs_out: *mut demi_qresult_t,
+    nqrs_out: *mut c_int,
+    max: c_int,
+    qts: *const demi_qtoken_t,
+    num_qts: c_int,
+    timeout: *const libc::timespec,
+) -> c_int {
+    trace!(
+        "demi_wait_many() {:?} {:?} {:?} {:?} {:?} {:?}",
+        qrs_out,
+        nqrs_out,
+        max,
+        qts,
+        num_qts,
+        timeout
+    );
+
+    // Check for invalid storage locations for queue results.
+    if qrs_out.is_null() || nqrs_out.is_null() {
+        warn!("qrs_out or nqrs_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Check arguments.
+    if max <= 0 || num_qts < 0 || (num_qts > 0 && qts.is_null()) {
+        return libc::EINVAL;
+    }
+
+    // Get queue tokens and storage for queue results.
+    let qts: &[QToken] = unsafe { slice::from_raw_parts(qts as *const QToken, num_qts as usize) };
+    let qrs: &mut [demi_qresult_t] = unsafe { slice::from_raw_parts_mut(qrs_out, max as usize) };
+
+    // Convert timespec to Duration.
+    let duration: Option<Duration> = if timeout.is_null() {
+        None
+    } else {
+        // Safety: We have to trust that our user is providing a valid timeout pointer for us to dereference.
+        Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
+    };
+
+    // Issue wait_many operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_many(&qts, qrs, duration) {
+        Ok(nqrs) => {
+            unsafe { *nqrs_out = nqrs as c_int };
+            0
+        },
+        Err(e) => {
+            trace!("demi_wait_many() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+//======================================================================================================================
+// wait_group_create
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_wait_group_create(wgd_out: *mut c_int) -> c_int {
+    trace!("demi_wait_group_create() {:?}", wgd_out);
+
+    // Check for invalid storage location.
+    if wgd_out.is_null() {
+        warn!("demi_wait_group_create() wgd_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Issue wait_group_create operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.alloc_wait_group() {
+        Ok(wgd) => {
+            unsafe { *wgd_out = wgd as c_int };
+            0
+        },
+        Err(e) => {
+            trace!("demi_wait_group_create() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+//======================================================================================================================
+// wait_group_add
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_wait_group_add(wgd: c_int, qt: demi_qtoken_t) -> c_int {
+    trace!("demi_wait_group_add() {:?} {:?}", wgd, qt);
+
+    // Check for invalid wait group descriptor.
+    if wgd < 0 {
+        return libc::EBADF;
+    }
+
+    // Issue wait_group_add operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_group_add(wgd as usize, qt.into()) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_wait_group_add() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+//======================================================================================================================
+// wait_group_wait
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_wait_group_wait(
+    qr_out: *mut demi_qresult_t,
+    wgd: c_int,
+    timeout: *const libc::timespec,
+) -> c_int {
+    trace!("demi_wait_group_wait() {:?} {:?} {:?}", qr_out, wgd, timeout);
+
+    // Check for invalid storage location for queue result.
+    if qr_out.is_null() {
+        warn!("qr_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Check for invalid wait group descriptor.
+    if wgd < 0 {
+        return libc::EBADF;
+    }
+
+    // Convert timespec to Duration.
+    let duration: Option<Duration> = if timeout.is_null() {
+        None
+    } else {
+        // Safety: We have to trust that our user is providing a valid timeout pointer for us to dereference.
+        Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
+    };
+
+    // Issue wait_group_wait operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_group(wgd as usize, duration) {
+        Ok(r) => {
+            unsafe { *qr_out = r };
+            0
+        },
+        Err(e) => {
+            trace!("demi_wait_group_wait() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+//======================================================================================================================
+// wait_group_free
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_wait_group_free(wgd: c_int) -> c_int {
+    trace!("demi_wait_group_free() {:?}", wgd);
+
+    // Check for invalid wait group descriptor.
+    if wgd < 0 {
+        return libc::EBADF;
+    }
+
+    // Issue wait_group_free operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.free_wait_group(wgd as usize) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_wait_group_free() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 //======================================================================================================================
 // sgaalloc
 //======================================================================================================================
@@ -637,7 +893,7 @@ pub extern "C" fn demi_sgaalloc(size: libc::size_t) -> demi_sgarray_t {
             sga_segs: [demi_sgaseg_t {
                 sgaseg_buf: ptr::null_mut() as *mut c_void,
                 sgaseg_len: 0,
-            }; 1],
+            }; DEMI_SGARRAY_MAXLEN],
             sga_addr: unsafe { mem::zeroed() },
         }
     };
@@ -690,6 +946,96 @@ pub extern "C" fn demi_sgafree(sga: *mut demi_sgarray_t) -> c_int {
     }
 }
 
+//======================================================================================================================
+// sgaappend
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_sgaappend(sga: *mut demi_sgarray_t, tail: *mut demi_sgarray_t) -> c_int {
+    trace!("demi_sgaappend()");
+
+    // Check if scatter-gather arrays are invalid.
+    if sga.is_null() || tail.is_null() {
+        return libc::EINVAL;
+    }
+
+    // Issue sgaappend operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.sgaappend(unsafe { &mut *sga }, unsafe { *tail }) {
+        Ok(()) => {
+            // The tail no longer owns any buffers.
+            unsafe { *tail = mem::zeroed() };
+            0
+        },
+        Err(e) => {
+            trace!("demi_sgaappend() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+//======================================================================================================================
+// getstats
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_getstats(stats_out: *mut demi_stats_t) -> c_int {
+    trace!("demi_getstats()");
+
+    // Check for invalid storage location.
+    if stats_out.is_null() {
+        warn!("demi_getstats() stats_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Take a snapshot of the statistics.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        unsafe { *stats_out = libos.getstats() };
+        0
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+//======================================================================================================================
+// getqstats
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_getqstats(qstats_out: *mut demi_qstats_t, qd: c_int) -> c_int {
+    trace!("demi_getqstats() {:?} {:?}", qstats_out, qd);
+
+    // Check for invalid storage location.
+    if qstats_out.is_null() {
+        warn!("demi_getqstats() qstats_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Take a snapshot of the statistics of the queue.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.getqstats(qd.into()) {
+        Ok(qstats) => {
+            unsafe { *qstats_out = qstats };
+            0
+        },
+        Err(e) => {
+            trace!("demi_getqstats() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 //======================================================================================================================
 // getsockname
 //======================================================================================================================
@@ -741,13 +1087,13 @@ pub extern "C" fn demi_getsockopt(
 
 /// Issues a system call.
 fn do_syscall<T>(f: impl FnOnce(&mut LibOS) -> T) -> Result<T, Fail> {
-    match unsafe { DEMIKERNEL.try_borrow_mut() } {
+    DEMIKERNEL.with(|demikernel| match demikernel.try_borrow_mut() {
         Ok(mut libos) => match libos.as_mut() {
             Some(libos) => Ok(f(libos)),
             None => Err(Fail::new(libc::ENOSYS, "Demikernel is not initialized")),
         },
         Err(_) => Err(Fail::new(libc::EBUSY, "Demikernel is busy")),
-    }
+    })
 }
 
 /// Converts a [sockaddr] into a [SocketAddr].
@@ -5,11 +5,19 @@
 // Imports
 //======================================================================================================================
 
-#[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
+#[cfg(any(feature = "catnip-libos", feature = "catpowder-libos", feature = "profiler-trace"))]
 use crate::runtime::fail::Fail;
+#[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
+use crate::runtime::network::config::CongestionControlAlgorithm;
+#[cfg(feature = "catnip-libos")]
+use crate::runtime::network::consts::RECEIVE_BATCH_SIZE;
 use crate::MacAddress;
 #[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
 use ::anyhow::Error;
+#[cfg(feature = "profiler-trace")]
+use ::std::path::PathBuf;
+#[cfg(any(feature = "catnip-libos", feature = "profiler-trace"))]
+use ::std::time::Duration;
 #[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
 use ::std::{
     collections::HashMap,
@@ -141,6 +149,60 @@ impl Config {
         }
     }
 
+    #[cfg(feature = "catnip-libos")]
+    /// Reads the "number of DPDK queues" parameter from the underlying configuration file. Each runtime instance
+    /// claims one receive/transmit queue pair, so this bounds the number of instances that may share the device.
+    pub fn num_queues(&self) -> Result<u16, Fail> {
+        match self.0["dpdk"]["num_queues"].as_i64() {
+            Some(num_queues) => match u16::try_from(num_queues) {
+                Ok(num_queues) if num_queues > 0 => Ok(num_queues),
+                _ => Err(Fail::new(libc::EINVAL, "invalid number of DPDK queues")),
+            },
+            None => Ok(1),
+        }
+    }
+
+    #[cfg(feature = "catnip-libos")]
+    /// Reads the "receive burst size" parameter from the underlying configuration file. This is the maximum number of
+    /// packets that are taken from the network device at once, and it defaults to [RECEIVE_BATCH_SIZE].
+    pub fn rx_burst_size(&self) -> Result<usize, Fail> {
+        match self.0["dpdk"]["rx_burst_size"].as_i64() {
+            Some(rx_burst_size) if rx_burst_size > 0 && rx_burst_size as usize <= RECEIVE_BATCH_SIZE => {
+                Ok(rx_burst_size as usize)
+            },
+            Some(_) => Err(Fail::new(libc::EINVAL, "invalid receive burst size")),
+            None => Ok(RECEIVE_BATCH_SIZE),
+        }
+    }
+
+    #[cfg(feature = "catnip-libos")]
+    /// Reads spin-then-block wait settings from the "spin_then_block" subsection of catnip. Returned value is Some(spin
+    /// time) if enabled; otherwise, None. A wait call that has busy-polled for the spin time without completing
+    /// anything blocks on the receive interrupt of its queue, which requires a device that supports receive
+    /// interrupts. A missing subsection disables blocking waits.
+    pub fn catnip_spin_then_block(&self) -> Result<Option<Duration>, Fail> {
+        let section: &Yaml = &self.0["catnip"]["spin_then_block"];
+        if section.is_badvalue() {
+            return Ok(None);
+        }
+
+        let enabled: bool = match section["enabled"].as_bool() {
+            Some(enabled) => enabled,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"enabled\" has unexpected type")),
+        };
+        let spin_micros: i64 = match section["spin_micros"].as_i64() {
+            Some(spin_micros) if spin_micros >= 0 => spin_micros,
+            Some(_) => return Err(Fail::new(libc::ERANGE, "parameter \"spin_micros\" is out of range")),
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"spin_micros\" has unexpected type")),
+        };
+
+        if enabled {
+            Ok(Some(Duration::from_micros(spin_micros as u64)))
+        } else {
+            Ok(None)
+        }
+    }
+
     #[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
     /// Reads the "ARP Disable" parameter from the underlying configuration file.
     pub fn disable_arp(&self) -> bool {
@@ -184,6 +246,12 @@ impl Config {
         ::std::env::var("TCP_CHECKSUM_OFFLOAD").is_ok()
     }
 
+    #[cfg(feature = "catnip-libos")]
+    /// Gets the "TCP_SEGMENTATION_OFFLOAD" parameter from environment variables.
+    pub fn tcp_segmentation_offload(&self) -> bool {
+        ::std::env::var("TCP_SEGMENTATION_OFFLOAD").is_ok()
+    }
+
     #[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
     /// Gets the "UDP_CHECKSUM_OFFLOAD" parameter from environment variables.
     pub fn udp_checksum_offload(&self) -> bool {
@@ -195,4 +263,65 @@ impl Config {
     pub fn use_jumbo_frames(&self) -> bool {
         ::std::env::var("USE_JUMBO").is_ok()
     }
+
+    #[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
+    /// Reads the "congestion control" parameter from the section of the `libos` in the underlying configuration file.
+    /// This is the algorithm that new TCP connections of that LibOS use, and it defaults to none.
+    pub fn congestion_control(&self, libos: &str) -> Result<CongestionControlAlgorithm, Fail> {
+        let value: &Yaml = &self.0[libos]["congestion_control"];
+        if value.is_badvalue() {
+            return Ok(CongestionControlAlgorithm::None);
+        }
+
+        match value.as_str() {
+            Some("none") => Ok(CongestionControlAlgorithm::None),
+            Some("cubic") => Ok(CongestionControlAlgorithm::Cubic),
+            Some("bbr") => Ok(CongestionControlAlgorithm::Bbr),
+            _ => Err(Fail::new(libc::EINVAL, "invalid congestion control algorithm")),
+        }
+    }
+
+    #[cfg(feature = "profiler-trace")]
+    /// Reads the trace exporter settings from the "profiler" section of the underlying configuration file. Returned
+    /// value is Some((export period, folded stacks path, Chrome trace path)) if enabled; otherwise, None. A missing
+    /// section disables the exporter.
+    pub fn profiler_trace(&self) -> Result<Option<(Duration, PathBuf, PathBuf)>, Fail> {
+        let section: &Yaml = &self.0["profiler"]["trace"];
+        if section.is_badvalue() {
+            return Ok(None);
+        }
+
+        let enabled: bool = match section["enabled"].as_bool() {
+            Some(enabled) => enabled,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"enabled\" has unexpected type")),
+        };
+        let period_millis: i64 = match section["period_millis"].as_i64() {
+            Some(period_millis) if period_millis > 0 => period_millis,
+            Some(_) => return Err(Fail::new(libc::ERANGE, "parameter \"period_millis\" is out of range")),
+            None => {
+                return Err(Fail::new(
+                    libc::EINVAL,
+                    "parameter \"period_millis\" has unexpected type",
+                ))
+            },
+        };
+        let folded_path: &str = match section["folded_path"].as_str() {
+            Some(folded_path) => folded_path,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"folded_path\" has unexpected type")),
+        };
+        let chrome_path: &str = match section["chrome_path"].as_str() {
+            Some(chrome_path) => chrome_path,
+            None => return Err(Fail::new(libc::EINVAL, "parameter \"chrome_path\" has unexpected type")),
+        };
+
+        if enabled {
+            Ok(Some((
+                Duration::from_millis(period_millis as u64),
+                PathBuf::from(folded_path),
+                PathBuf::from(chrome_path),
+            )))
+        } else {
+            Ok(None)
+        }
+    }
 }
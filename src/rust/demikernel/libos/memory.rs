@@ -9,7 +9,9 @@ use crate::runtime::{
     fail::Fail,
     types::{
         demi_qresult_t,
+        demi_qstats_t,
         demi_sgarray_t,
+        demi_stats_t,
     },
     QDesc,
     QToken,
@@ -92,6 +94,16 @@ impl MemoryLibOS {
         }
     }
 
+    /// Pops data from a memory queue straight into the buffer of a scatter-gather array.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn pop_into(&mut self, memqd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime: _, libos } => libos.pop_into(memqd, sga),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
     /// Waits for a pending I/O operation to complete or a timeout to expire.
     /// This is just a single-token convenience wrapper for wait_any().
     pub fn wait(&mut self, qt: QToken, timeout: Duration) -> Result<demi_qresult_t, Fail> {
@@ -116,6 +128,71 @@ impl MemoryLibOS {
         }
     }
 
+    /// Waits for any of the given pending I/O operations to complete or a timeout to expire, and returns the results
+    /// of as many completed operations as fit in `qrs_out`.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn wait_many(
+        &mut self,
+        qts: &[QToken],
+        qrs_out: &mut [demi_qresult_t],
+        timeout: Duration,
+    ) -> Result<usize, Fail> {
+        trace!(
+            "wait_many(): qts={:?}, max={:?}, timeout={:?}",
+            qts,
+            qrs_out.len(),
+            timeout
+        );
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => runtime.wait_many(qts, qrs_out, timeout),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
+    /// Allocates a new, empty wait group.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn alloc_wait_group(&mut self) -> Result<usize, Fail> {
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => Ok(runtime.alloc_wait_group()),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
+    /// Registers a pending I/O operation in a wait group.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn wait_group_add(&mut self, wgd: usize, qt: QToken) -> Result<(), Fail> {
+        trace!("wait_group_add(): wgd={:?}, qt={:?}", wgd, qt);
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => runtime.wait_group_add(wgd, qt),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
+    /// Waits for any of the pending I/O operations in a wait group to complete or a timeout to expire.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn wait_group(&mut self, wgd: usize, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        trace!("wait_group(): wgd={:?}, timeout={:?}", wgd, timeout);
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => runtime.wait_group(wgd, timeout),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
+    /// Releases a wait group.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn free_wait_group(&mut self, wgd: usize) -> Result<(), Fail> {
+        trace!("free_wait_group(): wgd={:?}", wgd);
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => runtime.free_wait_group(wgd),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
     /// Allocates a scatter-gather array.
     #[allow(unreachable_patterns, unused_variables)]
     pub fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
@@ -136,6 +213,36 @@ impl MemoryLibOS {
         }
     }
 
+    /// Appends the segments of a scatter-gather array to another one.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn sgaappend(&self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => runtime.sgaappend(sga, tail),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
+    /// Returns a snapshot of the statistics of this thread.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn getstats(&self) -> demi_stats_t {
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => runtime.get_stats(),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
+    /// Returns a snapshot of the statistics of an I/O queue.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn getqstats(&self, memqd: QDesc) -> Result<demi_qstats_t, Fail> {
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem { runtime, libos: _ } => runtime.get_qstats(&memqd),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
     /// Waits for any operation in an I/O queue.
     #[allow(unreachable_patterns, unused_variables)]
     pub fn poll(&mut self) {
@@ -34,7 +34,9 @@ use crate::{
         logging,
         types::{
             demi_qresult_t,
+            demi_qstats_t,
             demi_sgarray_t,
+            demi_stats_t,
         },
         QDesc,
         QToken,
@@ -93,6 +95,10 @@ impl LibOS {
             },
         };
         let config: Config = Config::new(config_path);
+        #[cfg(feature = "profiler-trace")]
+        if let Some((period, folded_path, chrome_path)) = config.profiler_trace()? {
+            crate::perftools::profiler::trace::start_exporter(period, folded_path, chrome_path)?;
+        }
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
         // Instantiate LibOS.
         #[allow(unreachable_patterns)]
@@ -120,7 +126,7 @@ impl LibOS {
             #[cfg(feature = "catnip-libos")]
             LibOSName::Catnip => {
                 // TODO: Remove some of these clones once we are done merging the libOSes.
-                let transport: SharedDPDKRuntime = SharedDPDKRuntime::new(config.clone())?;
+                let transport: SharedDPDKRuntime = SharedDPDKRuntime::new(config.clone(), &mut runtime)?;
                 let inetstack: SharedInetStack<SharedDPDKRuntime> =
                     SharedInetStack::<SharedDPDKRuntime>::new(config.clone(), runtime.clone(), transport).unwrap();
 
@@ -374,6 +380,23 @@ impl LibOS {
         result
     }
 
+    /// Pops data from an I/O queue straight into the buffer of a scatter-gather array, which the application keeps
+    /// owning. The completed pop returns a scatter-gather array that covers the received data in that buffer.
+    pub fn pop_into(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
+        let result: Result<QToken, Fail> = {
+            #[cfg(feature = "profiler")]
+            timer!("demikernel::pop_into");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.pop_into(qd, sga),
+                LibOS::MemoryLibOS(libos) => libos.pop_into(qd, sga),
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
     /// Waits for a pending I/O operation to complete or a timeout to expire.
     /// This is just a single-token convenience wrapper for wait_any().
     pub fn wait(&mut self, qt: QToken, timeout: Option<Duration>) -> Result<demi_qresult_t, Fail> {
@@ -395,6 +418,62 @@ impl LibOS {
         }
     }
 
+    /// Waits for any of the given pending I/O operations to complete or a timeout to expire, and returns the results
+    /// of as many completed operations as fit in `qrs_out`.
+    pub fn wait_many(
+        &mut self,
+        qts: &[QToken],
+        qrs_out: &mut [demi_qresult_t],
+        timeout: Option<Duration>,
+    ) -> Result<usize, Fail> {
+        #[cfg(feature = "profiler")]
+        timer!("demikernel::wait_many");
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.wait_many(qts, qrs_out, timeout.unwrap_or(DEFAULT_TIMEOUT)),
+            LibOS::MemoryLibOS(libos) => libos.wait_many(qts, qrs_out, timeout.unwrap_or(DEFAULT_TIMEOUT)),
+        }
+    }
+
+    /// Allocates a new, empty wait group.
+    pub fn alloc_wait_group(&mut self) -> Result<usize, Fail> {
+        #[cfg(feature = "profiler")]
+        timer!("demikernel::alloc_wait_group");
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.alloc_wait_group(),
+            LibOS::MemoryLibOS(libos) => libos.alloc_wait_group(),
+        }
+    }
+
+    /// Registers a pending I/O operation in a wait group.
+    pub fn wait_group_add(&mut self, wgd: usize, qt: QToken) -> Result<(), Fail> {
+        #[cfg(feature = "profiler")]
+        timer!("demikernel::wait_group_add");
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.wait_group_add(wgd, qt),
+            LibOS::MemoryLibOS(libos) => libos.wait_group_add(wgd, qt),
+        }
+    }
+
+    /// Waits for any of the pending I/O operations in a wait group to complete or a timeout to expire.
+    pub fn wait_group(&mut self, wgd: usize, timeout: Option<Duration>) -> Result<demi_qresult_t, Fail> {
+        #[cfg(feature = "profiler")]
+        timer!("demikernel::wait_group");
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.wait_group(wgd, timeout.unwrap_or(DEFAULT_TIMEOUT)),
+            LibOS::MemoryLibOS(libos) => libos.wait_group(wgd, timeout.unwrap_or(DEFAULT_TIMEOUT)),
+        }
+    }
+
+    /// Releases a wait group.
+    pub fn free_wait_group(&mut self, wgd: usize) -> Result<(), Fail> {
+        #[cfg(feature = "profiler")]
+        timer!("demikernel::free_wait_group");
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.free_wait_group(wgd),
+            LibOS::MemoryLibOS(libos) => libos.free_wait_group(wgd),
+        }
+    }
+
     /// Allocates a scatter-gather array.
     pub fn sgaalloc(&mut self, size: usize) -> Result<demi_sgarray_t, Fail> {
         let result: Result<demi_sgarray_t, Fail> = {
@@ -423,6 +502,36 @@ impl LibOS {
         result
     }
 
+    /// Appends the segments of a scatter-gather array to another one.
+    pub fn sgaappend(&mut self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            #[cfg(feature = "profiler")]
+            timer!("demikernel::sgaappend");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.sgaappend(sga, tail),
+                LibOS::MemoryLibOS(libos) => libos.sgaappend(sga, tail),
+            }
+        };
+
+        result
+    }
+
+    /// Returns a snapshot of the statistics of this thread.
+    pub fn getstats(&self) -> demi_stats_t {
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.getstats(),
+            LibOS::MemoryLibOS(libos) => libos.getstats(),
+        }
+    }
+
+    /// Returns a snapshot of the statistics of an I/O queue.
+    pub fn getqstats(&self, qd: QDesc) -> Result<demi_qstats_t, Fail> {
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.getqstats(qd),
+            LibOS::MemoryLibOS(libos) => libos.getqstats(qd),
+        }
+    }
+
     fn poll(&mut self) {
         #[cfg(feature = "profiler")]
         timer!("demikernel::poll");
@@ -12,6 +12,7 @@ use crate::{
         fail::Fail,
         limits,
         memory::{
+            self,
             DemiBuffer,
             MemoryRuntime,
         },
@@ -338,7 +339,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
     /// begins.
     pub fn push(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
         let buf: DemiBuffer = self.runtime.clone_sgarray(sga)?;
-        if buf.len() == 0 {
+        if buf.total_len() == 0 {
             let cause: String = format!("zero-length buffer");
             warn!("push(): {}", cause);
             return Err(Fail::new(libc::EINVAL, &cause));
@@ -382,7 +383,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         trace!("pushto() qd={:?}", qd);
 
         let buf: DemiBuffer = self.runtime.clone_sgarray(sga)?;
-        if buf.len() == 0 {
+        if buf.total_len() == 0 {
             return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
         }
 
@@ -440,6 +441,32 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
     /// function returns a coroutine that asynchronously runs pop and performs any necessary multi-queue operations at
     /// the libOS-level after the pop succeeds or fails.
     async fn pop_coroutine(self, qd: QDesc, size: Option<usize>) -> (QDesc, OperationResult) {
+        let size: usize = size.unwrap_or(limits::RECVBUF_SIZE_MAX);
+        self.pop_into_coroutine(qd, DemiBuffer::new(size as u16)).await
+    }
+
+    /// Synchronous code to pop data from a SharedNetworkQueue and its underlying POSIX socket straight into the buffer
+    /// of [sga], which the application owns. This function schedules the asynchronous coroutine and performs any
+    /// necessary synchronous, multi-queue operations at the libOS-level before beginning the pop.
+    pub fn pop_into(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
+        trace!("pop_into() qd={:?}", qd);
+
+        let buf: DemiBuffer = memory::into_pop_target(self.runtime.clone_sgarray(sga)?)?;
+
+        let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let coroutine_constructor = || -> Result<QToken, Fail> {
+            let task_name: String = format!("NetworkLibOS::pop_into for qd={:?}", qd);
+            let coroutine: Pin<Box<Operation>> = Box::pin(self.clone().pop_into_coroutine(qd, buf).fuse());
+            self.runtime.clone().insert_io_coroutine(&task_name, coroutine)
+        };
+
+        queue.pop(coroutine_constructor)
+    }
+
+    /// Asynchronous code to pop data from a SharedNetworkQueue and its underlying POSIX socket into [buf]. This
+    /// function returns a coroutine that asynchronously runs pop and performs any necessary multi-queue operations at
+    /// the libOS-level after the pop succeeds or fails.
+    async fn pop_into_coroutine(self, qd: QDesc, buf: DemiBuffer) -> (QDesc, OperationResult) {
         // Grab the queue, make sure it hasn't been closed in the meantime.
         // This will bump the Rc refcount so the coroutine can have it's own reference to the shared queue data
         // structure and the SharedNetworkQueue will not be freed until this coroutine finishes.
@@ -449,7 +476,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         };
 
         // Wait for pop to complete.
-        match queue.pop_coroutine(size).await {
+        match queue.pop_into_coroutine(buf).await {
             // FIXME: add IPv6 support; https://github.com/microsoft/demikernel/issues/935
             Ok((Some(addr), buf)) => (
                 qd,
@@ -532,4 +559,8 @@ impl<T: NetworkTransport> MemoryRuntime for SharedNetworkLibOS<T> {
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
         self.transport.sgafree(sga)
     }
+
+    fn sgaappend(&self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        self.transport.sgaappend(sga, tail)
+    }
 }
@@ -21,7 +21,9 @@ use crate::{
         memory::MemoryRuntime,
         types::{
             demi_qresult_t,
+            demi_qstats_t,
             demi_sgarray_t,
+            demi_stats_t,
         },
         QDesc,
         QToken,
@@ -234,6 +236,20 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Pops data from a socket straight into the buffer of a scatter-gather array.
+    pub fn pop_into(&mut self, sockqd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime: _, libos } => libos.pop_into(sockqd, sga),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime: _, libos } => libos.pop_into(sockqd, sga),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime: _, libos } => libos.pop_into(sockqd, sga),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime: _, libos } => libos.pop_into(sockqd, sga),
+        }
+    }
+
     /// Waits for a pending I/O operation to complete or a timeout to expire.
     /// This is just a single-token convenience wrapper for wait_any().
     pub fn wait(&mut self, qt: QToken, timeout: Duration) -> Result<demi_qresult_t, Fail> {
@@ -262,6 +278,110 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Waits for any of the given pending I/O operations to complete or a timeout to expire, and returns the results
+    /// of as many completed operations as fit in `qrs_out`.
+    pub fn wait_many(
+        &mut self,
+        qts: &[QToken],
+        qrs_out: &mut [demi_qresult_t],
+        timeout: Duration,
+    ) -> Result<usize, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime, libos: _ } => runtime.wait_many(qts, qrs_out, timeout),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime, libos: _ } => runtime.wait_many(qts, qrs_out, timeout),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime, libos: _ } => runtime.wait_many(qts, qrs_out, timeout),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.wait_many(qts, qrs_out, timeout),
+        }
+    }
+
+    /// Allocates a new, empty wait group.
+    pub fn alloc_wait_group(&mut self) -> Result<usize, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime, libos: _ } => Ok(runtime.alloc_wait_group()),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime, libos: _ } => Ok(runtime.alloc_wait_group()),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime, libos: _ } => Ok(runtime.alloc_wait_group()),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => Ok(runtime.alloc_wait_group()),
+        }
+    }
+
+    /// Registers a pending I/O operation in a wait group.
+    pub fn wait_group_add(&mut self, wgd: usize, qt: QToken) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime, libos: _ } => runtime.wait_group_add(wgd, qt),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime, libos: _ } => runtime.wait_group_add(wgd, qt),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime, libos: _ } => runtime.wait_group_add(wgd, qt),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.wait_group_add(wgd, qt),
+        }
+    }
+
+    /// Waits for any of the pending I/O operations in a wait group to complete or a timeout to expire.
+    pub fn wait_group(&mut self, wgd: usize, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime, libos: _ } => runtime.wait_group(wgd, timeout),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime, libos: _ } => runtime.wait_group(wgd, timeout),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime, libos: _ } => runtime.wait_group(wgd, timeout),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.wait_group(wgd, timeout),
+        }
+    }
+
+    /// Releases a wait group.
+    pub fn free_wait_group(&mut self, wgd: usize) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime, libos: _ } => runtime.free_wait_group(wgd),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime, libos: _ } => runtime.free_wait_group(wgd),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime, libos: _ } => runtime.free_wait_group(wgd),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.free_wait_group(wgd),
+        }
+    }
+
+    /// Returns a snapshot of the statistics of this thread.
+    pub fn getstats(&self) -> demi_stats_t {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime, libos: _ } => runtime.get_stats(),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime, libos: _ } => runtime.get_stats(),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime, libos: _ } => runtime.get_stats(),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.get_stats(),
+        }
+    }
+
+    /// Returns a snapshot of the statistics of an I/O queue.
+    pub fn getqstats(&self, qd: QDesc) -> Result<demi_qstats_t, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime, libos: _ } => runtime.get_qstats(&qd),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime, libos: _ } => runtime.get_qstats(&qd),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime, libos: _ } => runtime.get_qstats(&qd),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.get_qstats(&qd),
+        }
+    }
+
     /// Waits for any operation in an I/O queue.
     pub fn poll(&mut self) {
         match self {
@@ -307,4 +427,18 @@ impl NetworkLibOSWrapper {
             NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.sgafree(sga),
         }
     }
+
+    /// Appends the segments of a scatter-gather array to another one.
+    pub fn sgaappend(&self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder { runtime: _, libos } => libos.sgaappend(sga, tail),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap { runtime: _, libos } => libos.sgaappend(sga, tail),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip { runtime: _, libos } => libos.sgaappend(sga, tail),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOSWrapper::Catloop { runtime, libos: _ } => runtime.sgaappend(sga, tail),
+        }
+    }
 }
@@ -307,9 +307,15 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
     /// Asynchronously pops data from the queue. This function contains all of the single-queue, asynchronous code
     /// necessary to pop from a queue and any single-queue functionality after the pop completes.
     pub async fn pop_coroutine(&mut self, size: Option<usize>) -> Result<(Option<SocketAddr>, DemiBuffer), Fail> {
-        self.state_machine.may_pop()?;
         let size: usize = size.unwrap_or(limits::RECVBUF_SIZE_MAX);
-        let mut buf: DemiBuffer = DemiBuffer::new(size as u16);
+        self.pop_into_coroutine(DemiBuffer::new(size as u16)).await
+    }
+
+    /// Asynchronous code to pop data from this queue straight into `buf`, which is returned trimmed down to the data
+    /// that was received.
+    pub async fn pop_into_coroutine(&mut self, mut buf: DemiBuffer) -> Result<(Option<SocketAddr>, DemiBuffer), Fail> {
+        self.state_machine.may_pop()?;
+        let size: usize = buf.len();
 
         let result = {
             let mut state_machine: SocketStateMachine = self.state_machine.clone();
@@ -0,0 +1,119 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::net::SocketAddrV4;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of slots in a flow cache. This must be a power of two.
+const FLOW_CACHE_SIZE: usize = 64;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// # Flow Cache
+///
+/// Small direct-mapped cache of recently seen flows, which sits in front of a flow table so that back-to-back packets
+/// of the same flow skip the table lookup. Flows are identified by their local and remote addresses. Slots are picked
+/// with a cheap fold of the addresses rather than a keyed hash: a remote peer that crafts colliding flows may only
+/// thrash the cache, which then falls back to the table.
+///
+/// The cache must be cleared whenever the table changes.
+pub struct FlowCache<V> {
+    slots: [Option<(SocketAddrV4, SocketAddrV4, V)>; FLOW_CACHE_SIZE],
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl<V: Clone> FlowCache<V> {
+    /// Creates an empty flow cache.
+    pub fn new() -> Self {
+        Self {
+            slots: ::std::array::from_fn(|_| None),
+        }
+    }
+
+    /// Looks up the value cached for a flow.
+    pub fn get(&self, local: &SocketAddrV4, remote: &SocketAddrV4) -> Option<&V> {
+        match &self.slots[Self::slot(local, remote)] {
+            Some((slot_local, slot_remote, value)) if slot_local == local && slot_remote == remote => Some(value),
+            _ => None,
+        }
+    }
+
+    /// Caches the value of a flow, evicting the flow that used the same slot, if any.
+    pub fn insert(&mut self, local: SocketAddrV4, remote: SocketAddrV4, value: V) {
+        self.slots[Self::slot(&local, &remote)] = Some((local, remote, value));
+    }
+
+    /// Evicts all flows.
+    pub fn clear(&mut self) {
+        for slot in self.slots.iter_mut() {
+            *slot = None;
+        }
+    }
+
+    /// Computes the slot of a flow.
+    fn slot(local: &SocketAddrV4, remote: &SocketAddrV4) -> usize {
+        let remote_ip: u32 = u32::from(*remote.ip());
+        let ports: u32 = ((remote.port() as u32) << 16) | local.port() as u32;
+        let folded: u32 = remote_ip ^ ports;
+        (folded ^ (folded >> 16) ^ (folded >> 8)) as usize & (FLOW_CACHE_SIZE - 1)
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl<V: Clone> Default for FlowCache<V> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ::anyhow::Result;
+    use ::std::net::Ipv4Addr;
+
+    /// Tests that cached flows are found until they get evicted.
+    #[test]
+    fn test_get_insert_clear() -> Result<()> {
+        let mut cache: FlowCache<usize> = FlowCache::new();
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+        let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 49152);
+        crate::ensure_eq!(cache.get(&local, &remote), None);
+
+        cache.insert(local, remote, 1);
+        crate::ensure_eq!(cache.get(&local, &remote), Some(&1));
+        crate::ensure_eq!(cache.get(&remote, &local), None);
+
+        // A flow that uses the same slot evicts the previous one.
+        let mut other: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 49153);
+        while FlowCache::<usize>::slot(&local, &other) != FlowCache::<usize>::slot(&local, &remote) {
+            other.set_port(other.port() + 1);
+        }
+        cache.insert(local, other, 2);
+        crate::ensure_eq!(cache.get(&local, &other), Some(&2));
+        crate::ensure_eq!(cache.get(&local, &remote), None);
+
+        cache.clear();
+        crate::ensure_eq!(cache.get(&local, &other), None);
+        Ok(())
+    }
+}
@@ -0,0 +1,195 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Fast hasher for flow tables.
+//!
+//! Flow tables are keyed by small, fixed-size keys (addresses and ports) and are looked up for every incoming packet,
+//! so SipHash, the default hasher of [HashMap], is needlessly expensive for them. [FlowHasher] mixes the key one word
+//! at a time with a folded 64x64-bit multiplication instead. Its keys are drawn from the per-process randomness of the
+//! standard library, so that remote peers cannot craft addresses that collide in our tables.
+//!
+//! [HashMap]: std::collections::HashMap
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::{
+    collections::hash_map::RandomState,
+    hash::{
+        BuildHasher,
+        Hasher,
+    },
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Odd multiplier of the mixing step (the fractional part of pi), which spreads low entropy keys over all bits.
+const MULTIPLIER: u64 = 0x243f_6a88_85a3_08d3;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Builds [FlowHasher]s that share keys drawn at construction time.
+#[derive(Clone, Copy, Debug)]
+pub struct FlowHashBuilder {
+    keys: [u64; 2],
+}
+
+/// Keyed folded-multiply hasher for small keys. This is not a cryptographic hash.
+#[derive(Clone, Copy, Debug)]
+pub struct FlowHasher {
+    state: u64,
+    key: u64,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl FlowHashBuilder {
+    /// Creates a builder with random keys.
+    pub fn new() -> Self {
+        let random_state: RandomState = RandomState::new();
+        let mut keys: [u64; 2] = [0; 2];
+        for (i, key) in keys.iter_mut().enumerate() {
+            let mut hasher = random_state.build_hasher();
+            hasher.write_usize(i);
+            *key = hasher.finish();
+        }
+        Self::with_keys(keys)
+    }
+
+    /// Creates a builder with the given keys.
+    pub fn with_keys(keys: [u64; 2]) -> Self {
+        Self { keys }
+    }
+}
+
+impl FlowHasher {
+    /// Mixes a word into the state.
+    #[inline(always)]
+    fn mix(&mut self, word: u64) {
+        self.state = folded_multiply(self.state ^ word, MULTIPLIER ^ self.key);
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Default for FlowHashBuilder {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl BuildHasher for FlowHashBuilder {
+    type Hasher = FlowHasher;
+
+    fn build_hasher(&self) -> Self::Hasher {
+        FlowHasher {
+            state: self.keys[0],
+            key: self.keys[1],
+        }
+    }
+}
+
+impl Hasher for FlowHasher {
+    fn write(&mut self, bytes: &[u8]) {
+        let mut chunks_iter: ::std::slice::ChunksExact<u8> = bytes.chunks_exact(8);
+        while let Some(chunk) = chunks_iter.next() {
+            self.mix(u64::from_le_bytes([
+                chunk[0], chunk[1], chunk[2], chunk[3], chunk[4], chunk[5], chunk[6], chunk[7],
+            ]));
+        }
+        let remainder: &[u8] = chunks_iter.remainder();
+        if !remainder.is_empty() {
+            let mut tail: [u8; 8] = [0; 8];
+            tail[..remainder.len()].copy_from_slice(remainder);
+            // Tag the tail with its length, so that keys that only differ by trailing zeros do not collide.
+            self.mix(u64::from_le_bytes(tail) ^ ((remainder.len() as u64) << 59));
+        }
+    }
+
+    fn write_u8(&mut self, i: u8) {
+        self.mix(i as u64);
+    }
+
+    fn write_u16(&mut self, i: u16) {
+        self.mix(i as u64);
+    }
+
+    fn write_u32(&mut self, i: u32) {
+        self.mix(i as u64);
+    }
+
+    fn write_u64(&mut self, i: u64) {
+        self.mix(i);
+    }
+
+    fn write_usize(&mut self, i: usize) {
+        self.mix(i as u64);
+    }
+
+    fn finish(&self) -> u64 {
+        // A last round makes the high bits, which the hash map uses for tagging, depend on the whole state.
+        folded_multiply(self.state, self.key.rotate_left(32) ^ MULTIPLIER)
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Multiplies two words into a 128-bit product and folds its two halves together.
+#[inline(always)]
+fn folded_multiply(a: u64, b: u64) -> u64 {
+    let product: u128 = (a as u128) * (b as u128);
+    (product as u64) ^ ((product >> 64) as u64)
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ::anyhow::Result;
+    use ::std::{
+        collections::HashSet,
+        net::{
+            Ipv4Addr,
+            SocketAddrV4,
+        },
+    };
+
+    /// Tests that hashes depend on the keys of the builder.
+    #[test]
+    fn test_keys() -> Result<()> {
+        let addr: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+        let a: FlowHashBuilder = FlowHashBuilder::with_keys([1, 2]);
+        let b: FlowHashBuilder = FlowHashBuilder::with_keys([3, 4]);
+        crate::ensure_eq!(a.hash_one(&addr), FlowHashBuilder::with_keys([1, 2]).hash_one(&addr));
+        crate::ensure_neq!(a.hash_one(&addr), b.hash_one(&addr));
+        Ok(())
+    }
+
+    /// Tests that flows that only differ by a port do not collide.
+    #[test]
+    fn test_no_collisions() -> Result<()> {
+        let builder: FlowHashBuilder = FlowHashBuilder::new();
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+        let mut hashes: HashSet<u64> = HashSet::new();
+        for port in 0..=u16::MAX {
+            let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), port);
+            hashes.insert(builder.hash_one(&(local, remote)));
+        }
+        crate::ensure_eq!(hashes.len(), u16::MAX as usize + 1);
+        Ok(())
+    }
+}
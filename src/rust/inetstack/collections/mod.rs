@@ -1,6 +1,10 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+pub mod flow_cache;
+pub mod flow_hash;
 pub mod hashttlcache;
 
+pub use flow_cache::FlowCache;
+pub use flow_hash::FlowHashBuilder;
 pub use hashttlcache::HashTtlCache;
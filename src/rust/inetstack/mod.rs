@@ -31,6 +31,10 @@ use crate::{
             NetworkRuntime,
         },
         poll_yield,
+        stats::{
+            with_stats,
+            ThreadStats,
+        },
         SharedDemiRuntime,
         SharedObject,
     },
@@ -136,6 +140,10 @@ impl<N: NetworkRuntime> SharedInetStack<N> {
             arp.clone(),
             rng_seed,
         )?;
+        // Packets that coroutines queue for transmission after our poll loop has run are sent out at the end of the
+        // scheduler quantum, instead of waiting for our next turn.
+        let mut flush_network: N = network.clone();
+        runtime.set_transmit_flush(Box::new(move || flush_network.flush()));
         let me: Self = Self(SharedObject::<InetStack<N>>::new(InetStack::<N> {
             arp,
             ipv4,
@@ -171,13 +179,33 @@ impl<N: NetworkRuntime> SharedInetStack<N> {
                         break;
                     }
 
-                    for pkt in batch {
-                        if let Err(e) = self.receive(pkt) {
+                    let mut batch = batch.into_iter().peekable();
+                    while let Some(pkt) = batch.next() {
+                        // Start loading the headers of the next packet while we process this one.
+                        if let Some(next_pkt) = batch.peek() {
+                            next_pkt.prefetch();
+                        }
+                        with_stats(|s: &ThreadStats| {
+                            s.rx_packets.incr();
+                            s.rx_bytes.add(pkt.len() as u64);
+                        });
+                        if let Err(e) = self.receive_unflushed(pkt) {
+                            with_stats(|s: &ThreadStats| s.rx_drops.incr());
                             warn!("incorrectly formatted packet: {:?}", e);
                         }
                     }
+                    // Deliver the runs of segments that were coalesced during this batch.
+                    self.ipv4.flush_receive();
                 }
             }
+            {
+                #[cfg(feature = "profiler")]
+                timer!("inetstack::poll_bg_work::flush");
+
+                // Send out the replies to the packets that we just received right away. Whatever other coroutines queue
+                // afterwards is flushed by the runtime at the end of the scheduler quantum.
+                self.network.flush();
+            }
             poll_yield().await;
         }
     }
@@ -214,7 +242,17 @@ impl<N: NetworkRuntime> SharedInetStack<N> {
         self.arp.export_cache()
     }
 
+    /// Processes a single incoming frame. Segments that were held back for coalescing are dispatched before this
+    /// returns.
     pub fn receive(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
+        let result: Result<(), Fail> = self.receive_unflushed(pkt);
+        self.ipv4.flush_receive();
+        result
+    }
+
+    /// Processes an incoming frame of a receive batch. TCP segments may be held back for coalescing with the following
+    /// frames of the batch, so the caller must call `flush_receive()` once the batch is over.
+    fn receive_unflushed(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
         let (header, payload) = Ethernet2Header::parse(pkt)?;
         debug!("Engine received {:?}", header);
         if self.local_link_addr != header.dst_addr()
@@ -463,6 +501,10 @@ impl<N: NetworkRuntime> MemoryRuntime for InetStack<N> {
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
         self.network.sgafree(sga)
     }
+
+    fn sgaappend(&self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        self.network.sgaappend(sga, tail)
+    }
 }
 
 impl<N: NetworkRuntime> Debug for Socket<N> {
@@ -241,7 +241,7 @@ fn serialize_arp_message(pkt: &ArpMessage) -> DemiBuffer {
     let mut buf: DemiBuffer = DemiBuffer::new((header_size + body_size) as u16);
     pkt.write_header(&mut buf[..header_size]);
     if let Some(body) = pkt.take_body() {
-        buf[header_size..].copy_from_slice(&body[..]);
+        body.copy_to_slice(&mut buf[header_size..]);
     }
     buf
 }
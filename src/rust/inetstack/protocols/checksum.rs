@@ -0,0 +1,292 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Internet checksum (RFC 1071).
+//!
+//! This is the checksum used by IPv4, ICMPv4, UDP and TCP: the 16-bit one's complement of the one's complement sum of
+//! all 16-bit words in the checksummed data. Sums are kept unfolded-and-uncomplemented ([sum]) so that they can be
+//! computed piecewise and combined with [add], e.g. to checksum a retransmitted segment without summing its payload
+//! again.
+//!
+//! The one's complement sum is byte-order independent (RFC 1071, Section 2), so the kernels below sum the data in
+//! native byte order, many words at a time, and only swap the final 16-bit result into network byte order.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use ::std::net::Ipv4Addr;
+
+#[cfg(target_arch = "x86_64")]
+use ::std::arch::x86_64::{
+    __m256i,
+    _mm256_add_epi32,
+    _mm256_loadu_si256,
+    _mm256_setzero_si256,
+    _mm256_storeu_si256,
+    _mm256_unpackhi_epi16,
+    _mm256_unpacklo_epi16,
+};
+
+#[cfg(target_arch = "aarch64")]
+use ::std::arch::aarch64::{
+    uint32x4_t,
+    vaddlvq_u32,
+    vdupq_n_u32,
+    vld1q_u8,
+    vpadalq_u16,
+    vreinterpretq_u16_u8,
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Buffers shorter than this (in bytes) are summed by the scalar kernel, as headers are too short to amortize the setup
+/// of the vector kernels.
+#[cfg(any(target_arch = "x86_64", target_arch = "aarch64"))]
+const VECTOR_MIN_LEN: usize = 128;
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Computes the one's complement sum of `buf`, in network byte order. If `buf` has an odd length, it is padded with
+/// a zero octet at the end.
+///
+/// Sums of consecutive pieces of some data may be combined with [add], as long as all pieces but the last one have an
+/// even length.
+pub fn sum(buf: &[u8]) -> u16 {
+    let native: u64 = sum_native(buf);
+    u16::from_be(fold(native))
+}
+
+/// Computes the one's complement sum of consecutive `pieces` of some data (e.g. the segments of a buffer chain), in
+/// network byte order. Pieces may have any length: the sum of a piece that starts at an odd offset is byte-swapped, as
+/// its octets sit in the other half of each 16-bit word (RFC 1071, Section 2).
+pub fn sum_pieces<'a>(pieces: impl IntoIterator<Item = &'a [u8]>) -> u16 {
+    let mut state: u16 = 0;
+    let mut odd: bool = false;
+    for piece in pieces {
+        let piece_sum: u16 = sum(piece);
+        state = add(state, if odd { piece_sum.swap_bytes() } else { piece_sum });
+        odd ^= piece.len() % 2 == 1;
+    }
+    state
+}
+
+/// Adds two one's complement sums.
+pub fn add(a: u16, b: u16) -> u16 {
+    fold(a as u64 + b as u64)
+}
+
+/// Turns a one's complement sum into a checksum.
+pub fn finish(sum: u16) -> u16 {
+    !sum
+}
+
+/// Computes the one's complement sum of the IPv4 pseudo-header that prefixes TCP and UDP checksums.
+pub fn pseudo_header_sum(src_addr: &Ipv4Addr, dst_addr: &Ipv4Addr, protocol: u8, length: u16) -> u16 {
+    let src_octets: [u8; 4] = src_addr.octets();
+    let dst_octets: [u8; 4] = dst_addr.octets();
+    let state: u64 = u16::from_be_bytes([src_octets[0], src_octets[1]]) as u64
+        + u16::from_be_bytes([src_octets[2], src_octets[3]]) as u64
+        + u16::from_be_bytes([dst_octets[0], dst_octets[1]]) as u64
+        + u16::from_be_bytes([dst_octets[2], dst_octets[3]]) as u64
+        + protocol as u64
+        + length as u64;
+    fold(state)
+}
+
+/// Folds a 64-bit accumulator into a 16-bit one's complement sum.
+fn fold(mut state: u64) -> u16 {
+    while state > 0xffff {
+        state = (state & 0xffff) + (state >> 16);
+    }
+    state as u16
+}
+
+/// Computes the one's complement sum of `buf` in native byte order, using the fastest kernel for this processor.
+fn sum_native(buf: &[u8]) -> u64 {
+    #[cfg(target_arch = "x86_64")]
+    if buf.len() >= VECTOR_MIN_LEN && (cfg!(target_feature = "avx2") || is_x86_feature_detected!("avx2")) {
+        // Safety: We just checked that the processor supports AVX2.
+        return unsafe { sum_native_avx2(buf) };
+    }
+
+    #[cfg(target_arch = "aarch64")]
+    if buf.len() >= VECTOR_MIN_LEN {
+        // Safety: NEON is part of the baseline of aarch64.
+        return unsafe { sum_native_neon(buf) };
+    }
+
+    sum_native_scalar(buf)
+}
+
+/// Scalar kernel: sums eight bytes per iteration as two 32-bit words, which cannot overflow the accumulator for any
+/// buffer that fits in memory.
+fn sum_native_scalar(buf: &[u8]) -> u64 {
+    let mut state: u64 = 0;
+
+    let mut chunks_iter: ::std::slice::ChunksExact<u8> = buf.chunks_exact(8);
+    while let Some(chunk) = chunks_iter.next() {
+        state += u32::from_ne_bytes([chunk[0], chunk[1], chunk[2], chunk[3]]) as u64;
+        state += u32::from_ne_bytes([chunk[4], chunk[5], chunk[6], chunk[7]]) as u64;
+    }
+
+    let mut words_iter: ::std::slice::ChunksExact<u8> = chunks_iter.remainder().chunks_exact(2);
+    while let Some(word) = words_iter.next() {
+        state += u16::from_ne_bytes([word[0], word[1]]) as u64;
+    }
+
+    // Pad the last octet with zero, if the buffer has an odd length.
+    if let Some(&b) = words_iter.remainder().get(0) {
+        state += u16::from_ne_bytes([b, 0]) as u64;
+    }
+
+    state
+}
+
+/// AVX2 kernel: widens sixteen 16-bit words into 32-bit lanes per iteration.
+///
+/// Each lane of an accumulator grows by at most `0xffff` per iteration, so it is drained into a 64-bit sum every
+/// `u16::MAX` iterations, well before it could overflow.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn sum_native_avx2(buf: &[u8]) -> u64 {
+    const BLOCK_SIZE: usize = 32;
+    let zero: __m256i = _mm256_setzero_si256();
+    let mut state: u64 = 0;
+
+    let mut blocks_iter: ::std::slice::ChunksExact<u8> = buf.chunks_exact(BLOCK_SIZE);
+    loop {
+        let mut lo: __m256i = zero;
+        let mut hi: __m256i = zero;
+        let mut nblocks: usize = 0;
+        while nblocks < u16::MAX as usize {
+            let block: &[u8] = match blocks_iter.next() {
+                Some(block) => block,
+                None => break,
+            };
+            // Safety: The block holds exactly 32 bytes, and this is an unaligned load.
+            let v: __m256i = _mm256_loadu_si256(block.as_ptr() as *const __m256i);
+            lo = _mm256_add_epi32(lo, _mm256_unpacklo_epi16(v, zero));
+            hi = _mm256_add_epi32(hi, _mm256_unpackhi_epi16(v, zero));
+            nblocks += 1;
+        }
+
+        let mut lanes: [u32; 16] = [0; 16];
+        // Safety: Each half of the array holds exactly 32 bytes, and these are unaligned stores.
+        _mm256_storeu_si256(lanes.as_mut_ptr() as *mut __m256i, lo);
+        _mm256_storeu_si256(lanes[8..].as_mut_ptr() as *mut __m256i, hi);
+        state += lanes.iter().map(|lane| *lane as u64).sum::<u64>();
+
+        if nblocks < u16::MAX as usize {
+            break;
+        }
+    }
+
+    state + sum_native_scalar(blocks_iter.remainder())
+}
+
+/// NEON kernel: pairwise adds eight 16-bit words into 32-bit lanes per iteration.
+///
+/// Each lane of the accumulator grows by at most `2 * 0xffff` per iteration, so it is drained into a 64-bit sum every
+/// `i16::MAX` iterations, well before it could overflow.
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn sum_native_neon(buf: &[u8]) -> u64 {
+    const BLOCK_SIZE: usize = 16;
+    let mut state: u64 = 0;
+
+    let mut blocks_iter: ::std::slice::ChunksExact<u8> = buf.chunks_exact(BLOCK_SIZE);
+    loop {
+        let mut acc: uint32x4_t = vdupq_n_u32(0);
+        let mut nblocks: usize = 0;
+        while nblocks < i16::MAX as usize {
+            let block: &[u8] = match blocks_iter.next() {
+                Some(block) => block,
+                None => break,
+            };
+            // Safety: The block holds exactly 16 bytes, and byte loads have no alignment requirement.
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(block.as_ptr())));
+            nblocks += 1;
+        }
+
+        state += vaddlvq_u32(acc);
+
+        if nblocks < i16::MAX as usize {
+            break;
+        }
+    }
+
+    state + sum_native_scalar(blocks_iter.remainder())
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod test {
+    use super::*;
+    use ::anyhow::Result;
+
+    /// Reference implementation, which folds one 16-bit word at a time in network byte order.
+    fn reference_sum(buf: &[u8]) -> u16 {
+        let mut state: u64 = 0;
+        for word in buf.chunks(2) {
+            state += u16::from_be_bytes([word[0], *word.get(1).unwrap_or(&0)]) as u64;
+        }
+        fold(state)
+    }
+
+    /// Builds a buffer with a pattern that exercises carries.
+    fn cook_buffer(len: usize) -> Vec<u8> {
+        (0..len).map(|i| (i.wrapping_mul(131) ^ 0xa5) as u8).collect()
+    }
+
+    /// Tests that all kernels agree with the reference implementation, over lengths that cover every tail.
+    #[test]
+    fn test_sum_matches_reference() -> Result<()> {
+        for len in (0..300).chain([1500, 9000, 9001, 65535]) {
+            let buf: Vec<u8> = cook_buffer(len);
+            crate::ensure_eq!(sum(&buf), reference_sum(&buf));
+        }
+
+        // Enough 0xff octets to exercise the draining of the vector accumulators.
+        let buf: Vec<u8> = vec![0xff; 4 * 1024 * 1024 + 3];
+        crate::ensure_eq!(sum(&buf), reference_sum(&buf));
+
+        Ok(())
+    }
+
+    /// Tests that sums of consecutive pieces may be combined.
+    #[test]
+    fn test_add_combines_pieces() -> Result<()> {
+        let buf: Vec<u8> = cook_buffer(9001);
+        for split in [0, 2, 20, 128, 4000, 9000] {
+            crate::ensure_eq!(add(sum(&buf[..split]), sum(&buf[split..])), sum(&buf));
+        }
+        Ok(())
+    }
+
+    /// Tests that pieces of any length may be summed together.
+    #[test]
+    fn test_sum_pieces() -> Result<()> {
+        let buf: Vec<u8> = cook_buffer(9001);
+        for (first, second) in [(0, 0), (1, 2), (3, 4), (7, 1501), (4000, 4001)] {
+            let pieces: [&[u8]; 3] = [&buf[..first], &buf[first..second], &buf[second..]];
+            crate::ensure_eq!(sum_pieces(pieces), sum(&buf));
+        }
+        Ok(())
+    }
+
+    /// Tests the worked example of RFC 1071, Section 3.
+    #[test]
+    fn test_rfc1071_example() -> Result<()> {
+        let buf: [u8; 8] = [0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7];
+        crate::ensure_eq!(sum(&buf), 0xddf2);
+        Ok(())
+    }
+}
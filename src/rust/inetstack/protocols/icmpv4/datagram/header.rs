@@ -3,14 +3,11 @@
 
 use super::protocol::Icmpv4Type2;
 use crate::{
+    inetstack::protocols::checksum,
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
     },
-    inetstack::protocols::{
-        fold16,
-        compute_generic_checksum,
-    }
 };
 use ::libc::EBADMSG;
 use ::std::convert::TryInto;
@@ -79,10 +76,8 @@ impl Icmpv4Header {
 
     /// Computes the checksum of the target ICMPv4 header.
     fn compute_checksum(buf: &[u8; ICMPV4_HEADER_SIZE], body: &[u8]) -> u16 {
-        let mut state: u32 = compute_generic_checksum(buf, None);
-        state = compute_generic_checksum(body, Some(state));
-
-        fold16(state)
+        let state: u16 = checksum::add(checksum::sum(buf), checksum::sum(body));
+        checksum::finish(state)
     }
 
     pub fn get_protocol(&self) -> Icmpv4Type2 {
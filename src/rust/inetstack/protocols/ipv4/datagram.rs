@@ -6,7 +6,10 @@
 //==============================================================================
 
 use crate::{
-    inetstack::protocols::ip::IpProtocol,
+    inetstack::protocols::{
+        checksum,
+        ip::IpProtocol,
+    },
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
@@ -307,8 +310,6 @@ impl Ipv4Header {
 
     /// Computes the checksum of the target IPv4 header.
     pub fn compute_checksum(buf: &[u8]) -> u16 {
-        let mut state: u32 = 0xffff;
-
         // Do not compute checksum if buffer is too small.
         if buf.len() < IPV4_HEADER_MIN_SIZE as usize {
             // This should not happen by construction. If it does, log it.
@@ -316,17 +317,8 @@ impl Ipv4Header {
             return 0;
         }
 
-        for i in 0..5 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
-        // Skip the 5th u16 since octets 10-12 are the header checksum, whose value should be zero when
-        // computing a checksum.
-        for i in 6..10 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
-        while state > 0xffff {
-            state -= 0xffff;
-        }
-        !state as u16
+        // Skip octets 10-12, since they are the header checksum, whose value should be zero when computing a checksum.
+        let state: u16 = checksum::add(checksum::sum(&buf[0..10]), checksum::sum(&buf[12..20]));
+        checksum::finish(state)
     }
 }
@@ -107,6 +107,11 @@ impl<N: NetworkRuntime> Peer<N> {
         }
     }
 
+    /// Ends a receive batch, dispatching everything that was held back for coalescing.
+    pub fn flush_receive(&mut self) {
+        self.tcp.flush_receive();
+    }
+
     pub async fn ping(&mut self, dest_ipv4_addr: Ipv4Addr, timeout: Option<Duration>) -> Result<Duration, Fail> {
         self.icmpv4.ping(dest_ipv4_addr, timeout).await
     }
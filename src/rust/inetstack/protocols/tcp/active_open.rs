@@ -18,10 +18,7 @@ use crate::{
         tcp::{
             constants::FALLBACK_MSS,
             established::{
-                congestion_control::{
-                    self,
-                    CongestionControl,
-                },
+                congestion_control,
                 EstablishedSocket,
             },
             segment::{
@@ -159,12 +156,15 @@ impl<N: NetworkRuntime> SharedActiveOpenSocket<N> {
             ipv4_hdr: Ipv4Header::new(self.local.ip().clone(), self.remote.ip().clone(), IpProtocol::TCP),
             tcp_hdr,
             data: None,
+            data_sum: None,
             tx_checksum_offload: self.tcp_config.get_rx_checksum_offload(),
+            segment_size: None,
         };
         self.transport.transmit(Box::new(segment));
 
         let mut remote_window_scale = None;
         let mut mss = FALLBACK_MSS;
+        let mut sack_permitted: bool = false;
         for option in header.iter_options() {
             match option {
                 TcpOptions2::WindowScale(w) => {
@@ -175,6 +175,10 @@ impl<N: NetworkRuntime> SharedActiveOpenSocket<N> {
                     info!("Received advertised MSS: {}", m);
                     mss = *m as usize;
                 },
+                TcpOptions2::SelectiveAcknowlegementPermitted => {
+                    info!("Received SACK permitted");
+                    sack_permitted = true;
+                },
                 _ => continue,
             }
         }
@@ -222,7 +226,8 @@ impl<N: NetworkRuntime> SharedActiveOpenSocket<N> {
             tx_window_size,
             remote_window_scale,
             mss,
-            congestion_control::None::new,
+            sack_permitted,
+            congestion_control::get_constructor(self.tcp_config.get_congestion_control()),
             None,
             self.dead_socket_tx.clone(),
         )?)
@@ -256,13 +261,18 @@ impl<N: NetworkRuntime> SharedActiveOpenSocket<N> {
             tcp_hdr.push_option(TcpOptions2::WindowScale(self.tcp_config.get_window_scale()));
             info!("Advertising window scale: {}", self.tcp_config.get_window_scale());
 
+            // RFC 2018: Offer selective acknowledgements.  These are only used if our peer offers them too.
+            tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+
             debug!("Sending SYN {:?}", tcp_hdr);
             let segment = TcpSegment {
                 ethernet2_hdr: Ethernet2Header::new(remote_link_addr, self.local_link_addr, EtherType2::Ipv4),
                 ipv4_hdr: Ipv4Header::new(self.local.ip().clone(), self.remote.ip().clone(), IpProtocol::TCP),
                 tcp_hdr,
                 data: None,
+                data_sum: None,
                 tx_checksum_offload: self.tcp_config.get_rx_checksum_offload(),
+                segment_size: None,
             };
             // Send SYN.
             self.transport.transmit(Box::new(segment));
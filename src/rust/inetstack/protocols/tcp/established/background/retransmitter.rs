@@ -57,6 +57,9 @@ pub async fn retransmitter<N: NetworkRuntime>(mut cb: SharedControlBlock<N>) ->
                 let send_unacknowledged = cb.get_send_unacked();
                 cb.congestion_control_on_rto(send_unacknowledged.get());
 
+                // Retransmissions since the last timeout might have been lost as well, so let them be sent again.
+                cb.reset_retransmissions();
+
                 // RFC 6298 Section 5.4: Retransmit earliest unacknowledged segment.
                 cb.retransmit();
 
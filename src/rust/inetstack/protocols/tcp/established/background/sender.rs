@@ -19,6 +19,7 @@ use crate::{
     },
 };
 use ::futures::{
+    future,
     never::Never,
     pin_mut,
     select_biased,
@@ -74,9 +75,13 @@ pub async fn sender<N: NetworkRuntime>(mut cb: SharedControlBlock<N>) -> Result<
             cb.modify_send_next(|s| s + SeqNumber::from(1));
 
             // Add the probe byte (as a new separate buffer) to our unacknowledged queue.
+            let buf_sum: Option<u16> = cb.checksum_data(&buf);
             let unacked_segment = UnackedSegment {
                 bytes: buf.clone(),
+                bytes_sum: buf_sum,
                 initial_tx: Some(cb.get_now()),
+                sacked: false,
+                retransmitted: false,
             };
             cb.push_unacked_segment(unacked_segment);
 
@@ -87,7 +92,7 @@ pub async fn sender<N: NetworkRuntime>(mut cb: SharedControlBlock<N>) -> Result<
                 // Create packet.
                 let mut header: TcpHeader = cb.tcp_header();
                 header.seq_num = send_next;
-                cb.emit(header, Some(buf.clone()), remote_link_addr);
+                cb.emit(header, Some(buf.clone()), buf_sum, remote_link_addr);
 
                 match win_sz_watched.wait_for_change(Some(timeout)).await {
                     Ok(_) => continue 'top,
@@ -129,6 +134,17 @@ pub async fn sender<N: NetworkRuntime>(mut cb: SharedControlBlock<N>) -> Result<
             };
         }
 
+        // The congestion control algorithm may pace the connection, and hold the next segment back for a while.
+        if let Some(pacing_deadline) = cb.congestion_control_get_pacing_deadline() {
+            if pacing_deadline > cb.get_now() {
+                match conditional_yield_until(future::pending::<Never>(), Some(pacing_deadline)).await {
+                    Ok(never) => match never {},
+                    Err(Fail { errno, cause: _ }) if errno == libc::ETIMEDOUT => continue 'top,
+                    Err(e) => return Err(e),
+                }
+            }
+        }
+
         // Past this point we have data to send and it's valid to send it!
 
         // TODO: Nagle's algorithm - We need to coalese small buffers together to send MSS sized packets.
@@ -139,13 +155,13 @@ pub async fn sender<N: NetworkRuntime>(mut cb: SharedControlBlock<N>) -> Result<
 
         // Form an outgoing packet.
         let max_size: usize = cmp::min(
-            cmp::min((win_sz - sent_data) as usize, cb.get_mss()),
+            cmp::min((win_sz - sent_data) as usize, cb.get_max_send_size()),
             (effective_cwnd - sent_data) as usize,
         );
         let (segment_data, do_push): (DemiBuffer, bool) = cb
             .pop_unsent_segment(max_size)
             .expect("No unsent data with sequence number gap?");
-        let mut segment_data_len: u32 = segment_data.len() as u32;
+        let mut segment_data_len: u32 = segment_data.total_len() as u32;
 
         let rto: Duration = cb.rto();
         cb.congestion_control_on_send(rto, sent_data);
@@ -161,16 +177,24 @@ pub async fn sender<N: NetworkRuntime>(mut cb: SharedControlBlock<N>) -> Result<
         } else if do_push {
             header.psh = true;
         }
+        let segment_data_sum: Option<u16> = cb.checksum_data(&segment_data);
         let mut cb4 = cb.clone();
-        cb4.emit(header, Some(segment_data.clone()), remote_link_addr);
+        cb4.emit(header, Some(segment_data.clone()), segment_data_sum, remote_link_addr);
 
         // Update SND.NXT.
         cb.modify_send_next(|s| s + SeqNumber::from(segment_data_len));
 
+        // Sample the delivery rate and schedule the next departure, if the connection is paced.
+        let app_limited: bool = cb.unsent_top_size().is_none();
+        cb.congestion_control_on_segment_sent(send_next, segment_data_len, sent_data + segment_data_len, app_limited);
+
         // Put this segment on the unacknowledged list.
         let unacked_segment = UnackedSegment {
             bytes: segment_data,
+            bytes_sum: segment_data_sum,
             initial_tx: Some(cb.get_now()),
+            sacked: false,
+            retransmitted: false,
         };
         cb.push_unacked_segment(unacked_segment);
 
@@ -0,0 +1,943 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// This is an implementation of BBR, as in draft-ietf-ccwg-bbr, which carries over the loss response of BBRv2.  Rather
+// than taking losses as the signal of congestion, BBR builds a model of the path out of the delivery rate and the
+// round-trip time that each acknowledgement yields: the bottleneck bandwidth is the maximum delivery rate seen over
+// the last couple of bandwidth probes, and the propagation delay is the minimum round-trip time seen over the last ten
+// seconds.  Data is then paced at the bottleneck bandwidth, and the data in flight is bounded by a multiple of the
+// bandwidth-delay product, so that the pipe stays full without building a standing queue at the bottleneck.
+//
+// The connection goes through the following modes:
+// - Startup, which doubles the sending rate every round trip until the bandwidth stops growing;
+// - Drain, which drains the queue that Startup built;
+// - ProbeBW, which cruises at the estimated bandwidth, and every few seconds probes for more of it, before draining
+//   the queue that probing built;
+// - ProbeRTT, which shrinks the data in flight for a short while so as to measure the propagation delay again, when it
+//   has not been seen for a while.
+//
+// Losses bound the data in flight: a round trip that loses more than a small fraction of its data caps the data in
+// flight below the level at which losses occurred, and cuts the estimates that the model works with.
+//
+// Fast retransmit is on three duplicate ACKs, and recovery from partial acknowledgements follows RFC 6582, as in
+// Cubic.  Unlike Cubic, the congestion window is not cut on fast retransmit, as the model reacts to losses instead.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use super::{
+    rate::{
+        RateSample,
+        RateSampler,
+    },
+    CongestionControl,
+    FastRetransmitRecovery,
+    LimitedTransmit,
+    Options,
+    Pacing,
+    SlowStartCongestionAvoidance,
+};
+use crate::{
+    collections::async_value::SharedAsyncValue,
+    inetstack::protocols::tcp::SeqNumber,
+};
+use ::std::{
+    cmp::{
+        max,
+        min,
+    },
+    convert::TryInto,
+    fmt::Debug,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Phases of the ProbeBW mode.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum ProbeBwPhase {
+    /// Drains the queue that probing built, until the data in flight fits the estimated bandwidth-delay product.
+    Down,
+    /// Cruises at the estimated bandwidth.
+    Cruise,
+    /// Refills the pipe at the estimated bandwidth for one round trip, before probing.
+    Refill,
+    /// Probes for bandwidth, by sending faster than the estimated bandwidth.
+    Up,
+}
+
+/// Modes of BBR.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum Mode {
+    Startup,
+    Drain,
+    ProbeBw(ProbeBwPhase),
+    ProbeRtt,
+}
+
+#[derive(Debug)]
+pub struct Bbr {
+    mss: u32,
+    initial_cwnd: u32,
+
+    // Control Parameters
+    cwnd: SharedAsyncValue<u32>, // Congestion window: Max number of bytes that may be in flight.
+    pacing_rate: f64,            // Rate at which data is sent, in bytes per second.
+    send_quantum: u32,           // Number of bytes that may be sent back to back, at the pacing rate.
+    next_departure: Option<Instant>, // Time at which the next segment leaves, if sent at the pacing rate.
+    pacing_gain: f64,            // Multiple of the estimated bandwidth that the pacing rate is set to.
+    cwnd_gain: f64,              // Multiple of the estimated bandwidth-delay product that cwnd is set to.
+
+    // Model of the Path
+    sampler: RateSampler,
+    mode: Mode,
+    max_bw: f64,                                // Windowed maximum of the delivery rate, in bytes per second.
+    bw_hi: [f64; 2],  // Maximum delivery rate during the previous and the current bandwidth probe cycles.
+    bw_lo: f64,       // Short-term bound of the bandwidth, set on losses.
+    bw_latest: f64,   // Maximum delivery rate over the current round trip.
+    inflight_hi: u64, // Long-term bound of the data in flight, set on losses.
+    inflight_lo: u64, // Short-term bound of the data in flight, set on losses.
+    inflight_latest: u64, // Maximum data delivered by a sample over the current round trip.
+    min_rtt: Option<(Duration, Instant)>, // Windowed minimum of the RTT, and when it was seen.
+    probe_rtt_min: Option<(Duration, Instant)>, // Minimum of the RTT since the last ProbeRTT, and when it was seen.
+    probe_rtt_expired: bool, // Is it time to enter ProbeRTT?
+    probe_rtt_done_stamp: Option<Instant>, // Time at which ProbeRTT may end.
+    probe_rtt_round_done: bool, // Did a round trip elapse during ProbeRTT?
+    prior_cwnd: u32,  // The value of cwnd before ProbeRTT or a retransmission timeout.
+    idle_restart: bool, // Is the connection restarting after being idle?
+
+    // Round Trips
+    next_round_delivered: u64, // The round trip ends once the data delivered reaches this.
+    round_start: bool,         // Did the last acknowledgement start a new round trip?
+
+    // Startup
+    full_bw: f64,       // Bandwidth that was seen last time it grew substantially.
+    full_bw_count: u32, // Number of round trips during which the bandwidth did not grow substantially.
+    filled_pipe: bool,  // Has the bottleneck bandwidth been reached?
+
+    // Bandwidth Probing
+    cycle_stamp: Option<Instant>, // Start of the current ProbeBW phase.
+    rounds_since_bw_probe: u64,
+    bw_probe_wait: Duration, // Time to wait before the next bandwidth probe.
+    bw_probe_up_rounds: u32, // Number of round trips spent probing, which steers how fast inflight_hi grows.
+    jitter: u32,             // State of the generator that randomizes bandwidth probes.
+
+    // Losses
+    loss_round_delivered: u64, // Data delivered at the start of the current round trip.
+    lost_in_round: u64,        // Data lost in the current round trip.
+
+    // Fast Recovery / Fast Retransmit State
+    duplicate_ack_count: u32, // The number of consecutive duplicate ACKs we've received.
+    fast_retransmit_now: SharedAsyncValue<bool>, // Flag to cause the retransmitter to retransmit a segment now.
+    in_recovery: bool,        // Are we recovering losses?
+    after_rto: bool,          // Did a retransmission timeout expire since we last recovered?
+    recover: SeqNumber,       // Recovery ends once the ACK sequence number reaches this.
+
+    limited_transmit_cwnd_increase: SharedAsyncValue<u32>, // The limited transmit algorithm is not used by BBR.
+}
+
+impl CongestionControl for Bbr {
+    fn new(now: Instant, mss: usize, seq_no: SeqNumber, _options: Option<Options>) -> Box<dyn CongestionControl> {
+        Box::new(Self::create(now, mss.try_into().unwrap(), seq_no))
+    }
+}
+
+impl Bbr {
+    const BETA: f64 = 0.7;
+    const BW_PROBE_BASE_WAIT: Duration = Duration::from_secs(2);
+    const BW_PROBE_MAX_ROUNDS: u64 = 63;
+    const DRAIN_PACING_GAIN: f64 = 0.35;
+    const DUP_ACK_THRESHOLD: u32 = 3;
+    const FULL_BW_COUNT: u32 = 3;
+    const FULL_BW_THRESH: f64 = 1.25;
+    const HEADROOM: f64 = 0.15;
+    const INITIAL_CWND_SEGMENTS: u32 = 10;
+    const LOSS_THRESH: f64 = 0.02;
+    const MAX_SEND_QUANTUM: u32 = 64 * 1024;
+    const MIN_PIPE_CWND_SEGMENTS: u32 = 4;
+    const MIN_RTT_FILTER_LEN: Duration = Duration::from_secs(10);
+    const NOMINAL_RTT: Duration = Duration::from_millis(1);
+    const PACING_MARGIN: f64 = 0.01;
+    const PROBE_BW_CWND_GAIN: f64 = 2.0;
+    const PROBE_BW_DOWN_PACING_GAIN: f64 = 0.9;
+    const PROBE_BW_UP_CWND_GAIN: f64 = 2.25;
+    const PROBE_BW_UP_PACING_GAIN: f64 = 1.25;
+    const PROBE_RTT_CWND_GAIN: f64 = 0.5;
+    const PROBE_RTT_DURATION: Duration = Duration::from_millis(200);
+    const PROBE_RTT_INTERVAL: Duration = Duration::from_secs(5);
+    const STARTUP_CWND_GAIN: f64 = 2.0;
+    const STARTUP_PACING_GAIN: f64 = 2.77;
+
+    fn create(now: Instant, mss: u32, seq_no: SeqNumber) -> Self {
+        let initial_cwnd: u32 = Self::INITIAL_CWND_SEGMENTS * mss;
+
+        let mut bbr: Self = Self {
+            mss,
+            initial_cwnd,
+
+            cwnd: SharedAsyncValue::new(initial_cwnd),
+            // Until we take an RTT sample, we assume one of 1 ms, as recommended.
+            pacing_rate: Self::STARTUP_PACING_GAIN * initial_cwnd as f64 / Self::NOMINAL_RTT.as_secs_f64(),
+            send_quantum: 2 * mss,
+            next_departure: None,
+            pacing_gain: Self::STARTUP_PACING_GAIN,
+            cwnd_gain: Self::STARTUP_CWND_GAIN,
+
+            sampler: RateSampler::new(now),
+            mode: Mode::Startup,
+            max_bw: 0.0,
+            bw_hi: [0.0; 2],
+            bw_lo: f64::INFINITY,
+            bw_latest: 0.0,
+            inflight_hi: u64::MAX,
+            inflight_lo: u64::MAX,
+            inflight_latest: 0,
+            min_rtt: None,
+            probe_rtt_min: None,
+            probe_rtt_expired: false,
+            probe_rtt_done_stamp: None,
+            probe_rtt_round_done: false,
+            prior_cwnd: initial_cwnd,
+            idle_restart: false,
+
+            next_round_delivered: 0,
+            round_start: false,
+
+            full_bw: 0.0,
+            full_bw_count: 0,
+            filled_pipe: false,
+
+            cycle_stamp: None,
+            rounds_since_bw_probe: 0,
+            bw_probe_wait: Self::BW_PROBE_BASE_WAIT,
+            bw_probe_up_rounds: 0,
+            // The initial sequence number is random, so it seeds the jitter of bandwidth probes.
+            jitter: u32::from(seq_no) | 1,
+
+            loss_round_delivered: 0,
+            lost_in_round: 0,
+
+            duplicate_ack_count: 0,
+            fast_retransmit_now: SharedAsyncValue::new(false),
+            in_recovery: false,
+            after_rto: false,
+            recover: seq_no,
+
+            limited_transmit_cwnd_increase: SharedAsyncValue::new(0),
+        };
+        bbr.set_send_quantum();
+        bbr
+    }
+
+    //==================================================================================================================
+    // Model
+    //==================================================================================================================
+
+    /// Returns the bandwidth that the model works with, in bytes per second.
+    fn bw(&self) -> f64 {
+        self.max_bw.min(self.bw_lo)
+    }
+
+    /// Returns the minimum amount of data in flight at which the connection keeps going.
+    fn min_pipe_cwnd(&self) -> u64 {
+        (Self::MIN_PIPE_CWND_SEGMENTS * self.mss) as u64
+    }
+
+    /// Returns `gain` times the bandwidth-delay product at bandwidth `bw`.
+    fn bdp_multiple(&self, bw: f64, gain: f64) -> u64 {
+        match self.min_rtt {
+            Some((min_rtt, _)) => (gain * bw * min_rtt.as_secs_f64()) as u64,
+            None => self.initial_cwnd as u64,
+        }
+    }
+
+    /// Returns the amount of data in flight that fills `gain` times the bandwidth-delay product at bandwidth `bw`, with
+    /// room for the bursts that the sender and the network device send back to back.
+    fn inflight(&self, bw: f64, gain: f64) -> u64 {
+        let mut quanta: u64 = 3 * self.send_quantum as u64;
+        if self.mode == Mode::ProbeBw(ProbeBwPhase::Up) {
+            quanta += 2 * self.mss as u64;
+        }
+        max(self.bdp_multiple(bw, gain) + quanta, self.min_pipe_cwnd())
+    }
+
+    /// Returns the amount of data in flight that the model aims at.
+    fn target_inflight(&self) -> u64 {
+        min(self.bdp_multiple(self.bw(), 1.0), self.cwnd.get() as u64)
+    }
+
+    /// Returns the long-term bound of the data in flight, with headroom for other flows to grow into.
+    fn inflight_with_headroom(&self) -> u64 {
+        if self.inflight_hi == u64::MAX {
+            return u64::MAX;
+        }
+        let headroom: u64 = max((Self::HEADROOM * self.inflight_hi as f64) as u64, 1);
+        max(self.inflight_hi.saturating_sub(headroom), self.min_pipe_cwnd())
+    }
+
+    /// Takes the bandwidth, round trip and delivery signals of a rate sample into account.
+    fn update_from_sample(&mut self, now: Instant, rs: &RateSample) {
+        // A new round trip starts once the data that was in flight when the previous one started is delivered.
+        if rs.prior_delivered >= self.next_round_delivered {
+            self.next_round_delivered = self.sampler.get_delivered();
+            self.rounds_since_bw_probe += 1;
+            self.round_start = true;
+        }
+
+        // Samples that span less than a round trip come from compressed ACKs, so their rate is overestimated.
+        let too_short: bool = self.min_rtt.map_or(false, |(min_rtt, _)| rs.interval < min_rtt);
+        if let Some(delivery_rate) = rs.get_delivery_rate().filter(|_| !too_short) {
+            // Application limited samples bound the bandwidth from below only.
+            if delivery_rate >= self.max_bw || !rs.is_app_limited {
+                self.bw_hi[1] = self.bw_hi[1].max(delivery_rate);
+                self.max_bw = self.bw_hi[0].max(self.bw_hi[1]);
+            }
+            self.bw_latest = self.bw_latest.max(delivery_rate);
+        }
+        self.inflight_latest = max(self.inflight_latest, rs.delivered);
+
+        self.update_min_rtt(now, rs.rtt);
+    }
+
+    fn update_min_rtt(&mut self, now: Instant, rtt: Duration) {
+        self.probe_rtt_expired = self
+            .probe_rtt_min
+            .map_or(false, |(_, stamp)| now > stamp + Self::PROBE_RTT_INTERVAL);
+        if self.probe_rtt_expired || self.probe_rtt_min.map_or(true, |(delay, _)| rtt < delay) {
+            self.probe_rtt_min = Some((rtt, now));
+        }
+
+        let min_rtt_expired: bool = self
+            .min_rtt
+            .map_or(true, |(_, stamp)| now > stamp + Self::MIN_RTT_FILTER_LEN);
+        if let Some((delay, stamp)) = self.probe_rtt_min {
+            if min_rtt_expired || self.min_rtt.map_or(true, |(min_rtt, _)| delay < min_rtt) {
+                self.min_rtt = Some((delay, stamp));
+            }
+        }
+    }
+
+    /// Starts a new round trip right away.
+    fn start_round(&mut self) {
+        self.next_round_delivered = self.sampler.get_delivered();
+    }
+
+    /// Reacts to the losses of the round trip that just ended.
+    fn update_congestion_signals(&mut self, now: Instant) {
+        if !self.round_start {
+            return;
+        }
+
+        if self.lost_in_round > 0 {
+            let delivered_in_round: u64 = self.sampler.get_delivered() - self.loss_round_delivered;
+            if self.lost_in_round as f64 > Self::LOSS_THRESH * delivered_in_round as f64 {
+                self.handle_inflight_too_high(now);
+            }
+            self.adapt_lower_bounds_from_congestion();
+        }
+
+        self.loss_round_delivered = self.sampler.get_delivered();
+        self.lost_in_round = 0;
+    }
+
+    /// Caps the data in flight below the level at which the path lost too much data.
+    fn handle_inflight_too_high(&mut self, now: Instant) {
+        let beta_target: u64 = (Self::BETA * self.target_inflight() as f64) as u64;
+        self.inflight_hi = max(self.inflight_latest, max(beta_target, self.min_pipe_cwnd()));
+        match self.mode {
+            // Losses during Startup mean that we sent faster than the bottleneck already.
+            Mode::Startup => self.filled_pipe = true,
+            Mode::ProbeBw(ProbeBwPhase::Up) => self.start_probe_bw_down(now),
+            _ => (),
+        }
+    }
+
+    /// Cuts the short-term bounds of the model, unless we are probing for bandwidth.
+    fn adapt_lower_bounds_from_congestion(&mut self) {
+        match self.mode {
+            Mode::Startup | Mode::ProbeBw(ProbeBwPhase::Refill) | Mode::ProbeBw(ProbeBwPhase::Up) => return,
+            _ => (),
+        }
+        if self.bw_lo == f64::INFINITY {
+            self.bw_lo = self.max_bw;
+        }
+        if self.inflight_lo == u64::MAX {
+            self.inflight_lo = self.cwnd.get() as u64;
+        }
+        self.bw_lo = self.bw_latest.max(Self::BETA * self.bw_lo);
+        self.inflight_lo = max(self.inflight_latest, (Self::BETA * self.inflight_lo as f64) as u64);
+    }
+
+    fn reset_lower_bounds(&mut self) {
+        self.bw_lo = f64::INFINITY;
+        self.inflight_lo = u64::MAX;
+    }
+
+    fn advance_latest_delivery_signals(&mut self, rs: &Option<RateSample>) {
+        if self.round_start {
+            self.bw_latest = rs.and_then(|rs| rs.get_delivery_rate()).unwrap_or(0.0);
+            self.inflight_latest = rs.map_or(0, |rs| rs.delivered);
+        }
+    }
+
+    //==================================================================================================================
+    // Startup and Drain
+    //==================================================================================================================
+
+    fn enter_startup(&mut self) {
+        self.mode = Mode::Startup;
+        self.pacing_gain = Self::STARTUP_PACING_GAIN;
+        self.cwnd_gain = Self::STARTUP_CWND_GAIN;
+    }
+
+    /// Finds out whether the bandwidth stopped growing during Startup.
+    fn check_full_bw_reached(&mut self, rs: &Option<RateSample>) {
+        if self.filled_pipe || !self.round_start || rs.map_or(true, |rs| rs.is_app_limited) {
+            return;
+        }
+        if self.max_bw >= self.full_bw * Self::FULL_BW_THRESH {
+            self.full_bw = self.max_bw;
+            self.full_bw_count = 0;
+            return;
+        }
+        self.full_bw_count += 1;
+        if self.full_bw_count >= Self::FULL_BW_COUNT {
+            self.filled_pipe = true;
+        }
+    }
+
+    fn check_startup_done(&mut self) {
+        if self.mode == Mode::Startup && self.filled_pipe {
+            self.mode = Mode::Drain;
+            self.pacing_gain = Self::DRAIN_PACING_GAIN;
+            self.cwnd_gain = Self::STARTUP_CWND_GAIN;
+        }
+    }
+
+    fn check_drain(&mut self, now: Instant, bytes_in_flight: u64) {
+        if self.mode == Mode::Drain && bytes_in_flight <= self.inflight(self.max_bw, 1.0) {
+            self.start_probe_bw_down(now);
+        }
+    }
+
+    //==================================================================================================================
+    // ProbeBW
+    //==================================================================================================================
+
+    fn set_probe_bw_phase(&mut self, phase: ProbeBwPhase) {
+        self.mode = Mode::ProbeBw(phase);
+        (self.pacing_gain, self.cwnd_gain) = match phase {
+            ProbeBwPhase::Down => (Self::PROBE_BW_DOWN_PACING_GAIN, Self::PROBE_BW_CWND_GAIN),
+            ProbeBwPhase::Cruise | ProbeBwPhase::Refill => (1.0, Self::PROBE_BW_CWND_GAIN),
+            ProbeBwPhase::Up => (Self::PROBE_BW_UP_PACING_GAIN, Self::PROBE_BW_UP_CWND_GAIN),
+        };
+    }
+
+    fn start_probe_bw_down(&mut self, now: Instant) {
+        self.lost_in_round = 0;
+        // Each bandwidth probe cycle starts a new slot of the bandwidth filter, so samples live for two cycles.
+        self.bw_hi[0] = self.bw_hi[1];
+        self.bw_hi[1] = 0.0;
+        self.pick_probe_wait();
+        self.cycle_stamp = Some(now);
+        self.start_round();
+        self.set_probe_bw_phase(ProbeBwPhase::Down);
+    }
+
+    fn start_probe_bw_refill(&mut self) {
+        self.reset_lower_bounds();
+        self.bw_probe_up_rounds = 0;
+        self.start_round();
+        self.set_probe_bw_phase(ProbeBwPhase::Refill);
+    }
+
+    fn start_probe_bw_up(&mut self, now: Instant) {
+        self.start_round();
+        self.cycle_stamp = Some(now);
+        self.set_probe_bw_phase(ProbeBwPhase::Up);
+    }
+
+    /// Randomizes the wait before the next bandwidth probe, between two and three seconds, so that flows that share a
+    /// bottleneck don't probe in lockstep.
+    fn pick_probe_wait(&mut self) {
+        // Xorshift generator.
+        self.jitter ^= self.jitter << 13;
+        self.jitter ^= self.jitter >> 17;
+        self.jitter ^= self.jitter << 5;
+        self.rounds_since_bw_probe = 0;
+        self.bw_probe_wait = Self::BW_PROBE_BASE_WAIT + Duration::from_millis((self.jitter % 1000) as u64);
+    }
+
+    fn has_elapsed_in_phase(&self, now: Instant, interval: Duration) -> bool {
+        self.cycle_stamp
+            .map_or(true, |cycle_stamp| now > cycle_stamp + interval)
+    }
+
+    /// Starts a bandwidth probe when it is due. Loss-based flows back off once per round trip, and grow their window by
+    /// one segment per round trip, so probing at least that often keeps our share of the bottleneck on par with theirs.
+    fn check_time_to_probe_bw(&mut self, now: Instant) -> bool {
+        let reno_rounds: u64 = min(self.target_inflight() / self.mss as u64, Self::BW_PROBE_MAX_ROUNDS);
+        if self.has_elapsed_in_phase(now, self.bw_probe_wait) || self.rounds_since_bw_probe >= reno_rounds {
+            self.start_probe_bw_refill();
+            return true;
+        }
+        false
+    }
+
+    fn check_time_to_cruise(&self, bytes_in_flight: u64) -> bool {
+        bytes_in_flight <= self.inflight_with_headroom() && bytes_in_flight <= self.inflight(self.max_bw, 1.0)
+    }
+
+    /// Raises the long-term bound of the data in flight while probing, faster and faster as long as no losses occur.
+    fn probe_inflight_hi_upward(&mut self, bytes_in_flight: u64) {
+        let cwnd_limited: bool = bytes_in_flight + self.mss as u64 >= self.cwnd.get() as u64;
+        if self.inflight_hi == u64::MAX || !self.round_start || !cwnd_limited {
+            return;
+        }
+        let growth: u64 = (self.mss as u64) << min(self.bw_probe_up_rounds, 30);
+        self.inflight_hi = self.inflight_hi.saturating_add(growth);
+        self.bw_probe_up_rounds += 1;
+    }
+
+    fn update_probe_bw_cycle_phase(&mut self, now: Instant, bytes_in_flight: u64) {
+        if !self.filled_pipe {
+            return;
+        }
+        let phase: ProbeBwPhase = match self.mode {
+            Mode::ProbeBw(phase) => phase,
+            _ => return,
+        };
+        match phase {
+            ProbeBwPhase::Down => {
+                if !self.check_time_to_probe_bw(now) && self.check_time_to_cruise(bytes_in_flight) {
+                    self.set_probe_bw_phase(ProbeBwPhase::Cruise);
+                }
+            },
+            ProbeBwPhase::Cruise => {
+                self.check_time_to_probe_bw(now);
+            },
+            ProbeBwPhase::Refill => {
+                if self.round_start {
+                    self.start_probe_bw_up(now);
+                }
+            },
+            ProbeBwPhase::Up => {
+                self.probe_inflight_hi_upward(bytes_in_flight);
+                let min_rtt: Duration = self.min_rtt.map_or(Self::NOMINAL_RTT, |(min_rtt, _)| min_rtt);
+                if self.has_elapsed_in_phase(now, min_rtt)
+                    && bytes_in_flight > self.inflight(self.max_bw, Self::PROBE_BW_UP_PACING_GAIN)
+                {
+                    self.start_probe_bw_down(now);
+                }
+            },
+        }
+    }
+
+    //==================================================================================================================
+    // ProbeRTT
+    //==================================================================================================================
+
+    /// Returns the value of cwnd to restore once ProbeRTT or a recovery is over.
+    fn save_cwnd(&self) -> u32 {
+        if !self.in_recovery && !self.after_rto && self.mode != Mode::ProbeRtt {
+            self.cwnd.get()
+        } else {
+            max(self.prior_cwnd, self.cwnd.get())
+        }
+    }
+
+    fn probe_rtt_cwnd(&self) -> u64 {
+        max(
+            self.bdp_multiple(self.bw(), Self::PROBE_RTT_CWND_GAIN),
+            self.min_pipe_cwnd(),
+        )
+    }
+
+    fn check_probe_rtt(&mut self, now: Instant, bytes_in_flight: u64) {
+        if self.mode != Mode::ProbeRtt && self.probe_rtt_expired && !self.idle_restart {
+            self.prior_cwnd = self.save_cwnd();
+            self.mode = Mode::ProbeRtt;
+            self.pacing_gain = 1.0;
+            self.cwnd_gain = Self::PROBE_RTT_CWND_GAIN;
+            self.probe_rtt_done_stamp = None;
+        }
+        if self.mode != Mode::ProbeRtt {
+            return;
+        }
+
+        match self.probe_rtt_done_stamp {
+            None if bytes_in_flight <= self.probe_rtt_cwnd() => {
+                // Hold the data in flight down for a while and at least one round trip.
+                self.probe_rtt_done_stamp = Some(now + Self::PROBE_RTT_DURATION);
+                self.probe_rtt_round_done = false;
+                self.start_round();
+            },
+            None => (),
+            Some(done_stamp) => {
+                if self.round_start {
+                    self.probe_rtt_round_done = true;
+                }
+                if self.probe_rtt_round_done && now >= done_stamp {
+                    self.probe_rtt_min = self.probe_rtt_min.map(|(delay, _)| (delay, now));
+                    self.probe_rtt_expired = false;
+                    let cwnd: u32 = max(self.cwnd.get(), self.prior_cwnd);
+                    self.cwnd.set(cwnd);
+                    self.reset_lower_bounds();
+                    if self.filled_pipe {
+                        self.start_probe_bw_down(now);
+                        self.set_probe_bw_phase(ProbeBwPhase::Cruise);
+                    } else {
+                        self.enter_startup();
+                    }
+                }
+            },
+        }
+    }
+
+    //==================================================================================================================
+    // Control Parameters
+    //==================================================================================================================
+
+    fn set_pacing_rate(&mut self) {
+        let rate: f64 = self.pacing_gain * self.bw() * (1.0 - Self::PACING_MARGIN);
+        // Until the pipe is full, the pacing rate only grows, as early estimates of the bandwidth are low.
+        if rate > 0.0 && (self.filled_pipe || rate > self.pacing_rate) {
+            self.pacing_rate = rate;
+        }
+    }
+
+    /// Lets a millisecond worth of data out back to back, so that the sender doesn't wake up for each segment.
+    fn set_send_quantum(&mut self) {
+        let quantum: u32 = (self.pacing_rate * 0.001) as u32;
+        self.send_quantum = quantum.clamp(2 * self.mss, max(Self::MAX_SEND_QUANTUM, 2 * self.mss));
+    }
+
+    fn set_cwnd(&mut self, bytes_acknowledged: u32, restore_cwnd: bool) {
+        let max_inflight: u64 = self.inflight(self.bw(), self.cwnd_gain);
+        let mut cwnd: u64 = self.cwnd.get() as u64;
+        if restore_cwnd {
+            cwnd = max(cwnd, self.prior_cwnd as u64);
+        }
+
+        // Grow towards the target, or faster while the bandwidth is yet unknown.
+        if self.filled_pipe {
+            cwnd = min(cwnd + bytes_acknowledged as u64, max_inflight);
+        } else if cwnd < max_inflight || self.sampler.get_delivered() < self.initial_cwnd as u64 {
+            cwnd += bytes_acknowledged as u64;
+        }
+        cwnd = max(cwnd, self.min_pipe_cwnd());
+
+        // Bound cwnd by the model.
+        let mut cap: u64 = match self.mode {
+            Mode::ProbeBw(ProbeBwPhase::Cruise) => self.inflight_with_headroom(),
+            Mode::ProbeBw(_) => self.inflight_hi,
+            Mode::ProbeRtt => min(self.inflight_with_headroom(), self.probe_rtt_cwnd()),
+            Mode::Startup | Mode::Drain => u64::MAX,
+        };
+        cap = min(cap, self.inflight_lo);
+        cwnd = max(min(cwnd, cap), self.min_pipe_cwnd());
+
+        let cwnd: u32 = min(cwnd, u32::MAX as u64) as u32;
+        if cwnd != self.cwnd.get() {
+            self.cwnd.set(cwnd);
+        }
+    }
+
+    //==================================================================================================================
+    // Acknowledgements
+    //==================================================================================================================
+
+    fn on_dup_ack_received(&mut self, send_next: SeqNumber) {
+        self.duplicate_ack_count += 1;
+        if self.duplicate_ack_count == Self::DUP_ACK_THRESHOLD && !self.in_recovery {
+            self.in_recovery = true;
+            self.recover = send_next;
+            self.lost_in_round += self.mss as u64;
+            self.fast_retransmit_now.set(true);
+        }
+    }
+
+    /// Tracks the recovery of losses. Returns true once a recovery from a retransmission timeout is over.
+    fn on_ack_received_recovery(&mut self, send_next: SeqNumber, ack_seq_no: SeqNumber) -> bool {
+        if self.after_rto && !self.in_recovery {
+            // Recover the data that was in flight when the retransmission timeout expired.
+            self.in_recovery = true;
+            self.recover = send_next;
+        }
+        if !self.in_recovery {
+            return false;
+        }
+
+        if ack_seq_no >= self.recover {
+            // Full acknowledgement.
+            self.in_recovery = false;
+            let restore_cwnd: bool = self.after_rto;
+            self.after_rto = false;
+            restore_cwnd
+        } else {
+            // Partial acknowledgement: the next hole was lost too.
+            self.lost_in_round += self.mss as u64;
+            self.fast_retransmit_now.set(true);
+            false
+        }
+    }
+}
+
+impl SlowStartCongestionAvoidance for Bbr {
+    fn get_cwnd(&self) -> SharedAsyncValue<u32> {
+        self.cwnd.clone()
+    }
+
+    fn on_segment_sent(&mut self, now: Instant, seq_no: SeqNumber, len: u32, bytes_in_flight: u32, app_limited: bool) {
+        if bytes_in_flight <= len {
+            // Nothing else is in flight, so the connection was idle: resume at the estimated bandwidth.
+            self.idle_restart = true;
+            if let Mode::ProbeBw(_) = self.mode {
+                let rate: f64 = self.bw() * (1.0 - Self::PACING_MARGIN);
+                if rate > 0.0 {
+                    self.pacing_rate = rate;
+                }
+            }
+        }
+        self.sampler.on_sent(now, seq_no, len, bytes_in_flight, app_limited);
+
+        let departure: Instant = match self.next_departure {
+            Some(next_departure) if next_departure > now => next_departure,
+            _ => now,
+        };
+        self.next_departure = Some(departure + Duration::from_secs_f64(len as f64 / self.pacing_rate));
+    }
+
+    fn on_ack_received(
+        &mut self,
+        now: Instant,
+        _rto: Duration,
+        send_unacked: SeqNumber,
+        send_next: SeqNumber,
+        ack_seq_no: SeqNumber,
+    ) {
+        // Ignore acknowledgements that fall outside of the data in flight.
+        if ack_seq_no < send_unacked || ack_seq_no > send_next {
+            return;
+        }
+        let bytes_acknowledged: u32 = (ack_seq_no - send_unacked).into();
+        if bytes_acknowledged == 0 {
+            if send_next != send_unacked {
+                self.on_dup_ack_received(send_next);
+            }
+            return;
+        }
+        self.duplicate_ack_count = 0;
+        let restore_cwnd: bool = self.on_ack_received_recovery(send_next, ack_seq_no);
+
+        // Update the model.
+        let bytes_in_flight: u64 = u32::from(send_next - ack_seq_no) as u64;
+        let rs: Option<RateSample> = self.sampler.on_ack(now, ack_seq_no, bytes_acknowledged);
+        self.round_start = false;
+        if let Some(rs) = rs.as_ref() {
+            self.update_from_sample(now, rs);
+        }
+        self.update_congestion_signals(now);
+        self.check_full_bw_reached(&rs);
+        self.check_startup_done();
+        self.check_drain(now, bytes_in_flight);
+        self.update_probe_bw_cycle_phase(now, bytes_in_flight);
+        self.check_probe_rtt(now, bytes_in_flight);
+        self.advance_latest_delivery_signals(&rs);
+        self.idle_restart = false;
+
+        // Update the control parameters.
+        self.set_pacing_rate();
+        self.set_send_quantum();
+        self.set_cwnd(bytes_acknowledged, restore_cwnd);
+    }
+
+    fn on_rto(&mut self, send_unacked: SeqNumber) {
+        self.prior_cwnd = self.save_cwnd();
+        self.after_rto = true;
+        self.in_recovery = false;
+        self.recover = send_unacked;
+        self.lost_in_round += self.mss as u64;
+        self.sampler.on_rto();
+        self.cwnd.set(self.mss);
+    }
+}
+
+impl FastRetransmitRecovery for Bbr {
+    fn get_duplicate_ack_count(&self) -> u32 {
+        self.duplicate_ack_count
+    }
+
+    fn get_retransmit_now_flag(&self) -> SharedAsyncValue<bool> {
+        self.fast_retransmit_now.clone()
+    }
+
+    fn on_fast_retransmit(&mut self) {
+        self.fast_retransmit_now.set_without_notify(false);
+    }
+}
+
+impl LimitedTransmit for Bbr {
+    fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32> {
+        self.limited_transmit_cwnd_increase.clone()
+    }
+}
+
+impl Pacing for Bbr {
+    fn get_pacing_deadline(&self) -> Option<Instant> {
+        // Let up to a send quantum out ahead of the pacing schedule.
+        let next_departure: Instant = self.next_departure?;
+        let burst: Duration = Duration::from_secs_f64(self.send_quantum as f64 / self.pacing_rate);
+        Some(next_departure.checked_sub(burst).unwrap_or(next_departure))
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        Bbr,
+        Mode,
+    };
+    use crate::inetstack::protocols::tcp::{
+        established::congestion_control::{
+            FastRetransmitRecovery,
+            Pacing,
+            SlowStartCongestionAvoidance,
+        },
+        SeqNumber,
+    };
+    use ::anyhow::Result;
+    use ::std::{
+        cmp::max,
+        collections::VecDeque,
+        time::{
+            Duration,
+            Instant,
+        },
+    };
+
+    const MSS: u32 = 1000;
+
+    /// Runs a bulk transfer for `duration` over a path with a bottleneck of `bw` bytes per second, which queues
+    /// segments without ever dropping them, and a round-trip time of `rtt`. Returns the connection, along with the
+    /// longest time that a segment queued at the bottleneck after `warmup` elapsed.
+    fn run_bulk_transfer(bw: f64, rtt: Duration, warmup: Duration, duration: Duration) -> Result<(Bbr, Duration)> {
+        let isn: SeqNumber = SeqNumber::from(1);
+        let start: Instant = Instant::now();
+        let mut bbr: Bbr = Bbr::create(start, MSS, isn);
+        let mut now: Instant = start;
+        let mut send_unacked: SeqNumber = isn;
+        let mut send_next: SeqNumber = isn;
+        let mut link_free: Instant = start;
+        let mut acks: VecDeque<(Instant, SeqNumber)> = VecDeque::new();
+        let mut max_queueing: Duration = Duration::ZERO;
+
+        while now < start + duration {
+            let bytes_in_flight: u32 = (send_next - send_unacked).into();
+            let send_at: Option<Instant> = if bytes_in_flight + MSS <= bbr.get_cwnd().get() {
+                Some(bbr.get_pacing_deadline().map_or(now, |deadline| max(deadline, now)))
+            } else {
+                None
+            };
+            // Take the next event, in time order.
+            let next_ack: Option<(Instant, SeqNumber)> = acks
+                .front()
+                .copied()
+                .filter(|(ack_at, _)| send_at.map_or(true, |send_at| *ack_at <= send_at));
+            match (next_ack, send_at) {
+                (Some((ack_at, ack_seq_no)), _) => {
+                    acks.pop_front();
+                    now = ack_at;
+                    bbr.on_ack_received(now, rtt, send_unacked, send_next, ack_seq_no);
+                    send_unacked = ack_seq_no;
+                },
+                (None, Some(send_at)) => {
+                    now = send_at;
+                    bbr.on_segment_sent(now, send_next, MSS, bytes_in_flight + MSS, false);
+                    if now > start + warmup {
+                        max_queueing = max(max_queueing, link_free.saturating_duration_since(now));
+                    }
+                    link_free = max(link_free, now) + Duration::from_secs_f64(MSS as f64 / bw);
+                    send_next = send_next + SeqNumber::from(MSS);
+                    acks.push_back((link_free + rtt, send_next));
+                },
+                (None, None) => ::anyhow::bail!("connection should not stall"),
+            }
+        }
+
+        Ok((bbr, max_queueing))
+    }
+
+    /// Checks that a bulk transfer fills the pipe, finds the bottleneck bandwidth and the round-trip time, and paces
+    /// data without building a standing queue at the bottleneck.
+    #[test]
+    fn bulk_transfer_converges() -> Result<()> {
+        let bw: f64 = 12.5e6;
+        let rtt: Duration = Duration::from_millis(10);
+        let (bbr, max_queueing): (Bbr, Duration) =
+            run_bulk_transfer(bw, rtt, Duration::from_secs(1), Duration::from_secs(4))?;
+
+        ::anyhow::ensure!(bbr.filled_pipe, "startup should be over");
+        ::anyhow::ensure!(matches!(bbr.mode, Mode::ProbeBw(_)), "unexpected mode {:?}", bbr.mode);
+        ::anyhow::ensure!(
+            bbr.max_bw > 0.9 * bw && bbr.max_bw < 1.1 * bw,
+            "unexpected bandwidth estimate {}",
+            bbr.max_bw
+        );
+        let min_rtt: Duration = match bbr.min_rtt {
+            Some((min_rtt, _)) => min_rtt,
+            None => ::anyhow::bail!("min_rtt should be known"),
+        };
+        ::anyhow::ensure!(
+            min_rtt >= rtt && min_rtt < rtt + Duration::from_millis(1),
+            "unexpected min_rtt {:?}",
+            min_rtt
+        );
+        ::anyhow::ensure!(
+            bbr.pacing_rate > 0.8 * bw && bbr.pacing_rate < 1.3 * bw,
+            "unexpected pacing rate {}",
+            bbr.pacing_rate
+        );
+        // Probing for bandwidth queues a quarter of the bandwidth-delay product and a few send quanta, for about one
+        // round trip, whereas a loss-based algorithm would fill the buffer of the bottleneck.
+        ::anyhow::ensure!(max_queueing < rtt, "too much queueing {:?}", max_queueing);
+
+        Ok(())
+    }
+
+    /// Checks that three duplicate ACKs trigger a fast retransmit, without cutting the congestion window.
+    #[test]
+    fn fast_retransmit_on_dup_acks() -> Result<()> {
+        let isn: SeqNumber = SeqNumber::from(1);
+        let now: Instant = Instant::now();
+        let mut bbr: Bbr = Bbr::create(now, MSS, isn);
+        let mut send_next: SeqNumber = isn;
+        for _ in 0..4 {
+            let bytes_in_flight: u32 = (send_next - isn).into();
+            bbr.on_segment_sent(now, send_next, MSS, bytes_in_flight + MSS, false);
+            send_next = send_next + SeqNumber::from(MSS);
+        }
+        let cwnd: u32 = bbr.get_cwnd().get();
+
+        let rto: Duration = Duration::from_secs(1);
+        for i in 1..=3 {
+            crate::ensure_eq!(bbr.get_retransmit_now_flag().get(), false);
+            bbr.on_ack_received(now, rto, isn, send_next, isn);
+            crate::ensure_eq!(bbr.get_duplicate_ack_count(), i);
+        }
+        crate::ensure_eq!(bbr.get_retransmit_now_flag().get(), true);
+        crate::ensure_eq!(bbr.get_cwnd().get(), cwnd);
+
+        Ok(())
+    }
+}
@@ -14,6 +14,7 @@ use super::{
     FastRetransmitRecovery,
     LimitedTransmit,
     Options,
+    Pacing,
     SlowStartCongestionAvoidance,
 };
 use crate::{
@@ -60,7 +61,7 @@ pub struct Cubic {
 }
 
 impl CongestionControl for Cubic {
-    fn new(mss: usize, seq_no: SeqNumber, options: Option<Options>) -> Box<dyn CongestionControl> {
+    fn new(_now: Instant, mss: usize, seq_no: SeqNumber, options: Option<Options>) -> Box<dyn CongestionControl> {
         let mss: u32 = mss.try_into().unwrap();
         // The initial value of cwnd is set according to RFC5681, section 3.1, page 7.
         let initial_cwnd: u32 = match mss {
@@ -293,7 +294,14 @@ impl SlowStartCongestionAvoidance for Cubic {
         self.limited_transmit_cwnd_increase.set_without_notify(new_value);
     }
 
-    fn on_ack_received(&mut self, rto: Duration, send_unacked: SeqNumber, send_next: SeqNumber, ack_seq_no: SeqNumber) {
+    fn on_ack_received(
+        &mut self,
+        _now: Instant,
+        rto: Duration,
+        send_unacked: SeqNumber,
+        send_next: SeqNumber,
+        ack_seq_no: SeqNumber,
+    ) {
         let bytes_acknowledged: u32 = (ack_seq_no - send_unacked).into();
         if bytes_acknowledged == 0 {
             // ACK is a duplicate
@@ -345,3 +353,5 @@ impl LimitedTransmit for Cubic {
         self.limited_transmit_cwnd_increase.clone()
     }
 }
+
+impl Pacing for Cubic {}
@@ -1,20 +1,27 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod bbr;
 mod cubic;
 mod none;
 mod options;
+mod rate;
 
 use crate::{
     collections::async_value::SharedAsyncValue,
     inetstack::protocols::tcp::SeqNumber,
+    runtime::network::config::CongestionControlAlgorithm,
 };
 use ::std::{
     fmt::Debug,
-    time::Duration,
+    time::{
+        Duration,
+        Instant,
+    },
 };
 
 pub use self::{
+    bbr::Bbr,
     cubic::Cubic,
     none::None,
     options::{
@@ -31,6 +38,7 @@ pub trait SlowStartCongestionAvoidance {
 
     fn on_ack_received(
         &mut self,
+        _now: Instant,
         _rto: Duration,
         _send_unacked: SeqNumber,
         _send_next: SeqNumber,
@@ -43,6 +51,18 @@ pub trait SlowStartCongestionAvoidance {
 
     // Called immediately before a segment is sent for the 1st time.
     fn on_send(&mut self, _rto: Duration, _num_sent_bytes: u32) {}
+
+    // Called immediately after a segment is sent for the 1st time, with the sequence space that it covers, the bytes in
+    // flight once it is sent, and whether the application ran out of data to send.
+    fn on_segment_sent(
+        &mut self,
+        _now: Instant,
+        _seq_no: SeqNumber,
+        _len: u32,
+        _bytes_in_flight: u32,
+        _app_limited: bool,
+    ) {
+    }
 }
 
 pub trait FastRetransmitRecovery
@@ -65,10 +85,37 @@ where
     fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32>;
 }
 
-pub trait CongestionControl: SlowStartCongestionAvoidance + FastRetransmitRecovery + LimitedTransmit + Debug {
-    fn new(mss: usize, seq_no: SeqNumber, options: Option<options::Options>) -> Box<dyn CongestionControl>
+pub trait Pacing
+where
+    Self: SlowStartCongestionAvoidance,
+{
+    // Returns the earliest time at which the next segment may be sent, if the algorithm paces the connection.
+    fn get_pacing_deadline(&self) -> Option<Instant> {
+        None
+    }
+}
+
+pub trait CongestionControl:
+    SlowStartCongestionAvoidance + FastRetransmitRecovery + LimitedTransmit + Pacing + Debug
+{
+    fn new(
+        now: Instant,
+        mss: usize,
+        seq_no: SeqNumber,
+        options: Option<options::Options>,
+    ) -> Box<dyn CongestionControl>
     where
         Self: Sized;
 }
 
-pub type CongestionControlConstructor = fn(usize, SeqNumber, Option<options::Options>) -> Box<dyn CongestionControl>;
+pub type CongestionControlConstructor =
+    fn(Instant, usize, SeqNumber, Option<options::Options>) -> Box<dyn CongestionControl>;
+
+/// Returns the constructor of a congestion control algorithm.
+pub fn get_constructor(algorithm: CongestionControlAlgorithm) -> CongestionControlConstructor {
+    match algorithm {
+        CongestionControlAlgorithm::None => None::new,
+        CongestionControlAlgorithm::Cubic => Cubic::new,
+        CongestionControlAlgorithm::Bbr => Bbr::new,
+    }
+}
@@ -6,13 +6,17 @@ use super::{
     FastRetransmitRecovery,
     LimitedTransmit,
     Options,
+    Pacing,
     SlowStartCongestionAvoidance,
 };
 use crate::{
     collections::async_value::SharedAsyncValue,
     inetstack::protocols::tcp::SeqNumber,
 };
-use ::std::fmt::Debug;
+use ::std::{
+    fmt::Debug,
+    time::Instant,
+};
 
 // Implementation of congestion control which does nothing.
 #[derive(Debug)]
@@ -23,7 +27,7 @@ pub struct None {
 }
 
 impl CongestionControl for None {
-    fn new(_mss: usize, _seq_no: SeqNumber, _options: Option<Options>) -> Box<dyn CongestionControl> {
+    fn new(_now: Instant, _mss: usize, _seq_no: SeqNumber, _options: Option<Options>) -> Box<dyn CongestionControl> {
         Box::new(Self {
             cwnd: SharedAsyncValue::new(u32::MAX),
             fast_retransmit_flag: SharedAsyncValue::new(false),
@@ -47,3 +51,4 @@ impl LimitedTransmit for None {
         self.limited_retransmit_cwnd_increase.clone()
     }
 }
+impl Pacing for None {}
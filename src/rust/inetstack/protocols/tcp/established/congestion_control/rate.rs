@@ -0,0 +1,170 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Delivery rate estimation, as in draft-cheng-iccrg-delivery-rate-estimation. Each segment that is sent for the first
+//! time records how much data had been delivered when it left, and when. Once it is acknowledged, the data delivered
+//! since then, over the time that elapsed, yields a sample of the delivery rate of the path. Samples are taken on
+//! cumulative acknowledgements only: data that is selectively acknowledged counts as delivered once the cumulative
+//! acknowledgement covers it.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::inetstack::protocols::tcp::SeqNumber;
+use ::std::{
+    cmp,
+    collections::VecDeque,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Delivery state of the connection when a segment was sent.
+#[derive(Debug)]
+struct SegmentState {
+    /// Sequence number that follows the segment.
+    end_seq_no: SeqNumber,
+    /// Bytes delivered when the segment was sent.
+    delivered: u64,
+    /// Time at which [Self::delivered] was last updated, when the segment was sent.
+    delivered_time: Instant,
+    /// Send time of the segment that opened the flight of this one.
+    first_sent_time: Instant,
+    /// Send time of the segment.
+    sent_time: Instant,
+    /// Was the connection application limited when the segment was sent?
+    is_app_limited: bool,
+}
+
+/// A sample of the delivery rate.
+#[derive(Clone, Copy, Debug)]
+pub struct RateSample {
+    /// Bytes delivered over the sample interval.
+    pub delivered: u64,
+    /// Bytes delivered before the acknowledged segment was sent.
+    pub prior_delivered: u64,
+    /// Duration of the sample interval.
+    pub interval: Duration,
+    /// Round-trip time of the acknowledged segment.
+    pub rtt: Duration,
+    /// Was the connection application limited when the acknowledged segment was sent? If so, the sample only bounds
+    /// the delivery rate from below.
+    pub is_app_limited: bool,
+}
+
+/// Delivery rate sampler of a connection.
+#[derive(Debug)]
+pub struct RateSampler {
+    /// Bytes delivered so far.
+    delivered: u64,
+    /// Time at which [Self::delivered] was last updated.
+    delivered_time: Instant,
+    /// Send time of the segment that opened the current flight.
+    first_sent_time: Instant,
+    /// If nonzero, the connection is application limited until this many bytes are delivered.
+    app_limited_until: u64,
+    /// Segments in flight, in sequence order.
+    in_flight: VecDeque<SegmentState>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl RateSampler {
+    /// Creates a delivery rate sampler at time `now`. Its timestamps are reset when the first segment is sent.
+    pub fn new(now: Instant) -> Self {
+        Self {
+            delivered: 0,
+            delivered_time: now,
+            first_sent_time: now,
+            app_limited_until: 0,
+            in_flight: VecDeque::new(),
+        }
+    }
+
+    /// Returns the number of bytes delivered so far.
+    pub fn get_delivered(&self) -> u64 {
+        self.delivered
+    }
+
+    /// Records a segment that is sent for the first time. `app_limited` states that the application had no more data to
+    /// send, so that samples taken until the data in flight is delivered tell little about the path.
+    pub fn on_sent(&mut self, now: Instant, seq_no: SeqNumber, len: u32, bytes_in_flight: u32, app_limited: bool) {
+        // A new flight starts: don't count the idle time towards the next samples.
+        if self.in_flight.is_empty() {
+            self.first_sent_time = now;
+            self.delivered_time = now;
+        }
+
+        // The send that drains the application's data is itself application limited.
+        if app_limited {
+            self.app_limited_until = cmp::max(self.delivered + bytes_in_flight as u64, 1);
+        }
+
+        self.in_flight.push_back(SegmentState {
+            end_seq_no: seq_no + SeqNumber::from(len),
+            delivered: self.delivered,
+            delivered_time: self.delivered_time,
+            first_sent_time: self.first_sent_time,
+            sent_time: now,
+            is_app_limited: self.app_limited_until != 0,
+        });
+    }
+
+    /// Accounts for `bytes_acknowledged` newly acknowledged bytes, up to `ack_seq_no`. Returns a sample taken from the
+    /// most recently sent segment that the acknowledgement covers, if any.
+    pub fn on_ack(&mut self, now: Instant, ack_seq_no: SeqNumber, bytes_acknowledged: u32) -> Option<RateSample> {
+        self.delivered += bytes_acknowledged as u64;
+        self.delivered_time = now;
+
+        let mut latest: Option<SegmentState> = None;
+        while let Some(segment) = self.in_flight.front() {
+            if segment.end_seq_no > ack_seq_no {
+                break;
+            }
+            latest = self.in_flight.pop_front();
+        }
+
+        if self.app_limited_until != 0 && self.delivered > self.app_limited_until {
+            self.app_limited_until = 0;
+        }
+
+        let segment: SegmentState = latest?;
+        self.first_sent_time = segment.sent_time;
+
+        // The rate is bounded by the pace at which data was sent as well as by the pace at which it was acknowledged, so
+        // the longest of both intervals is used.
+        let send_elapsed: Duration = segment.sent_time.saturating_duration_since(segment.first_sent_time);
+        let ack_elapsed: Duration = now.saturating_duration_since(segment.delivered_time);
+        Some(RateSample {
+            delivered: self.delivered - segment.delivered,
+            prior_delivered: segment.delivered,
+            interval: cmp::max(send_elapsed, ack_elapsed),
+            rtt: now.saturating_duration_since(segment.sent_time),
+            is_app_limited: segment.is_app_limited,
+        })
+    }
+
+    /// Forgets the segments in flight, since their send times mean little once they are retransmitted.
+    pub fn on_rto(&mut self) {
+        self.in_flight.clear();
+    }
+}
+
+impl RateSample {
+    /// Returns the delivery rate of the sample, in bytes per second.
+    pub fn get_delivery_rate(&self) -> Option<f64> {
+        if self.interval.is_zero() {
+            None
+        } else {
+            Some(self.delivered as f64 / self.interval.as_secs_f64())
+        }
+    }
+}
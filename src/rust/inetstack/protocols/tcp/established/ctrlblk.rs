@@ -6,6 +6,7 @@ use super::{
         self,
         CongestionControlConstructor,
     },
+    reassembly::ReassemblyQueue,
     rto::RtoCalculator,
     sender::{
         Sender,
@@ -22,6 +23,7 @@ use crate::{
     },
     inetstack::protocols::{
         arp::SharedArpPeer,
+        checksum,
         ethernet2::{
             EtherType2,
             Ethernet2Header,
@@ -30,7 +32,9 @@ use crate::{
         ipv4::Ipv4Header,
         tcp::{
             segment::{
+                SelectiveAcknowlegement,
                 TcpHeader,
+                TcpOptions2,
                 TcpSegment,
             },
             SeqNumber,
@@ -44,13 +48,16 @@ use crate::{
             types::MacAddress,
             NetworkRuntime,
         },
+        stats::{
+            with_stats,
+            ThreadStats,
+        },
         SharedDemiRuntime,
         SharedObject,
     },
 };
 use ::futures::never::Never;
 use ::std::{
-    collections::VecDeque,
     convert::TryInto,
     net::SocketAddrV4,
     ops::{
@@ -69,10 +76,11 @@ use ::std::{
 // mechanism used to manage the receive queue (a VecDeque) than anything else.
 const RECV_QUEUE_SZ: usize = 2048;
 
-// TODO: Review this value (and its purpose).  It (16 segments) seems awfully small (would make fast retransmit less
-// useful), and this mechanism isn't the best way to protect ourselves against deliberate out-of-order segment attacks.
-// Ideally, we'd limit out-of-order data to that which (along with the unread data) will fit in the receive window.
-const MAX_OUT_OF_ORDER: usize = 16;
+// TODO: Review this value (and its purpose).  Out-of-order data is already limited (in size) by our receive window, so
+// this mostly bounds the bookkeeping that a peer can make us do with tiny segments.  Lookups in the reassembly queue are
+// logarithmic, so we can afford to hold a full receive queue's worth of segments, which keeps loss recovery effective
+// on connections with large windows.
+const MAX_OUT_OF_ORDER: usize = RECV_QUEUE_SZ;
 
 // TCP Connection State.
 // Note: This ControlBlock structure is only used after we've reached the ESTABLISHED state, so states LISTEN,
@@ -127,9 +135,14 @@ impl Receiver {
     pub async fn pop(&mut self, size: Option<usize>) -> Result<DemiBuffer, Fail> {
         let buf: DemiBuffer = if let Some(size) = size {
             let mut buf: DemiBuffer = self.recv_queue.pop(None).await?;
-            // Split the buffer if it's too big.
-            if buf.len() > size {
-                buf.split_front(size)?
+            // Cut the buffer if it's too big. A coalesced run may hold many segments' worth of data, so the rest is
+            // kept for the next pop.
+            if buf.total_len() > size {
+                let mut front: DemiBuffer = buf.clone();
+                front.truncate(size)?;
+                buf.advance(size)?;
+                self.recv_queue.push_front(buf);
+                front
             } else {
                 buf
             }
@@ -137,13 +150,13 @@ impl Receiver {
             self.recv_queue.pop(None).await?
         };
 
-        self.reader_next = self.reader_next + SeqNumber::from(buf.len() as u32);
+        self.reader_next = self.reader_next + SeqNumber::from(buf.total_len() as u32);
 
         Ok(buf)
     }
 
     pub fn push(&mut self, buf: DemiBuffer) {
-        let buf_len: u32 = buf.len() as u32;
+        let buf_len: u32 = buf.total_len() as u32;
         self.recv_queue.push(buf);
         self.receive_next = self.receive_next + SeqNumber::from(buf_len as u32);
     }
@@ -190,7 +203,11 @@ pub struct ControlBlock<N: NetworkRuntime> {
     // receive window) but can't yet present to the user because we're missing some other data that comes between this
     // and what we've already presented to the user.
     //
-    out_of_order: VecDeque<(SeqNumber, DemiBuffer)>,
+    out_of_order: ReassemblyQueue,
+
+    // RFC 2018: Did both sides agree to use selective acknowledgements during the handshake?  If so, our ACKs describe
+    // the out-of-order data that we hold, and we skip the data that our peer holds when retransmitting.
+    sack_permitted: bool,
 
     // The sequence number of the FIN, if we received it out-of-order.
     // Note: This could just be a boolean to remember if we got a FIN; the sequence number is for checking correctness.
@@ -237,12 +254,20 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         sender_window_size: u32,
         sender_window_scale: u8,
         sender_mss: usize,
+        sack_permitted: bool,
         cc_constructor: CongestionControlConstructor,
         congestion_control_options: Option<congestion_control::Options>,
         recv_queue: SharedAsyncQueue<(Ipv4Header, TcpHeader, DemiBuffer)>,
         ack_queue: SharedAsyncQueue<usize>,
     ) -> Self {
-        let sender: Sender = Sender::new(sender_seq_no, sender_window_size, sender_window_scale, sender_mss);
+        let sender: Sender = Sender::new(
+            sender_seq_no,
+            sender_window_size,
+            sender_window_scale,
+            sender_mss,
+            tcp_config.get_tx_segmentation_offload(),
+        );
+        let now: Instant = runtime.get_now();
         Self(SharedObject::<ControlBlock<N>>::new(ControlBlock {
             local,
             remote,
@@ -257,10 +282,11 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
             ack_deadline: SharedAsyncValue::new(None),
             receive_buffer_size: receiver_window_size,
             window_scale: receiver_window_scale,
-            out_of_order: VecDeque::new(),
+            out_of_order: ReassemblyQueue::new(receiver_seq_no, MAX_OUT_OF_ORDER),
+            sack_permitted,
             out_of_order_fin: Option::None,
             receiver: Receiver::new(receiver_seq_no, receiver_seq_no),
-            cc: cc_constructor(sender_mss, sender_seq_no, congestion_control_options),
+            cc: cc_constructor(now, sender_mss, sender_seq_no, congestion_control_options),
             retransmit_deadline: SharedAsyncValue::new(None),
             rto_calculator: RtoCalculator::new(),
             recv_queue,
@@ -290,6 +316,10 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         self.sender.retransmit(self.clone())
     }
 
+    pub fn reset_retransmissions(&self) {
+        self.sender.reset_retransmissions()
+    }
+
     pub fn congestion_control_watch_retransmit_now_flag(&self) -> SharedAsyncValue<bool> {
         self.cc.get_retransmit_now_flag()
     }
@@ -306,6 +336,21 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         self.cc.on_send(rto, num_sent_bytes)
     }
 
+    pub fn congestion_control_on_segment_sent(
+        &mut self,
+        seq_no: SeqNumber,
+        len: u32,
+        bytes_in_flight: u32,
+        app_limited: bool,
+    ) {
+        let now: Instant = self.get_now();
+        self.cc.on_segment_sent(now, seq_no, len, bytes_in_flight, app_limited)
+    }
+
+    pub fn congestion_control_get_pacing_deadline(&self) -> Option<Instant> {
+        self.cc.get_pacing_deadline()
+    }
+
     pub fn congestion_control_on_cwnd_check_before_send(&mut self) {
         self.cc.on_cwnd_check_before_send()
     }
@@ -322,6 +367,10 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         self.sender.get_mss()
     }
 
+    pub fn get_max_send_size(&self) -> usize {
+        self.sender.get_max_send_size()
+    }
+
     pub fn get_send_window(&self) -> SharedAsyncValue<u32> {
         self.sender.get_send_window()
     }
@@ -367,6 +416,7 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
     }
 
     pub fn rto_back_off(&mut self) {
+        with_stats(|s: &ThreadStats| s.tcp_rto_backoffs.incr());
         self.rto_calculator.back_off()
     }
 
@@ -415,29 +465,63 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
                 },
             };
 
-            debug!(
-                "{:?} Connection Receiving {} bytes + {:?}",
-                self.state,
-                data.len(),
-                header
-            );
-
-            match self.process_packet(header, data) {
-                Ok(()) => (),
-                Err(e) if e.errno == libc::ECONNRESET => {
-                    self.state = State::CloseWait;
-                    let cause: String = format!(
-                        "remote closed connection, stopping processing (local={:?}, remote={:?})",
-                        self.local, self.remote
-                    );
-                    error!("poll(): {}", cause);
-                    return Err(Fail::new(libc::ECANCELED, &cause));
-                },
-                Err(e) => debug!("Dropped packet: {:?}", e),
+            let mut num_accepted: usize = self.process_queued_packet(header, data)? as usize;
+
+            // Process every other segment that is already queued (e.g. the rest of a receive batch) before deciding
+            // whether to ACK, so that a burst of back-to-back segments is acknowledged once.
+            while self.state == State::Established {
+                match self.recv_queue.try_pop() {
+                    Some((_, header, data)) => num_accepted += self.process_queued_packet(header, data)? as usize,
+                    None => break,
+                }
+            }
+
+            // We should ACK these segments, preferably via piggybacking on a response.
+            // TODO: Consider replacing the delayed ACK timer with a simple flag.
+            if num_accepted == 1 && self.ack_deadline.get().is_none() {
+                // Start the delayed ACK timer to ensure an ACK gets sent soon even if no piggyback opportunity occurs.
+                let timeout: Duration = self.ack_delay_timeout;
+                // Getting the current time is extremely cheap as it is just a variable lookup.
+                let now: Instant = self.get_now();
+                self.ack_deadline.set(Some(now + timeout));
+            } else if num_accepted > 0 {
+                // We already owe our peer an ACK (the timer was already running or we accepted several segments), so
+                // cancel the timer and ACK now.
+                self.ack_deadline.set(None);
+                trace!("poll(): sending ack on deadline expiration");
+                self.send_ack();
             }
         }
     }
 
+    /// Processes a segment popped from the receive queue. Returns true if the segment was accepted and should be
+    /// acknowledged, false if it was dropped, and ECANCELED if the remote closed the connection.
+    fn process_queued_packet(&mut self, header: TcpHeader, data: DemiBuffer) -> Result<bool, Fail> {
+        debug!(
+            "{:?} Connection Receiving {} bytes + {:?}",
+            self.state,
+            data.total_len(),
+            header
+        );
+
+        match self.process_packet(header, data) {
+            Ok(()) => Ok(true),
+            Err(e) if e.errno == libc::ECONNRESET => {
+                self.state = State::CloseWait;
+                let cause: String = format!(
+                    "remote closed connection, stopping processing (local={:?}, remote={:?})",
+                    self.local, self.remote
+                );
+                error!("poll(): {}", cause);
+                Err(Fail::new(libc::ECANCELED, &cause))
+            },
+            Err(e) => {
+                debug!("Dropped packet: {:?}", e);
+                Ok(false)
+            },
+        }
+    }
+
     /// This is the main function for processing an incoming packet during the Established state when the connection is
     /// active. Each step in this function return Ok if there is further processing to be done and EBADMSG if the
     /// packet should be dropped after the step.
@@ -445,7 +529,7 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         let mut seg_start: SeqNumber = header.seq_num;
 
         let mut seg_end: SeqNumber = seg_start;
-        let mut seg_len: u32 = data.len() as u32;
+        let mut seg_len: u32 = data.total_len() as u32;
 
         // Check if the segment is in the receive window and trim off everything else.
         self.check_segment_in_window(&mut header, &mut data, &mut seg_start, &mut seg_end, &mut seg_len)?;
@@ -458,24 +542,10 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
             warn!("Got packet with URG bit set!");
         }
 
-        if data.len() > 0 {
+        if data.total_len() > 0 {
             self.process_data(&mut header, data, seg_start, seg_end, seg_len)?;
         }
         self.process_remote_close(&header)?;
-        // We should ACK this segment, preferably via piggybacking on a response.
-        // TODO: Consider replacing the delayed ACK timer with a simple flag.
-        if self.ack_deadline.get().is_none() {
-            // Start the delayed ACK timer to ensure an ACK gets sent soon even if no piggyback opportunity occurs.
-            let timeout: Duration = self.ack_delay_timeout;
-            // Getting the current time is extremely cheap as it is just a variable lookup.
-            let now: Instant = self.get_now();
-            self.ack_deadline.set(Some(now + timeout));
-        } else {
-            // We already owe our peer an ACK (the timer was already running), so cancel the timer and ACK now.
-            self.ack_deadline.set(None);
-            trace!("process_packet(): sending ack on deadline expiration");
-            self.send_ack();
-        }
 
         Ok(())
     }
@@ -554,7 +624,7 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
                         header.syn = false;
                         duplicate -= 1;
                     }
-                    data.adjust(duplicate as usize)
+                    data.advance(duplicate as usize)
                         .expect("'data' should contain at least 'duplicate' bytes");
                 }
             } else {
@@ -590,7 +660,7 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
                 header.fin = false;
                 excess -= 1;
             }
-            data.trim(excess as usize)
+            data.truncate(data.total_len() - excess as usize)
                 .expect("'data' should contain at least 'excess' bytes");
         }
 
@@ -663,8 +733,9 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         // grained.  It currently duplicates the new/duplicate ack check itself internally, which is inefficient.
         // We should either make separate calls for each case or integrate those cases directly.
         let rto: Duration = self.rto_calculator.rto();
+        let now: Instant = self.get_now();
         self.cc
-            .on_ack_received(rto, send_unacknowledged, send_next, header.ack_num);
+            .on_ack_received(now, rto, send_unacknowledged, send_next, header.ack_num);
 
         if send_unacknowledged < header.ack_num {
             if header.ack_num <= send_next {
@@ -713,6 +784,17 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
             // TODO: Implement fast-retransmit.  In which case, we'd increment our dup-ack counter here.
             warn!("process_ack(): received duplicate ack ({:?})", header.ack_num);
         }
+
+        // Record the data that our peer holds beyond the cumulative acknowledgement, so it isn't retransmitted.
+        if self.sack_permitted {
+            for option in header.iter_options() {
+                if let TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks } = option {
+                    self.sender.process_sack_blocks(&sacks[..*num_sacks]);
+                }
+            }
+            // Retransmit what the scoreboard deems lost now, rather than on the next timeout.
+            self.sender.recover_losses(self.clone());
+        }
         Ok(())
     }
 
@@ -721,7 +803,7 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         header: &mut TcpHeader,
         data: DemiBuffer,
         seg_start: SeqNumber,
-        mut seg_end: SeqNumber,
+        seg_end: SeqNumber,
         mut seg_len: u32,
     ) -> Result<(), Fail> {
         // We can only process in-order data (or FIN).  Check for out-of-order segment.
@@ -736,11 +818,10 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
                         if header.fin {
                             seg_len -= 1;
                             self.store_out_of_order_fin(seg_end);
-                            seg_end = seg_end - SeqNumber::from(1);
                         }
-                        debug_assert_eq!(seg_len, data.len() as u32);
+                        debug_assert_eq!(seg_len, data.total_len() as u32);
                         if seg_len > 0 {
-                            self.store_out_of_order_segment(seg_start, seg_end, data);
+                            self.store_out_of_order_segment(seg_start, data);
                         }
                         // Sending an ACK here is only a "MAY" according to the RFCs, but helpful for fast retransmit.
                         trace!("process_data(): send ack on out-of-order segment");
@@ -781,20 +862,48 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         let seq_num: SeqNumber = self.get_send_next().get();
         header.seq_num = seq_num;
 
+        // RFC 2018: Describe the out-of-order data that we hold, so our peer only retransmits what we are missing.
+        if self.sack_permitted {
+            let mut sacks: [SelectiveAcknowlegement; 4] = [SelectiveAcknowlegement {
+                begin: SeqNumber::from(0),
+                end: SeqNumber::from(0),
+            }; 4];
+            let num_sacks: usize = self.out_of_order.sack_blocks(&mut sacks);
+            if num_sacks > 0 {
+                header.push_option(TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks });
+            }
+        }
+
         // TODO: Remove this if clause once emit() is fixed to not require the remote hardware addr (this should be
         // left to the ARP layer and not exposed to TCP).
         if let Some(remote_link_addr) = self.arp().try_query(self.remote.ip().clone()) {
-            self.emit(header, None, remote_link_addr);
+            self.emit(header, None, None, remote_link_addr);
+        }
+    }
+
+    /// Computes the one's complement sum of the data in a segment, unless checksums are offloaded to the NIC.
+    pub fn checksum_data(&self, data: &DemiBuffer) -> Option<u16> {
+        if self.tcp_config.get_tx_checksum_offload() {
+            None
+        } else {
+            Some(checksum::sum_pieces(data.segments()))
         }
     }
 
     /// Transmit this message to our connected peer.
     ///
-    pub fn emit(&mut self, header: TcpHeader, body: Option<DemiBuffer>, remote_link_addr: MacAddress) {
+    /// If `body_sum` is given, it must be the one's complement sum of `body`.
+    pub fn emit(
+        &mut self,
+        header: TcpHeader,
+        body: Option<DemiBuffer>,
+        body_sum: Option<u16>,
+        remote_link_addr: MacAddress,
+    ) {
         // Only perform this debug print in debug builds.  debug_assertions is compiler set in non-optimized builds.
         #[cfg(debug_assertions)]
         if body.is_some() {
-            debug!("Sending {} bytes + {:?}", body.as_ref().unwrap().len(), header);
+            debug!("Sending {} bytes + {:?}", body.as_ref().unwrap().total_len(), header);
         } else {
             debug!("Sending 0 bytes + {:?}", header);
         }
@@ -804,6 +913,17 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
 
         let sent_fin: bool = header.fin;
 
+        // Under TCP segmentation offload, the sender may hand us more than a segment's worth of data at once, which the
+        // network device then cuts into segments of the size that our peer accepts.
+        let mss: usize = self.sender.get_mss();
+        let segment_size: Option<u16> = match body {
+            Some(ref body) if body.total_len() > mss => {
+                debug_assert!(self.tcp_config.get_tx_segmentation_offload().is_some());
+                Some(mss as u16)
+            },
+            _ => None,
+        };
+
         // Prepare description of TCP segment to send.
         // TODO: Change this to call lower levels to fill in their header information, handle routing, ARPing, etc.
         let segment = TcpSegment {
@@ -811,7 +931,9 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
             ipv4_hdr: Ipv4Header::new(self.local.ip().clone(), self.remote.ip().clone(), IpProtocol::TCP),
             tcp_hdr: header,
             data: body,
+            data_sum: body_sum,
             tx_checksum_offload: self.tcp_config.get_tx_checksum_offload(),
+            segment_size,
         };
 
         // Call the runtime to send the segment.
@@ -905,101 +1027,10 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
 
     // This routine takes an incoming TCP segment and adds it to the out-of-order receive queue.
     // If the new segment had a FIN it has been removed prior to this routine being called.
-    // Note: Since this is not the "fast path", this is written for clarity over efficiency.
     //
-    fn store_out_of_order_segment(&mut self, mut new_start: SeqNumber, mut new_end: SeqNumber, mut buf: DemiBuffer) {
-        let mut action_index: usize = self.out_of_order.len();
-        let mut another_pass_neeeded: bool = true;
-
-        while another_pass_neeeded {
-            another_pass_neeeded = false;
-
-            // Find the new segment's place in the out-of-order store.
-            // The out-of-order store is sorted by starting sequence number, and contains no duplicate data.
-            action_index = self.out_of_order.len();
-            for index in 0..self.out_of_order.len() {
-                let stored_segment: &(SeqNumber, DemiBuffer) = &self.out_of_order[index];
-
-                // Properties of the segment stored at this index.
-                let stored_start: SeqNumber = stored_segment.0;
-                let stored_len: u32 = stored_segment.1.len() as u32;
-                debug_assert_ne!(stored_len, 0);
-                let stored_end: SeqNumber = stored_start + SeqNumber::from(stored_len - 1);
-
-                //
-                // The new data segment has six possibilites when compared to an existing out-of-order segment:
-                //
-                //                                |<- out-of-order segment ->|
-                //
-                // |<- new before->|    |<- new front overlap ->|    |<- new end overlap ->|    |<- new after ->|
-                //                                   |<- new duplicate ->|
-                //                            |<- new completely encompassing ->|
-                //
-                if new_start < stored_start {
-                    // The new segment starts before the start of this out-of-order segment.
-                    if new_end < stored_start {
-                        // The new segment comes completely before this out-of-order segment.
-                        // Since the out-of-order store is sorted, we don't need to check for overlap with any more.
-                        action_index = index;
-                        break;
-                    }
-                    // The end of the new segment overlaps with the start of this out-of-order segment.
-                    if stored_end < new_end {
-                        // The new segment ends after the end of this out-of-order segment.  In other words, the new
-                        // segment completely encompasses the out-of-order segment.
-
-                        // Set flags to remove the currently stored segment and re-run the insertion loop, as the
-                        // new segment may completely encompass even more segments.
-                        another_pass_neeeded = true;
-                        action_index = index;
-                        break;
-                    }
-                    // We have some data overlap between the new segment and the front of the out-of-order segment.
-                    // Trim the end of the new segment and stop checking for out-of-order overlap.
-                    let excess: u32 = u32::from(new_end - stored_start) + 1;
-                    new_end = new_end - SeqNumber::from(excess);
-                    buf.trim(excess as usize)
-                        .expect("'buf' should contain at least 'excess' bytes");
-                    break;
-                } else {
-                    // The new segment starts at or after the start of this out-of-order segment.
-                    // This is the stored_start <= new_start case.
-                    if new_end <= stored_end {
-                        // And the new segment ends at or before this out-of-order segment.
-                        // The new segment's data is a complete duplicate of this out-of-order segment's data.
-                        // Just drop the new segment.
-                        return;
-                    }
-                    if stored_end < new_start {
-                        // The new segment comes entirely after this out-of-order segment.
-                        // Continue to check the next out-of-order segment for potential overlap.
-                        continue;
-                    }
-                    // We have some data overlap between the new segment and the end of the out-of-order segment.
-                    // Adjust the beginning of the new segment and continue on to check the next out-of-order segment.
-                    let duplicate: u32 = u32::from(stored_end - new_start);
-                    new_start = new_start + SeqNumber::from(duplicate);
-                    buf.adjust(duplicate as usize)
-                        .expect("'buf' should contain at least 'duplicate' bytes");
-                    continue;
-                }
-            }
-
-            if another_pass_neeeded {
-                // The new segment completely encompassed an existing segment, which we will now remove.
-                self.out_of_order.remove(action_index);
-            }
-        }
-
-        // Insert the new segment into the correct position.
-        self.out_of_order.insert(action_index, (new_start, buf));
-
-        // If the out-of-order store now contains too many entries, delete the later entries.
-        // TODO: The out-of-order store is already limited (in size) by our receive window, while the below check
-        // imposes a limit on the number of entries.  Do we need this?  Presumably for attack mitigation?
-        while self.out_of_order.len() > MAX_OUT_OF_ORDER {
-            self.out_of_order.pop_back();
-        }
+    fn store_out_of_order_segment(&mut self, seg_start: SeqNumber, buf: DemiBuffer) {
+        let recv_next: SeqNumber = self.receiver.receive_next;
+        self.out_of_order.insert(recv_next, seg_start, buf);
     }
 
     // This routine takes an incoming in-order TCP segment and adds the data to the user's receive queue.  If the new
@@ -1017,30 +1048,21 @@ impl<N: NetworkRuntime> SharedControlBlock<N> {
         debug_assert_eq!(seg_start, recv_next);
 
         // Push the new segment data onto the end of the receive queue.
-        let mut recv_next: SeqNumber = recv_next + SeqNumber::from(buf.len() as u32);
+        let mut recv_next: SeqNumber = recv_next + SeqNumber::from(buf.total_len() as u32);
         // This inserts the segment and wakes a waiting pop coroutine.
         self.receiver.push(buf);
 
         // Okay, we've successfully received some new data.  Check if any of the formerly out-of-order data waiting in
         // the out-of-order queue is now in-order.  If so, we can move it to the receive queue.
         let mut added_out_of_order: bool = false;
-        while !self.out_of_order.is_empty() {
-            if let Some(stored_entry) = self.out_of_order.front() {
-                if stored_entry.0 == recv_next {
-                    // Move this entry's buffer from the out-of-order store to the receive queue.
-                    // This data is now considered to be "received" by TCP, and included in our RCV.NXT calculation.
-                    debug!("Recovering out-of-order packet at {}", recv_next);
-                    if let Some(temp) = self.out_of_order.pop_front() {
-                        recv_next = recv_next + SeqNumber::from(temp.1.len() as u32);
-                        // This inserts the segment and wakes a waiting pop coroutine.
-                        self.receiver.push(temp.1);
-                        added_out_of_order = true;
-                    }
-                } else {
-                    // Since our out-of-order list is sorted, we can stop when the next segment is not in sequence.
-                    break;
-                }
-            }
+        while let Some(buf) = self.out_of_order.pop(recv_next) {
+            // Move this entry's buffer from the out-of-order store to the receive queue.
+            // This data is now considered to be "received" by TCP, and included in our RCV.NXT calculation.
+            debug!("Recovering out-of-order packet at {}", recv_next);
+            recv_next = recv_next + SeqNumber::from(buf.total_len() as u32);
+            // This inserts the segment and wakes a waiting pop coroutine.
+            self.receiver.push(buf);
+            added_out_of_order = true;
         }
 
         // TODO: Review recent change to update control block copy of recv_next upon each push to the receiver.
@@ -4,6 +4,7 @@
 mod background;
 pub mod congestion_control;
 mod ctrlblk;
+mod reassembly;
 mod rto;
 mod sender;
 
@@ -75,6 +76,7 @@ impl<N: NetworkRuntime> EstablishedSocket<N> {
         sender_window_size: u32,
         sender_window_scale: u8,
         sender_mss: usize,
+        sack_permitted: bool,
         cc_constructor: CongestionControlConstructor,
         congestion_control_options: Option<congestion_control::Options>,
         dead_socket_tx: mpsc::UnboundedSender<QDesc>,
@@ -96,6 +98,7 @@ impl<N: NetworkRuntime> EstablishedSocket<N> {
             sender_window_size,
             sender_window_scale,
             sender_mss,
+            sack_permitted,
             cc_constructor,
             congestion_control_options,
             recv_queue.clone(),
@@ -0,0 +1,412 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+use crate::{
+    inetstack::protocols::tcp::{
+        segment::SelectiveAcknowlegement,
+        SeqNumber,
+    },
+    runtime::{
+        memory::DemiBuffer,
+        stats::{
+            with_stats,
+            ThreadStats,
+        },
+    },
+};
+use ::std::collections::BTreeMap;
+
+// TCP Out-of-Order Reassembly Queue.
+//
+// This holds data that we've received (because it was within our receive window) but can't yet present to the user
+// because we're missing some other data that comes between this and what we've already presented to the user.
+//
+// Sequence numbers wrap around, so they can't be used as keys of an ordered map directly.  Instead, we "unwrap" them
+// into a 64-bit sequence space that never wraps (in practice), relative to the last RCV.NXT we were told about.  This
+// works because all of the data we hold lies within the receive window, which is much smaller than 2^31 bytes.  The
+// unwrapped value of a sequence number is congruent to it modulo 2^32, so wrapping back is a plain truncation.
+//
+// Storing a segment costs O(log n) plus the number of stored segments that it fully covers, and draining the segment
+// at the head when the hole before it fills costs O(log n).  As a by-product, we keep track of the maximal runs of
+// contiguous data that we hold, which are the blocks that we report in SACK options (RFC 2018).
+//
+// The number of segments that we hold is reflected in the out-of-order gauge of the thread statistics.
+
+#[derive(Debug)]
+pub struct ReassemblyQueue {
+    // Out-of-order segments, keyed by their unwrapped starting sequence number.  Stored segments never overlap.
+    segments: BTreeMap<u64, DemiBuffer>,
+
+    // Maximal runs of contiguous stored segments, keyed by their unwrapped starting sequence number, and mapping to
+    // their unwrapped ending sequence number (exclusive).
+    blocks: BTreeMap<u64, u64>,
+
+    // Unwrapped starting sequence number of the segment that was stored last, if we still hold it.  The block that
+    // contains it goes first in SACK options (RFC 2018, Section 4).
+    last_stored: Option<u64>,
+
+    // The last RCV.NXT that we were told about, and its unwrapped value.
+    anchor_seq: SeqNumber,
+    anchor: u64,
+
+    // Maximum number of segments that we hold.  Segments at the end of the sequence space are dropped first.
+    max_segments: usize,
+}
+
+impl ReassemblyQueue {
+    /// Creates an empty reassembly queue for a connection whose next expected sequence number is `recv_next`.
+    pub fn new(recv_next: SeqNumber, max_segments: usize) -> Self {
+        Self {
+            segments: BTreeMap::new(),
+            blocks: BTreeMap::new(),
+            last_stored: None,
+            anchor_seq: recv_next,
+            anchor: u32::from(recv_next) as u64,
+            max_segments,
+        }
+    }
+
+    /// Returns the number of segments that we hold.
+    #[cfg(test)]
+    pub fn len(&self) -> usize {
+        self.segments.len()
+    }
+
+    /// Stores a segment that starts at `start`, which lies after `recv_next` (i.e. RCV.NXT).  Data that we already hold
+    /// is trimmed off the new segment, and stored segments that the new one covers are replaced by it.
+    pub fn insert(&mut self, recv_next: SeqNumber, start: SeqNumber, buf: DemiBuffer) {
+        let num_segments: usize = self.segments.len();
+        self.store(recv_next, start, buf);
+        self.update_gauge(num_segments);
+    }
+
+    /// Removes and returns the data at the head of the queue, if it starts at `recv_next` (i.e. the hole before it was
+    /// filled).  Data before `recv_next` that the stored segments still hold is discarded.
+    pub fn pop(&mut self, recv_next: SeqNumber) -> Option<DemiBuffer> {
+        let num_segments: usize = self.segments.len();
+        let buf: Option<DemiBuffer> = self.take(recv_next);
+        self.update_gauge(num_segments);
+        buf
+    }
+
+    // Does the work of `insert()`.
+    fn store(&mut self, recv_next: SeqNumber, start: SeqNumber, mut buf: DemiBuffer) {
+        debug_assert!(recv_next < start);
+        self.advance(recv_next);
+        let mut start: u64 = self.unwrap(start);
+        let mut end: u64 = start + buf.total_len() as u64;
+
+        // The new segment may overlap with the end of the segment before it.
+        if let Some((&prev_start, prev_buf)) = self.segments.range(..=start).next_back() {
+            let prev_end: u64 = prev_start + prev_buf.total_len() as u64;
+            if end <= prev_end {
+                // The new segment's data is a complete duplicate.  Just drop the new segment.
+                return;
+            }
+            if start < prev_end {
+                buf.advance((prev_end - start) as usize)
+                    .expect("'buf' should contain at least the duplicate bytes");
+                start = prev_end;
+            }
+        }
+
+        // The new segment may completely encompass the segments after it, and overlap with the start of the first one
+        // that it doesn't encompass.
+        while let Some((&next_start, next_buf)) = self.segments.range(start..).next() {
+            if end <= next_start {
+                break;
+            }
+            let next_end: u64 = next_start + next_buf.total_len() as u64;
+            if next_end <= end {
+                self.segments.remove(&next_start);
+                continue;
+            }
+            buf.truncate((next_start - start) as usize)
+                .expect("'buf' should contain at least the duplicate bytes");
+            end = next_start;
+            break;
+        }
+        if start == end {
+            return;
+        }
+
+        self.segments.insert(start, buf);
+        self.add_block(start, end);
+        self.last_stored = Some(start);
+
+        // If we now hold too many segments, drop the later ones.
+        while self.segments.len() > self.max_segments {
+            if let Some((dropped_start, _)) = self.segments.pop_last() {
+                self.drop_block_tail(dropped_start);
+                if self.last_stored == Some(dropped_start) {
+                    self.last_stored = None;
+                }
+            }
+        }
+    }
+
+    // Does the work of `pop()`.
+    fn take(&mut self, recv_next: SeqNumber) -> Option<DemiBuffer> {
+        self.advance(recv_next);
+        loop {
+            let (start, len): (u64, u64) = match self.segments.first_key_value() {
+                Some((&start, buf)) if start <= self.anchor => (start, buf.total_len() as u64),
+                _ => return None,
+            };
+            let (_, mut buf): (u64, DemiBuffer) = self.segments.pop_first().expect("queue should not be empty");
+            let end: u64 = start + len;
+            self.release_blocks(end);
+            if self.last_stored == Some(start) {
+                self.last_stored = None;
+            }
+            if end <= self.anchor {
+                // We already received all of this segment's data through some other segment.
+                continue;
+            }
+            buf.advance((self.anchor - start) as usize)
+                .expect("'buf' should contain at least the received bytes");
+            return Some(buf);
+        }
+    }
+
+    /// Fills `sacks` with the blocks of data that we hold, starting with the one that contains the segment we stored
+    /// last, followed by the others in sequence order.  Returns the number of blocks that were filled in.
+    pub fn sack_blocks(&self, sacks: &mut [SelectiveAcknowlegement]) -> usize {
+        let first: Option<(u64, u64)> = self.last_stored.and_then(|start| {
+            self.blocks
+                .range(..=start)
+                .next_back()
+                .map(|(&block_start, &block_end)| (block_start, block_end))
+        });
+        let others = self
+            .blocks
+            .iter()
+            .map(|(&block_start, &block_end)| (block_start, block_end))
+            .filter(|block| Some(*block) != first);
+
+        let mut num_sacks: usize = 0;
+        for ((block_start, block_end), sack) in first.into_iter().chain(others).zip(sacks.iter_mut()) {
+            *sack = SelectiveAcknowlegement {
+                begin: Self::wrap(block_start),
+                end: Self::wrap(block_end),
+            };
+            num_sacks += 1;
+        }
+        num_sacks
+    }
+
+    // Moves the anchor forward to RCV.NXT, which never moves backwards.
+    fn advance(&mut self, recv_next: SeqNumber) {
+        debug_assert!(self.anchor_seq <= recv_next);
+        self.anchor += u32::from(recv_next - self.anchor_seq) as u64;
+        self.anchor_seq = recv_next;
+    }
+
+    // Unwraps a sequence number at or after the anchor.
+    fn unwrap(&self, seq: SeqNumber) -> u64 {
+        self.anchor + u32::from(seq - self.anchor_seq) as u64
+    }
+
+    // Wraps an unwrapped sequence number back.
+    fn wrap(seq: u64) -> SeqNumber {
+        SeqNumber::from(seq as u32)
+    }
+
+    // Accounts for newly stored data in [start, end), merging it with the blocks that it touches.
+    fn add_block(&mut self, mut start: u64, mut end: u64) {
+        if let Some((&block_start, &block_end)) = self.blocks.range(..=start).next_back() {
+            if start <= block_end {
+                self.blocks.remove(&block_start);
+                start = block_start;
+                end = end.max(block_end);
+            }
+        }
+        while let Some((&block_start, &block_end)) = self.blocks.range(start..).next() {
+            if end < block_start {
+                break;
+            }
+            self.blocks.remove(&block_start);
+            end = end.max(block_end);
+        }
+        self.blocks.insert(start, end);
+    }
+
+    // Accounts for the removal of all stored data before `until`.
+    fn release_blocks(&mut self, until: u64) {
+        while let Some(entry) = self.blocks.first_entry() {
+            let block_start: u64 = *entry.key();
+            let block_end: u64 = *entry.get();
+            if block_end <= until {
+                entry.remove();
+                continue;
+            }
+            if block_start < until {
+                entry.remove();
+                self.blocks.insert(until, block_end);
+            }
+            break;
+        }
+    }
+
+    // Accounts for the removal of the last stored segment, which started at `start`.
+    fn drop_block_tail(&mut self, start: u64) {
+        if let Some(mut entry) = self.blocks.last_entry() {
+            if *entry.key() >= start {
+                entry.remove();
+            } else {
+                *entry.get_mut() = start;
+            }
+        }
+    }
+
+    // Moves the out-of-order gauge by the change in the number of segments that we hold, which was `num_segments`.
+    fn update_gauge(&self, num_segments: usize) {
+        let now: usize = self.segments.len();
+        if now != num_segments {
+            with_stats(|s: &ThreadStats| {
+                if now > num_segments {
+                    s.tcp_out_of_order_segments.add((now - num_segments) as u64);
+                } else {
+                    s.tcp_out_of_order_segments.sub((num_segments - now) as u64);
+                }
+            });
+        }
+    }
+}
+
+impl Drop for ReassemblyQueue {
+    fn drop(&mut self) {
+        // The segments of a connection that goes away no longer count as held.
+        with_stats(|s: &ThreadStats| s.tcp_out_of_order_segments.sub(self.segments.len() as u64));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::ReassemblyQueue;
+    use crate::{
+        inetstack::protocols::tcp::{
+            segment::SelectiveAcknowlegement,
+            SeqNumber,
+        },
+        runtime::memory::DemiBuffer,
+    };
+    use ::anyhow::Result;
+
+    // Builds a segment whose bytes are the low bits of their sequence numbers.
+    fn segment(start: u32, len: usize) -> DemiBuffer {
+        let data: Vec<u8> = (0..len as u32).map(|i| start.wrapping_add(i) as u8).collect();
+        DemiBuffer::from_slice(&data).expect("buffer should be small enough")
+    }
+
+    // Drains the queue from `recv_next` and checks that the data comes out in sequence.
+    fn drain(queue: &mut ReassemblyQueue, mut recv_next: u32) -> Result<u32> {
+        while let Some(buf) = queue.pop(SeqNumber::from(recv_next)) {
+            for byte in &buf[..] {
+                crate::ensure_eq!(*byte, recv_next as u8);
+                recv_next = recv_next.wrapping_add(1);
+            }
+        }
+        Ok(recv_next)
+    }
+
+    // Returns the SACK blocks of the queue.
+    fn sacks(queue: &ReassemblyQueue) -> Vec<(u32, u32)> {
+        let mut sacks: [SelectiveAcknowlegement; 4] = [SelectiveAcknowlegement {
+            begin: SeqNumber::from(0),
+            end: SeqNumber::from(0),
+        }; 4];
+        let num_sacks: usize = queue.sack_blocks(&mut sacks);
+        sacks[..num_sacks]
+            .iter()
+            .map(|sack| (u32::from(sack.begin), u32::from(sack.end)))
+            .collect()
+    }
+
+    /// Tests that overlapping and duplicate segments are trimmed and merged.
+    #[test]
+    fn test_overlap() -> Result<()> {
+        let recv_next: SeqNumber = SeqNumber::from(100);
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(recv_next, 16);
+
+        queue.insert(recv_next, SeqNumber::from(120), segment(120, 10));
+        queue.insert(recv_next, SeqNumber::from(140), segment(140, 10));
+        // Overlaps the end of the first and the start of the second segment.
+        queue.insert(recv_next, SeqNumber::from(125), segment(125, 20));
+        // Complete duplicate.
+        queue.insert(recv_next, SeqNumber::from(130), segment(130, 5));
+        crate::ensure_eq!(queue.len(), 3);
+        crate::ensure_eq!(sacks(&queue), vec![(120, 150)]);
+
+        // Encompasses all stored segments.
+        queue.insert(recv_next, SeqNumber::from(110), segment(110, 50));
+        crate::ensure_eq!(queue.len(), 1);
+        crate::ensure_eq!(sacks(&queue), vec![(110, 160)]);
+
+        // Nothing comes out until the hole fills.
+        crate::ensure_eq!(queue.pop(recv_next).is_none(), true);
+        crate::ensure_eq!(drain(&mut queue, 110)?, 160);
+        crate::ensure_eq!(sacks(&queue), vec![]);
+
+        Ok(())
+    }
+
+    /// Tests that in-order data that overlaps stored segments does not leave them stuck in the queue.
+    #[test]
+    fn test_partially_received() -> Result<()> {
+        let recv_next: SeqNumber = SeqNumber::from(0);
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(recv_next, 16);
+
+        queue.insert(recv_next, SeqNumber::from(10), segment(10, 10));
+        queue.insert(recv_next, SeqNumber::from(30), segment(30, 10));
+
+        // An in-order segment covered [0, 15) and the last one covered [15, 35).
+        crate::ensure_eq!(drain(&mut queue, 35)?, 40);
+        crate::ensure_eq!(queue.len(), 0);
+
+        Ok(())
+    }
+
+    /// Tests reassembly across the wrap-around of the sequence space.
+    #[test]
+    fn test_wrap_around() -> Result<()> {
+        let start: u32 = u32::MAX - 1000;
+        let recv_next: SeqNumber = SeqNumber::from(start);
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(recv_next, 64);
+
+        // Store every other segment, in reverse.
+        for i in (1..20u32).step_by(2).rev() {
+            let seq: u32 = start.wrapping_add(i * 100);
+            queue.insert(recv_next, SeqNumber::from(seq), segment(seq, 100));
+        }
+        crate::ensure_eq!(sacks(&queue).len(), 4);
+        crate::ensure_eq!(sacks(&queue)[0], (start.wrapping_add(100), start.wrapping_add(200)));
+
+        // Fill in the holes, in order.
+        let mut recv_next: u32 = start;
+        for i in (0..20u32).step_by(2) {
+            crate::ensure_eq!(recv_next, start.wrapping_add(i * 100));
+            recv_next = recv_next.wrapping_add(100);
+            recv_next = drain(&mut queue, recv_next)?;
+        }
+        crate::ensure_eq!(recv_next, start.wrapping_add(2000));
+        crate::ensure_eq!(queue.len(), 0);
+
+        Ok(())
+    }
+
+    /// Tests that the segments at the end of the sequence space are dropped first, when we hold too many.
+    #[test]
+    fn test_limit() -> Result<()> {
+        let recv_next: SeqNumber = SeqNumber::from(0);
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(recv_next, 2);
+
+        queue.insert(recv_next, SeqNumber::from(30), segment(30, 10));
+        queue.insert(recv_next, SeqNumber::from(20), segment(20, 5));
+        queue.insert(recv_next, SeqNumber::from(10), segment(10, 10));
+        crate::ensure_eq!(queue.len(), 2);
+        crate::ensure_eq!(sacks(&queue), vec![(10, 25)]);
+
+        Ok(())
+    }
+}
@@ -3,15 +3,26 @@
 
 use crate::{
     collections::async_value::SharedAsyncValue,
-    inetstack::protocols::tcp::{
-        established::SharedControlBlock,
-        segment::TcpHeader,
-        SeqNumber,
+    inetstack::protocols::{
+        ipv4::IPV4_HEADER_MAX_SIZE,
+        tcp::{
+            established::SharedControlBlock,
+            segment::{
+                SelectiveAcknowlegement,
+                TcpHeader,
+                MAX_TCP_HEADER_SIZE,
+            },
+            SeqNumber,
+        },
     },
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
         network::NetworkRuntime,
+        stats::{
+            with_stats,
+            ThreadStats,
+        },
     },
 };
 use ::libc::{
@@ -23,6 +34,7 @@ use ::std::{
         Cell,
         RefCell,
     },
+    cmp,
     collections::VecDeque,
     convert::TryInto,
     fmt,
@@ -38,8 +50,26 @@ use ::std::{
 //
 pub struct UnackedSegment {
     pub bytes: DemiBuffer,
+    // One's complement sum of `bytes`, so that retransmissions don't checksum the data again. Set to `None` under
+    // checksum offload, and whenever `bytes` is trimmed.
+    pub bytes_sum: Option<u16>,
     // Set to `None` on retransmission to implement Karn's algorithm.
     pub initial_tx: Option<Instant>,
+    // Scoreboard (RFC 2018): Set once our peer selectively acknowledges all of `bytes`.
+    pub sacked: bool,
+    // Scoreboard: Set once this segment is retransmitted, and cleared on a retransmission timeout.
+    pub retransmitted: bool,
+}
+
+impl UnackedSegment {
+    // Amount of sequence space taken by this segment.  An empty buffer is the end-of-send marker, which stands for our
+    // FIN.
+    fn sequence_length(&self) -> u32 {
+        match self.bytes.total_len() {
+            0 => 1,
+            len => len as u32,
+        }
+    }
 }
 
 /// Hard limit for unsent queue.
@@ -47,6 +77,25 @@ pub struct UnackedSegment {
 /// not segments) and rejecting send requests that exceed that, or by limiting the user's send buffer allocations.
 const UNSENT_QUEUE_CUTOFF: usize = 1024;
 
+/// Largest amount of data that we hand to the network runtime in a single segment under TCP segmentation offload.  The
+/// IPv4 datagram that carries it must not exceed 64 KiB, even with headers of maximum size.
+const MAX_OFFLOAD_SEND_SIZE: usize = u16::MAX as usize - IPV4_HEADER_MAX_SIZE as usize - MAX_TCP_HEADER_SIZE;
+
+/// RFC 6675 DupThresh: A segment is deemed lost once this many later segments, or more than this many minus one
+/// segments' worth of later data, are selectively acknowledged.
+const DUP_THRESH: u32 = 3;
+
+/// What an incoming ACK means for SACK-based loss recovery.
+#[derive(Debug, PartialEq, Eq)]
+enum LossRecovery {
+    /// No data is deemed lost.
+    Idle,
+    /// The earliest unacknowledged segment was just deemed lost.
+    Started,
+    /// Data that was in flight when recovery started is still unacknowledged.
+    Ongoing,
+}
+
 // TODO: Consider moving retransmit timer and congestion control fields out of this structure.
 // TODO: Make all public fields in this structure private.
 pub struct Sender {
@@ -89,6 +138,14 @@ pub struct Sender {
     // Maximum Segment Size currently in use for this connection.
     // TODO: Revisit this once we support path MTU discovery.
     mss: usize,
+
+    // Largest amount of data that we send in a single segment.  This is the MSS, unless the network runtime offloads
+    // segmentation, in which case it is the largest multiple of the MSS that both the network device and an IPv4 datagram
+    // can take.
+    max_send_size: usize,
+
+    // RFC 6675 RecoveryPoint: SND.NXT when SACK-based loss recovery started, or `None` outside of loss recovery.
+    recovery_point: Cell<Option<SeqNumber>>,
 }
 
 impl fmt::Debug for Sender {
@@ -100,12 +157,24 @@ impl fmt::Debug for Sender {
             .field("send_window", &self.send_window)
             .field("window_scale", &self.window_scale)
             .field("mss", &self.mss)
+            .field("max_send_size", &self.max_send_size)
+            .field("recovery_point", &self.recovery_point)
             .finish()
     }
 }
 
 impl Sender {
-    pub fn new(seq_no: SeqNumber, send_window: u32, window_scale: u8, mss: usize) -> Self {
+    pub fn new(
+        seq_no: SeqNumber,
+        send_window: u32,
+        window_scale: u8,
+        mss: usize,
+        segmentation_offload: Option<usize>,
+    ) -> Self {
+        let max_send_size: usize = match segmentation_offload {
+            Some(limit) => cmp::max(mss, (cmp::min(limit, MAX_OFFLOAD_SEND_SIZE) / mss) * mss),
+            None => mss,
+        };
         Self {
             send_unacked: SharedAsyncValue::new(seq_no),
             unacked_queue: RefCell::new(VecDeque::new()),
@@ -119,6 +188,8 @@ impl Sender {
 
             window_scale,
             mss,
+            max_send_size,
+            recovery_point: Cell::new(None),
         }
     }
 
@@ -126,6 +197,10 @@ impl Sender {
         self.mss
     }
 
+    pub fn get_max_send_size(&self) -> usize {
+        self.max_send_size
+    }
+
     pub fn get_send_window(&self) -> SharedAsyncValue<u32> {
         self.send_window.clone()
     }
@@ -163,7 +238,7 @@ impl Sender {
         // Review: Move this check up the stack (i.e. closer to the user)?
         //
         let mut buf_len: u32 = buf
-            .len()
+            .total_len()
             .try_into()
             .map_err(|_| Fail::new(EINVAL, "buffer too large"))?;
 
@@ -183,8 +258,9 @@ impl Sender {
         // it on the unsent queue and that's it.
         //
 
-        // Check for unsent data.
-        if self.unsent_queue.borrow().is_empty() {
+        // Check for unsent data.  Buffers that don't fit in a single segment are cut into segments by the background
+        // sender.
+        if self.unsent_queue.borrow().is_empty() && buf.total_len() <= self.max_send_size {
             // No unsent data queued up, so we can try to send this new buffer immediately.
 
             // Calculate amount of data in flight (SND.NXT - SND.UNA).
@@ -204,7 +280,12 @@ impl Sender {
 
             let win_sz: u32 = self.send_window.get();
 
-            if win_sz > 0 && win_sz >= in_flight_after_send && effective_cwnd >= in_flight_after_send {
+            // Paced connections hand the buffer over to the background sender if it is not time to send yet.
+            let paced: bool = cb
+                .congestion_control_get_pacing_deadline()
+                .map_or(false, |pacing_deadline| pacing_deadline > cb.get_now());
+
+            if win_sz > 0 && win_sz >= in_flight_after_send && effective_cwnd >= in_flight_after_send && !paced {
                 if let Some(remote_link_addr) = cb.arp().try_query(cb.get_remote().ip().clone()) {
                     // This hook is primarily intended to record the last time we sent data, so we can later tell if
                     // the connection has been idle.
@@ -223,18 +304,25 @@ impl Sender {
                         header.psh = true;
                     }
                     trace!("Send immediate");
-                    cb.emit(header, Some(buf.clone()), remote_link_addr);
+                    let buf_sum: Option<u16> = cb.checksum_data(&buf);
+                    cb.emit(header, Some(buf.clone()), buf_sum, remote_link_addr);
 
                     // Update SND.NXT.
                     self.send_next.modify(|s| s + SeqNumber::from(buf_len));
 
+                    // Nothing else is queued, so the application limits the connection.
+                    cb.congestion_control_on_segment_sent(send_next, buf_len, sent_data + buf_len, true);
+
                     // TODO: We don't need to track this.
                     self.unsent_seq_no.modify(|s| s + SeqNumber::from(buf_len));
 
                     // Put the segment we just sent on the retransmission queue.
                     let unacked_segment = UnackedSegment {
                         bytes: buf,
+                        bytes_sum: buf_sum,
                         initial_tx: Some(cb.get_now()),
+                        sacked: false,
+                        retransmitted: false,
                     };
                     self.unacked_queue.borrow_mut().push_back(unacked_segment);
 
@@ -265,36 +353,209 @@ impl Sender {
         Ok(())
     }
 
-    /// Retransmits the earliest segment that has not (yet) been acknowledged by our peer.
+    /// Retransmits the earliest segment that has not (yet) been acknowledged by our peer, unless it was already
+    /// retransmitted during the current loss recovery.  If our peer selectively acknowledged later data, this also
+    /// retransmits the segments that the scoreboard deems lost, as far as the congestion window allows.
     pub fn retransmit<N: NetworkRuntime>(&self, mut cb: SharedControlBlock<N>) {
-        // Check that we have an unacknowledged segment.
-        if let Some(segment) = self.unacked_queue.borrow_mut().front_mut() {
-            // We're retransmitting this, so we can no longer use an ACK for it as an RTT measurement (as we can't tell
-            // if the ACK is for the original or the retransmission).  Remove the transmission timestamp from the entry.
-            segment.initial_tx.take();
-
-            // Clone the segment data for retransmission.
-            let data: DemiBuffer = segment.bytes.clone();
-
-            // TODO: Issue #198 Repacketization - we should send a full MSS (and set the FIN flag if applicable).
-
-            // Prepare and send the segment.
-            if let Some(first_hop_link_addr) = cb.arp().try_query(cb.get_remote().ip().clone()) {
-                let mut header: TcpHeader = cb.tcp_header();
-                header.seq_num = self.send_unacked.get();
-                if data.len() == 0 {
-                    // This buffer is the end-of-send marker.  Retransmit the FIN.
-                    header.fin = true;
-                } else {
-                    header.psh = true;
-                }
-                cb.emit(header, Some(data), first_hop_link_addr);
+        {
+            let mut unacked_queue = self.unacked_queue.borrow_mut();
+
+            // Check that we have an unacknowledged segment.
+            let segment: &mut UnackedSegment = match unacked_queue.front_mut() {
+                Some(segment) => segment,
+                None => {
+                    // We shouldn't enter the retransmit routine with an empty unacknowledged queue.  So maybe we should
+                    // assert here?  But this is relatively benign if it happens, and could be the result of a
+                    // race-condition or a mismanaged retransmission timer, so asserting would be over-reacting.
+                    warn!("Retransmission with empty unacknowledged queue?");
+                    return;
+                },
+            };
+            if !(segment.retransmitted && self.recovery_point.get().is_some()) {
+                Self::retransmit_segment(&mut cb, self.send_unacked.get(), segment);
             }
-        } else {
-            // We shouldn't enter the retransmit routine with an empty unacknowledged queue.  So maybe we should assert
-            // here?  But this is relatively benign if it happens, and could be the result of a race-condition or a
-            // mismanaged retransmission timer, so asserting would be over-reacting.
-            warn!("Retransmission with empty unacknowledged queue?");
+        }
+        self.retransmit_lost(cb);
+    }
+
+    /// Runs SACK-based loss recovery (RFC 6675) for an incoming ACK, once its SACK blocks are on the scoreboard.
+    /// Recovery starts as soon as the earliest unacknowledged segment is deemed lost, rather than on a retransmission
+    /// timeout or on duplicate ACKs that the congestion control algorithm might not count.
+    pub fn recover_losses<N: NetworkRuntime>(&self, cb: SharedControlBlock<N>) {
+        match self.update_loss_recovery() {
+            LossRecovery::Idle => (),
+            LossRecovery::Started => self.retransmit(cb),
+            LossRecovery::Ongoing => self.retransmit_lost(cb),
+        }
+    }
+
+    // Starts or ends loss recovery, depending on the scoreboard and on the data acknowledged so far.
+    fn update_loss_recovery(&self) -> LossRecovery {
+        if let Some(recovery_point) = self.recovery_point.get() {
+            if self.send_unacked.get() < recovery_point {
+                return LossRecovery::Ongoing;
+            }
+            self.recovery_point.set(None);
+        }
+
+        let unacked_queue = self.unacked_queue.borrow();
+        let (sacked_segments, sacked_bytes): (u32, u32) = Self::count_sacked(&unacked_queue);
+        match unacked_queue.front() {
+            Some(first) if !first.sacked && self.is_lost(sacked_segments, sacked_bytes) => {
+                self.recovery_point.set(Some(self.send_next.get()));
+                LossRecovery::Started
+            },
+            _ => LossRecovery::Idle,
+        }
+    }
+
+    // Retransmits the segments that the scoreboard deems lost and that were not retransmitted yet, in order, as long as
+    // the data in flight stays within the congestion window.
+    fn retransmit_lost<N: NetworkRuntime>(&self, mut cb: SharedControlBlock<N>) {
+        let cwnd: u32 = cb.congestion_control_get_cwnd().get();
+        self.select_lost(cwnd, |seq_num, segment| {
+            Self::retransmit_segment(&mut cb, seq_num, segment)
+        });
+    }
+
+    // RFC 6675 NextSeg() and SetPipe(): Hands each segment that is deemed lost and was not retransmitted yet to `send`,
+    // for as long as the data in flight (the pipe) leaves room for it in the congestion window.
+    fn select_lost(&self, cwnd: u32, mut send: impl FnMut(SeqNumber, &mut UnackedSegment)) {
+        let mut unacked_queue = self.unacked_queue.borrow_mut();
+        let mut pipe: u32 = self.pipe(&unacked_queue);
+        let (mut sacked_segments, mut sacked_bytes): (u32, u32) = Self::count_sacked(&unacked_queue);
+
+        let mut seq_num: SeqNumber = self.send_unacked.get();
+        for segment in unacked_queue.iter_mut() {
+            // Only data before a selectively acknowledged segment may be deemed lost.
+            if sacked_segments == 0 {
+                break;
+            }
+            let segment_seq_num: SeqNumber = seq_num;
+            let len: u32 = segment.sequence_length();
+            seq_num = seq_num + SeqNumber::from(len);
+            if segment.sacked {
+                sacked_segments -= 1;
+                sacked_bytes -= len;
+                continue;
+            }
+            if segment.retransmitted || !self.is_lost(sacked_segments, sacked_bytes) {
+                continue;
+            }
+            if pipe.saturating_add(len) > cwnd {
+                break;
+            }
+            pipe += len;
+            send(segment_seq_num, segment);
+        }
+    }
+
+    // RFC 6675 SetPipe(): Counts the data that is still in the network.  This is the data that was neither selectively
+    // acknowledged nor deemed lost, plus the data that was retransmitted.
+    fn pipe(&self, unacked_queue: &VecDeque<UnackedSegment>) -> u32 {
+        let (mut sacked_segments, mut sacked_bytes): (u32, u32) = Self::count_sacked(unacked_queue);
+        let mut pipe: u32 = 0;
+        for segment in unacked_queue.iter() {
+            let len: u32 = segment.sequence_length();
+            if segment.sacked {
+                sacked_segments -= 1;
+                sacked_bytes -= len;
+                continue;
+            }
+            if !self.is_lost(sacked_segments, sacked_bytes) {
+                pipe += len;
+            }
+            if segment.retransmitted {
+                pipe += len;
+            }
+        }
+        pipe
+    }
+
+    // RFC 6675 IsLost(): Checks if a segment is deemed lost, given the number of segments and bytes after it that were
+    // selectively acknowledged.
+    fn is_lost(&self, sacked_segments_after: u32, sacked_bytes_after: u32) -> bool {
+        sacked_segments_after >= DUP_THRESH || sacked_bytes_after as usize > (DUP_THRESH as usize - 1) * self.mss
+    }
+
+    // Returns the number of selectively acknowledged segments, and the number of bytes that they hold.
+    fn count_sacked(unacked_queue: &VecDeque<UnackedSegment>) -> (u32, u32) {
+        unacked_queue
+            .iter()
+            .filter(|segment| segment.sacked)
+            .fold((0, 0), |(segments, bytes), segment| {
+                (segments + 1, bytes + segment.sequence_length())
+            })
+    }
+
+    // Retransmits a single segment that starts at `seq_num`.
+    fn retransmit_segment<N: NetworkRuntime>(
+        cb: &mut SharedControlBlock<N>,
+        seq_num: SeqNumber,
+        segment: &mut UnackedSegment,
+    ) {
+        segment.retransmitted = true;
+
+        // We're retransmitting this, so we can no longer use an ACK for it as an RTT measurement (as we can't tell if
+        // the ACK is for the original or the retransmission).  Remove the transmission timestamp from the entry.
+        segment.initial_tx.take();
+
+        // Clone the segment data for retransmission. Its sum is kept around so that we only checksum it once.
+        let data: DemiBuffer = segment.bytes.clone();
+        if segment.bytes_sum.is_none() {
+            segment.bytes_sum = cb.checksum_data(&data);
+        }
+        let data_sum: Option<u16> = segment.bytes_sum;
+
+        // TODO: Issue #198 Repacketization - we should send a full MSS (and set the FIN flag if applicable).
+
+        // Prepare and send the segment.
+        if let Some(first_hop_link_addr) = cb.arp().try_query(cb.get_remote().ip().clone()) {
+            let mut header: TcpHeader = cb.tcp_header();
+            header.seq_num = seq_num;
+            if data.total_len() == 0 {
+                // This buffer is the end-of-send marker.  Retransmit the FIN.
+                header.fin = true;
+            } else {
+                header.psh = true;
+            }
+            cb.emit(header, Some(data), data_sum, first_hop_link_addr);
+            with_stats(|s: &ThreadStats| s.tcp_retransmits.incr());
+        }
+    }
+
+    /// Marks the unacknowledged segments that are covered by the SACK blocks of an incoming ACK.  Blocks that don't
+    /// lie within the data that we have in flight are ignored.
+    pub fn process_sack_blocks(&self, sacks: &[SelectiveAcknowlegement]) {
+        let send_unacked: SeqNumber = self.send_unacked.get();
+        let send_next: SeqNumber = self.send_next.get();
+        let is_valid = |sack: &&SelectiveAcknowlegement| {
+            send_unacked <= sack.begin && sack.begin < sack.end && sack.end <= send_next
+        };
+
+        let mut seq_num: SeqNumber = send_unacked;
+        for segment in self.unacked_queue.borrow_mut().iter_mut() {
+            let segment_end: SeqNumber = seq_num + SeqNumber::from(segment.sequence_length());
+            if !segment.sacked {
+                segment.sacked = sacks
+                    .iter()
+                    .filter(is_valid)
+                    .any(|sack| sack.begin <= seq_num && segment_end <= sack.end);
+            }
+            seq_num = segment_end;
+        }
+    }
+
+    /// Allows all holes to be retransmitted again, because previous retransmissions might have been lost.  Selective
+    /// acknowledgements are kept: if our peer discards data that it selectively acknowledged, each retransmission
+    /// timeout still retransmits the earliest unacknowledged segment, so the connection makes progress regardless.
+    pub fn reset_retransmissions(&self) {
+        for segment in self.unacked_queue.borrow_mut().iter_mut() {
+            segment.retransmitted = false;
+        }
+        // RFC 6675 Section 5.1: A timeout during loss recovery extends it to everything sent so far.
+        if self.recovery_point.get().is_some() {
+            self.recovery_point.set(Some(self.send_next.get()));
         }
     }
 
@@ -317,26 +578,27 @@ impl Sender {
                     cb.rto_add_sample(now - initial_tx);
                 }
 
-                if segment.bytes.len() > bytes_remaining {
+                if segment.bytes.total_len() > bytes_remaining {
                     // Only some of the data in this segment has been acked.  Remove just the acked amount.
                     segment
                         .bytes
-                        .adjust(bytes_remaining)
+                        .advance(bytes_remaining)
                         .expect("'segment' should contain at least 'bytes_remaining'");
+                    segment.bytes_sum = None;
                     segment.initial_tx = None;
 
                     // Leave this segment on the unacknowledged queue.
                     break;
                 }
 
-                if segment.bytes.len() == 0 {
+                if segment.bytes.total_len() == 0 {
                     // This buffer is the end-of-send marker.  So we should only have one byte of acknowledged sequence
                     // space remaining (corresponding to our FIN).
                     debug_assert_eq!(bytes_remaining, 1);
                     bytes_remaining = 0;
                 }
 
-                bytes_remaining -= segment.bytes.len();
+                bytes_remaining -= segment.bytes.total_len();
             } else {
                 debug_assert!(false); // Shouldn't have bytes_remaining with no segments remaining in unacked_queue.
             }
@@ -352,13 +614,12 @@ impl Sender {
 
         let buf = queue.front_mut()?;
         let mut cloned_buf = buf.clone();
-        let buf_len: usize = buf.len();
 
         // Pop one byte off the buf still in the queue and all but one of the bytes on our clone.
-        buf.adjust(1).expect("'buf' should contain at least one byte");
+        buf.advance(1).expect("'buf' should contain at least one byte");
         cloned_buf
-            .trim(buf_len - 1)
-            .expect("'cloned_buf' should contain at least one less than its professed length");
+            .truncate(1)
+            .expect("'cloned_buf' should contain at least one byte");
 
         Some(cloned_buf)
     }
@@ -368,16 +629,16 @@ impl Sender {
         let mut unsent_queue = self.unsent_queue.borrow_mut();
         let mut buf: DemiBuffer = unsent_queue.pop_front()?;
         let mut do_push: bool = true;
-        let buf_len: usize = buf.len();
+        let buf_len: usize = buf.total_len();
 
         if buf_len > max_bytes {
             let mut cloned_buf: DemiBuffer = buf.clone();
 
-            buf.adjust(max_bytes)
+            buf.advance(max_bytes)
                 .expect("'buf' should contain at least 'max_bytes'");
             cloned_buf
-                .trim(buf_len - max_bytes)
-                .expect("'cloned_buf' should contain at least less than its length");
+                .truncate(max_bytes)
+                .expect("'cloned_buf' should contain at least 'max_bytes'");
 
             unsent_queue.push_front(buf);
             buf = cloned_buf;
@@ -390,7 +651,7 @@ impl Sender {
 
     pub fn top_size_unsent(&self) -> Option<usize> {
         let unsent_queue = self.unsent_queue.borrow_mut();
-        Some(unsent_queue.front()?.len())
+        Some(unsent_queue.front()?.total_len())
     }
 
     // Update our send window to the value advertised by our peer.
@@ -419,3 +680,210 @@ impl Sender {
         self.mss
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        LossRecovery,
+        Sender,
+        UnackedSegment,
+    };
+    use crate::{
+        inetstack::protocols::tcp::{
+            segment::SelectiveAcknowlegement,
+            SeqNumber,
+        },
+        runtime::memory::DemiBuffer,
+    };
+    use ::anyhow::Result;
+
+    // Builds a sender that has `segment_lengths` in flight, starting at sequence number `seq_no`.
+    fn cook_sender(seq_no: u32, segment_lengths: &[u16]) -> Sender {
+        let mut sender: Sender = Sender::new(SeqNumber::from(seq_no), 65535, 0, 1460, None);
+        for len in segment_lengths {
+            sender.push_unacked_segment(UnackedSegment {
+                bytes: DemiBuffer::new(*len),
+                bytes_sum: None,
+                initial_tx: None,
+                sacked: false,
+                retransmitted: false,
+            });
+            sender.modify_send_next(|s| s + SeqNumber::from(*len as u32));
+        }
+        sender
+    }
+
+    fn sack(begin: u32, end: u32) -> SelectiveAcknowlegement {
+        SelectiveAcknowlegement {
+            begin: SeqNumber::from(begin),
+            end: SeqNumber::from(end),
+        }
+    }
+
+    fn sacked(sender: &Sender) -> Vec<bool> {
+        sender
+            .unacked_queue
+            .borrow()
+            .iter()
+            .map(|segment| segment.sacked)
+            .collect()
+    }
+
+    /// Tests that only segments that are fully covered by a SACK block are marked.
+    #[test]
+    fn test_scoreboard() -> Result<()> {
+        let sender: Sender = cook_sender(1000, &[100, 100, 100, 100]);
+
+        // Covers the second segment and half of the third one.
+        sender.process_sack_blocks(&[sack(1100, 1250)]);
+        crate::ensure_eq!(sacked(&sender), vec![false, true, false, false]);
+
+        // Marks are kept across ACKs.
+        sender.process_sack_blocks(&[sack(1300, 1400)]);
+        crate::ensure_eq!(sacked(&sender), vec![false, true, false, true]);
+
+        Ok(())
+    }
+
+    /// Returns the sequence numbers of the segments that the sender would retransmit with a congestion window of
+    /// `cwnd`, and marks them as retransmitted.
+    fn retransmissions(sender: &Sender, cwnd: u32) -> Vec<u32> {
+        let mut seq_nums: Vec<u32> = Vec::new();
+        sender.select_lost(cwnd, |seq_num, segment| {
+            segment.retransmitted = true;
+            seq_nums.push(u32::from(seq_num));
+        });
+        seq_nums
+    }
+
+    /// Tests that loss recovery starts once the earliest segment is deemed lost, and ends once all data that was in
+    /// flight at that time is acknowledged.
+    #[test]
+    fn test_loss_recovery() -> Result<()> {
+        let sender: Sender = cook_sender(0, &[100, 100, 100, 100, 100]);
+
+        // Two later segments are not enough to deem the first one lost.
+        sender.process_sack_blocks(&[sack(100, 300)]);
+        crate::ensure_eq!(sender.update_loss_recovery(), LossRecovery::Idle);
+
+        sender.process_sack_blocks(&[sack(100, 400)]);
+        crate::ensure_eq!(sender.update_loss_recovery(), LossRecovery::Started);
+        crate::ensure_eq!(sender.update_loss_recovery(), LossRecovery::Ongoing);
+
+        sender.unacked_queue.borrow_mut().clear();
+        sender.send_unacked.set(SeqNumber::from(500));
+        crate::ensure_eq!(sender.update_loss_recovery(), LossRecovery::Idle);
+
+        Ok(())
+    }
+
+    /// Tests that only the segments deemed lost are retransmitted, and only as far as the congestion window allows.
+    #[test]
+    fn test_retransmissions_fit_in_cwnd() -> Result<()> {
+        let sender: Sender = cook_sender(0, &[100, 100, 100, 100, 100, 100, 100]);
+        sender.process_sack_blocks(&[sack(300, 600)]);
+
+        // The last segment may still be in flight, and the holes are deemed lost, so only one of them fits.
+        crate::ensure_eq!(retransmissions(&sender, 200), vec![0]);
+        // Retransmissions are in flight as well.
+        crate::ensure_eq!(retransmissions(&sender, 200), Vec::<u32>::new());
+        crate::ensure_eq!(retransmissions(&sender, 400), vec![100, 200]);
+        crate::ensure_eq!(retransmissions(&sender, u32::MAX), Vec::<u32>::new());
+
+        Ok(())
+    }
+
+    /// Tests that SACK blocks outside of the data in flight are ignored.
+    #[test]
+    fn test_scoreboard_invalid_blocks() -> Result<()> {
+        let sender: Sender = cook_sender(1000, &[100, 100]);
+
+        sender.process_sack_blocks(&[sack(900, 1200), sack(1100, 1300), sack(1150, 1100)]);
+        crate::ensure_eq!(sacked(&sender), vec![false, false]);
+
+        Ok(())
+    }
+
+    /// Tests that segments are limited to whole multiples of the MSS under segmentation offload.
+    #[test]
+    fn test_max_send_size() -> Result<()> {
+        let seq_no: SeqNumber = SeqNumber::from(0);
+        crate::ensure_eq!(Sender::new(seq_no, 65535, 0, 1460, None).get_max_send_size(), 1460);
+        crate::ensure_eq!(
+            Sender::new(seq_no, 65535, 0, 1460, Some(10000)).get_max_send_size(),
+            8760
+        );
+        crate::ensure_eq!(
+            Sender::new(seq_no, 65535, 0, 1460, Some(1000)).get_max_send_size(),
+            1460
+        );
+        // Limited by the size of an IPv4 datagram.
+        crate::ensure_eq!(
+            Sender::new(seq_no, 65535, 0, 1460, Some(1 << 20)).get_max_send_size(),
+            64240
+        );
+        Ok(())
+    }
+
+    /// Tests that buffer chains are cut into segments across their own segments, without being copied.
+    #[test]
+    fn test_pop_unsent_chain() -> Result<()> {
+        let sender: Sender = cook_sender(0, &[]);
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(b"header")?;
+        buf.append(DemiBuffer::from_slice(b"payload")?)?;
+        let payload: *const u8 = buf.segments().nth(1).map(|segment| segment.as_ptr()).unwrap();
+        sender.unsent_queue.borrow_mut().push_back(buf);
+
+        // The first segment spans both buffers of the chain, and still points into them.
+        let (segment, do_push): (DemiBuffer, bool) = sender.pop_unsent(8).unwrap();
+        crate::ensure_eq!(do_push, false);
+        crate::ensure_eq!(segment.num_segments(), 2);
+        crate::ensure_eq!(
+            segment.segments().collect::<Vec<&[u8]>>().concat(),
+            b"headerpa".to_vec()
+        );
+        crate::ensure_eq!(segment.segments().nth(1).map(|segment| segment.as_ptr()), Some(payload));
+        crate::ensure_eq!(sender.top_size_unsent(), Some(5));
+
+        let (segment, do_push): (DemiBuffer, bool) = sender.pop_unsent(8).unwrap();
+        crate::ensure_eq!(do_push, true);
+        crate::ensure_eq!(&segment[..], b"yload");
+        crate::ensure_eq!(sender.top_size_unsent(), None);
+
+        Ok(())
+    }
+
+    /// Tests that the segments handed out for transmission share their data with the buffer that they were cut from,
+    /// so a network runtime may not write headers in front of it.
+    #[test]
+    fn test_pop_unsent_shares_headroom() -> Result<()> {
+        let sender: Sender = cook_sender(0, &[]);
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(b"headerpayload")?;
+        buf.adjust(6)?;
+        crate::ensure_eq!(buf.private_headroom(), 6);
+        sender.unsent_queue.borrow_mut().push_back(buf);
+
+        // The rest of the buffer stays queued.
+        let (segment, _): (DemiBuffer, bool) = sender.pop_unsent(4).unwrap();
+        crate::ensure_eq!(segment.private_headroom(), 0);
+
+        // The last segment is queued for retransmission while it is in flight.
+        let (segment, _): (DemiBuffer, bool) = sender.pop_unsent(4).unwrap();
+        let retransmission: DemiBuffer = segment.clone();
+        crate::ensure_eq!(segment.private_headroom(), 0);
+        crate::ensure_eq!(retransmission.private_headroom(), 0);
+
+        Ok(())
+    }
+
+    /// Tests the scoreboard when sequence numbers wrap around.
+    #[test]
+    fn test_scoreboard_wrap_around() -> Result<()> {
+        let sender: Sender = cook_sender(u32::MAX - 149, &[100, 100, 100]);
+
+        sender.process_sack_blocks(&[sack(u32::MAX - 49, 150)]);
+        crate::ensure_eq!(sacked(&sender), vec![false, true, true]);
+
+        Ok(())
+    }
+}
@@ -10,28 +10,30 @@ use crate::{
         AsyncQueue,
         SharedAsyncQueue,
     },
-    inetstack::protocols::{
-        arp::SharedArpPeer,
-        ethernet2::{
-            EtherType2,
-            Ethernet2Header,
-        },
-        ip::IpProtocol,
-        ipv4::Ipv4Header,
-        tcp::{
-            constants::FALLBACK_MSS,
-            established::{
-                congestion_control,
-                congestion_control::CongestionControl,
-                EstablishedSocket,
+    inetstack::{
+        collections::FlowHashBuilder,
+        protocols::{
+            arp::SharedArpPeer,
+            ethernet2::{
+                EtherType2,
+                Ethernet2Header,
             },
-            isn_generator::IsnGenerator,
-            segment::{
-                TcpHeader,
-                TcpOptions2,
-                TcpSegment,
+            ip::IpProtocol,
+            ipv4::Ipv4Header,
+            tcp::{
+                constants::FALLBACK_MSS,
+                established::{
+                    congestion_control,
+                    EstablishedSocket,
+                },
+                isn_generator::IsnGenerator,
+                segment::{
+                    TcpHeader,
+                    TcpOptions2,
+                    TcpSegment,
+                },
+                SeqNumber,
             },
-            SeqNumber,
         },
     },
     runtime::{
@@ -73,7 +75,7 @@ use ::std::{
 //======================================================================================================================
 
 pub struct PassiveSocket<N: NetworkRuntime> {
-    connections: HashMap<SocketAddrV4, SharedAsyncQueue<(Ipv4Header, TcpHeader, DemiBuffer)>>,
+    connections: HashMap<SocketAddrV4, SharedAsyncQueue<(Ipv4Header, TcpHeader, DemiBuffer)>, FlowHashBuilder>,
     recv_queue: SharedAsyncQueue<(Ipv4Header, TcpHeader, DemiBuffer)>,
     ready: AsyncQueue<Result<EstablishedSocket<N>, Fail>>,
     max_backlog: usize,
@@ -109,21 +111,26 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
         dead_socket_tx: mpsc::UnboundedSender<QDesc>,
         nonce: u32,
     ) -> Result<Self, Fail> {
-        let mut me: Self = Self(SharedObject::<PassiveSocket<N>>::new(PassiveSocket {
-            connections: HashMap::<SocketAddrV4, SharedAsyncQueue<(Ipv4Header, TcpHeader, DemiBuffer)>>::new(),
-            recv_queue,
-            ready: AsyncQueue::<Result<EstablishedSocket<N>, Fail>>::default(),
-            max_backlog,
-            isn_generator: IsnGenerator::new(nonce),
-            local,
-            local_link_addr,
-            runtime: runtime.clone(),
-            transport,
-            tcp_config,
-            arp,
-            dead_socket_tx,
-            background_task_qt: None,
-        }));
+        let mut me: Self =
+            Self(SharedObject::<PassiveSocket<N>>::new(PassiveSocket {
+                connections: HashMap::<
+                    SocketAddrV4,
+                    SharedAsyncQueue<(Ipv4Header, TcpHeader, DemiBuffer)>,
+                    FlowHashBuilder,
+                >::with_hasher(FlowHashBuilder::new()),
+                recv_queue,
+                ready: AsyncQueue::<Result<EstablishedSocket<N>, Fail>>::default(),
+                max_backlog,
+                isn_generator: IsnGenerator::new(nonce),
+                local,
+                local_link_addr,
+                runtime: runtime.clone(),
+                transport,
+                tcp_config,
+                arp,
+                dead_socket_tx,
+                background_task_qt: None,
+            }));
         let qt: QToken =
             runtime.insert_background_coroutine("passive_listening::poll", Box::pin(me.clone().poll().fuse()))?;
         me.background_task_qt = Some(qt);
@@ -268,7 +275,9 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
                 ipv4_hdr: Ipv4Header::new(self.local.ip().clone(), remote.ip().clone(), IpProtocol::TCP),
                 tcp_hdr,
                 data: None,
+                data_sum: None,
                 tx_checksum_offload: self.tcp_config.get_rx_checksum_offload(),
+                segment_size: None,
             }
         };
 
@@ -289,6 +298,7 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
         // Set up new inflight accept connection.
         let mut remote_window_scale = None;
         let mut mss = FALLBACK_MSS;
+        let mut sack_permitted: bool = false;
         for option in tcp_hdr.iter_options() {
             match option {
                 TcpOptions2::WindowScale(w) => {
@@ -299,6 +309,10 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
                     info!("Received advertised MSS: {}", m);
                     mss = *m as usize;
                 },
+                TcpOptions2::SelectiveAcknowlegementPermitted => {
+                    info!("Received SACK permitted");
+                    sack_permitted = true;
+                },
                 _ => continue,
             }
         }
@@ -308,7 +322,7 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
 
         loop {
             // Send the SYN + ACK.
-            if let Err(e) = self.send_syn_ack(local_isn, remote_isn, remote).await {
+            if let Err(e) = self.send_syn_ack(local_isn, remote_isn, remote, sack_permitted).await {
                 self.ready.push(Err(e));
                 return;
             }
@@ -325,6 +339,7 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
                 tcp_hdr.window_size,
                 remote_window_scale,
                 mss,
+                sack_permitted,
             );
 
             // Either we get an ack or a timeout.
@@ -356,6 +371,7 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
         local_isn: SeqNumber,
         remote_isn: SeqNumber,
         remote: SocketAddrV4,
+        sack_permitted: bool,
     ) -> Result<(), Fail> {
         let remote_link_addr = self.arp.query(remote.ip().clone()).await?;
         let mut tcp_hdr = TcpHeader::new(self.local.port(), remote.port());
@@ -372,13 +388,20 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
         tcp_hdr.push_option(TcpOptions2::WindowScale(self.tcp_config.get_window_scale()));
         info!("Advertising window scale: {}", self.tcp_config.get_window_scale());
 
+        // RFC 2018: Only agree to selective acknowledgements if our peer offered them in its SYN.
+        if sack_permitted {
+            tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+        }
+
         debug!("Sending SYN+ACK: {:?}", tcp_hdr);
         let segment = TcpSegment {
             ethernet2_hdr: Ethernet2Header::new(remote_link_addr, self.local_link_addr, EtherType2::Ipv4),
             ipv4_hdr: Ipv4Header::new(self.local.ip().clone(), remote.ip().clone(), IpProtocol::TCP),
             tcp_hdr,
             data: None,
+            data_sum: None,
             tx_checksum_offload: self.tcp_config.get_rx_checksum_offload(),
+            segment_size: None,
         };
         self.transport.transmit(Box::new(segment));
         Ok(())
@@ -394,6 +417,7 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
         header_window_size: u16,
         remote_window_scale: Option<u8>,
         mss: usize,
+        sack_permitted: bool,
     ) -> Result<EstablishedSocket<N>, Fail> {
         let (ipv4_hdr, tcp_hdr, buf) = recv_queue.pop(None).await?;
         debug!("Received ACK: {:?}", tcp_hdr);
@@ -447,7 +471,8 @@ impl<N: NetworkRuntime> SharedPassiveSocket<N> {
             remote_window_size,
             remote_window_scale,
             mss,
-            congestion_control::None::new,
+            sack_permitted,
+            congestion_control::get_constructor(self.tcp_config.get_congestion_control()),
             None,
             self.dead_socket_tx.clone(),
         )?;
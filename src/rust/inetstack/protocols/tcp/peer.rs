@@ -6,14 +6,20 @@
 //======================================================================================================================
 
 use crate::{
-    inetstack::protocols::{
-        arp::SharedArpPeer,
-        ipv4::Ipv4Header,
-        tcp::{
-            isn_generator::IsnGenerator,
-            segment::TcpHeader,
-            socket::SharedTcpSocket,
-            SeqNumber,
+    inetstack::{
+        collections::{
+            FlowCache,
+            FlowHashBuilder,
+        },
+        protocols::{
+            arp::SharedArpPeer,
+            ipv4::Ipv4Header,
+            tcp::{
+                isn_generator::IsnGenerator,
+                segment::TcpHeader,
+                socket::SharedTcpSocket,
+                SeqNumber,
+            },
         },
     },
     runtime::{
@@ -25,6 +31,7 @@ use crate::{
             types::MacAddress,
             NetworkRuntime,
         },
+        types::DEMI_SGARRAY_MAXLEN,
         QDesc,
         SharedDemiRuntime,
         SharedObject,
@@ -64,7 +71,15 @@ pub struct TcpPeer<N: NetworkRuntime> {
     arp: SharedArpPeer<N>,
     rng: SmallRng,
     dead_socket_tx: mpsc::UnboundedSender<QDesc>,
-    addresses: HashMap<SocketId, SharedTcpSocket<N>>,
+    addresses: HashMap<SocketId, SharedTcpSocket<N>, FlowHashBuilder>,
+    /// Sockets that recently received segments. This must be cleared whenever `addresses` changes.
+    flow_cache: FlowCache<SharedTcpSocket<N>>,
+    /// Flow (local and remote addresses) of `coalesced_segment`.
+    coalesced_flow: Option<(SocketAddrV4, SocketAddrV4)>,
+    /// Back-to-back, in-order data segments of a single flow that arrived in the current receive batch, merged into
+    /// one segment whose data is a buffer chain. This is held back until the run ends, and is then dispatched to its
+    /// socket as a single segment, with a single lookup.
+    coalesced_segment: Option<(Ipv4Header, TcpHeader, DemiBuffer)>,
 }
 
 #[derive(Clone)]
@@ -97,7 +112,10 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
             arp,
             rng,
             dead_socket_tx: tx,
-            addresses: HashMap::<SocketId, SharedTcpSocket<N>>::new(),
+            addresses: HashMap::<SocketId, SharedTcpSocket<N>, FlowHashBuilder>::with_hasher(FlowHashBuilder::new()),
+            flow_cache: FlowCache::<SharedTcpSocket<N>>::new(),
+            coalesced_flow: None,
+            coalesced_segment: None,
         })))
     }
 
@@ -123,6 +141,7 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
         // Issue operation.
         socket.bind(local)?;
         self.addresses.insert(SocketId::Passive(local), socket.clone());
+        self.flow_cache.clear();
         Ok(())
     }
 
@@ -146,12 +165,13 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
         let local: SocketAddrV4 = match socket.local() {
             Some(addr) => addr,
             None => {
-                let local_port: u16 = self.runtime.alloc_ephemeral_port()?;
+                let local_port: u16 = self.alloc_ephemeral_port(remote)?;
                 SocketAddrV4::new(self.local_ipv4_addr, local_port)
             },
         };
         // Insert the connection to receive incoming packets for this address pair.
         // Should we remove the passive entry for the local address if the socket was previously bound?
+        self.flow_cache.clear();
         if self
             .addresses
             .insert(SocketId::Active(local, remote.clone()), socket.clone())
@@ -168,6 +188,7 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
         // Wait for connect to complete.
         if let Err(e) = socket.connect(local, remote, local_isn).await {
             self.addresses.remove(&SocketId::Active(local, remote.clone()));
+            self.flow_cache.clear();
             Err(e)
         } else {
             Ok(())
@@ -177,9 +198,30 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
     /// Pushes immediately to the socket and returns the result asynchronously.
     pub async fn push(&self, socket: &mut SharedTcpSocket<N>, buf: &mut DemiBuffer) -> Result<(), Fail> {
         // TODO: Remove this copy after merging with the transport trait.
-        // Wait for push to complete.
-        socket.push(buf.clone()).await?;
-        buf.trim(buf.len())
+        // The whole buffer chain is a single send, so its segments leave together in the body of each TCP segment.
+        socket.push(Self::drop_empty_segments(buf.clone())?).await?;
+        buf.advance(buf.total_len())
+    }
+
+    /// Removes the segments that carry no data from a buffer chain, as network devices may reject them. The chain must
+    /// hold some data.
+    fn drop_empty_segments(buf: DemiBuffer) -> Result<DemiBuffer, Fail> {
+        if buf.segments().all(|segment| !segment.is_empty()) {
+            return Ok(buf);
+        }
+
+        let mut head: Option<DemiBuffer> = None;
+        let mut pending: Option<DemiBuffer> = Some(buf);
+        while let Some(mut segment) = pending.take() {
+            pending = segment.take_tail();
+            if !segment.is_empty() {
+                match head.as_mut() {
+                    Some(head) => head.append(segment)?,
+                    None => head = Some(segment),
+                }
+            }
+        }
+        head.ok_or_else(|| Fail::new(libc::EINVAL, "zero-length buffer"))
     }
 
     /// Sets up a coroutine for popping data from the socket.
@@ -193,13 +235,38 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
         // This will bump the Rc refcount so the coroutine can have it's own reference to the shared queue data
         // structure and the SharedTcpQueue will not be freed until this coroutine finishes.
         let incoming: DemiBuffer = socket.pop(Some(size)).await?;
-        let len: usize = incoming.len();
+        let len: usize = incoming.total_len();
         // TODO: Remove this copy. Our API should support passing back a buffer without sending in a buffer.
         buf.trim(size - len)?;
-        buf.copy_from_slice(&incoming[0..len]);
+        incoming.copy_to_slice(&mut buf[..len]);
         Ok(None)
     }
 
+    /// Allocates an ephemeral port for a connection to `remote`. Ports for which the network runtime would not receive
+    /// the reply traffic (e.g. because the device steers it to another queue) are skipped.
+    fn alloc_ephemeral_port(&mut self, remote: SocketAddrV4) -> Result<u16, Fail> {
+        let mut skipped_ports: Vec<u16> = Vec::new();
+        let result: Result<u16, Fail> = loop {
+            match self.runtime.alloc_ephemeral_port() {
+                Ok(port)
+                    if self
+                        .transport
+                        .receives_flow(SocketAddrV4::new(self.local_ipv4_addr, port), remote) =>
+                {
+                    break Ok(port)
+                },
+                Ok(port) => skipped_ports.push(port),
+                Err(e) => break Err(e),
+            }
+        };
+        for port in skipped_ports {
+            if self.runtime.free_ephemeral_port(port).is_err() {
+                warn!("alloc_ephemeral_port(): leaking ephemeral port (port={})", port);
+            }
+        }
+        result
+    }
+
     /// Frees an ephemeral port (if any) allocated to a given socket.
     fn free_ephemeral_port(&mut self, socket_id: &SocketId) {
         let local: &SocketAddrV4 = match socket_id {
@@ -223,6 +290,7 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
         // Handle result: If unsuccessful, free the new queue descriptor.
         if let Some(socket_id) = socket.close().await? {
             self.addresses.remove(&socket_id);
+            self.flow_cache.clear();
             self.free_ephemeral_port(&socket_id);
         }
         Ok(())
@@ -231,6 +299,7 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
     pub fn hard_close(&mut self, socket: &mut SharedTcpSocket<N>) -> Result<(), Fail> {
         if let Some(socket_id) = socket.hard_close()? {
             self.addresses.remove(&socket_id);
+            self.flow_cache.clear();
             self.free_ephemeral_port(&socket_id);
         }
         Ok(())
@@ -257,22 +326,120 @@ impl<N: NetworkRuntime> SharedTcpPeer<N> {
             return;
         }
 
-        // Retrieve the queue descriptor based on the incoming segment.
-        let socket: &mut SharedTcpSocket<N> = match self.addresses.get_mut(&SocketId::Active(local, remote)) {
-            Some(socket) => socket,
-            None => match self.addresses.get_mut(&SocketId::Passive(local)) {
-                Some(socket) => socket,
-                None => {
-                    let cause: String = format!("no queue descriptor for remote address (remote={})", remote.ip());
-                    error!("receive(): {}", &cause);
-                    return;
-                },
-            },
+        // Hold back data segments that may be coalesced with the following ones of the same receive batch.
+        let (tcp_hdr, data): (TcpHeader, DemiBuffer) = match self.coalesce(local, remote, tcp_hdr, data) {
+            Some(segment) => segment,
+            None => return,
         };
+        self.flush_receive();
+        if is_coalescable(&tcp_hdr, data.total_len()) {
+            self.coalesced_flow = Some((local, remote));
+            self.coalesced_segment = Some((ip_hdr, tcp_hdr, data));
+            return;
+        }
 
         // Dispatch to further processing depending on the socket state.
-        socket.receive(ip_hdr, tcp_hdr, data)
+        if let Some(mut socket) = self.lookup_socket(local, remote) {
+            socket.receive(ip_hdr, tcp_hdr, data)
+        }
+    }
+
+    /// Merges a segment into the run that is held back for its flow, if it directly extends that run. Otherwise, the
+    /// segment is handed back.
+    fn coalesce(
+        &mut self,
+        local: SocketAddrV4,
+        remote: SocketAddrV4,
+        tcp_hdr: TcpHeader,
+        data: DemiBuffer,
+    ) -> Option<(TcpHeader, DemiBuffer)> {
+        if self.coalesced_flow != Some((local, remote)) {
+            return Some((tcp_hdr, data));
+        }
+        let (_, run_hdr, run_data): &mut (Ipv4Header, TcpHeader, DemiBuffer) = self
+            .coalesced_segment
+            .as_mut()
+            .expect("a coalesced flow should have a segment");
+        // The application pops the run as a single scatter-gather array, which bounds its number of segments.
+        if !can_coalesce(run_hdr, run_data.total_len(), &tcp_hdr, data.total_len())
+            || run_data.num_segments() + data.num_segments() > DEMI_SGARRAY_MAXLEN
+        {
+            return Some((tcp_hdr, data));
+        }
+        match run_data.try_append(data) {
+            Ok(()) => {
+                // Only the last segment of a run may carry PSH.
+                run_hdr.psh = tcp_hdr.psh;
+                None
+            },
+            Err((_, data)) => Some((tcp_hdr, data)),
+        }
+    }
+
+    /// Dispatches the segment that is held back for coalescing. This should be called at the end of every receive
+    /// batch.
+    pub fn flush_receive(&mut self) {
+        if let Some((local, remote)) = self.coalesced_flow.take() {
+            let (ip_hdr, tcp_hdr, data): (Ipv4Header, TcpHeader, DemiBuffer) = self
+                .coalesced_segment
+                .take()
+                .expect("a coalesced flow should have a segment");
+            if let Some(mut socket) = self.lookup_socket(local, remote) {
+                socket.receive(ip_hdr, tcp_hdr, data)
+            }
+        }
     }
+
+    /// Checks if segments are held back for coalescing.
+    #[cfg(test)]
+    pub fn has_held_segments(&self) -> bool {
+        self.coalesced_segment.is_some()
+    }
+
+    /// Retrieves the socket that an incoming segment is destined to.
+    fn lookup_socket(&mut self, local: SocketAddrV4, remote: SocketAddrV4) -> Option<SharedTcpSocket<N>> {
+        if let Some(socket) = self.flow_cache.get(&local, &remote) {
+            return Some(socket.clone());
+        }
+
+        // Retrieve the queue descriptor based on the incoming segment.
+        let socket: Option<SharedTcpSocket<N>> = self
+            .addresses
+            .get(&SocketId::Active(local, remote))
+            .or_else(|| self.addresses.get(&SocketId::Passive(local)))
+            .cloned();
+        match socket {
+            Some(socket) => {
+                self.flow_cache.insert(local, remote, socket.clone());
+                Some(socket)
+            },
+            None => {
+                let cause: String = format!("no queue descriptor for remote address (remote={})", remote.ip());
+                error!("receive(): {}", &cause);
+                None
+            },
+        }
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Checks if a segment may start a run of coalesced segments: it must carry data and no control flags other than ACK
+/// and PSH, nor options.
+fn is_coalescable(hdr: &TcpHeader, len: usize) -> bool {
+    len > 0 && hdr.ack && !(hdr.syn || hdr.fin || hdr.rst || hdr.urg || hdr.ece || hdr.cwr) && hdr.num_options == 0
+}
+
+/// Checks if a segment directly extends a run of coalesced segments, whose header is `run_hdr` and which holds
+/// `run_len` bytes. PSH ends a run.
+fn can_coalesce(run_hdr: &TcpHeader, run_len: usize, hdr: &TcpHeader, len: usize) -> bool {
+    !run_hdr.psh
+        && is_coalescable(hdr, len)
+        && hdr.seq_num == run_hdr.seq_num + SeqNumber::from(run_len as u32)
+        && hdr.ack_num == run_hdr.ack_num
+        && hdr.window_size == run_hdr.window_size
 }
 
 //======================================================================================================================
@@ -292,3 +459,52 @@ impl<N: NetworkRuntime> DerefMut for SharedTcpPeer<N> {
         self.0.deref_mut()
     }
 }
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ::anyhow::Result;
+
+    /// Builds a data segment header.
+    fn cook_header(seq_num: u32) -> TcpHeader {
+        let mut hdr: TcpHeader = TcpHeader::new(80, 8080);
+        hdr.seq_num = SeqNumber::from(seq_num);
+        hdr.ack_num = SeqNumber::from(1000);
+        hdr.ack = true;
+        hdr.window_size = 1024;
+        hdr
+    }
+
+    /// Tests that only in-order data segments with the same acknowledgement and window are coalesced.
+    #[test]
+    fn test_can_coalesce() -> Result<()> {
+        let last: TcpHeader = cook_header(u32::MAX - 99);
+        crate::ensure_eq!(can_coalesce(&last, 100, &cook_header(0), 100), true);
+        crate::ensure_eq!(can_coalesce(&last, 100, &cook_header(1), 100), false);
+        crate::ensure_eq!(can_coalesce(&last, 100, &cook_header(0), 0), false);
+
+        let mut hdr: TcpHeader = cook_header(0);
+        hdr.ack_num = SeqNumber::from(2000);
+        crate::ensure_eq!(can_coalesce(&last, 100, &hdr, 100), false);
+
+        let mut hdr: TcpHeader = cook_header(0);
+        hdr.window_size = 512;
+        crate::ensure_eq!(can_coalesce(&last, 100, &hdr, 100), false);
+
+        let mut hdr: TcpHeader = cook_header(0);
+        hdr.fin = true;
+        crate::ensure_eq!(can_coalesce(&last, 100, &hdr, 100), false);
+
+        // A PSH may end a run, but not be followed by more segments.
+        let mut hdr: TcpHeader = cook_header(0);
+        hdr.psh = true;
+        crate::ensure_eq!(can_coalesce(&last, 100, &hdr, 100), true);
+        crate::ensure_eq!(can_coalesce(&hdr, 100, &cook_header(100), 100), false);
+
+        Ok(())
+    }
+}
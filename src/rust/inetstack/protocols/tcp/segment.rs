@@ -3,6 +3,7 @@
 
 use crate::{
     inetstack::protocols::{
+        checksum,
         ethernet2::Ethernet2Header,
         ip::IpProtocol,
         ipv4::Ipv4Header,
@@ -11,7 +12,10 @@ use crate::{
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
-        network::PacketBuf,
+        network::{
+            PacketBuf,
+            SegmentationOffload,
+        },
     },
 };
 use ::libc::EBADMSG;
@@ -21,7 +25,6 @@ use ::std::{
         Cursor,
         Read,
     },
-    slice::ChunksExact,
 };
 
 pub const MIN_TCP_HEADER_SIZE: usize = 20;
@@ -33,7 +36,11 @@ pub struct TcpSegment {
     pub ipv4_hdr: Ipv4Header,
     pub tcp_hdr: TcpHeader,
     pub data: Option<DemiBuffer>,
+    /// One's complement sum of `data`, if it is already known.
+    pub data_sum: Option<u16>,
     pub tx_checksum_offload: bool,
+    /// Size of the segments that the network device should cut `data` into, under TCP segmentation offload.
+    pub segment_size: Option<u16>,
 }
 
 impl PacketBuf for TcpSegment {
@@ -43,7 +50,7 @@ impl PacketBuf for TcpSegment {
 
     fn body_size(&self) -> usize {
         match &self.data {
-            Some(buf) => buf.len(),
+            Some(buf) => buf.total_len(),
             None => 0,
         }
     }
@@ -63,14 +70,11 @@ impl PacketBuf for TcpSegment {
             .serialize(&mut buf[cur_pos..(cur_pos + ipv4_hdr_size)], ipv4_payload_len);
         cur_pos += ipv4_hdr_size;
 
-        let payload: &[u8] = match &self.data {
-            Some(buf) => &buf[..],
-            None => &[],
-        };
         self.tcp_hdr.serialize(
             &mut buf[cur_pos..(cur_pos + tcp_hdr_size)],
             &self.ipv4_hdr,
-            payload,
+            self.data.as_ref(),
+            self.data_sum,
             self.tx_checksum_offload,
         );
     }
@@ -81,6 +85,16 @@ impl PacketBuf for TcpSegment {
             None => None,
         }
     }
+
+    fn segmentation_offload(&self) -> Option<SegmentationOffload> {
+        let segment_size: u16 = self.segment_size?;
+        Some(SegmentationOffload {
+            l2_len: self.ethernet2_hdr.compute_size() as u16,
+            l3_len: self.ipv4_hdr.compute_size() as u16,
+            l4_len: self.tcp_hdr.compute_size() as u16,
+            segment_size,
+        })
+    }
 }
 
 #[derive(Debug, Clone, Copy, PartialEq)]
@@ -267,7 +281,7 @@ impl TcpHeader {
 
         if !rx_checksum_offload {
             let checksum: u16 = u16::from_be_bytes([hdr_buf[16], hdr_buf[17]]);
-            if checksum != tcp_checksum(ipv4_header, hdr_buf, data_buf) {
+            if checksum != tcp_checksum(ipv4_header, hdr_buf, data_buf.len(), checksum::sum(data_buf)) {
                 return Err(Fail::new(EBADMSG, "TCP checksum mismatch"));
             }
         }
@@ -391,7 +405,16 @@ impl TcpHeader {
         Ok((header, buf))
     }
 
-    pub fn serialize(&self, buf: &mut [u8], ipv4_hdr: &Ipv4Header, data: &[u8], tx_checksum_offload: bool) {
+    /// Serializes the target TCP header. The one's complement sum of `data` is computed here, unless `data_sum` already
+    /// carries it.
+    pub fn serialize(
+        &self,
+        buf: &mut [u8],
+        ipv4_hdr: &Ipv4Header,
+        data: Option<&DemiBuffer>,
+        data_sum: Option<u16>,
+        tx_checksum_offload: bool,
+    ) {
         let fixed_buf: &mut [u8; MIN_TCP_HEADER_SIZE] = (&mut buf[..MIN_TCP_HEADER_SIZE]).try_into().unwrap();
         fixed_buf[0..2].copy_from_slice(&self.src_port.to_be_bytes());
         fixed_buf[2..4].copy_from_slice(&self.dst_port.to_be_bytes());
@@ -450,7 +473,10 @@ impl TcpHeader {
 
         // Alright, we've fully filled out the header, time to compute the checksum.
         if !tx_checksum_offload {
-            let checksum: u16 = tcp_checksum(ipv4_hdr, &buf[..], data);
+            let data_sum: u16 =
+                data_sum.unwrap_or_else(|| data.map_or(0, |data| checksum::sum_pieces(data.segments())));
+            let data_len: usize = data.map_or(0, |data| data.total_len());
+            let checksum: u16 = tcp_checksum(ipv4_hdr, &buf[..], data_len, data_sum);
             buf[16..18].copy_from_slice(&checksum.to_be_bytes());
         } else {
             buf[16] = 0;
@@ -484,80 +510,22 @@ impl TcpHeader {
     }
 }
 
-fn tcp_checksum(ipv4_header: &Ipv4Header, header: &[u8], data: &[u8]) -> u16 {
-    let mut state: u32 = 0xffff;
-
-    // First, fold in a "pseudo-IP" header of...
-    // 1) Source address (4 bytes)
-    let src_octets: [u8; 4] = ipv4_header.get_src_addr().octets();
-    state += u16::from_be_bytes([src_octets[0], src_octets[1]]) as u32;
-    state += u16::from_be_bytes([src_octets[2], src_octets[3]]) as u32;
-
-    // 2) Destination address (4 bytes)
-    let dst_octets: [u8; 4] = ipv4_header.get_dest_addr().octets();
-    state += u16::from_be_bytes([dst_octets[0], dst_octets[1]]) as u32;
-    state += u16::from_be_bytes([dst_octets[2], dst_octets[3]]) as u32;
-
-    // 3) 1 byte of zeros and TCP protocol number (1 byte)
-    state += u16::from_be_bytes([0, IpProtocol::TCP as u8]) as u32;
-
-    // 4) TCP segment length (2 bytes)
-    state += (header.len() + data.len()) as u32;
-
-    let fixed_header: &[u8; MIN_TCP_HEADER_SIZE] = header[..MIN_TCP_HEADER_SIZE].try_into().unwrap();
-
-    // Continue to the TCP header. First, for the fixed length parts, we have...
-    // 1) Source port (2 bytes)
-    state += u16::from_be_bytes([fixed_header[0], fixed_header[1]]) as u32;
-
-    // 2) Destination port (2 bytes)
-    state += u16::from_be_bytes([fixed_header[2], fixed_header[3]]) as u32;
-
-    // 3) Sequence number (4 bytes)
-    state += u16::from_be_bytes([fixed_header[4], fixed_header[5]]) as u32;
-    state += u16::from_be_bytes([fixed_header[6], fixed_header[7]]) as u32;
-
-    // 4) Acknowledgement number (4 bytes)
-    state += u16::from_be_bytes([fixed_header[8], fixed_header[9]]) as u32;
-    state += u16::from_be_bytes([fixed_header[10], fixed_header[11]]) as u32;
-
-    // 5) Data offset (4 bits), reserved (4 bits), and flags (1 byte)
-    state += u16::from_be_bytes([fixed_header[12], fixed_header[13]]) as u32;
-
-    // 6) Window (2 bytes)
-    state += u16::from_be_bytes([fixed_header[14], fixed_header[15]]) as u32;
-
-    // 7) Checksum (all zeros, 2 bytes)
-    state += 0;
-
-    // 8) Urgent pointer (2 bytes)
-    state += u16::from_be_bytes([fixed_header[18], fixed_header[19]]) as u32;
-
-    // Next, the variable length part of the header for TCP options. Since `data_offset` is
-    // guaranteed to be aligned to a 32-bit boundary, we don't have to handle remainders.
-    if header.len() > MIN_TCP_HEADER_SIZE {
-        assert_eq!(header.len() % 2, 0);
-        for chunk in header[MIN_TCP_HEADER_SIZE..].chunks_exact(2) {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-    }
-
-    // Finally, checksum the data itself.
-    let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-    while let Some(chunk) = chunks_iter.next() {
-        state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-    }
-    // Since the data may have an odd number of bytes, pad the last byte with zero if necessary.
-    if let Some(&b) = chunks_iter.remainder().get(0) {
-        state += u16::from_be_bytes([b, 0]) as u32;
-    }
-
-    // NB: We don't need to subtract out 0xFFFF as we accumulate the sum. Since we use a u32 for
-    // intermediate state, we would need 2^16 additions to overflow. This is well beyond the reach
-    // of the largest jumbo frames. The upshot is that the compiler can then optimize this final
-    // loop into a single branchfree code.
-    while state > 0xFFFF {
-        state -= 0xFFFF;
-    }
-    !state as u16
+/// Computes the checksum of a TCP segment, given the one's complement sum of its data.
+fn tcp_checksum(ipv4_header: &Ipv4Header, header: &[u8], data_len: usize, data_sum: u16) -> u16 {
+    // First, fold in a "pseudo-IP" header.
+    let mut state: u16 = checksum::pseudo_header_sum(
+        &ipv4_header.get_src_addr(),
+        &ipv4_header.get_dest_addr(),
+        IpProtocol::TCP as u8,
+        (header.len() + data_len) as u16,
+    );
+
+    // Continue to the TCP header, skipping the checksum (bytes 16..18), which should be zero when computing a
+    // checksum. Since `data_offset` is guaranteed to be aligned to a 32-bit boundary, the options have an even length.
+    debug_assert_eq!(header.len() % 2, 0);
+    state = checksum::add(state, checksum::sum(&header[..16]));
+    state = checksum::add(state, checksum::sum(&header[18..]));
+
+    // Finally, fold in the data itself.
+    checksum::finish(checksum::add(state, data_sum))
 }
@@ -0,0 +1,409 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    inetstack::{
+        protocols::{
+            ethernet2::{
+                EtherType2,
+                Ethernet2Header,
+            },
+            ip::IpProtocol,
+            ipv4::Ipv4Header,
+            tcp::{
+                segment::{
+                    TcpHeader,
+                    TcpSegment,
+                },
+                SeqNumber,
+            },
+        },
+        test_helpers::{
+            self,
+            engine::{
+                SharedEngine,
+                DEFAULT_TIMEOUT,
+            },
+            SharedTestRuntime,
+            ALICE_IPV4,
+            ALICE_MAC,
+            BOB_IPV4,
+            BOB_MAC,
+        },
+        SharedInetStack,
+    },
+    runtime::{
+        memory::DemiBuffer,
+        network::PacketBuf,
+        types::DEMI_SGARRAY_MAXLEN,
+        OperationResult,
+    },
+    QDesc,
+    QToken,
+};
+use ::anyhow::Result;
+use ::std::{
+    collections::VecDeque,
+    net::SocketAddrV4,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Port that Bob listens on.
+const LISTEN_PORT: u16 = 80;
+
+/// Port of the first connection that Alice opens.
+const REMOTE_PORT: u16 = 55000;
+
+/// Window that Alice advertises.
+const WINDOW_SIZE: u16 = 65535;
+
+/// Size of each data segment that Alice sends.
+const SEGMENT_SIZE: usize = 100;
+
+/// How long to run Bob before deciding that an operation is not complete.
+const SHORT_TIMEOUT: Duration = Duration::from_millis(10);
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A connection that Alice opened to Bob. Alice is played by the test.
+struct Connection {
+    /// Queue descriptor of the connection on Bob.
+    qd: QDesc,
+    /// Port of the connection on Alice.
+    remote_port: u16,
+    /// Acknowledgement number that Alice sends, i.e. the next sequence number of Bob.
+    ack_num: SeqNumber,
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+/// Tests that contiguous segments of a receive batch are held back and delivered together, by a single pop, when the
+/// batch is flushed.
+#[test]
+fn test_coalesce_run_is_delivered_on_flush() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    for i in 0..3 {
+        receive_unflushed(&mut bob, data_segment(&conn, i))?;
+    }
+    let qt: QToken = bob.tcp_pop(conn.qd)?;
+    crate::ensure_eq!(pop_is_pending(&mut bob, qt), true);
+
+    flush_receive(&mut bob);
+    let buf: DemiBuffer = match bob.wait(qt, DEFAULT_TIMEOUT)? {
+        (_, OperationResult::Pop(_, buf)) => buf,
+        _ => anyhow::bail!("pop should have completed"),
+    };
+    crate::ensure_eq!(buf.len(), 3 * SEGMENT_SIZE);
+    for payload in buf.chunks(SEGMENT_SIZE) {
+        crate::ensure_eq!(payload, &cook_buffer()[..]);
+    }
+
+    Ok(())
+}
+
+/// Tests that a pop that is smaller than a coalesced run leaves the rest of the run for the next pop.
+#[test]
+fn test_coalesce_run_is_popped_in_pieces() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    for i in 0..3 {
+        receive_unflushed(&mut bob, data_segment(&conn, i))?;
+    }
+    flush_receive(&mut bob);
+
+    let half: usize = 3 * SEGMENT_SIZE / 2;
+    for _ in 0..2 {
+        let qt: QToken = bob.pop(conn.qd, Some(half))?;
+        crate::ensure_eq!(wait_pop(&mut bob, qt)?, half);
+    }
+    let qt: QToken = bob.tcp_pop(conn.qd)?;
+    crate::ensure_eq!(pop_is_pending(&mut bob, qt), true);
+
+    Ok(())
+}
+
+/// Tests that a run is cut where its buffer chain would no longer fit in a scatter-gather array.
+#[test]
+fn test_coalesce_run_fits_in_sgarray() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    for i in 0..=DEMI_SGARRAY_MAXLEN {
+        receive_unflushed(&mut bob, data_segment(&conn, i as u32))?;
+    }
+
+    // The first run went through as soon as it was full, and the last segment started a new one.
+    let qt: QToken = bob.tcp_pop(conn.qd)?;
+    crate::ensure_eq!(wait_pop(&mut bob, qt)?, DEMI_SGARRAY_MAXLEN * SEGMENT_SIZE);
+    crate::ensure_eq!(has_held_segments(&mut bob), true);
+
+    flush_receive(&mut bob);
+    let qt: QToken = bob.tcp_pop(conn.qd)?;
+    crate::ensure_eq!(wait_pop(&mut bob, qt)?, SEGMENT_SIZE);
+
+    Ok(())
+}
+
+/// Tests that a burst of coalesced segments is acknowledged with a single ACK.
+#[test]
+fn test_coalesce_run_is_acked_once() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    for i in 0..4 {
+        receive_unflushed(&mut bob, data_segment(&conn, i))?;
+    }
+    flush_receive(&mut bob);
+    bob.poll();
+    bob.poll();
+
+    let acks: Vec<TcpHeader> = pop_tcp_headers(&mut bob)?;
+    crate::ensure_eq!(acks.len(), 1);
+    crate::ensure_eq!(acks[0].ack, true);
+    crate::ensure_eq!(acks[0].ack_num, SeqNumber::from(1 + 4 * SEGMENT_SIZE as u32));
+
+    Ok(())
+}
+
+/// Tests that PSH ends a run: the segment that follows it is not coalesced with it.
+#[test]
+fn test_coalesce_psh_ends_run() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    let mut pushed: TcpHeader = data_header(&conn, 0);
+    pushed.psh = true;
+    check_run_is_broken(&mut bob, &conn, pushed, data_header(&conn, 1))
+}
+
+/// Tests that a gap in sequence numbers breaks a run.
+#[test]
+fn test_coalesce_seq_gap_breaks_run() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    check_run_is_broken(&mut bob, &conn, data_header(&conn, 0), data_header(&conn, 2))
+}
+
+/// Tests that a change of acknowledgement number breaks a run.
+#[test]
+fn test_coalesce_ack_mismatch_breaks_run() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    let mut next: TcpHeader = data_header(&conn, 1);
+    next.ack_num = next.ack_num - SeqNumber::from(1);
+    check_run_is_broken(&mut bob, &conn, data_header(&conn, 0), next)
+}
+
+/// Tests that a change of window breaks a run.
+#[test]
+fn test_coalesce_window_mismatch_breaks_run() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let conn: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+
+    let mut next: TcpHeader = data_header(&conn, 1);
+    next.window_size = WINDOW_SIZE / 2;
+    check_run_is_broken(&mut bob, &conn, data_header(&conn, 0), next)
+}
+
+/// Tests that a segment of another flow flushes the run that is held back.
+#[test]
+fn test_coalesce_flow_change_flushes_run() -> Result<()> {
+    let (mut bob, listen_qd): (SharedEngine, QDesc) = listen()?;
+    let first: Connection = establish(&mut bob, listen_qd, REMOTE_PORT)?;
+    let second: Connection = establish(&mut bob, listen_qd, REMOTE_PORT + 1)?;
+
+    receive_unflushed(&mut bob, data_segment(&first, 0))?;
+    receive_unflushed(&mut bob, data_segment(&second, 0))?;
+
+    // The run of the first connection went through as soon as the second connection received a segment.
+    let first_qt: QToken = bob.tcp_pop(first.qd)?;
+    crate::ensure_eq!(wait_pop(&mut bob, first_qt)?, SEGMENT_SIZE);
+    let second_qt: QToken = bob.tcp_pop(second.qd)?;
+    crate::ensure_eq!(pop_is_pending(&mut bob, second_qt), true);
+
+    flush_receive(&mut bob);
+    crate::ensure_eq!(wait_pop(&mut bob, second_qt)?, SEGMENT_SIZE);
+
+    Ok(())
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Receives `first` and then `second` in the same batch, and checks that `first` is delivered before the batch is
+/// flushed, while `second` is held back until then.
+fn check_run_is_broken(bob: &mut SharedEngine, conn: &Connection, first: TcpHeader, second: TcpHeader) -> Result<()> {
+    receive_unflushed(bob, serialize(first, Some(cook_buffer())))?;
+    receive_unflushed(bob, serialize(second, Some(cook_buffer())))?;
+
+    let qt: QToken = bob.tcp_pop(conn.qd)?;
+    crate::ensure_eq!(wait_pop(bob, qt)?, SEGMENT_SIZE);
+    crate::ensure_eq!(has_held_segments(bob), true);
+
+    flush_receive(bob);
+    crate::ensure_eq!(has_held_segments(bob), false);
+
+    Ok(())
+}
+
+/// Creates Bob and a socket that listens for connections.
+fn listen() -> Result<(SharedEngine, QDesc)> {
+    let now: Instant = Instant::now();
+    let mut bob: SharedEngine = test_helpers::new_bob2(now);
+    let listen_qd: QDesc = bob.tcp_socket()?;
+    bob.tcp_bind(listen_qd, SocketAddrV4::new(BOB_IPV4, LISTEN_PORT))?;
+    bob.tcp_listen(listen_qd, 8)?;
+    Ok((bob, listen_qd))
+}
+
+/// Opens a connection from Alice to Bob, by playing Alice's side of the three-way handshake.
+fn establish(bob: &mut SharedEngine, listen_qd: QDesc, remote_port: u16) -> Result<Connection> {
+    let accept_qt: QToken = bob.tcp_accept(listen_qd)?;
+
+    let mut syn: TcpHeader = TcpHeader::new(remote_port, LISTEN_PORT);
+    syn.syn = true;
+    syn.window_size = WINDOW_SIZE;
+    bob.receive(serialize(syn, None))?;
+    bob.poll();
+
+    let syn_ack: TcpHeader = match pop_tcp_headers(bob)?.pop() {
+        Some(hdr) if hdr.syn && hdr.ack => hdr,
+        _ => anyhow::bail!("bob should have sent a SYN+ACK"),
+    };
+
+    let mut ack: TcpHeader = TcpHeader::new(remote_port, LISTEN_PORT);
+    ack.seq_num = SeqNumber::from(1);
+    ack.ack_num = syn_ack.seq_num + SeqNumber::from(1);
+    ack.ack = true;
+    ack.window_size = WINDOW_SIZE;
+    let ack_num: SeqNumber = ack.ack_num;
+    bob.receive(serialize(ack, None))?;
+
+    let qd: QDesc = match bob.wait(accept_qt, DEFAULT_TIMEOUT)? {
+        (_, OperationResult::Accept((qd, _))) => qd,
+        _ => anyhow::bail!("accept should have completed"),
+    };
+    bob.pop_all_frames();
+
+    Ok(Connection {
+        qd,
+        remote_port,
+        ack_num,
+    })
+}
+
+/// Builds the header of the `index`-th data segment that Alice sends on a connection.
+fn data_header(conn: &Connection, index: u32) -> TcpHeader {
+    let mut hdr: TcpHeader = TcpHeader::new(conn.remote_port, LISTEN_PORT);
+    hdr.seq_num = SeqNumber::from(1 + index * SEGMENT_SIZE as u32);
+    hdr.ack_num = conn.ack_num;
+    hdr.ack = true;
+    hdr.window_size = WINDOW_SIZE;
+    hdr
+}
+
+/// Builds the frame of the `index`-th data segment that Alice sends on a connection.
+fn data_segment(conn: &Connection, index: u32) -> DemiBuffer {
+    serialize(data_header(conn, index), Some(cook_buffer()))
+}
+
+/// Serializes a segment from Alice to Bob into a frame.
+fn serialize(tcp_hdr: TcpHeader, data: Option<DemiBuffer>) -> DemiBuffer {
+    let segment: TcpSegment = TcpSegment {
+        ethernet2_hdr: Ethernet2Header::new(BOB_MAC, ALICE_MAC, EtherType2::Ipv4),
+        ipv4_hdr: Ipv4Header::new(ALICE_IPV4, BOB_IPV4, IpProtocol::TCP),
+        tcp_hdr,
+        data,
+        data_sum: None,
+        tx_checksum_offload: false,
+        segment_size: None,
+    };
+    let header_size: usize = segment.header_size();
+    let body_size: usize = segment.body_size();
+    let mut buf: DemiBuffer = DemiBuffer::new((header_size + body_size) as u16);
+    segment.write_header(&mut buf[..header_size]);
+    if let Some(body) = segment.take_body() {
+        body.copy_to_slice(&mut buf[header_size..]);
+    }
+    buf
+}
+
+/// Cooks the payload of a data segment.
+fn cook_buffer() -> DemiBuffer {
+    let mut buf: DemiBuffer = DemiBuffer::new(SEGMENT_SIZE as u16);
+    for i in 0..SEGMENT_SIZE {
+        buf[i] = i as u8;
+    }
+    buf
+}
+
+/// Hands a frame to Bob as part of a receive batch that is not over yet.
+fn receive_unflushed(bob: &mut SharedEngine, buf: DemiBuffer) -> Result<()> {
+    let mut transport: SharedInetStack<SharedTestRuntime> = bob.get_transport();
+    transport.receive_unflushed(buf)?;
+    bob.poll();
+    Ok(())
+}
+
+/// Ends the receive batch of Bob.
+fn flush_receive(bob: &mut SharedEngine) {
+    let mut transport: SharedInetStack<SharedTestRuntime> = bob.get_transport();
+    transport.ipv4.flush_receive();
+    bob.poll();
+}
+
+/// Checks if Bob holds back segments for coalescing.
+fn has_held_segments(bob: &mut SharedEngine) -> bool {
+    let transport: SharedInetStack<SharedTestRuntime> = bob.get_transport();
+    transport.ipv4.tcp.has_held_segments()
+}
+
+/// Checks that a pop does not complete within a short time.
+fn pop_is_pending(bob: &mut SharedEngine, qt: QToken) -> bool {
+    match bob.wait(qt, SHORT_TIMEOUT) {
+        Err(e) => e.errno == libc::ETIMEDOUT,
+        Ok(_) => false,
+    }
+}
+
+/// Waits for a pop to complete and returns the number of bytes that it popped.
+fn wait_pop(bob: &mut SharedEngine, qt: QToken) -> Result<usize> {
+    match bob.wait(qt, DEFAULT_TIMEOUT)? {
+        (_, OperationResult::Pop(_, buf)) => Ok(buf.total_len()),
+        _ => anyhow::bail!("pop should have completed"),
+    }
+}
+
+/// Removes every frame that Bob sent, and returns their TCP headers.
+fn pop_tcp_headers(bob: &mut SharedEngine) -> Result<Vec<TcpHeader>> {
+    let frames: VecDeque<DemiBuffer> = bob.pop_all_frames();
+    let mut headers: Vec<TcpHeader> = Vec::with_capacity(frames.len());
+    for frame in frames {
+        let (_, eth2_payload): (Ethernet2Header, DemiBuffer) = Ethernet2Header::parse(frame)?;
+        let (ipv4_hdr, ipv4_payload): (Ipv4Header, DemiBuffer) = Ipv4Header::parse(eth2_payload)?;
+        let (tcp_hdr, _): (TcpHeader, DemiBuffer) = TcpHeader::parse(&ipv4_hdr, ipv4_payload, true)?;
+        headers.push(tcp_hdr);
+    }
+    Ok(headers)
+}
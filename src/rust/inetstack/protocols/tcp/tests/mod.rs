@@ -5,5 +5,6 @@
 // Exports
 //======================================================================================================================
 
+mod coalesce;
 #[cfg(debug_assertions)]
 mod simulator;
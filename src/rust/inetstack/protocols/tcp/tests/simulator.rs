@@ -801,7 +801,9 @@ impl Simulation {
             ipv4_hdr,
             tcp_hdr,
             data,
+            data_sum: None,
             tx_checksum_offload: false,
+            segment_size: None,
         }
     }
 
@@ -942,7 +944,7 @@ impl Simulation {
         let mut buf: DemiBuffer = DemiBuffer::new((header_size + body_size) as u16);
         pkt.write_header(&mut buf[..header_size]);
         if let Some(body) = pkt.take_body() {
-            buf[header_size..].copy_from_slice(&body[..]);
+            body.copy_to_slice(&mut buf[header_size..]);
         }
         buf
     }
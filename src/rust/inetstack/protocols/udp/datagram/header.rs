@@ -7,6 +7,7 @@
 
 use crate::{
     inetstack::protocols::{
+        checksum,
         ip::IpProtocol,
         ipv4::Ipv4Header,
     },
@@ -17,7 +18,6 @@ use crate::{
 };
 use ::libc::EBADMSG;
 use ::std::convert::TryInto;
-use std::slice::ChunksExact;
 
 //==============================================================================
 // Constants
@@ -92,7 +92,7 @@ impl UdpHeader {
             // Check if we should skip checksum verification.
             if checksum != 0 {
                 // No, so check if checksum value matches what we expect.
-                if checksum != Self::checksum(&ipv4_hdr, hdr_buf, payload_buf) {
+                if checksum != Self::checksum(&ipv4_hdr, hdr_buf, payload_buf.len(), checksum::sum(payload_buf)) {
                     return Err(Fail::new(EBADMSG, "UDP checksum mismatch"));
                 }
             }
@@ -111,7 +111,7 @@ impl UdpHeader {
     }
 
     /// Serializes the target UDP header.
-    pub fn serialize(&self, buf: &mut [u8], ipv4_hdr: &Ipv4Header, data: &[u8], checksum_offload: bool) {
+    pub fn serialize(&self, buf: &mut [u8], ipv4_hdr: &Ipv4Header, data: &DemiBuffer, checksum_offload: bool) {
         let fixed_buf: &mut [u8; UDP_HEADER_SIZE] = (&mut buf[..UDP_HEADER_SIZE]).try_into().unwrap();
 
         // Write source port.
@@ -121,13 +121,14 @@ impl UdpHeader {
         fixed_buf[2..4].copy_from_slice(&self.dest_port.to_be_bytes());
 
         // Write payload length.
-        fixed_buf[4..6].copy_from_slice(&((UDP_HEADER_SIZE + data.len()) as u16).to_be_bytes());
+        fixed_buf[4..6].copy_from_slice(&((UDP_HEADER_SIZE + data.total_len()) as u16).to_be_bytes());
 
         // Write checksum.
         let checksum: u16 = if checksum_offload {
             0
         } else {
-            Self::checksum(ipv4_hdr, &fixed_buf[..], data)
+            let data_sum: u16 = checksum::sum_pieces(data.segments());
+            Self::checksum(ipv4_hdr, &fixed_buf[..], data.total_len(), data_sum)
         };
         fixed_buf[6..8].copy_from_slice(&checksum.to_be_bytes());
     }
@@ -137,62 +138,27 @@ impl UdpHeader {
     /// This is the 16-bit one's complement of the one's complement sum of a
     /// pseudo header of information from the IP header, the UDP header, and the
     /// data,  padded  with zero octets at the end (if  necessary)  to  make  a
-    /// multiple of two octets.
+    /// multiple of two octets. The data is given by its length and one's complement sum.
     ///
     /// TODO: Write a unit test for this function.
-    fn checksum(ipv4_hdr: &Ipv4Header, udp_hdr: &[u8], data: &[u8]) -> u16 {
-        let mut state: u32 = 0xffff;
-
-        // Source address (4 bytes)
-        let src_octets: [u8; 4] = ipv4_hdr.get_src_addr().octets();
-        state += u16::from_be_bytes([src_octets[0], src_octets[1]]) as u32;
-        state += u16::from_be_bytes([src_octets[2], src_octets[3]]) as u32;
-
-        // Destination address (4 bytes)
-        let dst_octets: [u8; 4] = ipv4_hdr.get_dest_addr().octets();
-        state += u16::from_be_bytes([dst_octets[0], dst_octets[1]]) as u32;
-        state += u16::from_be_bytes([dst_octets[2], dst_octets[3]]) as u32;
-
-        // Padding zeros (1 byte) and UDP protocol number (1 byte)
-        state += u16::from_be_bytes([0, IpProtocol::UDP as u8]) as u32;
-
-        // UDP segment length (2 bytes)
-        state += (udp_hdr.len() + data.len()) as u32;
-
-        // Switch to UDP header.
+    fn checksum(ipv4_hdr: &Ipv4Header, udp_hdr: &[u8], data_len: usize, data_sum: u16) -> u16 {
+        // Pseudo header.
+        let mut state: u16 = checksum::pseudo_header_sum(
+            &ipv4_hdr.get_src_addr(),
+            &ipv4_hdr.get_dest_addr(),
+            IpProtocol::UDP as u8,
+            (udp_hdr.len() + data_len) as u16,
+        );
+
+        // UDP header: source port, destination port and length (6 bytes). The checksum field (2 bytes) should be zero
+        // when computing a checksum, so we skip it.
         let fixed_header: &[u8; UDP_HEADER_SIZE] = udp_hdr.try_into().unwrap();
-
-        // Source port (2 bytes)
-        state += u16::from_be_bytes([fixed_header[0], fixed_header[1]]) as u32;
-
-        // Destination port (2 bytes)
-        state += u16::from_be_bytes([fixed_header[2], fixed_header[3]]) as u32;
-
-        // Payload Length (2 bytes)
-        state += u16::from_be_bytes([fixed_header[4], fixed_header[5]]) as u32;
-
-        // Checksum (2 bytes, all zeros)
-        state += 0;
+        state = checksum::add(state, checksum::sum(&fixed_header[..6]));
 
         // Payload.
-        let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-        while let Some(chunk) = chunks_iter.next() {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-        // Pad with zeros with payload has an odd number of bytes.
-        if let Some(&b) = chunks_iter.remainder().get(0) {
-            state += u16::from_be_bytes([b, 0]) as u32;
-        }
+        state = checksum::add(state, data_sum);
 
-        // NOTE: We don't need to subtract out 0xFFFF as we accumulate the sum.
-        // Since we use a u32 for intermediate state, we would need 2^16
-        // additions to overflow. This is well beyond the reach of the largest
-        // jumbo frames. The upshot is that the compiler can then optimize this
-        // final loop into a single branch-free code.
-        while state > 0xFFFF {
-            state -= 0xFFFF;
-        }
-        !state as u16
+        checksum::finish(state)
     }
 }
 
@@ -227,7 +193,7 @@ mod test {
         let udp_hdr: UdpHeader = UdpHeader::new(src_port, dest_port);
 
         // Payload.
-        let data: [u8; 8] = [0x0, 0x1, 0x0, 0x1, 0x0, 0x1, 0x0, 0x1];
+        let data: DemiBuffer = DemiBuffer::from_slice(&[0x0, 0x1, 0x0, 0x1, 0x0, 0x1, 0x0, 0x1])?;
 
         // Output buffer.
         let mut buf: [u8; 8] = [0; 8];
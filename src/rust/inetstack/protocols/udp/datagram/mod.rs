@@ -80,7 +80,7 @@ impl PacketBuf for UdpDatagram {
 
     /// Computes the payload size of the target UDP datagram.
     fn body_size(&self) -> usize {
-        self.data.len()
+        self.data.total_len()
     }
 
     /// Serializes the header of the target UDP datagram.
@@ -88,7 +88,7 @@ impl PacketBuf for UdpDatagram {
         let mut cur_pos: usize = 0;
         let eth_hdr_size: usize = self.ethernet2_hdr.compute_size();
         let udp_hdr_size: usize = self.udp_hdr.size();
-        let ipv4_payload_len: usize = udp_hdr_size + self.data.len();
+        let ipv4_payload_len: usize = udp_hdr_size + self.data.total_len();
 
         // Ethernet header.
         self.ethernet2_hdr
@@ -105,7 +105,7 @@ impl PacketBuf for UdpDatagram {
         self.udp_hdr.serialize(
             &mut buf[cur_pos..(cur_pos + udp_hdr_size)],
             &self.ipv4_hdr,
-            &self.data[..],
+            &self.data,
             self.checksum_offload,
         );
     }
@@ -193,4 +193,39 @@ mod test {
 
         Ok(())
     }
+
+    /// Tests that a buffer chain makes up the payload of a single datagram, with the same header as a single buffer.
+    #[test]
+    fn test_udp_datagram_chained_payload() -> Result<()> {
+        const HEADER_SIZE: usize = ETHERNET2_HEADER_SIZE + (IPV4_HEADER_MIN_SIZE as usize) + UDP_HEADER_SIZE;
+        let mac_addr: MacAddress = MacAddress::new([0xd, 0xe, 0xa, 0xd, 0x0, 0x0]);
+        let ethernet2_hdr: Ethernet2Header = Ethernet2Header::new(mac_addr, mac_addr, EtherType2::Ipv4);
+        let src_addr: Ipv4Addr = Ipv4Addr::new(198, 0, 0, 1);
+        let dst_addr: Ipv4Addr = Ipv4Addr::new(198, 0, 0, 2);
+        let ipv4_hdr: Ipv4Header = Ipv4Header::new(src_addr, dst_addr, IpProtocol::UDP);
+
+        // Odd-length segments shift the words of the ones that follow them.
+        let mut chain: DemiBuffer = DemiBuffer::from_slice(b"odd")?;
+        chain.append(DemiBuffer::from_slice(b"length")?)?;
+        chain.append(DemiBuffer::from_slice(b"pieces")?)?;
+        let flat: DemiBuffer = DemiBuffer::from_slice(b"oddlengthpieces")?;
+
+        let chained: UdpDatagram = UdpDatagram::new(
+            ethernet2_hdr.clone(),
+            ipv4_hdr,
+            UdpHeader::new(0x32, 0x45),
+            chain,
+            false,
+        );
+        let single: UdpDatagram = UdpDatagram::new(ethernet2_hdr, ipv4_hdr, UdpHeader::new(0x32, 0x45), flat, false);
+        crate::ensure_eq!(chained.body_size(), single.body_size());
+
+        let mut chained_hdr: [u8; HEADER_SIZE] = [0; HEADER_SIZE];
+        let mut single_hdr: [u8; HEADER_SIZE] = [0; HEADER_SIZE];
+        chained.write_header(&mut chained_hdr);
+        single.write_header(&mut single_hdr);
+        crate::ensure_eq!(chained_hdr, single_hdr);
+
+        Ok(())
+    }
 }
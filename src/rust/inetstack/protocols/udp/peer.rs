@@ -141,9 +141,12 @@ impl<N: NetworkRuntime> SharedUdpPeer<N> {
             error!("pushto(): {}", &cause);
             return Err(Fail::new(libc::ENOTSUP, &cause));
         }
-        // TODO: Remove copy once we actually use push coroutine for send.
+        // The segments of a buffer chain leave as the body of a single datagram, without being copied together.
+        if buf.total_len() > u16::MAX as usize {
+            return Err(Fail::new(libc::EMSGSIZE, "datagram is too large"));
+        }
         socket.push(remote, buf.clone()).await?;
-        buf.trim(buf.len())
+        buf.advance(buf.total_len())
     }
 
     /// Pops data from a socket.
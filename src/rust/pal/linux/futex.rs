@@ -0,0 +1,71 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+//! Futex wait and wake on words that may live in memory shared across processes. These are process-shared futexes,
+//! thus they do not use FUTEX_PRIVATE_FLAG.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::fail::Fail;
+use ::core::{
+    ptr,
+    sync::atomic::AtomicU32,
+    time::Duration,
+};
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Blocks the calling thread while `word` holds `expected`, for at most `timeout`. Returns when the word is woken
+/// up, holds a different value, or the timeout expires (in which case the error is ETIMEDOUT).
+pub fn futex_wait(word: &AtomicU32, expected: u32, timeout: Duration) -> Result<(), Fail> {
+    let timespec: libc::timespec = libc::timespec {
+        tv_sec: timeout.as_secs() as libc::time_t,
+        tv_nsec: timeout.subsec_nanos() as libc::c_long,
+    };
+    // Safety: The word is a valid, aligned 32-bit integer, and the timespec outlives the call.
+    let ret: libc::c_long = unsafe {
+        libc::syscall(
+            libc::SYS_futex,
+            word.as_ptr(),
+            libc::FUTEX_WAIT,
+            expected,
+            &timespec as *const libc::timespec,
+            ptr::null::<u32>(),
+            0,
+        )
+    };
+    if ret == -1 {
+        let errno: libc::c_int = unsafe { *libc::__errno_location() };
+        match errno {
+            // The word did not hold the expected value, or a signal interrupted the wait.
+            libc::EAGAIN | libc::EINTR => return Ok(()),
+            _ => return Err(Fail::new(errno, "failed to wait on futex")),
+        }
+    }
+    Ok(())
+}
+
+/// Wakes up at most `count` threads blocked on `word`. Returns the number of threads that were woken up.
+pub fn futex_wake(word: &AtomicU32, count: u32) -> Result<usize, Fail> {
+    // Safety: The word is a valid, aligned 32-bit integer.
+    let ret: libc::c_long = unsafe {
+        libc::syscall(
+            libc::SYS_futex,
+            word.as_ptr(),
+            libc::FUTEX_WAKE,
+            count.min(i32::MAX as u32),
+            ptr::null::<libc::timespec>(),
+            ptr::null::<u32>(),
+            0,
+        )
+    };
+    if ret == -1 {
+        let errno: libc::c_int = unsafe { *libc::__errno_location() };
+        return Err(Fail::new(errno, "failed to wake futex"));
+    }
+    Ok(ret as usize)
+}
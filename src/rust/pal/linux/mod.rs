@@ -5,6 +5,8 @@
 // Exports
 //======================================================================================================================
 
+#[cfg(feature = "catmem-libos")]
+pub mod futex;
 #[cfg(feature = "catmem-libos")]
 pub mod shm;
 
@@ -1,9 +1,11 @@
 // Copyright(c) Microsoft Corporation.
 // Licensed under the MIT license.
 
-#[cfg(test)]
+#[cfg(all(test, not(feature = "profiler-trace")))]
 mod tests;
 
+pub mod trace;
+
 use std::{
     cell::RefCell,
     io,
@@ -26,7 +28,9 @@ thread_local!(
 /// taken from entering to leaving the scope will be measured.
 ///
 /// Internally, the scope is inserted in the scope tree of the global
-/// thread-local [`PROFILER`](constant.PROFILER.html).
+/// thread-local [`PROFILER`](constant.PROFILER.html). With the
+/// `profiler-trace` feature, the scope is instead recorded in the trace ring
+/// of the current thread (see [`trace`](trace/index.html)).
 ///
 /// # Example
 ///
@@ -47,7 +51,7 @@ thread_local!(
 ///     // ... do some more ...
 /// }
 /// ```
-
+#[cfg(not(feature = "profiler-trace"))]
 #[macro_export]
 macro_rules! timer {
     ($name:expr) => {
@@ -55,6 +59,14 @@ macro_rules! timer {
     };
 }
 
+#[cfg(feature = "profiler-trace")]
+#[macro_export]
+macro_rules! timer {
+    ($name:expr) => {
+        let _guard = $crate::perftools::profiler::trace::enter($name);
+    };
+}
+
 /// Print profiling scope tree.
 ///
 /// Percentages represent the amount of time taken relative to the parent node.
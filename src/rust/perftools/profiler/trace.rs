@@ -0,0 +1,559 @@
+// Copyright(c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Trace mode of the profiler.
+//!
+//! Instead of maintaining a scope tree, each thread appends timestamped enter and leave events to a preallocated ring
+//! of its own, so that entering and leaving a scope neither allocates nor touches reference counts. The owner thread
+//! is the single producer of its ring and an [Exporter] is the single consumer; rings are registered once per thread,
+//! so that the exporter may find them. The exporter replays the events to rebuild call stacks and emits them as
+//! folded stacks (for flamegraph tools) and Chrome trace events (for chrome://tracing and Perfetto).
+//!
+//! When a ring is full its owner drops new scopes, rather than waiting for the exporter. A scope is only recorded if
+//! there is room for its leave event and for the leave events of all scopes that are still open, so the recorded
+//! events always nest properly.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::runtime::fail::Fail;
+use ::std::{
+    cell::{
+        Cell,
+        UnsafeCell,
+    },
+    collections::HashMap,
+    fs::{
+        self,
+        File,
+    },
+    io::{
+        self,
+        BufWriter,
+    },
+    mem::MaybeUninit,
+    path::{
+        Path,
+        PathBuf,
+    },
+    sync::{
+        atomic::{
+            AtomicBool,
+            AtomicU64,
+            AtomicUsize,
+            Ordering,
+        },
+        Arc,
+        Mutex,
+    },
+    thread,
+    time::Duration,
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Capacity (in events) of the ring of each thread. This must be a power of two. Each scope takes two events, so rings
+/// hold 32768 scopes in 1.5 MB.
+pub const TRACE_RING_CAPACITY: usize = 65536;
+
+/// Maximum number of Chrome trace events that an exporter keeps between two calls to [Exporter::clear_chrome_trace].
+pub const MAX_CHROME_TRACE_EVENTS: usize = 1 << 20;
+
+//==============================================================================
+// Global Variables
+//==============================================================================
+
+/// Rings of all threads that have entered a traced scope.
+static REGISTRY: Mutex<Vec<Arc<ThreadRing>>> = Mutex::new(Vec::new());
+
+/// Source of identifiers for rings.
+static NEXT_RING_ID: AtomicU64 = AtomicU64::new(1);
+
+/// Was the background exporter started?
+static EXPORTER_STARTED: AtomicBool = AtomicBool::new(false);
+
+thread_local!(
+    /// Ring of the current thread, which is allocated and registered the first time that the thread enters a scope.
+    static RING: Arc<ThreadRing> = ThreadRing::register()
+);
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// An event in a ring. Leave events have no name.
+#[derive(Clone, Copy)]
+struct Event {
+    name: Option<&'static str>,
+    timestamp: u64,
+}
+
+/// Single-producer single-consumer ring of events.
+struct ThreadRing {
+    /// Identifier of the ring, which is used as the thread identifier in traces.
+    id: u64,
+    /// Name of the owner thread.
+    thread_name: String,
+    /// Preallocated events.
+    events: Box<[UnsafeCell<MaybeUninit<Event>>]>,
+    /// Number of events pushed so far. Only the owner thread writes this.
+    head: AtomicUsize,
+    /// Number of events consumed so far. Only the exporter writes this.
+    tail: AtomicUsize,
+    /// Number of scopes that were not recorded because the ring was full.
+    num_dropped: AtomicU64,
+    /// Last value of `tail` observed by the owner thread.
+    cached_tail: Cell<usize>,
+    /// Number of recorded scopes that the owner thread has not left yet.
+    num_open: Cell<usize>,
+}
+
+/// A guard that is created when entering a traced scope and dropped when leaving it.
+pub struct Guard {
+    recorded: bool,
+}
+
+/// A frame in the call stack of a thread, as rebuilt by an exporter.
+struct Frame {
+    name: &'static str,
+    enter: u64,
+    children: u64,
+}
+
+/// Replay state of a thread.
+struct ThreadState {
+    name: String,
+    stack: Vec<Frame>,
+}
+
+/// A completed scope, to be written as a Chrome trace event.
+struct Span {
+    name: &'static str,
+    tid: u64,
+    enter: u64,
+    duration: u64,
+}
+
+/// Consumer of the rings of all threads.
+pub struct Exporter {
+    threads: HashMap<u64, ThreadState>,
+    /// Self time (in cycles) of each folded stack.
+    folded: HashMap<String, u64>,
+    spans: Vec<Span>,
+    num_dropped: u64,
+    ns_per_cycle: f64,
+    epoch: u64,
+}
+
+//==============================================================================
+// Associated Functions
+//==============================================================================
+
+impl ThreadRing {
+    fn new(id: u64, thread_name: String, capacity: usize) -> Self {
+        debug_assert!(capacity.is_power_of_two());
+        Self {
+            id,
+            thread_name,
+            events: (0..capacity).map(|_| UnsafeCell::new(MaybeUninit::uninit())).collect(),
+            head: AtomicUsize::new(0),
+            tail: AtomicUsize::new(0),
+            num_dropped: AtomicU64::new(0),
+            cached_tail: Cell::new(0),
+            num_open: Cell::new(0),
+        }
+    }
+
+    /// Allocates a ring for the current thread and registers it.
+    fn register() -> Arc<Self> {
+        let id: u64 = NEXT_RING_ID.fetch_add(1, Ordering::Relaxed);
+        let thread_name: String = match thread::current().name() {
+            Some(name) => name.replace(';', "_"),
+            None => format!("thread-{}", id),
+        };
+        let ring: Arc<Self> = Arc::new(Self::new(id, thread_name, TRACE_RING_CAPACITY));
+        match REGISTRY.lock() {
+            Ok(mut registry) => registry.push(ring.clone()),
+            Err(_) => warn!("register(): profiler registry is poisoned, scopes of this thread will not be exported"),
+        }
+        ring
+    }
+
+    /// Records that the owner thread entered a scope. Returns false if the scope was dropped.
+    fn enter(&self, name: &'static str, timestamp: u64) -> bool {
+        let num_open: usize = self.num_open.get();
+        // Keep room for the leave events of this scope and of all open ones.
+        if !self.has_room_for(num_open + 2) {
+            self.num_dropped.fetch_add(1, Ordering::Relaxed);
+            return false;
+        }
+        self.push(Event {
+            name: Some(name),
+            timestamp,
+        });
+        self.num_open.set(num_open + 1);
+        true
+    }
+
+    /// Records that the owner thread left the last scope that it entered and was recorded.
+    fn leave(&self, timestamp: u64) {
+        self.push(Event { name: None, timestamp });
+        self.num_open.set(self.num_open.get() - 1);
+    }
+
+    fn has_room_for(&self, count: usize) -> bool {
+        let head: usize = self.head.load(Ordering::Relaxed);
+        if head - self.cached_tail.get() + count <= self.events.len() {
+            return true;
+        }
+        self.cached_tail.set(self.tail.load(Ordering::Acquire));
+        head - self.cached_tail.get() + count <= self.events.len()
+    }
+
+    fn push(&self, event: Event) {
+        let head: usize = self.head.load(Ordering::Relaxed);
+        // Safety: Only the owner thread pushes, and the exporter does not read this slot until head is published.
+        unsafe { (*self.events[head & (self.events.len() - 1)].get()).write(event) };
+        self.head.store(head + 1, Ordering::Release);
+    }
+
+    /// Consumes all published events. Only one exporter may call this at a time.
+    fn drain<F: FnMut(Event)>(&self, mut f: F) {
+        let tail: usize = self.tail.load(Ordering::Relaxed);
+        let head: usize = self.head.load(Ordering::Acquire);
+        for i in tail..head {
+            // Safety: The owner thread initialized this slot before publishing head, and does not overwrite it until
+            // tail moves past it.
+            let event: Event = unsafe { (*self.events[i & (self.events.len() - 1)].get()).assume_init_read() };
+            f(event);
+        }
+        self.tail.store(head, Ordering::Release);
+    }
+}
+
+impl Exporter {
+    /// Creates an exporter. Timestamps of Chrome trace events are relative to the creation of the exporter.
+    pub fn new() -> Self {
+        Self::with_clock(super::Profiler::measure_ns_per_cycle(), now())
+    }
+
+    fn with_clock(ns_per_cycle: f64, epoch: u64) -> Self {
+        Self {
+            threads: HashMap::new(),
+            folded: HashMap::new(),
+            spans: Vec::new(),
+            num_dropped: 0,
+            ns_per_cycle,
+            epoch,
+        }
+    }
+
+    /// Consumes the events of all threads. Rings of threads that have exited are released once drained.
+    pub fn drain(&mut self) {
+        let rings: Vec<Arc<ThreadRing>> = match REGISTRY.lock() {
+            Ok(mut registry) => {
+                let rings: Vec<Arc<ThreadRing>> = registry.clone();
+                // The thread-local variable of the owner holds the other reference.
+                registry.retain(|ring| Arc::strong_count(ring) > 2);
+                rings
+            },
+            Err(_) => {
+                warn!("drain(): profiler registry is poisoned");
+                return;
+            },
+        };
+        for ring in rings.iter() {
+            self.drain_ring(ring);
+        }
+    }
+
+    fn drain_ring(&mut self, ring: &ThreadRing) {
+        let state: &mut ThreadState = self.threads.entry(ring.id).or_insert_with(|| ThreadState {
+            name: ring.thread_name.clone(),
+            stack: Vec::new(),
+        });
+        let folded: &mut HashMap<String, u64> = &mut self.folded;
+        let spans: &mut Vec<Span> = &mut self.spans;
+        ring.drain(|event| match event.name {
+            Some(name) => state.stack.push(Frame {
+                name,
+                enter: event.timestamp,
+                children: 0,
+            }),
+            None => {
+                let frame: Frame = match state.stack.pop() {
+                    Some(frame) => frame,
+                    None => return,
+                };
+                let duration: u64 = event.timestamp.saturating_sub(frame.enter);
+
+                let mut key: String = state.name.clone();
+                for parent in state.stack.iter() {
+                    key.push(';');
+                    key.push_str(parent.name);
+                }
+                key.push(';');
+                key.push_str(frame.name);
+                *folded.entry(key).or_insert(0) += duration.saturating_sub(frame.children);
+
+                if let Some(parent) = state.stack.last_mut() {
+                    parent.children += duration;
+                }
+                if spans.len() < MAX_CHROME_TRACE_EVENTS {
+                    spans.push(Span {
+                        name: frame.name,
+                        tid: ring.id,
+                        enter: frame.enter,
+                        duration,
+                    });
+                }
+            },
+        });
+        self.num_dropped += ring.num_dropped.swap(0, Ordering::Relaxed);
+    }
+
+    /// Number of scopes that threads dropped because their rings were full.
+    pub fn num_dropped(&self) -> u64 {
+        self.num_dropped
+    }
+
+    /// Writes the self time (in nanoseconds) of each call stack seen so far in folded format, one "thread;outer;inner
+    /// time" line per stack. This is the input format of flamegraph.pl and inferno.
+    pub fn write_folded<W: io::Write>(&self, out: &mut W) -> io::Result<()> {
+        let mut stacks: Vec<(&String, &u64)> = self.folded.iter().collect();
+        stacks.sort();
+        for (stack, cycles) in stacks {
+            writeln!(out, "{} {}", stack, (*cycles as f64 * self.ns_per_cycle) as u64)?;
+        }
+        out.flush()
+    }
+
+    /// Writes the scopes completed since the last call to [Exporter::clear_chrome_trace] in the Chrome trace event
+    /// format, as complete ("X") events.
+    pub fn write_chrome_trace<W: io::Write>(&self, out: &mut W) -> io::Result<()> {
+        let pid: u32 = ::std::process::id();
+        write!(out, "{{\"traceEvents\":[")?;
+        let mut separator: &str = "";
+        for (tid, state) in self.threads.iter() {
+            write!(
+                out,
+                "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":",
+                separator, pid, tid
+            )?;
+            write_json_string(out, &state.name)?;
+            write!(out, "}}}}")?;
+            separator = ",";
+        }
+        for span in self.spans.iter() {
+            write!(out, "{}{{\"name\":", separator)?;
+            write_json_string(out, span.name)?;
+            write!(
+                out,
+                ",\"ph\":\"X\",\"ts\":{:.3},\"dur\":{:.3},\"pid\":{},\"tid\":{}}}",
+                self.cycles_to_us(span.enter.saturating_sub(self.epoch)),
+                self.cycles_to_us(span.duration),
+                pid,
+                span.tid
+            )?;
+            separator = ",";
+        }
+        writeln!(out, "],\"displayTimeUnit\":\"ns\"}}")?;
+        out.flush()
+    }
+
+    /// Discards the scopes kept for the Chrome trace.
+    pub fn clear_chrome_trace(&mut self) {
+        self.spans.clear();
+    }
+
+    fn cycles_to_us(&self, cycles: u64) -> f64 {
+        cycles as f64 * self.ns_per_cycle / 1000.0
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+// Safety: Fields in cells are only accessed by the owner thread, events are handed over through head and tail.
+unsafe impl Sync for ThreadRing {}
+
+// Safety: See above.
+unsafe impl Send for ThreadRing {}
+
+impl Drop for Guard {
+    #[inline]
+    fn drop(&mut self) {
+        if self.recorded {
+            let timestamp: u64 = now();
+            // The ring may already be gone if the thread is exiting.
+            let _ = RING.try_with(|ring| ring.leave(timestamp));
+        }
+    }
+}
+
+impl Default for Exporter {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Enters a traced scope. Returns a [Guard] that should be dropped upon leaving the scope.
+///
+/// Usually, this function will be called by the `timer` macro, so it does not need to be used directly.
+#[inline]
+pub fn enter(name: &'static str) -> Guard {
+    let recorded: bool = RING.try_with(|ring| ring.enter(name, now())).unwrap_or(false);
+    Guard { recorded }
+}
+
+/// Starts a background thread that drains the rings of all threads every `period`. On every period, the thread
+/// rewrites `folded_path` with all stacks seen so far and `chrome_path` with the scopes of that period. Calling this
+/// again once the thread is running has no effect.
+pub fn start_exporter(period: Duration, folded_path: PathBuf, chrome_path: PathBuf) -> Result<(), Fail> {
+    if EXPORTER_STARTED.swap(true, Ordering::AcqRel) {
+        return Ok(());
+    }
+
+    let spawned: io::Result<thread::JoinHandle<()>> = thread::Builder::new()
+        .name("demikernel-profiler".to_string())
+        .spawn(move || {
+            let mut exporter: Exporter = Exporter::new();
+            loop {
+                thread::sleep(period);
+                exporter.drain();
+                if let Err(e) = write_file(&folded_path, |out| exporter.write_folded(out)) {
+                    warn!("start_exporter(): failed to write {:?} ({:?})", folded_path, e);
+                }
+                if let Err(e) = write_file(&chrome_path, |out| exporter.write_chrome_trace(out)) {
+                    warn!("start_exporter(): failed to write {:?} ({:?})", chrome_path, e);
+                }
+                exporter.clear_chrome_trace();
+            }
+        });
+
+    match spawned {
+        Ok(_) => Ok(()),
+        Err(_) => {
+            EXPORTER_STARTED.store(false, Ordering::Release);
+            Err(Fail::new(libc::EAGAIN, "failed to spawn profiler exporter thread"))
+        },
+    }
+}
+
+/// Replaces the contents of a file, so that readers never see a partially written one.
+fn write_file<F: FnOnce(&mut BufWriter<File>) -> io::Result<()>>(path: &Path, f: F) -> io::Result<()> {
+    let temp_path: PathBuf = path.with_extension("tmp");
+    let mut out: BufWriter<File> = BufWriter::new(File::create(&temp_path)?);
+    f(&mut out)?;
+    drop(out);
+    fs::rename(&temp_path, path)
+}
+
+fn write_json_string<W: io::Write>(out: &mut W, s: &str) -> io::Result<()> {
+    write!(out, "\"")?;
+    for c in s.chars() {
+        match c {
+            '"' => write!(out, "\\\"")?,
+            '\\' => write!(out, "\\\\")?,
+            c if (c as u32) < 0x20 => write!(out, "\\u{:04x}", c as u32)?,
+            c => write!(out, "{}", c)?,
+        }
+    }
+    write!(out, "\"")
+}
+
+#[inline]
+fn now() -> u64 {
+    let (now, _): (u64, u32) = unsafe { x86::time::rdtscp() };
+    now
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ::anyhow::Result;
+
+    /// Tests that a full ring drops whole scopes and always keeps room for the leave events of open scopes.
+    #[test]
+    fn test_ring_keeps_scopes_balanced() -> Result<()> {
+        let ring: ThreadRing = ThreadRing::new(1, "test".to_string(), 8);
+
+        // Four nested scopes fill the ring. The fifth one would leave no room for all leave events.
+        let mut recorded: Vec<bool> = Vec::new();
+        for i in 0..5 {
+            recorded.push(ring.enter("a", i));
+        }
+        crate::ensure_eq!(recorded, vec![true, true, true, true, false]);
+        crate::ensure_eq!(ring.num_dropped.load(Ordering::Relaxed), 1);
+        for (i, recorded) in recorded.iter().rev().enumerate() {
+            if *recorded {
+                ring.leave(10 + i as u64);
+            }
+        }
+
+        let mut depth: i64 = 0;
+        let mut num_events: usize = 0;
+        ring.drain(|event| {
+            depth += if event.name.is_some() { 1 } else { -1 };
+            num_events += 1;
+        });
+        crate::ensure_eq!(depth, 0);
+        crate::ensure_eq!(num_events, 8);
+
+        // Draining makes room again.
+        crate::ensure_eq!(ring.enter("b", 20), true);
+
+        Ok(())
+    }
+
+    /// Tests that an exporter rebuilds call stacks into folded stacks and Chrome trace events.
+    #[test]
+    fn test_export() -> Result<()> {
+        let ring: ThreadRing = ThreadRing::new(1, "test".to_string(), 16);
+        ring.enter("a", 100);
+        ring.enter("b", 110);
+        ring.leave(130);
+        ring.enter("b", 140);
+        ring.leave(150);
+        ring.leave(200);
+
+        let mut exporter: Exporter = Exporter::with_clock(1.0, 100);
+        exporter.drain_ring(&ring);
+
+        let mut folded: Vec<u8> = Vec::new();
+        exporter.write_folded(&mut folded)?;
+        crate::ensure_eq!(String::from_utf8(folded)?, "test;a 70\ntest;a;b 30\n");
+
+        let mut trace: Vec<u8> = Vec::new();
+        exporter.write_chrome_trace(&mut trace)?;
+        let trace: String = String::from_utf8(trace)?;
+        crate::ensure_eq!(trace.matches("\"ph\":\"X\"").count(), 3);
+        crate::ensure_eq!(
+            trace.contains("\"name\":\"b\",\"ph\":\"X\",\"ts\":0.010,\"dur\":0.020"),
+            true
+        );
+        crate::ensure_eq!(
+            trace.contains("\"name\":\"a\",\"ph\":\"X\",\"ts\":0.000,\"dur\":0.100"),
+            true
+        );
+
+        exporter.clear_chrome_trace();
+        let mut trace: Vec<u8> = Vec::new();
+        exporter.write_chrome_trace(&mut trace)?;
+        crate::ensure_eq!(String::from_utf8(trace)?.contains("\"ph\":\"X\""), false);
+
+        Ok(())
+    }
+}
@@ -0,0 +1,234 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Spin-then-block wait policy. Wait calls normally busy-poll the scheduler until they complete or time out. When a
+//! wait policy is installed, a wait call that has been spinning for longer than the spin time without completing
+//! anything hands the thread to an [IdleBlocker], which blocks in the I/O device until it may have work for us, the
+//! next timer is due or the wait times out, and then goes back to spinning.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::queue::QDesc;
+use ::std::{
+    cmp,
+    collections::HashMap,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Longest time that we block in one go. This bounds how late we notice work that does not come through the I/O
+/// device, such as a wait that is satisfied by another thread.
+const MAX_BLOCK_TIME: Duration = Duration::from_millis(100);
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Blocks the calling thread on the I/O device of a LibOS.
+pub trait IdleBlocker {
+    /// Blocks until the I/O device may have work for us or `timeout` expires, whichever comes first. Returning early
+    /// is always fine.
+    fn block(&mut self, timeout: Duration);
+}
+
+/// Statistics of how wait calls on a queue completed.
+#[derive(Clone, Copy, Debug, Default, Eq, PartialEq)]
+pub struct WaitStats {
+    /// Number of operations that completed while we were busy-polling.
+    pub num_spin_completions: u64,
+    /// Number of operations that completed after the wait call had blocked at least once.
+    pub num_block_completions: u64,
+}
+
+/// Spin-then-block wait policy.
+pub struct IdleWait {
+    /// Time that a wait call busy-polls before it blocks.
+    spin_time: Duration,
+    blocker: Box<dyn IdleBlocker>,
+    /// Number of times that wait calls blocked.
+    num_blocks: u64,
+}
+
+/// State of a wait call under a spin-then-block policy.
+pub struct WaitState {
+    /// When we last started to busy-poll.
+    spin_start: Instant,
+    /// Whether this wait call blocked at least once.
+    blocked: bool,
+}
+
+/// Per-queue wait statistics.
+#[derive(Default)]
+pub struct WaitStatsTable(HashMap<QDesc, WaitStats>);
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl IdleWait {
+    /// Creates a wait policy that busy-polls for `spin_time` and then blocks with `blocker`.
+    pub fn new(spin_time: Duration, blocker: Box<dyn IdleBlocker>) -> Self {
+        Self {
+            spin_time,
+            blocker,
+            num_blocks: 0,
+        }
+    }
+
+    /// Blocks if the wait call in `state` has been spinning for long enough. The thread is blocked for no longer than
+    /// `timeout`. Returns true if we blocked.
+    pub fn block_if_idle(&mut self, state: &mut WaitState, now: Instant, timeout: Duration) -> bool {
+        if now.saturating_duration_since(state.spin_start) < self.spin_time {
+            return false;
+        }
+        let timeout: Duration = cmp::min(timeout, MAX_BLOCK_TIME);
+        if timeout.is_zero() {
+            return false;
+        }
+        trace!("block_if_idle(): timeout={:?}", timeout);
+        self.blocker.block(timeout);
+        self.num_blocks += 1;
+        state.blocked = true;
+        true
+    }
+
+    /// Returns the number of times that wait calls blocked.
+    pub fn get_num_blocks(&self) -> u64 {
+        self.num_blocks
+    }
+}
+
+impl WaitState {
+    /// Starts a wait call at `now`.
+    pub fn new(now: Instant) -> Self {
+        Self {
+            spin_start: now,
+            blocked: false,
+        }
+    }
+
+    /// Goes back to busy-polling at `now`, after having blocked or run some tasks.
+    pub fn restart_spin(&mut self, now: Instant) {
+        self.spin_start = now;
+    }
+}
+
+impl WaitStatsTable {
+    /// Accounts for an operation on `qd` that completed during the wait call in `state`.
+    pub fn record(&mut self, qd: QDesc, state: &WaitState) {
+        let stats: &mut WaitStats = self.0.entry(qd).or_default();
+        if state.blocked {
+            stats.num_block_completions += 1;
+        } else {
+            stats.num_spin_completions += 1;
+        }
+    }
+
+    /// Returns the wait statistics of `qd`.
+    pub fn get(&self, qd: &QDesc) -> WaitStats {
+        self.0.get(qd).copied().unwrap_or_default()
+    }
+
+    /// Drops the wait statistics of `qd`, once the queue is gone.
+    pub fn remove(&mut self, qd: &QDesc) {
+        self.0.remove(qd);
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        IdleBlocker,
+        IdleWait,
+        WaitState,
+        WaitStats,
+        WaitStatsTable,
+        MAX_BLOCK_TIME,
+    };
+    use crate::runtime::QDesc;
+    use ::anyhow::Result;
+    use ::std::{
+        cell::RefCell,
+        rc::Rc,
+        time::{
+            Duration,
+            Instant,
+        },
+    };
+
+    /// Records the timeouts that it was asked to block for, instead of blocking.
+    struct RecordingBlocker(Rc<RefCell<Vec<Duration>>>);
+
+    impl IdleBlocker for RecordingBlocker {
+        fn block(&mut self, timeout: Duration) {
+            self.0.borrow_mut().push(timeout);
+        }
+    }
+
+    /// Checks that wait calls only block once they have been spinning for the spin time, and for no longer than the
+    /// longest block time.
+    #[test]
+    fn block_if_idle_spins_first() -> Result<()> {
+        let timeouts: Rc<RefCell<Vec<Duration>>> = Rc::new(RefCell::new(Vec::new()));
+        let spin_time: Duration = Duration::from_micros(50);
+        let mut idle_wait: IdleWait = IdleWait::new(spin_time, Box::new(RecordingBlocker(timeouts.clone())));
+        let start: Instant = Instant::now();
+        let mut state: WaitState = WaitState::new(start);
+
+        ::anyhow::ensure!(!idle_wait.block_if_idle(&mut state, start + spin_time / 2, Duration::from_secs(1)));
+        ::anyhow::ensure!(idle_wait.block_if_idle(&mut state, start + spin_time, Duration::from_secs(1)));
+        ::anyhow::ensure!(idle_wait.block_if_idle(&mut state, start + spin_time, Duration::from_millis(1)));
+        // A wait call that is about to time out should not block at all.
+        ::anyhow::ensure!(!idle_wait.block_if_idle(&mut state, start + spin_time, Duration::ZERO));
+        crate::ensure_eq!(*timeouts.borrow(), vec![MAX_BLOCK_TIME, Duration::from_millis(1)]);
+        crate::ensure_eq!(idle_wait.get_num_blocks(), 2);
+
+        // Spinning starts over after blocking.
+        state.restart_spin(start + spin_time);
+        ::anyhow::ensure!(!idle_wait.block_if_idle(&mut state, start + spin_time, Duration::from_secs(1)));
+
+        Ok(())
+    }
+
+    /// Checks that completions are accounted for by how the wait call ran.
+    #[test]
+    fn stats_record_spin_and_block_completions() -> Result<()> {
+        let mut table: WaitStatsTable = WaitStatsTable::default();
+        let mut idle_wait: IdleWait = IdleWait::new(
+            Duration::ZERO,
+            Box::new(RecordingBlocker(Rc::new(RefCell::new(Vec::new())))),
+        );
+        let qd: QDesc = QDesc::from(500);
+        let now: Instant = Instant::now();
+
+        table.record(qd, &WaitState::new(now));
+        let mut state: WaitState = WaitState::new(now);
+        ::anyhow::ensure!(idle_wait.block_if_idle(&mut state, now, Duration::from_millis(1)));
+        table.record(qd, &state);
+        table.record(qd, &state);
+        crate::ensure_eq!(
+            table.get(&qd),
+            WaitStats {
+                num_spin_completions: 1,
+                num_block_completions: 2,
+            }
+        );
+
+        table.remove(&qd);
+        crate::ensure_eq!(table.get(&qd), WaitStats::default());
+
+        Ok(())
+    }
+}
@@ -13,10 +13,11 @@
 // Note: if compiled without the "libdpdk" feature defined, the DPDK-specific functionality won't be present.
 
 // Note on buffer chain support:
-// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  While the
-// DemiBuffer routines for heap-allocated buffers also now support this functionality, it isn't yet exposed via the
-// DemiBuffer interface.
-// TODO: Expose buffer chain support once we have a solid use case.
+// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  The DemiBuffer
+// routines for heap-allocated buffers also support this functionality, which is exposed via append(), take_tail(),
+// advance() and segments(), so that multi-segment scatter-gather arrays can be handed down without copying them.  A
+// chain only holds buffers of one type.  Note that len() and the slice returned by deref() only cover the first
+// segment of a chain, while total_len() covers all of them.
 
 // Note on intrusive queueing:
 // Since all DemiBuffer types keep the metadata for each "view" in a separate allocated region, they can be queued
@@ -24,9 +25,11 @@
 // TODO: Expose calls to get/set a linking field.
 
 // Note on the allocation functions:
-// This code currently uses std::alloc() and std::dealloc() to allocate/free things from the heap.  Note that the Rust
-// documentation says that these functions are expected to be deprecated in favor of their respective methods of the
-// "Global" type when it and the "Allocator" trait become stable.
+// Heap-allocated DemiBuffers are carved out of blocks that each thread caches in a size-classed pool (BufferPool
+// below).  Freed blocks go back to the pool of the thread that frees them, and the pools only fall back to
+// std::alloc() and std::dealloc() when they run dry or fill up.  Note that the Rust documentation says that these
+// functions are expected to be deprecated in favor of their respective methods of the "Global" type when it and the
+// "Allocator" trait become stable.
 
 use crate::{
     pal::arch,
@@ -37,6 +40,7 @@ use ::dpdk_rs::{
     rte_mbuf,
     rte_mempool,
     rte_pktmbuf_adj,
+    rte_pktmbuf_chain,
     rte_pktmbuf_clone,
     rte_pktmbuf_free,
     rte_pktmbuf_trim,
@@ -48,6 +52,7 @@ use ::std::{
         handle_alloc_error,
         Layout,
     },
+    cell::RefCell,
     marker::PhantomData,
     mem::{
         self,
@@ -145,6 +150,67 @@ const _: () = assert!(std::mem::size_of::<MetaData>() == 2 * arch::CPU_DATA_CACH
 
 // MetaData "offload flags".  These exactly mimic those of DPDK MBufs.
 
+// Buffer Pool.
+// Data capacities of the size classes of the buffer pool.  Each block holds a MetaData struct, followed by up to this
+// many bytes of directly attached data.  Blocks of the zero class back clones (indirect buffers), the others back
+// buffers of at most their capacity, so a block wastes at most half of its data space.
+const POOL_CLASS_CAPACITIES: [usize; 12] = [
+    0,
+    64,
+    128,
+    256,
+    512,
+    1024,
+    2048,
+    4096,
+    8192,
+    16384,
+    32768,
+    u16::MAX as usize,
+];
+// Number of bytes that the pool of each thread caches, at most, in each size class.
+const POOL_BYTES_PER_CLASS: usize = 4 * 1024 * 1024;
+
+// Per-thread cache of free blocks, one list per size class.
+struct BufferPool {
+    free_lists: [Vec<NonNull<u8>>; POOL_CLASS_CAPACITIES.len()],
+}
+
+thread_local! {
+    static BUFFER_POOL: RefCell<BufferPool> = RefCell::new(BufferPool {
+        free_lists: Default::default(),
+    });
+}
+
+impl BufferPool {
+    // Returns the smallest size class that fits `capacity` bytes of directly attached data.
+    fn class_of(capacity: u16) -> usize {
+        POOL_CLASS_CAPACITIES.partition_point(|class_capacity| *class_capacity < capacity as usize)
+    }
+
+    // Returns the memory layout of the blocks in a size class.
+    fn layout_of(class: usize) -> Layout {
+        // Given our limited allocation amount (u16::MAX) and fixed alignment size, this unwrap cannot panic.
+        Layout::from_size_align(
+            size_of::<MetaData>() + POOL_CLASS_CAPACITIES[class],
+            arch::CPU_DATA_CACHE_LINE_SIZE,
+        )
+        .unwrap()
+    }
+}
+
+impl Drop for BufferPool {
+    fn drop(&mut self) {
+        for (class, free_list) in self.free_lists.iter_mut().enumerate() {
+            let layout: Layout = BufferPool::layout_of(class);
+            for block in free_list.drain(..) {
+                // Safety: this is safe because the block was allocated with the same allocator and Layout.
+                unsafe { dealloc(block.as_ptr(), layout) };
+            }
+        }
+    }
+}
+
 // Indicates this MetaData struct doesn't have the actual data directly attached, but rather this MetaData's buf_addr
 // points to another MetaData's directly attached data.
 const METADATA_F_INDIRECT: u64 = 1 << 62;
@@ -233,6 +299,12 @@ pub struct DemiBuffer {
     _phantom: PhantomData<MetaData>,
 }
 
+/// Iterator over the data of each segment in a `DemiBuffer` chain.
+pub struct Segments<'a> {
+    next: Option<NonNull<MetaData>>,
+    _phantom: PhantomData<&'a DemiBuffer>,
+}
+
 // Safety: Technically, DemiBuffer's aren't safe to Send between threads in their current implementation, as the
 // reference counting on the data region isn't performed using (expensive) atomic operations, for performance reasons.
 // This is okay in practice, as we currently run Demikernel single-threaded.  If this changes, the reference counting
@@ -353,6 +425,148 @@ impl DemiBuffer {
         self.as_metadata().data_len as usize
     }
 
+    /// Returns the number of bytes in front of the data of the first segment that no other `DemiBuffer` can see, so
+    /// that headers may be written there. A clone shares that memory with the buffer it points to (where it may hold
+    /// data that other clones still send), so this is zero for indirect buffers and for buffers that were cloned.
+    pub fn private_headroom(&self) -> usize {
+        // MetaData and MBuf are laid out the same, so this works for both types of buffers.
+        let metadata: &MetaData = self.as_metadata();
+        if metadata.ol_flags & METADATA_F_INDIRECT == 0 && metadata.refcnt == 1 {
+            metadata.data_off as usize
+        } else {
+            0
+        }
+    }
+
+    /// Returns the length of the data stored in all segments of the `DemiBuffer` chain.
+    pub fn total_len(&self) -> usize {
+        // MetaData and MBuf are laid out the same, so this works for both types of buffers.
+        self.as_metadata().pkt_len as usize
+    }
+
+    /// Returns the number of segments in the `DemiBuffer` chain.
+    pub fn num_segments(&self) -> usize {
+        // MetaData and MBuf are laid out the same, so this works for both types of buffers.
+        self.as_metadata().nb_segs as usize
+    }
+
+    /// Returns an iterator over the data of each segment in the `DemiBuffer` chain.
+    pub fn segments(&self) -> Segments<'_> {
+        Segments {
+            next: Some(self.get_ptr::<MetaData>()),
+            _phantom: PhantomData,
+        }
+    }
+
+    /// Attaches `tail` (which may itself be a chain) to the end of the `DemiBuffer` chain. Both buffers must be of
+    /// the same type. On failure, `tail` is released.
+    pub fn append(&mut self, tail: DemiBuffer) -> Result<(), Fail> {
+        self.try_append(tail).map_err(|(e, _)| e)
+    }
+
+    /// Attaches `tail` to the end of the `DemiBuffer` chain, like [Self::append]. On failure, `tail` is handed back
+    /// untouched, for callers that do not own its reference.
+    pub fn try_append(&mut self, tail: DemiBuffer) -> Result<(), (Fail, DemiBuffer)> {
+        if self.get_tag() != tail.get_tag() {
+            return Err((Fail::new(libc::EINVAL, "cannot chain buffers of different types"), tail));
+        }
+
+        match self.get_tag() {
+            Tag::Heap => {
+                let md_first: &mut MetaData = self.as_metadata();
+                let md_tail: &mut MetaData = tail.as_metadata();
+                md_first.nb_segs = match md_first.nb_segs.checked_add(md_tail.nb_segs) {
+                    Some(nb_segs) => nb_segs,
+                    None => return Err((Fail::new(libc::EOVERFLOW, "too many segments in buffer chain"), tail)),
+                };
+                md_first.pkt_len += md_tail.pkt_len;
+                md_first.get_last_segment().next = Some(tail.get_ptr::<MetaData>());
+            },
+            #[cfg(feature = "libdpdk")]
+            Tag::Dpdk => {
+                // Safety: rte_pktmbuf_chain is a FFI that is safe to call as both of its args are valid MBuf pointers.
+                if unsafe { rte_pktmbuf_chain(self.as_mbuf(), tail.as_mbuf()) } != 0 {
+                    return Err((Fail::new(libc::EOVERFLOW, "too many segments in buffer chain"), tail));
+                }
+            },
+        }
+
+        // The chain now holds the reference of `tail`.
+        mem::forget(tail);
+        Ok(())
+    }
+
+    /// Detaches all segments after the first one from the `DemiBuffer` chain, and returns them as a chain of their
+    /// own. Returns `None` if this is a single segment.
+    pub fn take_tail(&mut self) -> Option<DemiBuffer> {
+        // MetaData and MBuf are laid out the same, so this works for both types of buffers.
+        let md_first: &mut MetaData = self.as_metadata();
+        let mut next: NonNull<MetaData> = md_first.next.take()?;
+        {
+            // Safety: This is safe, as `next` is aligned, dereferenceable, and the MetaData struct it points to is
+            // initialized and not aliased in this block.
+            let md_next: &mut MetaData = unsafe { next.as_mut() };
+            md_next.nb_segs = md_first.nb_segs - 1;
+            md_next.pkt_len = md_first.pkt_len - md_first.data_len as u32;
+        }
+        md_first.nb_segs = 1;
+        md_first.pkt_len = md_first.data_len as u32;
+
+        // The tail is of the same type as the head.
+        let tag: usize = usize::from(self.tagged_ptr.addr()) & Tag::MASK;
+        Some(DemiBuffer {
+            tagged_ptr: next.with_addr(next.addr() | tag),
+            _phantom: PhantomData,
+        })
+    }
+
+    /// Removes `nbytes` bytes from the beginning of the `DemiBuffer` chain, across segments. Segments that are
+    /// entirely removed are released, except for the last one.
+    pub fn advance(&mut self, mut nbytes: usize) -> Result<(), Fail> {
+        while nbytes >= self.len() {
+            match self.take_tail() {
+                Some(tail) => {
+                    nbytes -= self.len();
+                    *self = tail;
+                },
+                None => break,
+            }
+        }
+        self.adjust(nbytes)
+    }
+
+    /// Keeps the first `len` bytes of the `DemiBuffer` chain, across segments. Segments past them are released, and the
+    /// segment in which they end is trimmed.
+    pub fn truncate(&mut self, len: usize) -> Result<(), Fail> {
+        if len > self.total_len() {
+            return Err(Fail::new(libc::EINVAL, "tried to keep more bytes than are present"));
+        }
+
+        let head_len: usize = self.len();
+        match self.take_tail() {
+            Some(mut tail) if len > head_len => {
+                tail.truncate(len - head_len)?;
+                self.append(tail)
+            },
+            // Dropping the tail releases it.
+            _ => self.trim(head_len - len),
+        }
+    }
+
+    /// Copies the data of all segments of the `DemiBuffer` chain into `dst`, which must be as long as the chain.
+    pub fn copy_to_slice(&self, dst: &mut [u8]) {
+        assert_eq!(
+            dst.len(),
+            self.total_len(),
+            "destination and buffer chain have different lengths"
+        );
+        let mut offset: usize = 0;
+        for segment in self.segments() {
+            dst[offset..(offset + segment.len())].copy_from_slice(segment);
+            offset += segment.len();
+        }
+    }
+
     /// Removes `nbytes` bytes from the beginning of the `DemiBuffer` chain.
     // Note: If `nbytes` is greater than the length of the first segment in the chain, then this function will fail and
     // return an error, rather than remove the remaining bytes from subsequent segments in the chain.  This is to match
@@ -541,6 +755,17 @@ impl DemiBuffer {
         }
     }
 
+    /// Hints the processor to start loading the first cache line of the buffer data (i.e. the headers of a received
+    /// packet) ahead of its use. This never faults, and it does nothing on targets without a prefetch instruction.
+    #[inline]
+    pub fn prefetch(&self) {
+        #[cfg(target_arch = "x86_64")]
+        // Safety: _mm_prefetch is safe to call with any address, as prefetches are only hints and never fault.
+        unsafe {
+            ::std::arch::x86_64::_mm_prefetch::<{ ::std::arch::x86_64::_MM_HINT_T0 }>(self.as_ptr() as *const i8)
+        };
+    }
+
     /// Consumes the `DemiBuffer`, returning a raw token (useful for FFI) that can be used with `from_raw()`.
     // Note the type of the token is arbitrary, it should be treated as an opaque value.
     pub fn into_raw(self) -> NonNull<u8> {
@@ -652,17 +877,25 @@ impl DemiBuffer {
 
 // Allocates the MetaData (plus the space for any directly attached data) for a new heap-allocated DemiBuffer.
 fn allocate_metadata_data(direct_data_size: u16) -> NonNull<MetaData> {
-    // We need space for the MetaData struct, plus any extra memory for directly attached data.
-    let amount: usize = size_of::<MetaData>() + direct_data_size as usize;
-
-    // Given our limited allocation amount (u16::MAX) and fixed alignment size, this unwrap cannot panic.
-    let layout: Layout = Layout::from_size_align(amount, arch::CPU_DATA_CACHE_LINE_SIZE).unwrap();
-
-    // Safety: This is safe, as we check for a null return value before dereferencing "allocation".
-    let allocation: *mut u8 = unsafe { alloc(layout) };
-    if allocation.is_null() {
-        handle_alloc_error(layout);
-    }
+    // We need space for the MetaData struct, plus any extra memory for directly attached data.  Reuse a free block of
+    // the matching size class if this thread has one.  The pool is gone if this thread is already exiting.
+    let class: usize = BufferPool::class_of(direct_data_size);
+    let cached: Option<NonNull<u8>> = BUFFER_POOL
+        .try_with(|pool| pool.borrow_mut().free_lists[class].pop())
+        .unwrap_or(None);
+
+    let allocation: *mut u8 = match cached {
+        Some(block) => block.as_ptr(),
+        None => {
+            let layout: Layout = BufferPool::layout_of(class);
+            // Safety: This is safe, as we check for a null return value before dereferencing "allocation".
+            let allocation: *mut u8 = unsafe { alloc(layout) };
+            if allocation.is_null() {
+                handle_alloc_error(layout);
+            }
+            allocation
+        },
+    };
 
     let metadata: *mut MetaData = allocation.cast::<MetaData>();
 
@@ -691,18 +924,32 @@ fn free_metadata_data(buffer: NonNull<MetaData>) {
     // Check in debug builds that we weren't accidentally passed a DPDK-allocated MBuf to free.
     debug_assert_eq!(metadata._pool, 0);
 
-    // Determine the size of the original allocation.
+    // Determine the size class of the original allocation.
     // Note that this code currently assumes we're not using a "private data" feature akin to DPDK's.
     debug_assert_eq!(metadata._priv_size, 0);
-    let amount: usize = size_of::<MetaData>() + metadata.buf_len as usize;
-    // This unwrap will never panic, as we pass a known allocation amount and a fixed alignment to from_size_align().
-    let layout: Layout = Layout::from_size_align(amount, arch::CPU_DATA_CACHE_LINE_SIZE).unwrap();
+    let class: usize = BufferPool::class_of(metadata.buf_len);
 
     // Convert buffer pointer into a raw allocation pointer.
-    let allocation: *mut u8 = buffer.cast::<u8>().as_ptr();
+    let allocation: NonNull<u8> = buffer.cast::<u8>();
+
+    // Hand the block back to the pool of this thread, unless the pool is full (or gone, if this thread is exiting).
+    let max_cached: usize = POOL_BYTES_PER_CLASS / BufferPool::layout_of(class).size();
+    let cached: bool = BUFFER_POOL
+        .try_with(|pool| {
+            let free_list: &mut Vec<NonNull<u8>> = &mut pool.borrow_mut().free_lists[class];
+            if free_list.len() < max_cached {
+                free_list.push(allocation);
+                true
+            } else {
+                false
+            }
+        })
+        .unwrap_or(false);
 
-    // Safety: this is safe because we're using the same (de)allocator and Layout used for allocation.
-    unsafe { dealloc(allocation, layout) };
+    if !cached {
+        // Safety: this is safe because we're using the same (de)allocator and Layout used for allocation.
+        unsafe { dealloc(allocation.as_ptr(), BufferPool::layout_of(class)) };
+    }
 }
 
 // ---------------------
@@ -935,6 +1182,30 @@ impl Drop for DemiBuffer {
     }
 }
 
+/// Iterator Trait Implementation for `Segments`.
+impl<'a> Iterator for Segments<'a> {
+    type Item = &'a [u8];
+
+    fn next(&mut self) -> Option<Self::Item> {
+        // Safety: This is safe, as the pointer is aligned and dereferenceable, and the MetaData struct it points to is
+        // initialized and kept alive by the DemiBuffer that this iterator borrows.  MetaData and MBuf are laid out the
+        // same, so this works for both types of buffers.
+        let metadata: &MetaData = unsafe { self.next?.as_ref() };
+        self.next = metadata.next;
+        if metadata.data_len == 0 {
+            return Some(&[]);
+        }
+        // Safety: The data of the segment is a valid readable memory region of `data_len` bytes that starts at
+        // `data_off` bytes into `buf_addr`.
+        Some(unsafe {
+            slice::from_raw_parts(
+                metadata.buf_addr.offset(metadata.data_off as isize),
+                metadata.data_len as usize,
+            )
+        })
+    }
+}
+
 /// TryFrom Trait Implementation for `DemiBuffer`.
 impl TryFrom<&[u8]> for DemiBuffer {
     type Error = Fail;
@@ -1024,6 +1295,33 @@ mod tests {
         Ok(())
     }
 
+    // Test that freed buffers are recycled by the buffer pool, across capacities of the same size class.
+    #[test]
+    fn pooled() -> Result<()> {
+        let buf: DemiBuffer = DemiBuffer::new(8000);
+        let address: *const u8 = buf.as_ptr();
+        drop(buf);
+
+        // A buffer of the same size class reuses the block, and still has the length that was asked for.
+        let buf: DemiBuffer = DemiBuffer::new(8192);
+        crate::ensure_eq!(buf.as_ptr(), address);
+        crate::ensure_eq!(buf.len(), 8192);
+
+        // A buffer of another size class does not.
+        let other: DemiBuffer = DemiBuffer::new(100);
+        crate::ensure_neq!(other.as_ptr(), address);
+
+        // Clones come from (and go back to) their own size class.
+        let clone: DemiBuffer = buf.clone();
+        drop(buf);
+        crate::ensure_eq!(clone.len(), 8192);
+        drop(clone);
+        let buf: DemiBuffer = DemiBuffer::new(8192);
+        crate::ensure_eq!(buf.as_ptr(), address);
+
+        Ok(())
+    }
+
     // Test cloning, raw conversion, and zero-size buffers.
     #[test]
     fn advanced() -> Result<()> {
@@ -1167,4 +1465,108 @@ mod tests {
 
         Ok(())
     }
+
+    // Test chaining buffers, and walking, cloning and taking apart chains.
+    #[test]
+    fn chain() -> Result<()> {
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(b"header")?;
+        buf.append(DemiBuffer::from_slice(b"metadata")?)?;
+        buf.append(DemiBuffer::from_slice(b"payload")?)?;
+        crate::ensure_eq!(buf.len(), 6);
+        crate::ensure_eq!(buf.total_len(), 21);
+        crate::ensure_eq!(buf.num_segments(), 3);
+        let segments: Vec<&[u8]> = buf.segments().collect();
+        crate::ensure_eq!(segments, vec![&b"header"[..], &b"metadata"[..], &b"payload"[..]]);
+
+        // Clones are chains too, and outlive the original.
+        let clone: DemiBuffer = buf.clone();
+        drop(buf);
+        crate::ensure_eq!(clone.num_segments(), 3);
+        crate::ensure_eq!(
+            clone.segments().collect::<Vec<&[u8]>>().concat(),
+            b"headermetadatapayload".to_vec()
+        );
+
+        // Take the chain apart.
+        let mut head: DemiBuffer = clone;
+        let mut tail: DemiBuffer = match head.take_tail() {
+            Some(tail) => tail,
+            None => anyhow::bail!("chain should have a tail"),
+        };
+        crate::ensure_eq!(head.num_segments(), 1);
+        crate::ensure_eq!(head.total_len(), 6);
+        crate::ensure_eq!(tail.num_segments(), 2);
+        crate::ensure_eq!(tail.total_len(), 15);
+        crate::ensure_eq!(&tail[..], b"metadata");
+        crate::ensure_eq!(head.take_tail().is_none(), true);
+
+        // Advance across segments.
+        tail.advance(10)?;
+        crate::ensure_eq!(tail.num_segments(), 1);
+        crate::ensure_eq!(&tail[..], b"yload");
+        tail.advance(5)?;
+        crate::ensure_eq!(tail.total_len(), 0);
+        crate::ensure_eq!(tail.advance(1).is_err(), true);
+
+        Ok(())
+    }
+
+    // Test that only buffers that hold the sole reference to their data have private headroom.
+    #[test]
+    fn private_headroom() -> Result<()> {
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(b"headerpayload")?;
+        crate::ensure_eq!(buf.private_headroom(), 0);
+        buf.adjust(6)?;
+        crate::ensure_eq!(buf.private_headroom(), 6);
+
+        // Neither the original nor the clone may write in front of the data while both are alive.
+        let mut clone: DemiBuffer = buf.clone();
+        crate::ensure_eq!(buf.private_headroom(), 0);
+        crate::ensure_eq!(clone.private_headroom(), 0);
+        // In the clone, the bytes in front of its data are data of the original.
+        clone.adjust(4)?;
+        crate::ensure_eq!(clone.private_headroom(), 0);
+
+        drop(clone);
+        crate::ensure_eq!(buf.private_headroom(), 6);
+
+        Ok(())
+    }
+
+    // Test cutting chains short, and gathering their data.
+    #[test]
+    fn truncate_chain() -> Result<()> {
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(b"header")?;
+        buf.append(DemiBuffer::from_slice(b"metadata")?)?;
+        buf.append(DemiBuffer::from_slice(b"payload")?)?;
+
+        let mut gathered: Vec<u8> = vec![0; buf.total_len()];
+        buf.copy_to_slice(&mut gathered);
+        crate::ensure_eq!(gathered, b"headermetadatapayload".to_vec());
+
+        // Cut within the second segment: the third one is released.
+        let mut prefix: DemiBuffer = buf.clone();
+        prefix.truncate(10)?;
+        crate::ensure_eq!(prefix.num_segments(), 2);
+        crate::ensure_eq!(
+            prefix.segments().collect::<Vec<&[u8]>>().concat(),
+            b"headermeta".to_vec()
+        );
+
+        // Cut within the first segment, and at the end of the chain.
+        prefix.truncate(4)?;
+        crate::ensure_eq!(prefix.num_segments(), 1);
+        crate::ensure_eq!(&prefix[..], b"head");
+        crate::ensure_eq!(buf.truncate(buf.total_len() + 1).is_err(), true);
+        buf.truncate(buf.total_len())?;
+        crate::ensure_eq!(buf.num_segments(), 3);
+
+        // The original chain is untouched by cutting its clone.
+        crate::ensure_eq!(
+            buf.segments().collect::<Vec<&[u8]>>().concat(),
+            b"headermetadatapayload".to_vec()
+        );
+
+        Ok(())
+    }
 }
@@ -9,9 +9,11 @@ mod demibuffer;
 
 use crate::runtime::{
     fail::Fail,
+    limits,
     types::{
         demi_sgarray_t,
         demi_sgaseg_t,
+        DEMI_SGARRAY_MAXLEN,
     },
 };
 use ::libc::c_void;
@@ -36,71 +38,40 @@ pub use self::demibuffer::*;
 /// memory from the heap (shared with the application since Demikernel runs as a library) and creates
 /// a Demibuffer from that allocation. Other libOSes may override these functions to allocate memory
 /// specific kernel-bypass memory (e.g., DPDK mbufs or registered RDMA memory).
+///
+/// The `sga_buf` field of a scatter-gather array holds the token of a [DemiBuffer] chain that has one segment for
+/// each segment of the scatter-gather array.
 pub trait MemoryRuntime {
     /// Converts a buffer into a scatter-gather array.
     fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        into_sgarray(buf)
     }
 
-    /// Allocates a scatter-gather array.
+    /// Allocates a scatter-gather array. Sizes that do not fit in a single buffer get one segment per
+    /// `u16::MAX` bytes.
     fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
+        const SEGMENT_SIZE: usize = u16::MAX as usize;
+        if size > DEMI_SGARRAY_MAXLEN * SEGMENT_SIZE {
+            return Err(Fail::new(libc::EINVAL, "size too large for a demi_sgarray_t"));
         }
 
-        // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer = DemiBuffer::new(size as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
+        // First allocate the underlying DemiBuffer chain.
+        let mut buf: DemiBuffer = DemiBuffer::new(size.min(SEGMENT_SIZE) as u16);
+        let mut remaining: usize = size - buf.len();
+        while remaining > 0 {
+            let segment: DemiBuffer = DemiBuffer::new(remaining.min(SEGMENT_SIZE) as u16);
+            remaining -= segment.len();
+            buf.append(segment)?;
+        }
 
         // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        into_sgarray(buf)
     }
 
     /// Releases a scatter-gather array.
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
-
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
-        }
-
         // Convert back to a DemiBuffer and drop it.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
+        let buf: DemiBuffer = unsafe { take_sgarray_buffer(&sga)? };
         drop(buf);
 
         Ok(())
@@ -108,60 +79,385 @@ pub trait MemoryRuntime {
 
     /// Clones a scatter-gather array.
     fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
+        clone_sgarray(sga)
+    }
+
+    /// Appends the segments of `tail` to `sga`, which takes over the buffers of `tail`. On failure, both
+    /// scatter-gather arrays are left untouched.
+    fn sgaappend(&self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        append_sgarray(sga, tail)
+    }
+}
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Creates a scatter-gather array that exposes each segment of `buf`, and inherits its reference.
+pub fn into_sgarray(buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
+    let num_segments: usize = buf.num_segments();
+    if num_segments > DEMI_SGARRAY_MAXLEN {
+        return Err(Fail::new(
+            libc::EINVAL,
+            "buffer has too many segments for a demi_sgarray_t",
+        ));
+    }
+
+    // Safety: A scatter-gather array is a plain C structure, for which zero is a valid value.
+    let mut sga: demi_sgarray_t = unsafe { mem::zeroed() };
+    for (i, segment) in buf.segments().enumerate() {
+        sga.sga_segs[i] = demi_sgaseg_t {
+            sgaseg_buf: segment.as_ptr() as *mut c_void,
+            sgaseg_len: segment.len() as u32,
+        };
+    }
+    sga.sga_numsegs = num_segments as u32;
+    sga.sga_buf = buf.into_raw().as_ptr() as *mut c_void;
+    Ok(sga)
+}
+
+/// Clones the buffers of a scatter-gather array into a [DemiBuffer] chain, which only covers the data that the
+/// segments of the scatter-gather array describe now.
+pub fn clone_sgarray(sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+    // Convert back to a DemiBuffer.
+    let buf: DemiBuffer = unsafe { take_sgarray_buffer(sga)? };
+    let clone: DemiBuffer = buf.clone();
+
+    // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
+    mem::forget(buf);
+
+    let num_segments: usize = sga.sga_numsegs as usize;
+    if clone.num_segments() != num_segments {
+        return Err(Fail::new(
+            libc::EINVAL,
+            "demi_sgarray_t segment count does not match its backing buffers",
+        ));
+    }
+
+    // Fast path for single buffers.
+    if num_segments == 1 {
+        let mut clone: DemiBuffer = clone;
+        trim_to_segment(&mut clone, &sga.sga_segs[0])?;
+        return Ok(clone);
+    }
 
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    // Take the chain apart, fit each buffer to its segment, and put the chain back together.
+    let mut head: Option<DemiBuffer> = None;
+    let mut pending: Option<DemiBuffer> = Some(clone);
+    for i in 0..num_segments {
+        let mut segment: DemiBuffer = pending.take().expect("chain should have as many buffers as segments");
+        pending = segment.take_tail();
+        trim_to_segment(&mut segment, &sga.sga_segs[i])?;
+        match head.as_mut() {
+            Some(head) => head.append(segment)?,
+            None => head = Some(segment),
         }
+    }
+
+    Ok(head.expect("scatter-gather array should have at least one segment"))
+}
 
-        // Convert back to a DemiBuffer.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        let mut clone: DemiBuffer = buf.clone();
+/// Moves the buffers and segments of `tail` to the end of `sga`. On failure, both scatter-gather arrays are left
+/// untouched.
+pub fn append_sgarray(sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+    let num_segments: usize = sga.sga_numsegs as usize;
+    let num_tail_segments: usize = tail.sga_numsegs as usize;
+    let mut buf: DemiBuffer = unsafe { take_sgarray_buffer(sga)? };
+    let tail_buf: DemiBuffer = match unsafe { take_sgarray_buffer(&tail) } {
+        Ok(tail_buf) => tail_buf,
+        Err(e) => {
+            mem::forget(buf);
+            return Err(e);
+        },
+    };
 
-        // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
+    // Check arguments before touching any of the chains.
+    let cause: Option<&str> = if num_segments + num_tail_segments > DEMI_SGARRAY_MAXLEN {
+        Some("too many segments for a demi_sgarray_t")
+    } else if buf.num_segments() != num_segments || tail_buf.num_segments() != num_tail_segments {
+        Some("demi_sgarray_t segment count does not match its backing buffers")
+    } else if buf.is_heap_allocated() != tail_buf.is_heap_allocated() {
+        Some("demi_sgarray_t buffers come from different memory pools")
+    } else {
+        None
+    };
+    if let Some(cause) = cause {
+        // The scatter-gather arrays keep their references.
         mem::forget(buf);
+        mem::forget(tail_buf);
+        return Err(Fail::new(libc::EINVAL, cause));
+    }
 
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the DemiBuffer's allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
-            }
+    if let Err((e, tail_buf)) = buf.try_append(tail_buf) {
+        mem::forget(buf);
+        mem::forget(tail_buf);
+        return Err(e);
+    }
+    for i in 0..num_tail_segments {
+        sga.sga_segs[num_segments + i] = tail.sga_segs[i];
+    }
+    sga.sga_numsegs = (num_segments + num_tail_segments) as u32;
+    sga.sga_buf = buf.into_raw().as_ptr() as *mut c_void;
+    Ok(())
+}
+
+/// Replaces the buffers of a scatter-gather array with buffers from `alloc` that hold a copy of their data. Segments
+/// keep their offsets and lengths in the new buffers. On failure, the scatter-gather array is left untouched.
+pub fn copy_sgarray(
+    sga: &mut demi_sgarray_t,
+    alloc: impl FnMut(usize) -> Result<DemiBuffer, Fail>,
+) -> Result<(), Fail> {
+    let buf: DemiBuffer = unsafe { take_sgarray_buffer(sga)? };
+    let mut sga_segs: [demi_sgaseg_t; DEMI_SGARRAY_MAXLEN] = sga.sga_segs;
+    let result: Result<DemiBuffer, Fail> = copy_segments(&buf, &mut sga_segs, alloc);
+    // The scatter-gather array keeps its reference on failure, and releases it to the old buffers on success.
+    let chain: DemiBuffer = match result {
+        Ok(chain) => {
+            drop(buf);
+            chain
+        },
+        Err(e) => {
+            mem::forget(buf);
+            return Err(e);
+        },
+    };
+    sga.sga_buf = chain.into_raw().as_ptr() as *mut c_void;
+    sga.sga_segs = sga_segs;
+    Ok(())
+}
 
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
+/// Fits a buffer cloned from a scatter-gather array to receive the data of a pop. Pops place data in a single segment,
+/// and receive at most [limits::POP_SIZE_MAX] bytes.
+pub fn into_pop_target(mut buf: DemiBuffer) -> Result<DemiBuffer, Fail> {
+    if buf.num_segments() != 1 {
+        return Err(Fail::new(
+            libc::EINVAL,
+            "cannot pop into a demi_sgarray_t with multiple segments",
+        ));
+    }
+
+    if buf.len() == 0 {
+        return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
+    }
 
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
+    if buf.len() > limits::POP_SIZE_MAX {
+        let trim_amount: usize = buf.len() - limits::POP_SIZE_MAX;
+        buf.trim(trim_amount)?;
+    }
+
+    Ok(buf)
+}
 
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
+/// Converts the token of a scatter-gather array back to a [DemiBuffer], after checking that the scatter-gather array
+/// is well formed.
+///
+/// # Safety
+///
+/// The returned buffer holds the reference of the scatter-gather array, so the caller must either drop it to release
+/// the scatter-gather array, or forget it.
+pub unsafe fn take_sgarray_buffer(sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+    // Check arguments.
+    if sga.sga_numsegs == 0 || sga.sga_numsegs as usize > DEMI_SGARRAY_MAXLEN {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+    }
+
+    if sga.sga_buf == ptr::null_mut() {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    }
+
+    // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
+    let token: NonNull<u8> = NonNull::new_unchecked(sga.sga_buf as *mut u8);
+    // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
+    // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
+    Ok(DemiBuffer::from_raw(token))
+}
+
+/// Copies each segment of `buf` to a buffer from `alloc`, and points `sga_segs` at the copies. Returns the copies as a
+/// chain. On failure, dropping the partial chain releases the copies made so far.
+fn copy_segments(
+    buf: &DemiBuffer,
+    sga_segs: &mut [demi_sgaseg_t; DEMI_SGARRAY_MAXLEN],
+    mut alloc: impl FnMut(usize) -> Result<DemiBuffer, Fail>,
+) -> Result<DemiBuffer, Fail> {
+    let mut chain: Option<DemiBuffer> = None;
+    for (i, segment) in buf.segments().enumerate() {
+        let mut copy: DemiBuffer = alloc(segment.len())?;
+        copy.copy_from_slice(segment);
+        let offset: usize = (sga_segs[i].sgaseg_buf as *const u8)
+            .addr()
+            .wrapping_sub(segment.as_ptr().addr());
+        sga_segs[i].sgaseg_buf = copy.as_ptr().wrapping_add(offset) as *mut c_void;
+        match chain.as_mut() {
+            Some(chain) => chain.append(copy)?,
+            None => chain = Some(copy),
         }
+    }
+    Ok(chain.expect("scatter-gather array should have at least one segment"))
+}
+
+/// Fits a single buffer to the data described by a scatter-gather array segment.
+fn trim_to_segment(buf: &mut DemiBuffer, sga_seg: &demi_sgaseg_t) -> Result<(), Fail> {
+    // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
+    // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
+    // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
+    let sga_data: *const u8 = sga_seg.sgaseg_buf as *const u8;
+    let sga_len: usize = sga_seg.sgaseg_len as usize;
+    let buf_data: *const u8 = buf.as_ptr();
+    let mut buf_len: usize = buf.len();
+    if sga_data != buf_data || sga_len != buf_len {
+        // We need to adjust the DemiBuffer to match the user's changes.
+
+        // First check that the user didn't do something non-sensical, like change the buffer description to
+        // reference address space outside of the DemiBuffer's allocated memory area.
+        if sga_data < buf_data || sga_data.addr() + sga_len > buf_data.addr() + buf_len {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "demi_sgarray_t describes data outside backing buffer's allocated region",
+            ));
+        }
+
+        // Calculate the amount the new starting address is ahead of the old.  And then adjust `buf` to match.
+        let adjustment_amount: usize = sga_data.addr() - buf_data.addr();
+        buf.adjust(adjustment_amount)?;
 
-        // Return the clone.
-        Ok(clone)
+        // An adjustment above would have reduced buf.len() by the adjustment amount.
+        buf_len -= adjustment_amount;
+        debug_assert_eq!(buf_len, buf.len());
+
+        // Trim the buffer down to size.
+        let trim_amount: usize = buf_len - sga_len;
+        buf.trim(trim_amount)?;
+    }
+
+    Ok(())
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ::anyhow::Result;
+
+    /// Memory runtime with the default implementation.
+    struct HeapRuntime;
+
+    impl MemoryRuntime for HeapRuntime {}
+
+    /// Fills segment `i` of a scatter-gather array with `data`, and trims the segment down to it.
+    fn fill_segment(sga: &mut demi_sgarray_t, i: usize, data: &[u8]) {
+        let seg: demi_sgaseg_t = sga.sga_segs[i];
+        // Safety: The segment describes at least `data.len()` writable bytes.
+        let slice: &mut [u8] = unsafe { ::std::slice::from_raw_parts_mut(seg.sgaseg_buf as *mut u8, data.len()) };
+        slice.copy_from_slice(data);
+        sga.sga_segs[i].sgaseg_len = data.len() as u32;
+    }
+
+    /// Tests that scatter-gather arrays that do not fit in a single buffer get one segment per buffer.
+    #[test]
+    fn test_sgaalloc_multiple_segments() -> Result<()> {
+        let runtime: HeapRuntime = HeapRuntime;
+
+        let sga: demi_sgarray_t = runtime.sgaalloc(3 * u16::MAX as usize + 10)?;
+        crate::ensure_eq!({ sga.sga_numsegs }, 4);
+        crate::ensure_eq!({ sga.sga_segs[3].sgaseg_len }, 10);
+        let buf: DemiBuffer = runtime.clone_sgarray(&sga)?;
+        crate::ensure_eq!(buf.total_len(), 3 * u16::MAX as usize + 10);
+        runtime.sgafree(sga)?;
+
+        crate::ensure_eq!(
+            runtime.sgaalloc(DEMI_SGARRAY_MAXLEN * u16::MAX as usize + 1).is_err(),
+            true
+        );
+        Ok(())
+    }
+
+    /// Tests that appended scatter-gather arrays are cloned into a single chain, without copying them.
+    #[test]
+    fn test_sgaappend_clone() -> Result<()> {
+        let runtime: HeapRuntime = HeapRuntime;
+
+        let mut sga: demi_sgarray_t = runtime.sgaalloc(64)?;
+        fill_segment(&mut sga, 0, b"header");
+        let mut payload: demi_sgarray_t = runtime.sgaalloc(64)?;
+        fill_segment(&mut payload, 0, b"payload");
+        let payload_data: *mut c_void = payload.sga_segs[0].sgaseg_buf;
+        runtime.sgaappend(&mut sga, payload)?;
+        crate::ensure_eq!({ sga.sga_numsegs }, 2);
+
+        let buf: DemiBuffer = runtime.clone_sgarray(&sga)?;
+        crate::ensure_eq!(buf.num_segments(), 2);
+        crate::ensure_eq!(
+            buf.segments().collect::<Vec<&[u8]>>().concat(),
+            b"headerpayload".to_vec()
+        );
+        crate::ensure_eq!(
+            buf.segments().nth(1).map(|s| s.as_ptr() as *mut c_void),
+            Some(payload_data)
+        );
+
+        // The clone outlives the scatter-gather array.
+        runtime.sgafree(sga)?;
+        crate::ensure_eq!(
+            buf.segments().collect::<Vec<&[u8]>>().concat(),
+            b"headerpayload".to_vec()
+        );
+        Ok(())
+    }
+
+    /// Tests that appending fails without side effects when the result would have too many segments.
+    #[test]
+    fn test_sgaappend_too_many_segments() -> Result<()> {
+        let runtime: HeapRuntime = HeapRuntime;
+
+        let mut sga: demi_sgarray_t = runtime.sgaalloc((DEMI_SGARRAY_MAXLEN - 1) * u16::MAX as usize + 1)?;
+        crate::ensure_eq!({ sga.sga_numsegs } as usize, DEMI_SGARRAY_MAXLEN);
+        let tail: demi_sgarray_t = runtime.sgaalloc(1)?;
+        crate::ensure_eq!(runtime.sgaappend(&mut sga, tail).is_err(), true);
+        crate::ensure_eq!({ sga.sga_numsegs } as usize, DEMI_SGARRAY_MAXLEN);
+
+        runtime.sgafree(tail)?;
+        runtime.sgafree(sga)?;
+        Ok(())
+    }
+
+    /// Tests that copying a scatter-gather array leaves it untouched when its copies cannot be chained.
+    #[test]
+    fn test_copy_sgarray_append_failure() -> Result<()> {
+        let runtime: HeapRuntime = HeapRuntime;
+
+        let mut sga: demi_sgarray_t = runtime.sgaalloc(u16::MAX as usize + 1)?;
+        fill_segment(&mut sga, 1, b"x");
+        let before: demi_sgarray_t = sga;
+
+        // The copy of the second segment comes with so many empty segments that it cannot be chained to the first.
+        let mut copies: usize = 0;
+        let result: Result<(), Fail> = copy_sgarray(&mut sga, |len| {
+            copies += 1;
+            let mut copy: DemiBuffer = DemiBuffer::new(len as u16);
+            if copies == 2 {
+                let mut filler: DemiBuffer = DemiBuffer::new(0);
+                for _ in 2..u16::MAX {
+                    let mut segment: DemiBuffer = DemiBuffer::new(0);
+                    segment.append(filler)?;
+                    filler = segment;
+                }
+                copy.append(filler)?;
+            }
+            Ok(copy)
+        });
+        crate::ensure_eq!(result.map_err(|e| e.errno), Err(libc::EOVERFLOW));
+        crate::ensure_eq!(copies, 2);
+
+        // The scatter-gather array still owns its buffers.
+        crate::ensure_eq!({ sga.sga_buf }, { before.sga_buf });
+        crate::ensure_eq!({ sga.sga_segs[1].sgaseg_buf }, { before.sga_segs[1].sgaseg_buf });
+        let buf: DemiBuffer = runtime.clone_sgarray(&sga)?;
+        crate::ensure_eq!(buf.segments().nth(1), Some(&b"x"[..]));
+        drop(buf);
+        runtime.sgafree(sga)?;
+        Ok(())
     }
 }
@@ -13,10 +13,18 @@ pub mod memory;
 pub mod network;
 pub mod queue;
 pub mod scheduler;
+pub mod stats;
 pub mod types;
 pub use condition_variable::SharedConditionVariable;
+mod idle;
 mod poll;
 mod timer;
+mod wait_group;
+pub use idle::{
+    IdleBlocker,
+    IdleWait,
+    WaitStats,
+};
 pub use queue::{
     BackgroundTask,
     Operation,
@@ -39,6 +47,10 @@ use crate::{
     pal::data_structures::SockAddr,
     runtime::{
         fail::Fail,
+        idle::{
+            WaitState,
+            WaitStatsTable,
+        },
         memory::MemoryRuntime,
         network::{
             ephemeral::EphemeralPorts,
@@ -52,7 +64,14 @@ use crate::{
         },
         scheduler::{
             SharedScheduler,
+            Task,
+            TaskPriority,
             TaskWithResult,
+            ROOT_GROUP_ID,
+        },
+        stats::{
+            with_stats,
+            ThreadStats,
         },
         timer::SharedTimer,
         types::{
@@ -60,7 +79,10 @@ use crate::{
             demi_opcode_t,
             demi_qr_value_t,
             demi_qresult_t,
+            demi_qstats_t,
+            demi_stats_t,
         },
+        wait_group::WaitGroupTable,
     },
 };
 use ::futures::{
@@ -110,6 +132,9 @@ thread_local! {
 /// Each Demikernel thread has its own instance of the scheduler stored in a thread local variable for access from
 /// different coroutines. It is important to note that this is NEVER accessed directly from outside of the runtime.
 static THREAD_SCHEDULER: SharedScheduler = SharedScheduler::default();
+/// Background coroutines run in their own low-priority task group, so they do not delay I/O coroutines.
+static THREAD_BACKGROUND_GROUP: TaskId =
+    THREAD_SCHEDULER.with(|s| s.clone().create_group_with_priority(TaskPriority::Low));
 /// This is our shared sense of time. It is explicitly moved forward ONLY by the runtime and used to trigger time outs.
 static THREAD_TIME: SharedTimer = SharedTimer::default();
 }
@@ -118,6 +143,7 @@ static THREAD_TIME: SharedTimer = SharedTimer::default();
 // Constants
 //======================================================================================================================
 
+/// Number of iterations of the poll loop between two reads of the clock.
 const TIMER_RESOLUTION: usize = 64;
 
 //======================================================================================================================
@@ -136,6 +162,17 @@ pub struct DemiRuntime {
     ts_iters: usize,
     /// Tasks that have been completed and removed from the
     completed_tasks: HashMap<QToken, (QDesc, OperationResult)>,
+    /// Wait groups, which collect the results of the tasks that were registered in them.
+    wait_groups: WaitGroupTable,
+    /// Buffer for tasks that complete while polling, which is reused across polls.
+    polled_tasks: Vec<Box<dyn Task>>,
+    /// Policy for blocking wait calls that have nothing to do. Wait calls busy-poll if there is none.
+    idle_wait: Option<IdleWait>,
+    /// Hands off to the network device the packets that were queued for transmission. It runs at the end of every
+    /// scheduler quantum.
+    transmit_flush: Option<Box<dyn FnMut()>>,
+    /// How the operations on each queue completed in wait calls.
+    wait_stats: WaitStatsTable,
 }
 
 #[derive(Clone)]
@@ -174,12 +211,17 @@ impl SharedDemiRuntime {
             network_table: NetworkQueueTable::default(),
             ts_iters: 0,
             completed_tasks: HashMap::<QToken, (QDesc, OperationResult)>::new(),
+            wait_groups: WaitGroupTable::default(),
+            polled_tasks: Vec::<Box<dyn Task>>::new(),
+            idle_wait: None,
+            transmit_flush: None,
+            wait_stats: WaitStatsTable::default(),
         }))
     }
 
     /// Inserts the `coroutine` named `task_name` into the scheduler.
     pub fn insert_io_coroutine(&mut self, task_name: &str, coroutine: Pin<Box<Operation>>) -> Result<QToken, Fail> {
-        self.insert_coroutine(task_name, coroutine)
+        self.insert_coroutine_with_group_id(ROOT_GROUP_ID, task_name, coroutine)
     }
 
     /// Inserts the background `coroutine` named `task_name` into the scheduler
@@ -188,7 +230,8 @@ impl SharedDemiRuntime {
         task_name: &str,
         coroutine: Pin<Box<dyn FusedFuture<Output = ()>>>,
     ) -> Result<QToken, Fail> {
-        self.insert_coroutine(task_name, coroutine)
+        let group_id: TaskId = THREAD_BACKGROUND_GROUP.with(|g| *g);
+        self.insert_coroutine_with_group_id(group_id, task_name, coroutine)
     }
 
     /// Inserts a coroutine of type T and task
@@ -203,7 +246,26 @@ impl SharedDemiRuntime {
             Some(task_id) => Ok(task_id.into()),
             None => {
                 let cause: String = format!("cannot schedule coroutine (task_name={:?})", &task_name);
-                error!("insert_background_coroutine(): {}", cause);
+                error!("insert_coroutine(): {}", cause);
+                Err(Fail::new(libc::EAGAIN, &cause))
+            },
+        }
+    }
+
+    /// Inserts a coroutine of type T and task into the task group `group_id`.
+    fn insert_coroutine_with_group_id<R: Unpin + Clone + Any>(
+        &mut self,
+        group_id: TaskId,
+        task_name: &str,
+        coroutine: Pin<Box<dyn FusedFuture<Output = R>>>,
+    ) -> Result<QToken, Fail> {
+        trace!("Inserting coroutine: {:?} (group_id={:?})", task_name, group_id);
+        let task: TaskWithResult<R> = TaskWithResult::<R>::new(task_name.to_string(), coroutine);
+        match THREAD_SCHEDULER.with(|s| s.clone().insert_task_with_group_id(group_id, task)) {
+            Some(task_id) => Ok(task_id.into()),
+            None => {
+                let cause: String = format!("cannot schedule coroutine (task_name={:?})", &task_name);
+                error!("insert_coroutine_with_group_id(): {}", cause);
                 Err(Fail::new(libc::EAGAIN, &cause))
             },
         }
@@ -235,9 +297,16 @@ impl SharedDemiRuntime {
 
         // 2. None of the tasks have already completed, so start a timer and move the clock.
         self.advance_clock_to_now();
+        let start: Instant = self.get_now();
+        let deadline: Option<Instant> =
+            abstime.map(|abstime: SystemTime| start + abstime.duration_since(SystemTime::now()).unwrap_or_default());
+        let mut wait_state: WaitState = WaitState::new(start);
 
         loop {
-            if let Some(boxed_task) = THREAD_SCHEDULER.with(|s| s.clone().get_next_completed_task(TIMER_RESOLUTION)) {
+            let completed_task: Option<Box<dyn Task>> =
+                THREAD_SCHEDULER.with(|s| s.clone().get_next_completed_task(TIMER_RESOLUTION));
+            self.flush_transmissions();
+            if let Some(boxed_task) = completed_task {
                 // Perform bookkeeping for the completed and removed task.
                 trace!("Removing coroutine: {:?}", boxed_task.get_name());
                 let completed_qt: QToken = boxed_task.get_id().into();
@@ -248,12 +317,14 @@ impl SharedDemiRuntime {
 
                     // Check whether it matches any of the queue tokens that we are waiting on.
                     if completed_qt == qt {
+                        self.wait_stats.record(qd, &wait_state);
                         let result: demi_qresult_t = self.create_result(result, qd, qt);
                         return Ok(result);
                     }
 
-                    // If not a queue token that we are waiting on, then insert into our list of completed tasks.
-                    self.completed_tasks.insert(qt, (qd, result));
+                    // If not a queue token that we are waiting on, then hand it over to its wait group or insert it
+                    // into our list of completed tasks.
+                    self.complete_task(completed_qt, qd, result);
                 }
             }
             // Check the timeout.
@@ -265,6 +336,7 @@ impl SharedDemiRuntime {
 
             // Advance the clock and continue running tasks.
             self.advance_clock_to_now();
+            self.block_if_idle(&mut wait_state, deadline);
         }
     }
 
@@ -287,11 +359,13 @@ impl SharedDemiRuntime {
         // 3. None of the tasks have already completed, so start a timer and move the clock.
         self.advance_clock_to_now();
         let start: Instant = self.get_now();
+        let mut wait_state: WaitState = WaitState::new(start);
 
         // 4. Invoke the scheduler and run some tasks.
         loop {
             // Run for one quanta and if one of our queue tokens completed, then return.
             if let Some((i, qd, result)) = self.run_any(qts) {
+                self.wait_stats.record(qd, &wait_state);
                 return Ok((i, self.create_result(result, qd, qts[i])));
             }
             // Otherwise, move time forward.
@@ -300,6 +374,75 @@ impl SharedDemiRuntime {
             if now >= start + timeout {
                 return Err(Fail::new(libc::ETIMEDOUT, "wait timed out"));
             }
+            self.block_if_idle(&mut wait_state, Some(start + timeout));
+        }
+    }
+
+    /// Waits until at least one of the tasks in qts has completed, and then returns the results of as many completed
+    /// tasks as fit in `qrs_out`. The number of results that were stored in `qrs_out` is returned.
+    pub fn wait_many(
+        &mut self,
+        qts: &[QToken],
+        qrs_out: &mut [demi_qresult_t],
+        timeout: Duration,
+    ) -> Result<usize, Fail> {
+        if qrs_out.is_empty() {
+            let cause: String = format!("no room for results (max={:?})", qrs_out.len());
+            warn!("wait_many(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        // 1. Make sure these queue tokens all point to valid tasks, before we hand out any results.
+        for qt in qts {
+            if !self.completed_tasks.contains_key(qt) && !THREAD_SCHEDULER.with(|s| s.is_valid_task(&TaskId::from(*qt)))
+            {
+                let cause: String = format!("{:?} is not a valid queue token", qt);
+                warn!("wait_many(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            }
+        }
+
+        // 2. Collect the results of tasks that have already completed.
+        let mut num_results: usize = 0;
+        for qt in qts {
+            if num_results == qrs_out.len() {
+                break;
+            }
+            if let Some((qd, result)) = self.get_completed_task(&qt) {
+                qrs_out[num_results] = self.create_result(result, qd, *qt);
+                num_results += 1;
+            }
+        }
+        if num_results > 0 {
+            return Ok(num_results);
+        }
+
+        // 3. None of the tasks have already completed, so start a timer and move the clock.
+        self.advance_clock_to_now();
+        let start: Instant = self.get_now();
+        let mut wait_state: WaitState = WaitState::new(start);
+
+        // 4. Invoke the scheduler and run some tasks.
+        loop {
+            // Keep running quanta for as long as they complete our tasks, so that we return as many results as we can.
+            while let Some((i, qd, result)) = self.run_any(qts) {
+                self.wait_stats.record(qd, &wait_state);
+                qrs_out[num_results] = self.create_result(result, qd, qts[i]);
+                num_results += 1;
+                if num_results == qrs_out.len() {
+                    return Ok(num_results);
+                }
+            }
+            if num_results > 0 {
+                return Ok(num_results);
+            }
+            // Otherwise, move time forward.
+            self.advance_clock_to_now();
+            let now: Instant = self.get_now();
+            if now >= start + timeout {
+                return Err(Fail::new(libc::ETIMEDOUT, "wait timed out"));
+            }
+            self.block_if_idle(&mut wait_state, Some(start + timeout));
         }
     }
 
@@ -309,7 +452,10 @@ impl SharedDemiRuntime {
 
     /// Runs the scheduler for one [TIMER_RESOLUTION] quanta. Importantly does not modify the clock.
     pub fn run_any(&mut self, qts: &[QToken]) -> Option<(usize, QDesc, OperationResult)> {
-        if let Some(boxed_task) = THREAD_SCHEDULER.with(|s| s.clone().get_next_completed_task(TIMER_RESOLUTION)) {
+        let completed_task: Option<Box<dyn Task>> =
+            THREAD_SCHEDULER.with(|s| s.clone().get_next_completed_task(TIMER_RESOLUTION));
+        self.flush_transmissions();
+        if let Some(boxed_task) = completed_task {
             // Perform bookkeeping for the completed and removed task.
             trace!("Removing coroutine: {:?}", boxed_task.get_name());
             let qt: QToken = boxed_task.get_id().into();
@@ -319,6 +465,9 @@ impl SharedDemiRuntime {
                 let (qd, result): (QDesc, OperationResult) =
                     operation_task.get_result().expect("coroutine not finished");
 
+                // Queue tokens that were registered in a wait group are only handed out through their wait group.
+                let (qd, result): (QDesc, OperationResult) = self.wait_groups.complete(qt, qd, result)?;
+
                 // Check whether it matches any of the queue tokens that we are waiting on.
                 for i in 0..qts.len() {
                     if qts[i] == qt {
@@ -333,19 +482,204 @@ impl SharedDemiRuntime {
         None
     }
 
+    /// Hands over the result of a completed task to its wait group or, if it is not in any, to our list of completed
+    /// tasks.
+    fn complete_task(&mut self, qt: QToken, qd: QDesc, result: OperationResult) {
+        if let Some((qd, result)) = self.wait_groups.complete(qt, qd, result) {
+            self.completed_tasks.insert(qt, (qd, result));
+        }
+    }
+
+    /// Allocates a new, empty wait group and returns its descriptor.
+    pub fn alloc_wait_group(&mut self) -> usize {
+        let wgd: usize = self.wait_groups.alloc();
+        trace!("alloc_wait_group(): wgd={:?}", wgd);
+        wgd
+    }
+
+    /// Registers the queue token `qt` in the wait group `wgd`. From now on, the result of the associated task is only
+    /// retrieved through [Self::wait_group], and finding it costs the same regardless of the size of the wait group.
+    pub fn wait_group_add(&mut self, wgd: usize, qt: QToken) -> Result<(), Fail> {
+        trace!("wait_group_add(): wgd={:?}, qt={:?}", wgd, qt);
+        if !self.wait_groups.contains(wgd) {
+            let cause: String = format!("invalid wait group descriptor (wgd={:?})", wgd);
+            warn!("wait_group_add(): {}", cause);
+            return Err(Fail::new(libc::EBADF, &cause));
+        }
+
+        // The task may have already completed.
+        if let Some((qd, result)) = self.get_completed_task(&qt) {
+            return self.wait_groups.add_completed(wgd, qt, qd, result);
+        }
+
+        if !THREAD_SCHEDULER.with(|s| s.is_valid_task(&TaskId::from(qt))) {
+            let cause: String = format!("{:?} is not a valid queue token", qt);
+            warn!("wait_group_add(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        self.wait_groups.add_pending(wgd, qt)
+    }
+
+    /// Waits until one of the tasks in the wait group `wgd` has completed, and returns its result. The task is removed
+    /// from the wait group.
+    pub fn wait_group(&mut self, wgd: usize, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        // 1. Check if some task in the wait group has already completed.
+        if let Some((qt, qd, result)) = self.wait_groups.pop_ready(wgd)? {
+            return Ok(self.create_result(result, qd, qt));
+        }
+
+        // 2. Make sure that there is something to wait for.
+        if self.wait_groups.len(wgd)? == 0 {
+            let cause: String = format!("wait group is empty (wgd={:?})", wgd);
+            warn!("wait_group(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        // 3. None of the tasks have already completed, so start a timer and move the clock.
+        self.advance_clock_to_now();
+        let start: Instant = self.get_now();
+        let mut wait_state: WaitState = WaitState::new(start);
+
+        // 4. Invoke the scheduler and run some tasks. Completed tasks are routed to their wait groups as they come out.
+        loop {
+            self.run_any(&[]);
+            if let Some((qt, qd, result)) = self.wait_groups.pop_ready(wgd)? {
+                self.wait_stats.record(qd, &wait_state);
+                return Ok(self.create_result(result, qd, qt));
+            }
+            // Otherwise, move time forward.
+            self.advance_clock_to_now();
+            let now: Instant = self.get_now();
+            if now >= start + timeout {
+                return Err(Fail::new(libc::ETIMEDOUT, "wait timed out"));
+            }
+            self.block_if_idle(&mut wait_state, Some(start + timeout));
+        }
+    }
+
+    /// Installs the policy for blocking wait calls that have nothing to do.
+    pub fn set_idle_wait(&mut self, idle_wait: IdleWait) {
+        self.idle_wait = Some(idle_wait);
+    }
+
+    /// Installs the hook that hands off to the network device the packets that coroutines queued for transmission. It
+    /// runs at the end of every scheduler quantum, so that no packet stays queued while we return to the application or
+    /// block.
+    pub fn set_transmit_flush(&mut self, flush: Box<dyn FnMut()>) {
+        self.transmit_flush = Some(flush);
+    }
+
+    /// Runs the transmit flush hook, if one is installed.
+    fn flush_transmissions(&mut self) {
+        if let Some(flush) = self.transmit_flush.as_mut() {
+            flush();
+        }
+    }
+
+    /// Returns how the operations on the queue `qd` completed in wait calls.
+    pub fn get_wait_stats(&self, qd: &QDesc) -> WaitStats {
+        self.wait_stats.get(qd)
+    }
+
+    /// Returns the number of times that wait calls blocked because they had nothing to do.
+    pub fn get_num_idle_blocks(&self) -> u64 {
+        self.idle_wait
+            .as_ref()
+            .map_or(0, |idle_wait: &IdleWait| idle_wait.get_num_blocks())
+    }
+
+    /// Returns a snapshot of the statistics of this thread, along with the state of its scheduler and of the results
+    /// that are waiting to be retrieved.
+    pub fn get_stats(&self) -> demi_stats_t {
+        let mut out: demi_stats_t = with_stats(|s: &ThreadStats| demi_stats_t {
+            rx_packets: s.rx_packets.get(),
+            rx_bytes: s.rx_bytes.get(),
+            rx_drops: s.rx_drops.get(),
+            tx_packets: s.tx_packets.get(),
+            tx_bytes: s.tx_bytes.get(),
+            tx_drops: s.tx_drops.get(),
+            mempool_exhausted: s.mempool_exhausted.get(),
+            tcp_retransmits: s.tcp_retransmits.get(),
+            tcp_rto_backoffs: s.tcp_rto_backoffs.get(),
+            tcp_out_of_order_segments: s.tcp_out_of_order_segments.get(),
+            ..Default::default()
+        });
+        out.num_tasks = THREAD_SCHEDULER.with(|s| s.num_tasks()) as u64;
+        out.num_unclaimed_results = (self.completed_tasks.len() + self.wait_groups.num_ready()) as u64;
+        out.num_idle_blocks = self.get_num_idle_blocks();
+        out
+    }
+
+    /// Returns a snapshot of the statistics of the queue `qd`.
+    pub fn get_qstats(&self, qd: &QDesc) -> Result<demi_qstats_t, Fail> {
+        // Fail on queue descriptors that are not in use.
+        self.qtable.get_type(qd)?;
+        let stats: WaitStats = self.get_wait_stats(qd);
+        Ok(demi_qstats_t {
+            num_spin_completions: stats.num_spin_completions,
+            num_block_completions: stats.num_block_completions,
+        })
+    }
+
+    /// Blocks the thread if the wait call in `wait_state` has been busy-polling for long enough without any task being
+    /// woken up or completing. We wake up no later than the next timer is due or `deadline`, when the wait call times
+    /// out.
+    fn block_if_idle(&mut self, wait_state: &mut WaitState, deadline: Option<Instant>) {
+        let now: Instant = self.get_now();
+        let idle_wait: &mut IdleWait = match self.idle_wait.as_mut() {
+            Some(idle_wait) => idle_wait,
+            None => return,
+        };
+        // Tasks ran since we last checked, so we are not idle. Start spinning again.
+        if THREAD_SCHEDULER.with(|s| s.clone().take_progress()) {
+            wait_state.restart_spin(now);
+            return;
+        }
+        // Some task was woken up and is waiting to run.
+        if THREAD_SCHEDULER.with(|s| s.has_notified_tasks()) {
+            return;
+        }
+        let wakeup: Option<Instant> = match (deadline, THREAD_TIME.with(|t| t.next_deadline())) {
+            (Some(deadline), Some(next_timer)) => Some(deadline.min(next_timer)),
+            (deadline, next_timer) => deadline.or(next_timer),
+        };
+        let timeout: Duration = wakeup.map_or(Duration::MAX, |wakeup: Instant| wakeup.saturating_duration_since(now));
+        if idle_wait.block_if_idle(wait_state, now, timeout) {
+            // Time went by while we were blocked, so catch up with it and start spinning again.
+            let now: Instant = Instant::now();
+            self.advance_clock(now);
+            wait_state.restart_spin(now);
+        }
+    }
+
+    /// Releases the wait group `wgd`. Results that were not retrieved from it are moved back to our list of completed
+    /// tasks, so that they can still be waited on individually.
+    pub fn free_wait_group(&mut self, wgd: usize) -> Result<(), Fail> {
+        trace!("free_wait_group(): wgd={:?}", wgd);
+        for (qt, qd, result) in self.wait_groups.free(wgd)? {
+            self.completed_tasks.insert(qt, (qd, result));
+        }
+        Ok(())
+    }
+
     /// Performs a single pool on the underlying scheduler.
     pub fn poll(&mut self) {
         // For all ready tasks that were removed from the scheduler, add to our completed task list.
-        for boxed_task in THREAD_SCHEDULER.with(|s| s.clone().poll_all()) {
+        let mut polled_tasks: Vec<Box<dyn Task>> = mem::take(&mut self.polled_tasks);
+        THREAD_SCHEDULER.with(|s| s.clone().poll_all(&mut polled_tasks));
+        self.flush_transmissions();
+        for boxed_task in polled_tasks.drain(..) {
             trace!("Completed while polling coroutine: {:?}", boxed_task.get_name());
             let qt: QToken = boxed_task.get_id().into();
 
             if let Ok(operation_task) = OperationTask::try_from(boxed_task.as_any()) {
                 let (qd, result): (QDesc, OperationResult) =
                     operation_task.get_result().expect("coroutine not finished");
-                self.completed_tasks.insert(qt, (qd, result));
+                self.complete_task(qt, qd, result);
             }
         }
+        self.polled_tasks = polled_tasks;
     }
 
     /// Allocates a queue of type `T` and returns the associated queue descriptor.
@@ -368,6 +702,7 @@ impl SharedDemiRuntime {
     /// Frees the queue associated with [qd] and returns the freed queue.
     pub fn free_queue<T: IoQueue>(&mut self, qd: &QDesc) -> Result<T, Fail> {
         trace!("Freeing queue: qd={:?}", qd);
+        self.wait_stats.remove(qd);
         self.qtable.free(qd)
     }
 
@@ -647,6 +982,11 @@ impl Default for SharedDemiRuntime {
             network_table: NetworkQueueTable::default(),
             ts_iters: 0,
             completed_tasks: HashMap::<QToken, (QDesc, OperationResult)>::new(),
+            wait_groups: WaitGroupTable::default(),
+            polled_tasks: Vec::<Box<dyn Task>>::new(),
+            idle_wait: None,
+            transmit_flush: None,
+            wait_stats: WaitStatsTable::default(),
         }))
     }
 }
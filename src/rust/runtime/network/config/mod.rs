@@ -11,6 +11,9 @@ mod udp;
 
 pub use self::{
     arp::ArpConfig,
-    tcp::TcpConfig,
+    tcp::{
+        CongestionControlAlgorithm,
+        TcpConfig,
+    },
     udp::UdpConfig,
 };
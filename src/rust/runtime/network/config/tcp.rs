@@ -18,6 +18,17 @@ use ::std::time::Duration;
 // Structures
 //==============================================================================
 
+/// Congestion Control Algorithms
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum CongestionControlAlgorithm {
+    /// No congestion control: only the receive window of the peer limits the data in flight.
+    None,
+    /// Loss-based congestion control, as in RFC 8312.
+    Cubic,
+    /// Model-based congestion control, which paces data at the estimated bottleneck bandwidth.
+    Bbr,
+}
+
 /// TCP Configuration Descriptor
 #[derive(Clone, Debug)]
 pub struct TcpConfig {
@@ -37,6 +48,10 @@ pub struct TcpConfig {
     rx_checksum_offload: bool,
     /// Offload Checksum to Hardware When Sending?
     tx_checksum_offload: bool,
+    /// Largest Segment That Hardware Cuts Into MSS-Sized Segments When Sending (If Offloaded)
+    tx_segmentation_offload: Option<usize>,
+    /// Congestion Control Algorithm for New Connections
+    congestion_control: CongestionControlAlgorithm,
 }
 
 //==============================================================================
@@ -55,6 +70,8 @@ impl TcpConfig {
         ack_delay_timeout: Option<Duration>,
         rx_checksum_offload: Option<bool>,
         tx_checksum_offload: Option<bool>,
+        tx_segmentation_offload: Option<usize>,
+        congestion_control: Option<CongestionControlAlgorithm>,
     ) -> Self {
         let mut options = Self::default();
 
@@ -82,6 +99,12 @@ impl TcpConfig {
         if let Some(value) = tx_checksum_offload {
             options.tx_checksum_offload = value;
         }
+        if let Some(value) = tx_segmentation_offload {
+            options = options.set_tx_segmentation_offload(value);
+        }
+        if let Some(value) = congestion_control {
+            options.congestion_control = value;
+        }
 
         options
     }
@@ -121,11 +144,22 @@ impl TcpConfig {
         self.tx_checksum_offload
     }
 
+    /// Gets the TX hardware segmentation offload option in the target [TcpConfig]. When set, the network runtime accepts
+    /// segments that carry up to this many bytes of data, and cuts them into MSS-sized segments in hardware.
+    pub fn get_tx_segmentation_offload(&self) -> Option<usize> {
+        self.tx_segmentation_offload
+    }
+
     /// Gets the RX hardware checksum offload option in the target [TcpConfig].
     pub fn get_rx_checksum_offload(&self) -> bool {
         self.rx_checksum_offload
     }
 
+    /// Gets the congestion control algorithm in the target [TcpConfig].
+    pub fn get_congestion_control(&self) -> CongestionControlAlgorithm {
+        self.congestion_control
+    }
+
     /// Sets the advertised maximum segment size in the target [TcpConfig].
     fn set_advertised_mss(mut self, value: usize) -> Self {
         assert!(value >= MIN_MSS);
@@ -161,6 +195,13 @@ impl TcpConfig {
         self
     }
 
+    /// Sets the TX hardware segmentation offload option in the target [TcpConfig].
+    fn set_tx_segmentation_offload(mut self, value: usize) -> Self {
+        assert!(value > 0);
+        self.tx_segmentation_offload = Some(value);
+        self
+    }
+
     /// Sets the acknowledgement delay timeout in the target [TcpConfig].
     fn set_ack_delay_timeout(mut self, value: Duration) -> Self {
         assert!(value <= Duration::from_millis(500));
@@ -186,6 +227,8 @@ impl Default for TcpConfig {
             window_scale: 0,
             rx_checksum_offload: false,
             tx_checksum_offload: false,
+            tx_segmentation_offload: None,
+            congestion_control: CongestionControlAlgorithm::None,
         }
     }
 }
@@ -197,7 +240,10 @@ impl Default for TcpConfig {
 #[cfg(test)]
 mod tests {
     use crate::runtime::network::{
-        config::TcpConfig,
+        config::{
+            CongestionControlAlgorithm,
+            TcpConfig,
+        },
         consts::DEFAULT_MSS,
     };
     use ::anyhow::Result;
@@ -214,6 +260,8 @@ mod tests {
         crate::ensure_eq!(config.get_window_scale(), 0);
         crate::ensure_eq!(config.get_rx_checksum_offload(), false);
         crate::ensure_eq!(config.get_tx_checksum_offload(), false);
+        crate::ensure_eq!(config.get_tx_segmentation_offload(), None);
+        crate::ensure_eq!(config.get_congestion_control(), CongestionControlAlgorithm::None);
 
         Ok(())
     }
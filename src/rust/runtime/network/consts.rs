@@ -32,7 +32,8 @@ pub const TCP_HANDSHAKE_TIMEOUT: Duration = Duration::from_secs(3);
 /// TODO: Auto-Discovery MTU Size
 pub const DEFAULT_MSS: usize = 1450;
 
-/// Length of a [crate::memory::DemiBuffer] batch.
-///
-/// TODO: This Should be Generic
-pub const RECEIVE_BATCH_SIZE: usize = 4;
+/// Maximum length of a [crate::memory::DemiBuffer] batch. Network runtimes may be configured to receive smaller bursts.
+pub const RECEIVE_BATCH_SIZE: usize = 32;
+
+/// Maximum number of packets that are handed to the network device in a single transmit burst.
+pub const TRANSMIT_BATCH_SIZE: usize = 32;
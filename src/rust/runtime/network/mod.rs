@@ -52,6 +52,20 @@ pub struct NetworkQueueTable {
     mappings: HashMap<SocketId, QDesc>,
 }
 
+/// Describes how the network device should cut a packet whose body is larger than a segment into several packets (i.e.
+/// TCP segmentation offload). Each resulting packet carries a copy of the headers.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub struct SegmentationOffload {
+    /// Size of the link-layer header, in bytes.
+    pub l2_len: u16,
+    /// Size of the network-layer header, in bytes.
+    pub l3_len: u16,
+    /// Size of the transport-layer header, in bytes.
+    pub l4_len: u16,
+    /// Size of the body of each resulting packet, in bytes.
+    pub segment_size: u16,
+}
+
 //======================================================================================================================
 // Associated Functions
 //======================================================================================================================
@@ -121,6 +135,11 @@ pub trait PacketBuf {
     fn body_size(&self) -> usize;
     /// Consumes and returns the body of the target [PacketBuf].
     fn take_body(&self) -> Option<DemiBuffer>;
+    /// Returns how the network device should segment the target [PacketBuf], if its body spans several segments. Only
+    /// runtimes that advertise TCP segmentation offload in their [TcpConfig] are handed such packets.
+    fn segmentation_offload(&self) -> Option<SegmentationOffload> {
+        None
+    }
 }
 
 /// Network Runtime
@@ -131,6 +150,16 @@ pub trait NetworkRuntime: Clone + 'static + MemoryRuntime {
     /// Receives a batch of [DemiBuffer].
     fn receive(&mut self) -> ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>;
 
+    /// Hands off to the network device any packets that were buffered by previous calls to [NetworkRuntime::transmit].
+    /// Runtimes that transmit packets right away do not need to override this.
+    fn flush(&mut self) {}
+
+    /// Checks if packets that `remote` sends to `local` are received by this runtime. Runtimes that share a network
+    /// device with others (e.g. one per device queue) override this, so that flows we open land on our own queue.
+    fn receives_flow(&self, _local: SocketAddrV4, _remote: SocketAddrV4) -> bool {
+        true
+    }
+
     /// Gets the UDP config options.
     fn get_udp_config(&self) -> UdpConfig;
 
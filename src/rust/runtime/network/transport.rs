@@ -99,4 +99,8 @@ impl<N: NetworkTransport> MemoryRuntime for N {
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
         self.get_runtime().sgafree(sga)
     }
+
+    fn sgaappend(&self, sga: &mut demi_sgarray_t, tail: demi_sgarray_t) -> Result<(), Fail> {
+        self.get_runtime().sgaappend(sga, tail)
+    }
 }
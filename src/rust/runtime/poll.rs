@@ -5,6 +5,7 @@
 // Imports
 //======================================================================================================================
 
+use crate::runtime::THREAD_SCHEDULER;
 use ::std::{
     future::Future,
     pin::Pin,
@@ -53,6 +54,8 @@ impl Future for PollFuture {
         if self_.state == YieldState::Running {
             // Set our state
             self_.state = YieldState::Yielded;
+            // Run again in the next round, but let the scheduler know that we are only busy-polling.
+            THREAD_SCHEDULER.with(|s| s.clone().yield_current_task());
             context.waker().wake_by_ref();
             Poll::Pending
         } else {
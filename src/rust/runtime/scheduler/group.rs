@@ -33,6 +33,7 @@ use crate::{
 use ::bit_iter::BitIter;
 use ::futures::Future;
 use ::std::{
+    mem,
     pin::Pin,
     ptr::NonNull,
     task::{
@@ -46,15 +47,30 @@ use ::std::{
 // Structures
 //======================================================================================================================
 
+/// Scheduling priority of a task group. In each scheduling round, groups run in order of decreasing priority, so the
+/// ready tasks of a group run before those of lower-priority groups, and every group runs once per round.
+#[derive(Clone, Copy, Debug, Default, Eq, Ord, PartialEq, PartialOrd)]
+pub enum TaskPriority {
+    Low,
+    #[default]
+    Normal,
+    High,
+}
+
 /// This represents a resource management group. All tasks belong to a task group. By default, a task belongs to the
 /// same task group as the allocating task.
 #[derive(Default)]
 pub struct TaskGroup {
+    /// Scheduling priority of this group.
+    priority: TaskPriority,
     ids: IdMap<TaskId, InternalId>,
     /// Stores all the tasks that are held by the scheduler.
     tasks: PinSlab<Box<dyn Task>>,
     /// Holds the waker bits for controlling task scheduling.
     waker_page_refs: Vec<WakerPageRef>,
+    /// Flags the tasks that yielded without waiting for anything, one bitmap per waker page. These run again in the
+    /// next round, but are kept apart from notified tasks so that busy-polling does not look like work.
+    yielded: Vec<u64>,
 }
 
 //======================================================================================================================
@@ -62,6 +78,19 @@ pub struct TaskGroup {
 //======================================================================================================================
 
 impl TaskGroup {
+    /// Creates an empty task group with the given scheduling `priority`.
+    pub fn new(priority: TaskPriority) -> Self {
+        Self {
+            priority,
+            ..Default::default()
+        }
+    }
+
+    /// Returns the scheduling priority of this group.
+    pub fn get_priority(&self) -> TaskPriority {
+        self.priority
+    }
+
     /// Given a handle to a task, remove it from the scheduler
     pub fn remove(&mut self, task_id: TaskId) -> Option<Box<dyn Task>> {
         // We should not have a scheduler handle that refers to an invalid id, so unwrap and expect are safe here.
@@ -75,6 +104,7 @@ impl TaskGroup {
             (&self.waker_page_refs[waker_page_index], waker_page_offset)
         };
         waker_page_ref.clear(waker_page_offset);
+        self.yielded[pin_slab_index >> WAKER_BIT_LENGTH_SHIFT] &= !(1 << waker_page_offset);
         if let Some(task) = self.tasks.remove_unpin(pin_slab_index) {
             trace!(
                 "remove(): name={:?}, id={:?}, pin_slab_index={:?}",
@@ -92,12 +122,13 @@ impl TaskGroup {
         }
     }
 
-    /// Insert a new task into our scheduler returning a handle corresponding to it.
-    pub fn insert(&mut self, task: Box<dyn Task>) -> Option<TaskId> {
+    /// Insert a new task into our scheduler under the handle `task_id`. Handles are allocated by the scheduler, so that
+    /// they are unique across all groups.
+    pub fn insert(&mut self, task_id: TaskId, task: Box<dyn Task>) -> Option<()> {
         let task_name: String = task.get_name();
         // The pin slab index can be reverse-computed in a page index and an offset within the page.
         let pin_slab_index: usize = self.tasks.insert(task)?;
-        let task_id: TaskId = self.ids.insert_with_new_id(pin_slab_index.into());
+        self.ids.insert(task_id, pin_slab_index.into());
 
         self.add_new_pages_up_to_pin_slab_index(pin_slab_index.into());
 
@@ -119,7 +150,7 @@ impl TaskGroup {
             .get_pin_mut(pin_slab_index)
             .expect("just allocated!")
             .set_id(task_id);
-        Some(task_id)
+        Some(())
     }
 
     /// Computes the page and page offset of a given task based on its total offset.
@@ -139,13 +170,10 @@ impl TaskGroup {
     fn add_new_pages_up_to_pin_slab_index(&mut self, pin_slab_index: usize) {
         while pin_slab_index >= (self.waker_page_refs.len() << WAKER_BIT_LENGTH_SHIFT) {
             self.waker_page_refs.push(WakerPageRef::default());
+            self.yielded.push(0);
         }
     }
 
-    pub fn get_num_waker_pages(&self) -> usize {
-        self.waker_page_refs.len()
-    }
-
     fn get_waker_page_offset(pin_slab_index: usize) -> usize {
         pin_slab_index & (WAKER_BIT_LENGTH - 1)
     }
@@ -154,18 +182,48 @@ impl TaskGroup {
         (waker_page_index << WAKER_BIT_LENGTH_SHIFT) + waker_page_offset
     }
 
-    pub fn get_offsets_for_ready_tasks(&mut self) -> Vec<InternalId> {
-        let mut result: Vec<InternalId> = vec![];
-        for i in 0..self.get_num_waker_pages() {
+    /// Takes the notified and yielded bits of all waker pages and appends the ids of the tasks that they flag as ready
+    /// to `ready_tasks`. The caller owns the buffer, so it can be reused across scheduling rounds without allocating.
+    /// Returns true if any of these tasks was notified, rather than having only yielded.
+    pub fn take_ready_tasks(&mut self, ready_tasks: &mut Vec<InternalId>) -> bool {
+        let mut woken: bool = false;
+        for (i, waker_page_ref) in self.waker_page_refs.iter().enumerate() {
             // Grab notified bits.
-            let notified: u64 = self.waker_page_refs[i].take_notified();
-            // Turn into bit iter.
-            let mut offset: Vec<InternalId> = BitIter::from(notified)
-                .map(|x| Self::get_pin_slab_index(i, x).into())
-                .collect();
-            result.append(&mut offset);
+            let notified: u64 = waker_page_ref.take_notified();
+            woken |= notified != 0;
+            let ready: u64 = notified | mem::take(&mut self.yielded[i]);
+            if ready != 0 {
+                ready_tasks.extend(BitIter::from(ready).map(|x| InternalId::from(Self::get_pin_slab_index(i, x))));
+            }
+        }
+        woken
+    }
+
+    /// Checks whether any task was notified and has not run since.
+    pub fn has_notified_tasks(&self) -> bool {
+        self.waker_page_refs
+            .iter()
+            .any(|waker_page_ref| waker_page_ref.has_notified())
+    }
+
+    /// Flags the task `internal_task_id` as having yielded. Its notification is turned into a yield, so it runs again
+    /// in the next round without counting as a task that was woken up.
+    pub fn set_yielded(&mut self, internal_task_id: InternalId) {
+        if let Some((waker_page_index, waker_page_offset)) =
+            self.get_waker_page_index_and_offset(internal_task_id.into())
+        {
+            self.waker_page_refs[waker_page_index].clear(waker_page_offset);
+            self.yielded[waker_page_index] |= 1 << waker_page_offset;
+        }
+    }
+
+    /// Flags the task `internal_task_id` as ready again, so it runs the next time that this group is scheduled.
+    pub fn notify(&self, internal_task_id: InternalId) {
+        if let Some((waker_page_index, waker_page_offset)) =
+            self.get_waker_page_index_and_offset(internal_task_id.into())
+        {
+            self.waker_page_refs[waker_page_index].notify(waker_page_offset);
         }
-        result
     }
 
     /// Translates an internal task id to an external one. Expects the task to exist.
@@ -225,8 +283,8 @@ impl TaskGroup {
         }
     }
 
-    #[cfg(test)]
+    /// Returns the number of tasks in this group.
     pub fn num_tasks(&self) -> usize {
-        self.ids.len()
+        self.tasks.len()
     }
 }
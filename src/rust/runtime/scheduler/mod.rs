@@ -41,7 +41,11 @@ mod waker64;
 //==============================================================================
 
 pub use self::{
-    scheduler::SharedScheduler,
+    group::TaskPriority,
+    scheduler::{
+        SharedScheduler,
+        ROOT_GROUP_ID,
+    },
     task::{
         Task,
         TaskId,
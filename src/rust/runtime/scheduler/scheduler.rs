@@ -15,7 +15,10 @@ use crate::{
     collections::id_map::IdMap,
     runtime::{
         scheduler::{
-            group::TaskGroup,
+            group::{
+                TaskGroup,
+                TaskPriority,
+            },
             Task,
             TaskId,
         },
@@ -24,6 +27,7 @@ use crate::{
 };
 use ::slab::Slab;
 use ::std::{
+    mem,
     ops::{
         Deref,
         DerefMut,
@@ -31,6 +35,13 @@ use ::std::{
     task::Waker,
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Id of the task group that is created along with the scheduler.
+pub const ROOT_GROUP_ID: TaskId = TaskId(0);
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -44,21 +55,32 @@ pub struct Scheduler {
     // Mapping between external task ids and internal ids (which currently represent the offset into the slab where the
     // task lives).
     ids: IdMap<TaskId, InternalId>,
-    // A group of tasks used for resource management. Currently all of our tasks are in a single group but we will
-    // eventually break them up by Demikernel queue for fairness and performance isolation.
+    // A group of tasks used for resource management. Groups have a priority that decides in which order they run.
     groups: Slab<TaskGroup>,
+    // Order in which groups run in each scheduling round: by decreasing priority, then by creation.
+    group_order: Vec<InternalId>,
+    // The group that tasks are inserted into when they are not allocated by another task.
+    root_group_id: InternalId,
     // Track the currently running task id. This is entirely for external use. If there are no coroutines running (i.
     // e.g, we did not enter the scheduler through a wait), this MUST be set to none because we cannot yield or wake ///
     // unless inside a task/async coroutine.
     current_running_task: Box<Option<TaskId>>,
 
-    // These global variables are for our scheduling policy. For now, we simply use round robin.
+    // These global variables are for our scheduling policy. We go round robin over the groups in [group_order] and
+    // run all of the ready tasks of a group before moving to the next one.
     // The index of the current or last task that we ran.
     current_task_id: InternalId,
-    // The group index of the current or last task that we ran.
-    current_group_id: InternalId,
-    // The current set of ready tasks in the group.
+    // The position in [group_order] of the group of the current or last task that we ran.
+    current_group_index: usize,
+    // The current set of ready tasks in the group. This buffer is reused across rounds, so we do not allocate while
+    // scheduling.
     current_ready_tasks: Vec<InternalId>,
+    // Whether the task that is currently running yielded without waiting for anything. This is set from within the
+    // task, so like [current_running_task], it is boxed.
+    current_task_yielded: Box<bool>,
+    // Whether a task was woken up or completed since we last reported progress. Tasks that only yielded do not count,
+    // so that a runtime where everything is busy-polling can tell that it is idle.
+    made_progress: bool,
 }
 
 #[derive(Clone)]
@@ -71,21 +93,46 @@ pub struct SharedScheduler(SharedObject<Scheduler>);
 impl Scheduler {
     /// Creates a new task group. Returns an identifier for the group.
     pub fn create_group(&mut self) -> TaskId {
-        let internal_id: InternalId = self.groups.insert(TaskGroup::default()).into();
+        self.create_group_with_priority(TaskPriority::default())
+    }
+
+    /// Creates a new task group with the given scheduling `priority`. Returns an identifier for the group.
+    pub fn create_group_with_priority(&mut self, priority: TaskPriority) -> TaskId {
+        let internal_id: InternalId = self.groups.insert(TaskGroup::new(priority)).into();
+        // Place the new group after all groups of the same or higher priority.
+        let position: usize = self
+            .group_order
+            .iter()
+            .position(|id| self.groups[usize::from(*id)].get_priority() < priority)
+            .unwrap_or(self.group_order.len());
+        self.group_order.insert(position, internal_id);
+        if position <= self.current_group_index {
+            self.current_group_index += 1;
+        }
         self.ids.insert_with_new_id(internal_id)
     }
 
     /// Switch to a different task group. Returns true if the group has been switched.
     pub fn switch_group(&mut self, group_id: TaskId) -> bool {
         if let Some(internal_id) = self.ids.get(&group_id) {
-            if self.groups.contains(internal_id.into()) {
-                self.current_group_id = internal_id;
+            if let Some(position) = self.group_order.iter().position(|id| *id == internal_id) {
+                // Hand the tasks that did not get to run back to their group, so that their notifications are not lost.
+                let group: &TaskGroup = &self.groups[self.current_group_id().into()];
+                for task_id in self.current_ready_tasks.drain(..) {
+                    group.notify(task_id);
+                }
+                self.current_group_index = position;
                 return true;
             }
         }
         false
     }
 
+    /// Returns the internal id of the group that we are currently running.
+    fn current_group_id(&self) -> InternalId {
+        self.group_order[self.current_group_index]
+    }
+
     /// Get a reference to the task group using the id.
     fn get_group(&self, task_id: &TaskId) -> Option<&TaskGroup> {
         // Get the internal id of the parent task or group.
@@ -105,26 +152,36 @@ impl Scheduler {
     /// Removes a task group. The group id should be the one originally allocated for this group since the group should
     /// not have any running tasks. Returns true if the task group was successfully removed.
     pub fn remove_group(&mut self, group_id: TaskId) -> bool {
+        // The root group cannot be removed.
+        if group_id == ROOT_GROUP_ID {
+            return false;
+        }
         if let Some(internal_id) = self.ids.remove(&group_id) {
             self.groups.remove(internal_id.into());
+            if let Some(position) = self.group_order.iter().position(|id| *id == internal_id) {
+                self.group_order.remove(position);
+                if position == self.current_group_index {
+                    // The ready tasks belonged to the removed group, so move on to the group that followed it.
+                    self.current_ready_tasks.clear();
+                    self.current_group_index = (position + self.group_order.len() - 1) % self.group_order.len();
+                } else if position < self.current_group_index {
+                    self.current_group_index -= 1;
+                }
+            }
             true
         } else {
             false
         }
     }
 
-    /// Insert a task into a task group. The parent id can either be the id of the group or another task in the same
-    /// group.
+    /// Insert a task into the task group of the currently running task, or into the root group if no task is running.
     pub fn insert_task<T: Task>(&mut self, task: T) -> Option<TaskId> {
         // Use the currently running task id to find the task group for this task.
-        let group: &mut TaskGroup = self.groups.get_mut(self.current_group_id.into())?;
-        // Insert the task into the task group.
-        let new_task_id: TaskId = group.insert(Box::new(task))?;
-        // Add a mapping so we can use this new task id to find the task in the future.
-        if let Some(existing) = self.ids.insert(new_task_id, self.current_group_id) {
-            panic!("should not exist an id: {:?}", existing);
-        }
-        Some(new_task_id)
+        let group_id: InternalId = match *self.current_running_task {
+            Some(running_task_id) => self.ids.get(&running_task_id)?,
+            None => self.root_group_id,
+        };
+        self.insert_task_into_group(group_id, task)
     }
 
     /// Insert a task into a task group. The parent id can either be the id of the group or another task in the same
@@ -132,12 +189,20 @@ impl Scheduler {
     pub fn insert_task_with_group_id<T: Task>(&mut self, group_id: TaskId, task: T) -> Option<TaskId> {
         // Get the internal id of the parent task or group.
         let group_id: InternalId = self.ids.get(&group_id)?;
+        self.insert_task_into_group(group_id, task)
+    }
+
+    /// Insert a task into the task group `group_id`.
+    fn insert_task_into_group<T: Task>(&mut self, group_id: InternalId, task: T) -> Option<TaskId> {
         // Use that to find the task group for this task.
         let group: &mut TaskGroup = self.groups.get_mut(group_id.into())?;
+        // Allocate the task id here rather than in the group, so that it does not clash with ids of other groups.
+        let new_task_id: TaskId = self.ids.insert_with_new_id(group_id);
         // Insert the task into the task group.
-        let new_task_id: TaskId = group.insert(Box::new(task))?;
-        // Add a mapping so we can use this new task id to find the task in the future.
-        self.ids.insert(new_task_id, group_id);
+        if group.insert(new_task_id, Box::new(task)).is_none() {
+            self.ids.remove(&new_task_id);
+            return None;
+        }
         Some(new_task_id)
     }
 
@@ -152,48 +217,65 @@ impl Scheduler {
     }
 
     fn poll_notified_task_and_remove_if_ready(&mut self) -> Option<Box<dyn Task>> {
-        let group: &mut TaskGroup = self
-            .groups
-            .get_mut(self.current_group_id.into())
-            .expect("task group should exist: ");
+        let group_id: InternalId = self.current_group_id();
+        let group: &mut TaskGroup = self.groups.get_mut(group_id.into()).expect("task group should exist: ");
         assert!(self.current_running_task.is_none());
         *self.current_running_task = Some(group.unchecked_internal_to_external_id(self.current_task_id));
         assert!(self.current_running_task.is_some());
+        *self.current_task_yielded = false;
         let result: Option<Box<dyn Task>> = group.poll_notified_task_and_remove_if_ready(self.current_task_id);
+        if result.is_some() {
+            self.made_progress = true;
+        } else if *self.current_task_yielded {
+            group.set_yielded(self.current_task_id);
+        }
         assert!(self.current_running_task.is_some());
         *self.current_running_task = None;
         assert!(self.current_running_task.is_none());
         result
     }
 
-    /// Poll all tasks which are ready to run for [max_iterations]. This does the same thing as get_next_completed task
-    /// but does not stop until it has reached [max_iterations] and collects all of the
-    pub fn poll_all(&mut self) -> Vec<Box<dyn Task>> {
-        let mut completed_tasks: Vec<Box<dyn Task>> = vec![];
-        let start_group = self.current_group_id;
-        loop {
-            self.current_task_id = {
-                match self.current_ready_tasks.pop() {
-                    Some(index) => index,
-                    None => {
-                        self.next_runnable_group();
-                        if self.current_group_id == start_group {
-                            break;
-                        }
-                        match self.current_ready_tasks.pop() {
-                            Some(index) => index,
-                            None => return completed_tasks,
-                        }
-                    },
-                }
-            };
+    /// Flags the currently running task as having yielded without waiting for anything. It runs again in the next
+    /// round, like a task that woke itself up, but does not count as progress.
+    pub fn yield_current_task(&mut self) {
+        *self.current_task_yielded = true;
+    }
+
+    /// Returns whether a task was woken up or completed since the last call, and resets this.
+    pub fn take_progress(&mut self) -> bool {
+        mem::take(&mut self.made_progress)
+    }
 
+    /// Checks whether a task was woken up and has not run since. Tasks that only yielded do not count.
+    pub fn has_notified_tasks(&self) -> bool {
+        self.groups.iter().any(|(_, group)| group.has_notified_tasks())
+    }
+
+    /// Poll all tasks which are ready to run. This does the same thing as get_next_completed_task but does not stop
+    /// until it has run the remaining ready tasks of the current group, followed by a full round over all groups that
+    /// starts from the highest-priority one. Completed tasks are appended to `completed_tasks`, which the caller may
+    /// reuse across calls.
+    pub fn poll_all(&mut self, completed_tasks: &mut Vec<Box<dyn Task>>) {
+        self.poll_ready_tasks(completed_tasks);
+        // Groups may be created or removed by the tasks that we run, so check the bounds on every iteration.
+        let mut group_index: usize = 0;
+        while group_index < self.group_order.len() {
+            self.current_group_index = group_index;
+            self.take_ready_tasks();
+            self.poll_ready_tasks(completed_tasks);
+            group_index += 1;
+        }
+    }
+
+    /// Polls the ready tasks of the current group, appending those that complete to `completed_tasks`.
+    fn poll_ready_tasks(&mut self, completed_tasks: &mut Vec<Box<dyn Task>>) {
+        while let Some(index) = self.current_ready_tasks.pop() {
+            self.current_task_id = index;
             // Now that we have a runnable task, actually poll it.
             if let Some(task) = self.poll_notified_task_and_remove_if_ready() {
                 completed_tasks.push(task);
             }
         }
-        completed_tasks
     }
 
     /// Poll all tasks until one completes. Remove that task and return it or fail after polling [max_iteration] number
@@ -204,11 +286,10 @@ impl Scheduler {
                 match self.current_ready_tasks.pop() {
                     Some(index) => index,
                     None => {
-                        self.next_runnable_group();
-                        match self.current_ready_tasks.pop() {
-                            Some(index) => index,
-                            None => return None,
+                        if !self.next_runnable_group() {
+                            return None;
                         }
+                        self.current_ready_tasks.pop().expect("group should have ready tasks")
                     },
                 }
             };
@@ -221,28 +302,31 @@ impl Scheduler {
         None
     }
 
-    /// Poll over all of the groups looking for a group with runnable tasks. Sets the current_group_id to the next
-    /// runnable task group and current_ready_tasks to a list of tasks that are runnable in that group.
-    fn next_runnable_group(&mut self) {
-        let starting_group_index: InternalId = self.current_group_id;
-        self.current_group_id = self.get_next_group_index();
-
-        loop {
-            self.current_ready_tasks = self.groups[self.current_group_id.into()].get_offsets_for_ready_tasks();
+    /// Poll over all of the groups looking for a group with runnable tasks. Sets the current group to the next runnable
+    /// task group and current_ready_tasks to a list of tasks that are runnable in that group. Returns false if no
+    /// group has runnable tasks.
+    fn next_runnable_group(&mut self) -> bool {
+        for _ in 0..self.group_order.len() {
+            self.switch_to_next_group();
             if !self.current_ready_tasks.is_empty() {
-                return;
-            }
-            // If we reach this point, then we have looped all the way around without finding any runnable tasks.
-            if self.current_group_id == starting_group_index {
-                return;
+                return true;
             }
         }
+        false
+    }
+
+    /// Moves on to the next group in the scheduling round and takes its ready tasks.
+    fn switch_to_next_group(&mut self) {
+        self.current_group_index = (self.current_group_index + 1) % self.group_order.len();
+        self.take_ready_tasks();
     }
 
-    /// Choose the index of the next group to run.
-    fn get_next_group_index(&self) -> InternalId {
-        // For now, we just choose the next group in the list.
-        InternalId::from((usize::from(self.current_group_id) + 1) % self.groups.len())
+    /// Takes the ready tasks of the current group.
+    fn take_ready_tasks(&mut self) {
+        let group_id: InternalId = self.current_group_id();
+        if self.groups[group_id.into()].take_ready_tasks(&mut self.current_ready_tasks) {
+            self.made_progress = true;
+        }
     }
 
     /// Returns whether this task id points to a valid task.
@@ -266,7 +350,7 @@ impl Scheduler {
         group.get_waker(internal_id)
     }
 
-    #[cfg(test)]
+    /// Returns the number of tasks in the scheduler, across all task groups.
     pub fn num_tasks(&self) -> usize {
         let mut num_tasks: usize = 0;
         for (_, group) in self.groups.iter() {
@@ -287,15 +371,18 @@ impl Default for Scheduler {
         let mut groups: Slab<TaskGroup> = Slab::<TaskGroup>::default();
         let internal_id: InternalId = groups.insert(group).into();
         // Use 0 as a special task id for the root.
-        let current_task: TaskId = TaskId::from(0);
-        ids.insert(current_task, internal_id);
+        ids.insert(ROOT_GROUP_ID, internal_id);
         Self {
             ids,
             groups,
+            group_order: vec![internal_id],
+            root_group_id: internal_id,
             current_running_task: Box::new(None),
-            current_group_id: internal_id,
+            current_group_index: 0,
             current_task_id: InternalId(0),
             current_ready_tasks: vec![],
+            current_task_yielded: Box::new(false),
+            made_progress: false,
         }
     }
 }
@@ -350,18 +437,31 @@ impl From<InternalId> for u64 {
 
 #[cfg(test)]
 mod tests {
-    use crate::runtime::scheduler::{
+    use crate::runtime::{
+        poll_yield,
         scheduler::{
-            Scheduler,
-            TaskId,
+            scheduler::{
+                Scheduler,
+                SharedScheduler,
+                TaskId,
+                ROOT_GROUP_ID,
+            },
+            task::TaskWithResult,
+            Task,
+            TaskPriority,
         },
-        task::TaskWithResult,
+        THREAD_SCHEDULER,
     };
     use ::anyhow::Result;
     use ::futures::FutureExt;
     use ::std::{
+        cell::{
+            Cell,
+            RefCell,
+        },
         future::Future,
         pin::Pin,
+        rc::Rc,
         task::{
             Context,
             Poll,
@@ -579,6 +679,109 @@ mod tests {
         Ok(())
     }
 
+    /// Tests if tasks of higher-priority groups run before those of lower-priority groups in a scheduling round.
+    #[test]
+    fn poll_runs_groups_by_priority() -> Result<()> {
+        let mut scheduler: Scheduler = Scheduler::default();
+        let low_group_id: TaskId = scheduler.create_group_with_priority(TaskPriority::Low);
+        let high_group_id: TaskId = scheduler.create_group_with_priority(TaskPriority::High);
+        let order: Rc<RefCell<Vec<TaskPriority>>> = Rc::new(RefCell::new(vec![]));
+
+        // Insert tasks in increasing order of priority.
+        for (group_id, priority) in [
+            (low_group_id, TaskPriority::Low),
+            (ROOT_GROUP_ID, TaskPriority::Normal),
+            (high_group_id, TaskPriority::High),
+        ] {
+            let order: Rc<RefCell<Vec<TaskPriority>>> = order.clone();
+            let coroutine = async move { order.borrow_mut().push(priority) };
+            let task: DummyTask = DummyTask::new(String::from("testing"), Box::pin(coroutine.fuse()));
+            if scheduler.insert_task_with_group_id(group_id, task).is_none() {
+                anyhow::bail!("insert() failed");
+            }
+        }
+
+        let mut completed_tasks: Vec<Box<dyn Task>> = vec![];
+        scheduler.poll_all(&mut completed_tasks);
+        crate::ensure_eq!(completed_tasks.len(), 3);
+        crate::ensure_eq!(
+            *order.borrow(),
+            vec![TaskPriority::High, TaskPriority::Normal, TaskPriority::Low]
+        );
+
+        Ok(())
+    }
+
+    /// Tests if we find ready tasks in groups other than the current one and if removing a group keeps the others.
+    #[test]
+    fn poll_next_visits_all_groups() -> Result<()> {
+        let mut scheduler: Scheduler = Scheduler::default();
+        let first_group_id: TaskId = scheduler.create_group();
+        let second_group_id: TaskId = scheduler.create_group();
+
+        let task: DummyTask = DummyTask::new(String::from("testing"), Box::pin(DummyCoroutine::new(0).fuse()));
+        let Some(task_id) = scheduler.insert_task_with_group_id(second_group_id, task) else {
+            anyhow::bail!("insert() failed")
+        };
+        crate::ensure_eq!(scheduler.remove_group(first_group_id), true);
+        crate::ensure_eq!(scheduler.remove_group(ROOT_GROUP_ID), false);
+
+        if let Some(task) = scheduler.get_next_completed_task(MAX_ITERATIONS) {
+            crate::ensure_eq!(task.get_id(), task_id);
+        } else {
+            anyhow::bail!("task should have completed");
+        }
+        crate::ensure_eq!(scheduler.get_next_completed_task(MAX_ITERATIONS).is_none(), true);
+
+        Ok(())
+    }
+
+    /// Tests if tasks that only yield keep running without counting as progress, while tasks that are woken up do.
+    #[test]
+    fn yielding_is_not_progress() -> Result<()> {
+        // Tasks yield to the scheduler of their thread.
+        let mut scheduler: SharedScheduler = THREAD_SCHEDULER.with(|s| s.clone());
+        let num_polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        let coroutine = {
+            let num_polls: Rc<Cell<usize>> = num_polls.clone();
+            async move {
+                loop {
+                    num_polls.set(num_polls.get() + 1);
+                    poll_yield().await;
+                }
+            }
+        };
+        let task: DummyTask = DummyTask::new(String::from("testing"), Box::pin(coroutine.fuse()));
+        let Some(task_id) = scheduler.insert_task(task) else {
+            anyhow::bail!("insert() failed")
+        };
+
+        // New tasks are notified, so running one is progress.
+        let mut completed_tasks: Vec<Box<dyn Task>> = vec![];
+        scheduler.poll_all(&mut completed_tasks);
+        crate::ensure_eq!(num_polls.get(), 1);
+        crate::ensure_eq!(scheduler.take_progress(), true);
+
+        // A task that yielded runs again, but is not progress.
+        crate::ensure_eq!(scheduler.has_notified_tasks(), false);
+        scheduler.poll_all(&mut completed_tasks);
+        crate::ensure_eq!(num_polls.get(), 2);
+        crate::ensure_eq!(scheduler.take_progress(), false);
+
+        // Waking the task up is progress.
+        let Some(waker) = scheduler.get_waker(task_id) else {
+            anyhow::bail!("task should have a waker")
+        };
+        waker.wake_by_ref();
+        crate::ensure_eq!(scheduler.has_notified_tasks(), true);
+        scheduler.poll_all(&mut completed_tasks);
+        crate::ensure_eq!(num_polls.get(), 3);
+        crate::ensure_eq!(scheduler.take_progress(), true);
+        crate::ensure_eq!(completed_tasks.len(), 0);
+
+        Ok(())
+    }
+
     #[bench]
     fn benchmark_insert(b: &mut Bencher) {
         let mut scheduler: Scheduler = Scheduler::default();
@@ -609,8 +812,10 @@ mod tests {
             task_ids.push(task_id);
         }
 
+        let mut completed_tasks: Vec<Box<dyn Task>> = vec![];
         b.iter(|| {
-            black_box(scheduler.poll_all());
+            scheduler.poll_all(&mut completed_tasks);
+            black_box(completed_tasks.drain(..));
         });
     }
 
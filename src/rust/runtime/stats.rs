@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Per-thread runtime statistics. Each Demikernel thread owns its network device and its connections, so counters are
+//! kept in a thread local variable, as plain cells: bumping one on the hot path is a load and a store, without atomics
+//! or locks. Counters are read on the same thread when the application asks for a snapshot of them.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::cell::Cell;
+
+//======================================================================================================================
+// Thread local variable
+//======================================================================================================================
+
+thread_local! {
+/// Statistics of this thread.
+static THREAD_STATS: ThreadStats = ThreadStats::default();
+}
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A counter that is only ever touched by the thread that owns it.
+#[derive(Default)]
+pub struct Counter(Cell<u64>);
+
+/// Statistics of a Demikernel thread.
+#[derive(Default)]
+pub struct ThreadStats {
+    /// Packets that the network device handed to us.
+    pub rx_packets: Counter,
+    /// Bytes in the packets that the network device handed to us.
+    pub rx_bytes: Counter,
+    /// Received packets that the network stack dropped, because they were malformed or not meant for us.
+    pub rx_drops: Counter,
+    /// Packets that the network device accepted for transmission.
+    pub tx_packets: Counter,
+    /// Bytes in the packets that the network device accepted for transmission.
+    pub tx_bytes: Counter,
+    /// Outgoing packets that were dropped before the network device accepted them.
+    pub tx_drops: Counter,
+    /// Failed allocations of packet buffers.
+    pub mempool_exhausted: Counter,
+    /// TCP segments that were sent again.
+    pub tcp_retransmits: Counter,
+    /// Times that a TCP retransmission timeout was backed off.
+    pub tcp_rto_backoffs: Counter,
+    /// Out-of-order TCP segments that are held for reassembly, across all connections. This is a gauge.
+    pub tcp_out_of_order_segments: Counter,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Counter {
+    /// Adds `n` to the counter.
+    #[inline]
+    pub fn add(&self, n: u64) {
+        self.0.set(self.0.get().wrapping_add(n));
+    }
+
+    /// Adds one to the counter.
+    #[inline]
+    pub fn incr(&self) {
+        self.add(1);
+    }
+
+    /// Subtracts `n` from a gauge.
+    #[inline]
+    pub fn sub(&self, n: u64) {
+        self.0.set(self.0.get().saturating_sub(n));
+    }
+
+    /// Returns the value of the counter.
+    pub fn get(&self) -> u64 {
+        self.0.get()
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Runs `f` on the statistics of the calling thread.
+#[inline]
+pub fn with_stats<R, F: FnOnce(&ThreadStats) -> R>(f: F) -> R {
+    THREAD_STATS.with(f)
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::with_stats;
+    use ::anyhow::Result;
+    use ::std::thread;
+
+    /// Checks that counters and gauges move as expected, and that each thread has its own statistics.
+    #[test]
+    fn counters_are_per_thread() -> Result<()> {
+        let (packets, backlog): (u64, u64) = with_stats(|s| {
+            s.rx_packets.incr();
+            s.rx_packets.add(2);
+            s.tcp_out_of_order_segments.add(1);
+            s.tcp_out_of_order_segments.sub(5);
+            (s.rx_packets.get(), s.tcp_out_of_order_segments.get())
+        });
+        crate::ensure_eq!(packets, 3);
+        // Gauges never go below zero.
+        crate::ensure_eq!(backlog, 0);
+
+        let other: u64 = match thread::spawn(|| with_stats(|s| s.rx_packets.get())).join() {
+            Ok(other) => other,
+            Err(_) => ::anyhow::bail!("thread should not panic"),
+        };
+        crate::ensure_eq!(other, 0);
+
+        Ok(())
+    }
+}
@@ -1,6 +1,16 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+//! Timers are kept in a hierarchical timing wheel. Arming and disarming a timer are O(1), and advancing the clock
+//! only visits slots that hold timers, so the cost of [SharedTimer::advance_clock] does not depend on how many timers
+//! are armed or on how far the clock jumps.
+//!
+//! The wheel has [NUM_LEVELS] levels of [NUM_SLOTS] slots each. A slot on level `l` spans `NUM_SLOTS^l` ticks of
+//! [TICK] each, so level 0 covers the next [NUM_SLOTS] ticks with one slot per tick, and every level above covers
+//! [NUM_SLOTS] times more time than the one below. When the clock enters a slot on a level above 0, its timers are
+//! cascaded down to the level that matches how far away they are now. Timers always fire on their exact expiry, not on
+//! tick boundaries: timers that are due later within the current tick wait in their slot for the next clock advance.
+
 //==============================================================================
 // Imports
 //==============================================================================
@@ -8,10 +18,12 @@
 use crate::runtime::{
     SharedConditionVariable,
     SharedObject,
+    TIMER_RESOLUTION,
 };
-use ::core::cmp::Reverse;
+use ::slab::Slab;
 use ::std::{
-    collections::BinaryHeap,
+    cmp,
+    mem,
     ops::{
         Deref,
         DerefMut,
@@ -22,49 +34,275 @@ use ::std::{
     },
 };
 
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Time that we budget for one iteration of the poll loop of the runtime.
+const POLL_ITERATION_TIME: Duration = Duration::from_micros(16);
+
+/// Granularity of the timing wheel. The runtime reads the clock once every [TIMER_RESOLUTION] iterations of its poll
+/// loop, so a tick spans that many iterations (about 1 ms). Most clock advances then visit at most a handful of slots.
+const TICK: Duration = Duration::from_micros(POLL_ITERATION_TIME.as_micros() as u64 * TIMER_RESOLUTION as u64);
+
+/// Number of bits of a tick that select a slot on each level.
+const SLOT_BITS: u32 = 6;
+
+/// Number of slots on each level.
+const NUM_SLOTS: usize = 1 << SLOT_BITS;
+
+/// Number of levels, which lets the wheel hold timers up to 2^36 ticks (a little over two years) ahead.
+const NUM_LEVELS: usize = 6;
+
+/// Timers that are further ahead than this (in ticks) are parked on the last slot within reach, and cascaded again
+/// from there.
+const MAX_TICKS: u64 = 1 << (SLOT_BITS * NUM_LEVELS as u32);
+
 //==============================================================================
 // Structures
 //==============================================================================
 
-struct TimerQueueEntry {
+/// Key of a timer armed in a [TimingWheel].
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub struct TimerKey {
+    /// Index of the entry in the wheel.
+    index: usize,
+    /// Unique identifier, so that the key of a timer that already fired cannot disarm a newer timer that reused its
+    /// index.
+    id: u64,
+}
+
+/// A timer armed in a [TimingWheel].
+struct WheelEntry<T> {
     expiry: Instant,
-    cond_var: SharedConditionVariable,
+    /// Tick of the expiry, relative to the origin of the wheel.
+    tick: u64,
+    id: u64,
+    /// Slot that holds the entry (as an index into [TimingWheel::slots]), and position in that slot.
+    slot: usize,
+    position: usize,
+    value: T,
+}
+
+/// Hierarchical timing wheel.
+pub struct TimingWheel<T> {
+    /// Time of tick zero.
+    origin: Instant,
+    /// Tick up to which all slots have been processed.
+    elapsed: u64,
+    entries: Slab<WheelEntry<T>>,
+    /// Entries in each slot, level after level.
+    slots: Vec<Vec<usize>>,
+    /// Bitmap of non-empty slots on each level.
+    occupied: [u64; NUM_LEVELS],
+    next_id: u64,
 }
 
 /// Timer that holds one or more events for future wake up.
 pub struct Timer {
     now: Instant,
-    // Use a reverse to get a min heap.
-    heap: BinaryHeap<Reverse<TimerQueueEntry>>,
+    wheel: TimingWheel<SharedConditionVariable>,
 }
 
 #[derive(Clone)]
 pub struct SharedTimer(SharedObject<Timer>);
 
+/// Disarms a timer when the future that waits on it is dropped before the timer fires.
+struct ArmedTimer {
+    timer: SharedTimer,
+    key: TimerKey,
+}
+
 //==============================================================================
 // Associate Functions
 //==============================================================================
 
+impl<T> TimingWheel<T> {
+    pub fn new(origin: Instant) -> Self {
+        Self {
+            origin,
+            elapsed: 0,
+            entries: Slab::new(),
+            slots: (0..(NUM_LEVELS * NUM_SLOTS)).map(|_| Vec::new()).collect(),
+            occupied: [0; NUM_LEVELS],
+            next_id: 0,
+        }
+    }
+
+    /// Returns the number of armed timers.
+    #[cfg(test)]
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    /// Arms a timer that carries `value` and fires on `expiry`.
+    pub fn insert(&mut self, expiry: Instant, value: T) -> TimerKey {
+        let id: u64 = self.next_id;
+        self.next_id += 1;
+        let tick: u64 = self.tick_of(expiry);
+        let index: usize = self.entries.insert(WheelEntry {
+            expiry,
+            tick,
+            id,
+            slot: 0,
+            position: 0,
+            value,
+        });
+        self.link(index);
+        TimerKey { index, id }
+    }
+
+    /// Disarms a timer. Returns its value, or `None` if it already fired or was disarmed.
+    pub fn remove(&mut self, key: TimerKey) -> Option<T> {
+        match self.entries.get(key.index) {
+            Some(entry) if entry.id == key.id => {
+                self.unlink(key.index);
+                Some(self.entries.remove(key.index).value)
+            },
+            _ => None,
+        }
+    }
+
+    /// Moves the wheel forward to `now`, and hands the value of every timer that expired on or before it to `expire`.
+    pub fn advance(&mut self, now: Instant, mut expire: impl FnMut(T)) {
+        let now_tick: u64 = self.tick_of(now);
+        let mut not_yet_due: Vec<usize> = Vec::new();
+
+        while let Some((level, slot, deadline)) = self.next_expiration() {
+            if deadline > now_tick {
+                break;
+            }
+            self.elapsed = cmp::max(self.elapsed, deadline);
+
+            let index: usize = level * NUM_SLOTS + slot;
+            let mut bucket: Vec<usize> = mem::take(&mut self.slots[index]);
+            self.occupied[level] &= !(1 << slot);
+            for key in bucket.drain(..) {
+                let entry: &WheelEntry<T> = &self.entries[key];
+                if entry.expiry <= now {
+                    expire(self.entries.remove(key).value);
+                } else if level == 0 && entry.tick == deadline {
+                    // Due later within the current tick.
+                    not_yet_due.push(key);
+                } else {
+                    // Cascade to a lower level.
+                    self.link(key);
+                }
+            }
+            // Keep the allocation around, unless something was linked back into this very slot.
+            if self.slots[index].is_empty() {
+                self.slots[index] = bucket;
+            }
+        }
+
+        self.elapsed = cmp::max(self.elapsed, now_tick);
+        for key in not_yet_due {
+            self.link(key);
+        }
+    }
+
+    /// Returns the start of the tick of the earliest non-empty slot. No armed timer fires before then.
+    pub fn next_deadline(&self) -> Option<Instant> {
+        self.next_expiration()
+            .map(|(_, _, deadline)| self.origin + Duration::from_nanos(deadline * TICK.as_nanos() as u64))
+    }
+
+    /// Moves the origin of the wheel, and re-arms all timers relative to it.
+    pub fn rebase(&mut self, origin: Instant) {
+        self.origin = origin;
+        self.elapsed = 0;
+        for bucket in self.slots.iter_mut() {
+            bucket.clear();
+        }
+        self.occupied = [0; NUM_LEVELS];
+        let keys: Vec<usize> = self.entries.iter().map(|(key, _)| key).collect();
+        for key in keys {
+            let tick: u64 = self.tick_of(self.entries[key].expiry);
+            self.entries[key].tick = tick;
+            self.link(key);
+        }
+    }
+
+    /// Converts an instant into ticks since the origin of the wheel, rounding down.
+    fn tick_of(&self, instant: Instant) -> u64 {
+        (instant.saturating_duration_since(self.origin).as_nanos() / TICK.as_nanos()) as u64
+    }
+
+    /// Places an entry on the slot that matches how far away from the current tick it is.
+    fn link(&mut self, key: usize) {
+        let when: u64 = cmp::min(
+            cmp::max(self.entries[key].tick, self.elapsed),
+            self.elapsed + MAX_TICKS - 1,
+        );
+        let level: usize = Self::level_for(self.elapsed, when);
+        let slot: usize = ((when >> (SLOT_BITS * level as u32)) as usize) & (NUM_SLOTS - 1);
+        let index: usize = level * NUM_SLOTS + slot;
+
+        let entry: &mut WheelEntry<T> = &mut self.entries[key];
+        entry.slot = index;
+        entry.position = self.slots[index].len();
+        self.slots[index].push(key);
+        self.occupied[level] |= 1 << slot;
+    }
+
+    /// Removes an entry from its slot.
+    fn unlink(&mut self, key: usize) {
+        let (index, position): (usize, usize) = (self.entries[key].slot, self.entries[key].position);
+        let bucket: &mut Vec<usize> = &mut self.slots[index];
+        bucket.swap_remove(position);
+        if let Some(&moved) = bucket.get(position) {
+            self.entries[moved].position = position;
+        }
+        if bucket.is_empty() {
+            self.occupied[index / NUM_SLOTS] &= !(1 << (index % NUM_SLOTS));
+        }
+    }
+
+    /// Returns the level of the slot for a timer that fires on tick `when`. This is the highest level in which the
+    /// slot numbers of `elapsed` and `when` differ.
+    fn level_for(elapsed: u64, when: u64) -> usize {
+        let masked: u64 = (elapsed ^ when) | (NUM_SLOTS as u64 - 1);
+        let significant: u32 = u64::BITS - 1 - masked.leading_zeros();
+        cmp::min((significant / SLOT_BITS) as usize, NUM_LEVELS - 1)
+    }
+
+    /// Returns the level, slot and first tick of the earliest non-empty slot.
+    fn next_expiration(&self) -> Option<(usize, usize, u64)> {
+        let mut earliest: Option<(usize, usize, u64)> = None;
+        for level in 0..NUM_LEVELS {
+            if self.occupied[level] == 0 {
+                continue;
+            }
+            let slot_range: u64 = 1 << (SLOT_BITS * level as u32);
+            let level_range: u64 = slot_range << SLOT_BITS;
+            let current: u32 = ((self.elapsed / slot_range) % NUM_SLOTS as u64) as u32;
+            let slot: usize =
+                ((self.occupied[level].rotate_right(current).trailing_zeros() + current) as usize) % NUM_SLOTS;
+            let mut deadline: u64 = (self.elapsed & !(level_range - 1)) + slot as u64 * slot_range;
+            if (slot as u32) < current {
+                // Wraps around into the next turn of this level.
+                deadline += level_range;
+            }
+            if earliest.map_or(true, |(_, _, earliest_deadline)| deadline < earliest_deadline) {
+                earliest = Some((level, slot, deadline));
+            }
+        }
+        earliest
+    }
+}
+
 impl SharedTimer {
     /// This sets the time but is only used for initialization.
     pub fn set_time(&mut self, now: Instant) {
         self.now = now;
+        self.wheel.rebase(now);
     }
 
+    /// Moves the clock forward and fires all timers that expired, in one batch.
     pub fn advance_clock(&mut self, now: Instant) {
         assert!(self.now <= now);
-
-        while let Some(Reverse(entry)) = self.heap.peek() {
-            if now < entry.expiry {
-                break;
-            }
-            let mut entry: TimerQueueEntry = self
-                .heap
-                .pop()
-                .expect("should have an entry because we were able to peek")
-                .0;
-            entry.cond_var.broadcast();
-        }
+        self.wheel
+            .advance(now, |mut cond_var: SharedConditionVariable| cond_var.broadcast());
         self.now = now;
     }
 
@@ -72,17 +310,25 @@ impl SharedTimer {
         self.now
     }
 
+    /// Returns a time before which no armed timer fires, if any timer is armed.
+    pub fn next_deadline(&self) -> Option<Instant> {
+        self.wheel.next_deadline()
+    }
+
     pub async fn wait(self, timeout: Duration, cond_var: SharedConditionVariable) {
         let now: Instant = self.now;
         self.wait_until(now + timeout, cond_var).await
     }
 
     pub async fn wait_until(mut self, expiry: Instant, cond_var: SharedConditionVariable) {
-        let entry = TimerQueueEntry {
-            expiry,
-            cond_var: cond_var.clone(),
+        if self.now >= expiry {
+            return;
+        }
+        let key: TimerKey = self.wheel.insert(expiry, cond_var.clone());
+        let _armed: ArmedTimer = ArmedTimer {
+            timer: self.clone(),
+            key,
         };
-        self.heap.push(Reverse(entry));
         while self.now < expiry {
             cond_var.wait().await;
         }
@@ -95,9 +341,10 @@ impl SharedTimer {
 
 impl Default for SharedTimer {
     fn default() -> Self {
+        let now: Instant = Instant::now();
         Self(SharedObject::<Timer>::new(Timer {
-            now: Instant::now(),
-            heap: BinaryHeap::new(),
+            now,
+            wheel: TimingWheel::new(now),
         }))
     }
 }
@@ -116,118 +363,136 @@ impl DerefMut for SharedTimer {
     }
 }
 
-impl PartialEq for TimerQueueEntry {
-    fn eq(&self, other: &TimerQueueEntry) -> bool {
-        // This is technically not correct. However for the usage in this module
-        // we only need to compare timers by expiration.
-        self.expiry == other.expiry
+impl Drop for ArmedTimer {
+    fn drop(&mut self) {
+        self.timer.wheel.remove(self.key);
     }
 }
 
-impl Eq for TimerQueueEntry {}
+//==============================================================================
+// Unit Tests
+//==============================================================================
 
-impl PartialOrd for TimerQueueEntry {
-    fn partial_cmp(&self, other: &TimerQueueEntry) -> Option<core::cmp::Ordering> {
-        // Compare timer queue entries by expiration time
-        self.expiry.partial_cmp(&other.expiry)
+#[cfg(test)]
+mod tests {
+    use super::{
+        TimerKey,
+        TimingWheel,
+        TICK,
+    };
+    use ::anyhow::Result;
+    use ::std::time::{
+        Duration,
+        Instant,
+    };
+
+    /// Advances a wheel and returns the values of the timers that fired, sorted.
+    fn advance(wheel: &mut TimingWheel<usize>, now: Instant) -> Vec<usize> {
+        let mut fired: Vec<usize> = Vec::new();
+        wheel.advance(now, |value: usize| fired.push(value));
+        fired.sort();
+        fired
     }
-}
 
-impl Ord for TimerQueueEntry {
-    fn cmp(&self, other: &TimerQueueEntry) -> core::cmp::Ordering {
-        self.expiry.cmp(&other.expiry)
+    /// Tests that timers fire on their exact expiry, even within a tick.
+    #[test]
+    fn test_timing_wheel_fires_on_expiry() -> Result<()> {
+        let origin: Instant = Instant::now();
+        let mut wheel: TimingWheel<usize> = TimingWheel::new(origin);
+        let expiry: Instant = origin + TICK + TICK / 2;
+        wheel.insert(expiry, 1);
+
+        crate::ensure_eq!(advance(&mut wheel, origin + TICK), vec![]);
+        crate::ensure_eq!(advance(&mut wheel, expiry - Duration::from_nanos(1)), vec![]);
+        crate::ensure_eq!(advance(&mut wheel, expiry), vec![1]);
+        crate::ensure_eq!(wheel.len(), 0);
+
+        Ok(())
     }
-}
 
-//==============================================================================
-// Unit Tests
-//==============================================================================
+    /// Tests that disarmed timers do not fire, and that stale keys do not disarm other timers.
+    #[test]
+    fn test_timing_wheel_remove() -> Result<()> {
+        let origin: Instant = Instant::now();
+        let mut wheel: TimingWheel<usize> = TimingWheel::new(origin);
+        let key1: TimerKey = wheel.insert(origin + Duration::from_millis(10), 1);
+        let key2: TimerKey = wheel.insert(origin + Duration::from_millis(10), 2);
 
-// FIXME: Turning these off because they do not use the scheduler.
-
-// #[cfg(test)]
-// mod tests {
-//     use super::{
-//         SharedConditionVariable,
-//         SharedTimer,
-//     };
-//     use ::anyhow::Result;
-//     use futures::task::noop_waker_ref;
-//     use std::{
-//         future::Future,
-//         pin::Pin,
-//         task::Context,
-//         time::{
-//             Duration,
-//             Instant,
-//         },
-//     };
-
-//     #[test]
-//     fn test_timer() -> Result<()> {
-//         let mut ctx = Context::from_waker(noop_waker_ref());
-//         let mut now = Instant::now();
-
-//         // Add a single time out at start of test + 2 seconds.
-//         let mut timer: SharedTimer = SharedTimer::new(now);
-//         let cond_var: SharedConditionVariable = SharedConditionVariable::default();
-//         let wait_future1 = timer.clone().wait(Duration::from_secs(2), cond_var);
-//         futures::pin_mut!(wait_future1);
-
-//         // Check that the time out has not triggered.
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future1), &mut ctx).is_ready(), false);
-
-//         // Move time to start of test + 0.5 seconds.
-//         now += Duration::from_millis(500);
-//         timer.advance_clock(now);
-
-//         // Check that the first time out has not triggered.
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future1), &mut ctx).is_ready(), false);
-
-//         // Create second time out at start of test + 1.5 seconds.
-//         let cond_var2: SharedConditionVariable = SharedConditionVariable::default();
-//         let wait_future2 = timer.clone().wait(Duration::from_secs(1), cond_var2);
-//         futures::pin_mut!(wait_future2);
-
-//         // Check that both have not triggered.
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future1), &mut ctx).is_ready(), false);
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future2), &mut ctx).is_ready(), false);
-
-//         // Move time to start of test + 1 second.
-//         now += Duration::from_millis(500);
-//         timer.advance_clock(now);
-
-//         // Check that both time outs have not triggered
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future1), &mut ctx).is_ready(), false);
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future2), &mut ctx).is_ready(), false);
-
-//         // Create a new timeout for start of test + 5 seconds.
-//         let mut cond_var3: SharedConditionVariable = SharedConditionVariable::default();
-//         let wait_future3 = timer.clone().wait(Duration::from_secs(4), cond_var3.clone());
-//         futures::pin_mut!(wait_future3);
-
-//         // Move time to start of test + 1.5 seconds.
-//         now += Duration::from_millis(500);
-//         timer.advance_clock(now);
-
-//         // Check that timer2 has triggered but not timer1.
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future1), &mut ctx).is_ready(), false);
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future2), &mut ctx).is_ready(), true);
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future3), &mut ctx).is_ready(), false);
-
-//         // Move time to start of test + 2.15 seconds.
-//         now += Duration::from_millis(750);
-//         timer.advance_clock(now);
-
-//         // Check that timer1 has triggered.
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future1), &mut ctx).is_ready(), true);
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future3), &mut ctx).is_ready(), false);
-
-//         // Cancel the condition variable waiters and ensure that the timer does not fire.
-//         cond_var3.cancel();
-//         now += Duration::from_millis(10000);
-//         crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future3), &mut ctx).is_ready(), false);
-
-//         Ok(())
-//     }
-// }
+        crate::ensure_eq!(wheel.remove(key1), Some(1));
+        crate::ensure_eq!(wheel.remove(key1), None);
+        crate::ensure_eq!(advance(&mut wheel, origin + Duration::from_millis(10)), vec![2]);
+
+        // The index of the first timer is reused, but its key must not disarm the new one.
+        wheel.insert(origin + Duration::from_millis(20), 3);
+        crate::ensure_eq!(wheel.remove(key2), None);
+        crate::ensure_eq!(advance(&mut wheel, origin + Duration::from_millis(20)), vec![3]);
+
+        Ok(())
+    }
+
+    /// Tests that distant timers cascade through the levels and fire neither early nor late.
+    #[test]
+    fn test_timing_wheel_cascades() -> Result<()> {
+        let origin: Instant = Instant::now();
+        let mut wheel: TimingWheel<usize> = TimingWheel::new(origin);
+        let hour: Duration = Duration::from_secs(3600);
+        wheel.insert(origin + hour, 1);
+        wheel.insert(origin + 240 * hour, 2);
+        wheel.insert(origin + 365 * 24 * 3 * hour, 3);
+
+        crate::ensure_eq!(advance(&mut wheel, origin + hour - TICK), vec![]);
+        crate::ensure_eq!(advance(&mut wheel, origin + hour), vec![1]);
+        crate::ensure_eq!(advance(&mut wheel, origin + 239 * hour), vec![]);
+        crate::ensure_eq!(advance(&mut wheel, origin + 240 * hour + TICK), vec![2]);
+        crate::ensure_eq!(advance(&mut wheel, origin + 365 * 24 * 3 * hour - TICK), vec![]);
+        crate::ensure_eq!(advance(&mut wheel, origin + 365 * 24 * 3 * hour), vec![3]);
+
+        Ok(())
+    }
+
+    /// Tests the wheel against a naive list of timers, with pseudo-random expiries and clock advances.
+    #[test]
+    fn test_timing_wheel_matches_reference() -> Result<()> {
+        let origin: Instant = Instant::now();
+        let mut wheel: TimingWheel<usize> = TimingWheel::new(origin);
+        let mut reference: Vec<(Instant, usize, TimerKey)> = Vec::new();
+        let mut now: Instant = origin;
+        let mut seed: u64 = 0x2545f4914f6cdd1d;
+        let mut random = move |bound: u64| -> u64 {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            seed % bound
+        };
+
+        for value in 0..10000 {
+            // Arm a timer, anywhere from within the current tick up to about a minute ahead.
+            let range: u64 = 1 << random(27);
+            let expiry: Instant = now + Duration::from_micros(random(range));
+            let key: TimerKey = wheel.insert(expiry, value);
+            reference.push((expiry, value, key));
+
+            // Occasionally disarm a timer.
+            if random(4) == 0 {
+                let (_, value, key): (Instant, usize, TimerKey) =
+                    reference.swap_remove(random(reference.len() as u64) as usize);
+                crate::ensure_eq!(wheel.remove(key), Some(value));
+            }
+
+            // Move the clock forward.
+            let range: u64 = 1 << random(20);
+            now += Duration::from_micros(random(range));
+            let mut expected: Vec<usize> = reference
+                .iter()
+                .filter(|(expiry, _, _)| *expiry <= now)
+                .map(|(_, value, _)| *value)
+                .collect();
+            expected.sort();
+            reference.retain(|(expiry, _, _)| *expiry > now);
+            crate::ensure_eq!(advance(&mut wheel, now), expected);
+            crate::ensure_eq!(wheel.len(), reference.len());
+        }
+
+        Ok(())
+    }
+}
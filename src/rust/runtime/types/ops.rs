@@ -99,10 +99,16 @@ mod test {
         const QR_RET_SIZE: usize = 8;
         // Size of a demi_qr_value_t structure.
         const QR_VALUE_SIZE: usize = mem::size_of::<demi_qr_value_t>();
-        // Size of a demi_qresult_t structure.
+        // Size of a demi_qresult_t structure, which is padded to its alignment.
+        const QR_SIZE: usize = QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE;
         crate::ensure_eq!(
             mem::size_of::<demi_qresult_t>(),
-            QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE
+            QR_SIZE.next_multiple_of(mem::align_of::<demi_qresult_t>())
+        );
+        // Offset of the result value in a demi_qresult_t structure.
+        crate::ensure_eq!(
+            mem::offset_of!(demi_qresult_t, qr_value),
+            QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE
         );
         Ok(())
     }
@@ -0,0 +1,64 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#![allow(non_camel_case_types)]
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Snapshot of the statistics of a Demikernel thread.
+#[repr(C)]
+#[derive(Copy, Clone, Debug, Default, Eq, PartialEq)]
+pub struct demi_stats_t {
+    /// Packets that the network device handed to us.
+    pub rx_packets: u64,
+    /// Bytes in the packets that the network device handed to us.
+    pub rx_bytes: u64,
+    /// Received packets that were dropped.
+    pub rx_drops: u64,
+    /// Packets that the network device accepted for transmission.
+    pub tx_packets: u64,
+    /// Bytes in the packets that the network device accepted for transmission.
+    pub tx_bytes: u64,
+    /// Outgoing packets that were dropped.
+    pub tx_drops: u64,
+    /// Failed allocations of packet buffers.
+    pub mempool_exhausted: u64,
+    /// TCP segments that were sent again.
+    pub tcp_retransmits: u64,
+    /// Times that a TCP retransmission timeout was backed off.
+    pub tcp_rto_backoffs: u64,
+    /// Out-of-order TCP segments that are held for reassembly.
+    pub tcp_out_of_order_segments: u64,
+    /// Coroutines in the scheduler.
+    pub num_tasks: u64,
+    /// Completed operations whose results were not retrieved yet.
+    pub num_unclaimed_results: u64,
+    /// Times that wait calls blocked because they had nothing to do.
+    pub num_idle_blocks: u64,
+}
+
+/// Snapshot of the statistics of an I/O queue.
+#[repr(C)]
+#[derive(Copy, Clone, Debug, Default, Eq, PartialEq)]
+pub struct demi_qstats_t {
+    /// Operations that completed while wait calls were busy-polling.
+    pub num_spin_completions: u64,
+    /// Operations that completed after a wait call had blocked.
+    pub num_block_completions: u64,
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+    use std::mem;
+
+    /// Tests if the statistics structures have the sizes that the C interface expects.
+    #[test]
+    fn test_size_demi_stats_t() -> Result<(), anyhow::Error> {
+        crate::ensure_eq!(mem::size_of::<demi_stats_t>(), 13 * mem::size_of::<u64>());
+        crate::ensure_eq!(mem::size_of::<demi_qstats_t>(), 2 * mem::size_of::<u64>());
+        Ok(())
+    }
+}
@@ -0,0 +1,236 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Wait groups are persistent sets of queue tokens. A queue token is registered once in a wait group, and its result
+//! is routed to the wait group by a hash lookup as soon as the underlying operation completes. Waiting on a wait group
+//! therefore costs the same regardless of how many queue tokens are outstanding in it.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::{
+    fail::Fail,
+    queue::{
+        OperationResult,
+        QDesc,
+        QToken,
+    },
+};
+use ::slab::Slab;
+use ::std::collections::{
+    HashMap,
+    HashSet,
+    VecDeque,
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A set of queue tokens that are waited on together.
+#[derive(Default)]
+struct WaitGroup {
+    /// Queue tokens of operations that have not completed yet.
+    pending: HashSet<QToken>,
+    /// Results of completed operations, in completion order.
+    ready: VecDeque<(QToken, QDesc, OperationResult)>,
+}
+
+/// Table of wait groups.
+#[derive(Default)]
+pub struct WaitGroupTable {
+    /// Wait groups, indexed by wait group descriptor.
+    groups: Slab<WaitGroup>,
+    /// Maps each pending queue token to the wait group that it was added to.
+    membership: HashMap<QToken, usize>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Associated functions for wait group tables.
+impl WaitGroupTable {
+    /// Allocates a new, empty wait group and returns its descriptor.
+    pub fn alloc(&mut self) -> usize {
+        self.groups.insert(WaitGroup::default())
+    }
+
+    /// Releases the wait group `wgd`. Pending queue tokens are no longer routed to the wait group, and results that
+    /// were not retrieved are handed back to the caller.
+    pub fn free(&mut self, wgd: usize) -> Result<Vec<(QToken, QDesc, OperationResult)>, Fail> {
+        let group: WaitGroup = match self.groups.try_remove(wgd) {
+            Some(group) => group,
+            None => return Err(Self::bad_descriptor("free", wgd)),
+        };
+        for qt in group.pending.iter() {
+            self.membership.remove(qt);
+        }
+        Ok(group.ready.into_iter().collect())
+    }
+
+    /// Adds the queue token `qt` of an operation that has not completed yet to the wait group `wgd`.
+    pub fn add_pending(&mut self, wgd: usize, qt: QToken) -> Result<(), Fail> {
+        self.check_not_member(qt)?;
+        match self.groups.get_mut(wgd) {
+            Some(group) => {
+                group.pending.insert(qt);
+                self.membership.insert(qt, wgd);
+                Ok(())
+            },
+            None => Err(Self::bad_descriptor("add_pending", wgd)),
+        }
+    }
+
+    /// Adds the result of an operation that has already completed to the wait group `wgd`.
+    pub fn add_completed(&mut self, wgd: usize, qt: QToken, qd: QDesc, result: OperationResult) -> Result<(), Fail> {
+        match self.groups.get_mut(wgd) {
+            Some(group) => {
+                group.ready.push_back((qt, qd, result));
+                Ok(())
+            },
+            None => Err(Self::bad_descriptor("add_completed", wgd)),
+        }
+    }
+
+    /// Checks whether `wgd` refers to an allocated wait group.
+    pub fn contains(&self, wgd: usize) -> bool {
+        self.groups.contains(wgd)
+    }
+
+    /// Checks whether the queue token `qt` is pending in some wait group.
+    pub fn is_member(&self, qt: &QToken) -> bool {
+        self.membership.contains_key(qt)
+    }
+
+    /// Routes the result of a completed operation to the wait group of its queue token. If the queue token is not
+    /// pending in any wait group, the result is handed back to the caller.
+    pub fn complete(&mut self, qt: QToken, qd: QDesc, result: OperationResult) -> Option<(QDesc, OperationResult)> {
+        match self.membership.remove(&qt) {
+            Some(wgd) => {
+                let group: &mut WaitGroup = self.groups.get_mut(wgd).expect("wait group should be allocated");
+                group.pending.remove(&qt);
+                group.ready.push_back((qt, qd, result));
+                None
+            },
+            None => Some((qd, result)),
+        }
+    }
+
+    /// Removes the oldest result from the wait group `wgd`.
+    pub fn pop_ready(&mut self, wgd: usize) -> Result<Option<(QToken, QDesc, OperationResult)>, Fail> {
+        match self.groups.get_mut(wgd) {
+            Some(group) => Ok(group.ready.pop_front()),
+            None => Err(Self::bad_descriptor("pop_ready", wgd)),
+        }
+    }
+
+    /// Returns the number of queue tokens in the wait group `wgd`, both pending and completed.
+    pub fn len(&self, wgd: usize) -> Result<usize, Fail> {
+        match self.groups.get(wgd) {
+            Some(group) => Ok(group.pending.len() + group.ready.len()),
+            None => Err(Self::bad_descriptor("len", wgd)),
+        }
+    }
+
+    /// Returns the number of results that are waiting to be retrieved, across all wait groups.
+    pub fn num_ready(&self) -> usize {
+        self.groups.iter().map(|(_, group)| group.ready.len()).sum()
+    }
+
+    /// Fails if the queue token `qt` is already pending in some wait group.
+    fn check_not_member(&self, qt: QToken) -> Result<(), Fail> {
+        if self.is_member(&qt) {
+            let cause: String = format!("queue token is already in a wait group (qt={:?})", qt);
+            warn!("check_not_member(): {}", &cause);
+            return Err(Fail::new(libc::EEXIST, &cause));
+        }
+        Ok(())
+    }
+
+    /// Builds the error that is returned when `wgd` does not refer to an allocated wait group.
+    fn bad_descriptor(fn_name: &str, wgd: usize) -> Fail {
+        let cause: String = format!("invalid wait group descriptor (wgd={:?})", wgd);
+        warn!("{}(): {}", fn_name, &cause);
+        Fail::new(libc::EBADF, &cause)
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::WaitGroupTable;
+    use crate::runtime::{
+        OperationResult,
+        QDesc,
+        QToken,
+    };
+    use ::anyhow::Result;
+
+    /// Checks that results are routed to the wait group of their queue token, in completion order.
+    #[test]
+    fn complete_routes_results_to_wait_group() -> Result<()> {
+        let mut table: WaitGroupTable = WaitGroupTable::default();
+        let wgd: usize = table.alloc();
+        let qd: QDesc = QDesc::from(500);
+        table.add_pending(wgd, QToken::from(1))?;
+        table.add_pending(wgd, QToken::from(2))?;
+        crate::ensure_eq!(table.len(wgd)?, 2);
+
+        // Completions of queue tokens that are not in a wait group are handed back.
+        ::anyhow::ensure!(table.complete(QToken::from(3), qd, OperationResult::Push).is_some());
+
+        ::anyhow::ensure!(table.complete(QToken::from(2), qd, OperationResult::Push).is_none());
+        ::anyhow::ensure!(table.complete(QToken::from(1), qd, OperationResult::Close).is_none());
+        ::anyhow::ensure!(!table.is_member(&QToken::from(1)));
+        crate::ensure_eq!(table.num_ready(), 2);
+
+        match table.pop_ready(wgd)? {
+            Some((qt, _, OperationResult::Push)) => crate::ensure_eq!(qt, QToken::from(2)),
+            _ => ::anyhow::bail!("first result should be a push on the second queue token"),
+        }
+        match table.pop_ready(wgd)? {
+            Some((qt, _, OperationResult::Close)) => crate::ensure_eq!(qt, QToken::from(1)),
+            _ => ::anyhow::bail!("second result should be a close on the first queue token"),
+        }
+        ::anyhow::ensure!(table.pop_ready(wgd)?.is_none());
+        crate::ensure_eq!(table.len(wgd)?, 0);
+        crate::ensure_eq!(table.num_ready(), 0);
+        Ok(())
+    }
+
+    /// Checks that a queue token cannot be pending in two wait groups at once.
+    #[test]
+    fn add_pending_rejects_duplicates() -> Result<()> {
+        let mut table: WaitGroupTable = WaitGroupTable::default();
+        let first: usize = table.alloc();
+        let second: usize = table.alloc();
+        table.add_pending(first, QToken::from(1))?;
+        match table.add_pending(second, QToken::from(1)) {
+            Err(e) if e.errno == libc::EEXIST => Ok(()),
+            _ => ::anyhow::bail!("add_pending() should fail with EEXIST"),
+        }
+    }
+
+    /// Checks that freeing a wait group releases its queue tokens and hands back unretrieved results.
+    #[test]
+    fn free_releases_queue_tokens() -> Result<()> {
+        let mut table: WaitGroupTable = WaitGroupTable::default();
+        let wgd: usize = table.alloc();
+        table.add_pending(wgd, QToken::from(1))?;
+        table.add_completed(wgd, QToken::from(2), QDesc::from(500), OperationResult::Push)?;
+
+        let leftovers: Vec<(QToken, QDesc, OperationResult)> = table.free(wgd)?;
+        crate::ensure_eq!(leftovers.len(), 1);
+        ::anyhow::ensure!(!table.is_member(&QToken::from(1)));
+        ::anyhow::ensure!(!table.contains(wgd));
+        match table.pop_ready(wgd) {
+            Err(e) if e.errno == libc::EBADF => Ok(()),
+            _ => ::anyhow::bail!("pop_ready() should fail with EBADF on a freed wait group"),
+        }
+    }
+}
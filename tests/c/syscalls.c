@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <demi/libos.h>
 #include <demi/sga.h>
+#include <demi/stats.h>
 #include <demi/wait.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -123,6 +124,18 @@ static bool inval_pop(void)
     return (demi_pop(qt, qd) != 0);
 }
 
+/**
+ * @brief Issues an invalid system call to demi_pop_into().
+ */
+static bool inval_pop_into(void)
+{
+    demi_qtoken_t *qt = NULL;
+    int qd = -1;
+    demi_sgarray_t *sga = NULL;
+
+    return (demi_pop_into(qt, qd, sga) != 0);
+}
+
 /*===================================================================================================================*
  * System Calls in demi/sga.h                                                                                        *
  *===================================================================================================================*/
@@ -148,6 +161,17 @@ static bool inval_sgafree(void)
     return (demi_sgafree(sga) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_sgaappend().
+ */
+static bool inval_sgaappend(void)
+{
+    demi_sgarray_t *sga = NULL;
+    demi_sgarray_t *tail = NULL;
+
+    return (demi_sgaappend(sga, tail) != 0);
+}
+
 /*===================================================================================================================*
  * System Calls in demi/wait.h                                                                                       *
  *===================================================================================================================*/
@@ -178,6 +202,89 @@ static bool inval_wait_any(void)
     return (demi_wait_any(qr, ready_offset, qts, num_qts, timeout) != 0);
 }
 
+/**
+ * @brief Issues an invalid system call to demi_wait_many().
+ */
+static bool inval_wait_many(void)
+{
+    demi_qresult_t *qrs = NULL;
+    int *nqrs = NULL;
+    int max = -1;
+    demi_qtoken_t *qts = NULL;
+    int num_qts = -1;
+    struct timespec *timeout = NULL;
+
+    return (demi_wait_many(qrs, nqrs, max, qts, num_qts, timeout) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_wait_group_create().
+ */
+static bool inval_wait_group_create(void)
+{
+    int *wgd = NULL;
+
+    return (demi_wait_group_create(wgd) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_wait_group_add().
+ */
+static bool inval_wait_group_add(void)
+{
+    int wgd = -1;
+    demi_qtoken_t qt = -1;
+
+    return (demi_wait_group_add(wgd, qt) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_wait_group_wait().
+ */
+static bool inval_wait_group_wait(void)
+{
+    demi_qresult_t *qr = NULL;
+    int wgd = -1;
+    struct timespec *timeout = NULL;
+
+    return (demi_wait_group_wait(qr, wgd, timeout) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_wait_group_free().
+ */
+static bool inval_wait_group_free(void)
+{
+    int wgd = -1;
+
+    return (demi_wait_group_free(wgd) != 0);
+}
+
+/*===================================================================================================================*
+ * System Calls in demi/stats.h                                                                                      *
+ *===================================================================================================================*/
+
+/**
+ * @brief Issues an invalid system call to demi_getstats().
+ */
+static bool inval_getstats(void)
+{
+    demi_stats_t *stats = NULL;
+
+    return (demi_getstats(stats) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_getqstats().
+ */
+static bool inval_getqstats(void)
+{
+    demi_qstats_t qstats;
+    int qd = -1;
+
+    return (demi_getqstats(&qstats, qd) != 0);
+}
+
 /*===================================================================================================================*
  * main()                                                                                                            *
  *===================================================================================================================*/
@@ -198,18 +305,31 @@ static struct test tests_libos[] = {{inval_socket, "invalid demi_socket()"},   {
                                     {inval_bind, "invalid demi_bind()"},       {inval_close, "invalid_demi_close()"},
                                     {inval_connect, "invalid demi_connect()"}, {inval_listen, "invalid demi_listen()"},
                                     {inval_pop, "invalid demi_pop()"},         {inval_push, "invalid demi_push()"},
-                                    {inval_pushto, "invalid demi_pushto()"}};
+                                    {inval_pushto, "invalid demi_pushto()"},   {inval_pop_into, "invalid demi_pop_into()"}};
 
 /**
  * @brief Tests for system calls in demi/sga.h
  */
 static struct test tests_sga[] = {{inval_sgaalloc, "invalid demi_sgaalloc()"},
-                                  {inval_sgafree, "invalid demi_sgafree()"}};
+                                  {inval_sgafree, "invalid demi_sgafree()"},
+                                  {inval_sgaappend, "invalid demi_sgaappend()"}};
 
 /**
  * @brief Tests for system calls in demi/wait.h
  */
-static struct test tests_wait[] = {{inval_wait, "invalid demi_wait()"}, {inval_wait_any, "invalid demi_wait_any()"}};
+static struct test tests_wait[] = {{inval_wait, "invalid demi_wait()"},
+                                   {inval_wait_any, "invalid demi_wait_any()"},
+                                   {inval_wait_many, "invalid demi_wait_many()"},
+                                   {inval_wait_group_create, "invalid demi_wait_group_create()"},
+                                   {inval_wait_group_add, "invalid demi_wait_group_add()"},
+                                   {inval_wait_group_wait, "invalid demi_wait_group_wait()"},
+                                   {inval_wait_group_free, "invalid demi_wait_group_free()"}};
+
+/**
+ * @brief Tests for system calls in demi/stats.h
+ */
+static struct test tests_stats[] = {{inval_getstats, "invalid demi_getstats()"},
+                                    {inval_getqstats, "invalid demi_getqstats()"}};
 
 /**
  * @brief Drives the application.
@@ -268,5 +388,17 @@ int main(int argc, char *const argv[])
         }
     }
 
+    /* System calls in demi/stats.h */
+    for (size_t i = 0; i < sizeof(tests_stats) / sizeof(struct test); i++)
+    {
+        if (tests_stats[i].fn() == true)
+            fprintf(stderr, "test result: passed %s\n", tests_stats[i].name);
+        else
+        {
+            fprintf(stderr, "test result: FAILED %s\n", tests_stats[i].name);
+            return (EXIT_FAILURE);
+        }
+    }
+
     return (EXIT_SUCCESS);
 }
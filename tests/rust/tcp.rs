@@ -386,6 +386,106 @@ fn tcp_push_remote() -> Result<()> {
     Ok(())
 }
 
+/// Tests if data can be popped straight into a buffer of the application.
+#[test]
+fn tcp_push_pop_into() -> Result<()> {
+    let (alice_tx, alice_rx): (Sender<DemiBuffer>, Receiver<DemiBuffer>) = crossbeam_channel::unbounded();
+    let (bob_tx, bob_rx): (Sender<DemiBuffer>, Receiver<DemiBuffer>) = crossbeam_channel::unbounded();
+
+    let bob_barrier: Arc<Barrier> = Arc::new(Barrier::new(2));
+    let alice_barrier: Arc<Barrier> = bob_barrier.clone();
+
+    let alice: JoinHandle<Result<()>> = thread::spawn(move || {
+        let mut libos: DummyLibOS = match DummyLibOS::new(ALICE_MAC, ALICE_IPV4, alice_tx, bob_rx, arp()) {
+            Ok(libos) => libos,
+            Err(e) => anyhow::bail!("Could not create inetstack: {:?}", e),
+        };
+
+        let port: u16 = PORT_BASE;
+        let local: SocketAddr = SocketAddr::new(ALICE_IP, port);
+
+        // Open connection.
+        let sockqd: QDesc = safe_socket(&mut libos)?;
+        safe_bind(&mut libos, sockqd, local)?;
+        safe_listen(&mut libos, sockqd)?;
+        let qt: QToken = safe_accept(&mut libos, sockqd)?;
+        let (_, qr): (QDesc, OperationResult) = safe_wait(&mut libos, qt)?;
+        let qd: QDesc = match qr {
+            OperationResult::Accept((qd, addr)) if addr.ip() == &BOB_IPV4 => qd,
+            _ => anyhow::bail!("accept() has failed"),
+        };
+
+        // Pop data into a buffer that is larger than the data.
+        let sga: demi_sgarray_t = match libos.sgaalloc(64) {
+            Ok(sga) => sga,
+            Err(e) => anyhow::bail!("sgaalloc() failed: {:?}", e),
+        };
+        let qt: QToken = match libos.pop_into(qd, &sga) {
+            Ok(qt) => qt,
+            Err(e) => anyhow::bail!("pop_into() failed: {:?}", e),
+        };
+        let (qd, qr): (QDesc, OperationResult) = safe_wait(&mut libos, qt)?;
+        match qr {
+            // The data should land in the buffer that we provided.
+            OperationResult::Pop(_, buf) if buf.as_ptr() as *mut libc::c_void == sga.sga_segs[0].sgaseg_buf => {
+                if buf[..] != [b'a'; 32] {
+                    anyhow::bail!("pop_into() has received unexpected data")
+                }
+            },
+            _ => anyhow::bail!("pop_into() has has failed {:?}", qr),
+        }
+        if let Err(e) = libos.sgafree(sga) {
+            anyhow::bail!("sgafree() failed: {:?}", e)
+        }
+
+        // Close connection.
+        safe_close_active(&mut libos, qd)?;
+        safe_close_passive(&mut libos, sockqd)?;
+        alice_barrier.wait();
+        Ok(())
+    });
+
+    let bob: JoinHandle<Result<()>> = thread::spawn(move || {
+        let mut libos: DummyLibOS = match DummyLibOS::new(BOB_MAC, BOB_IPV4, bob_tx, alice_rx, arp()) {
+            Ok(libos) => libos,
+            Err(e) => anyhow::bail!("Could not create inetstack: {:?}", e),
+        };
+
+        let port: u16 = PORT_BASE;
+        let remote: SocketAddr = SocketAddr::new(ALICE_IP, port);
+
+        // Open connection.
+        let sockqd: QDesc = safe_socket(&mut libos)?;
+        let qt: QToken = safe_connect(&mut libos, sockqd, remote)?;
+        let (_, qr): (QDesc, OperationResult) = safe_wait(&mut libos, qt)?;
+        match qr {
+            OperationResult::Connect => (),
+            _ => anyhow::bail!("connect() has failed"),
+        }
+
+        // Cook some data and push.
+        let buf = libos.cook_data(32)?;
+        let qt: QToken = safe_push(&mut libos, sockqd, buf)?;
+        let (_, qr): (QDesc, OperationResult) = safe_wait(&mut libos, qt)?;
+        match qr {
+            OperationResult::Push => (),
+            _ => anyhow::bail!("push() has failed"),
+        }
+
+        // Close connection.
+        safe_close_active(&mut libos, sockqd)?;
+        bob_barrier.wait();
+
+        Ok(())
+    });
+    // It is safe to use unwrap here because there should not be any reason that we can't join the thread and if there
+    // is, there is nothing to clean up here on the main thread.
+    alice.join().unwrap()?;
+    bob.join().unwrap()?;
+
+    Ok(())
+}
+
 //======================================================================================================================
 // Bad Socket
 //======================================================================================================================